@@ -311,6 +311,7 @@ var match = [
 	{ re: "!TSF:MSG:LEN,(\\d+)!=(\\d+)", d: "Invalid message length, <b>$1</b> (actual) != <b>$2</b> (expected)" },
 	{ re: "!TSF:MSG:PVER,(\\d+)!=(\\d+)", d: "Message protocol version mismatch, <b>$1</b> (actual) != <b>$2</b> (expected)" },
 	{ re: "!TSF:MSG:SIGN VERIFY FAIL", d: "Signing verification failed" },
+	{ re: "!TSF:MSG:SIGN QUEUE FULL", d: "No room to queue the message for signature verification, message dropped" },
 	{ re: "!TSF:MSG:REL MSG,NORP", d: "Node received a message for relaying, but node is not a repeater, message skipped" },
 	{ re: "!TSF:MSG:SIGN FAIL", d: "Signing message failed" },
 	{ re: "!TSF:MSG:GWL FAIL", d: "GW uplink failed" },
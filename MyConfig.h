@@ -130,6 +130,8 @@
  * - 'F': CPU frequency
  * - 'M': free memory
  * - 'E': clear MySensors EEPROM area and reboot (i.e. "factory" reset)
+ * - 'Q': RX queue statistics (only with @ref MY_RX_MESSAGE_BUFFER_FEATURE):
+ *   "D=<dropped messages>,H=<high-water mark>,S=<queue size>"
  */
 //#define MY_SPECIAL_DEBUG
 
@@ -291,6 +293,37 @@
 #define MY_RS485_SOH_COUNT (1)
 #endif
 
+/**
+ * @def MY_RS485_CRC16
+ * @brief Define this to protect sent frames with a CRC16 instead of the 8 bit additive checksum.
+ *
+ * The option only selects the format of the frames a node sends. Each frame carries its format
+ * in a flag bit of the command byte, receivers check it per frame and accept both formats
+ * regardless of this setting, and ACKs are sent in the format of the frame they acknowledge.
+ * Releases before this option drop CRC16 frames, so update every node on the bus first, then
+ * enable it node by node.
+ */
+//#define MY_RS485_CRC16
+
+/**
+ * @def MY_RS485_ACK
+ * @brief Define this to have the recipient acknowledge sent frames, with retries if no ACK arrives.
+ *
+ * Without it transportSend() cannot detect lost frames. Sequenced frames and ACKs are dropped by
+ * older releases, so enable it on the whole bus.
+ */
+//#define MY_RS485_ACK
+
+/**
+ * @def MY_RS485_ACK_TIMEOUT_MS
+ * @brief Time the recipient has to start its ACK, on top of the ACK transmission time.
+ *
+ * Nodes only answer from transportDataAvailable(), so sketches blocking in loop() need more.
+ */
+#ifndef MY_RS485_ACK_TIMEOUT_MS
+#define MY_RS485_ACK_TIMEOUT_MS (50ul)
+#endif
+
 
 /**
  * @def MY_RS485_DE_PIN
@@ -411,8 +444,9 @@
  * @def MY_RX_MESSAGE_BUFFER_FEATURE
  * @brief This enables the receiving buffer feature.
  *
- * This feature is currently not supported for anything but RF24.
- * Require @ref MY_RF24_IRQ_PIN to be set.
+ * Supported for RF24, RFM95, RFM69 (new driver) and RS485. RF24 requires @ref MY_RF24_IRQ_PIN to be set.
+ * RFM95, RFM69 and RS485 always queue at least one received packet, so packets arriving while
+ * waiting for an ACK are kept; this feature sets the queue to @ref MY_RX_MESSAGE_BUFFER_SIZE packets.
  *
  * Note: Not supported on ESP8266, ESP32, STM32, nRF5 and sketches
  * that use SoftSPI. See below issue for details
@@ -422,9 +456,10 @@
 
 /**
  * @def MY_RX_MESSAGE_BUFFER_SIZE
- * @brief Define this to change the incoming message buffer size from the default.
+ * @brief Define this to change the incoming message buffer size from the default (127 max).
  *
- * Require @ref MY_RX_MESSAGE_BUFFER_FEATURE to be set.
+ * Require @ref MY_RX_MESSAGE_BUFFER_FEATURE to be set. On Linux this is only the default,
+ * rx_queue_size in mysensors.conf sets the size at runtime (32767 max).
  */
 #ifdef MY_RX_MESSAGE_BUFFER_FEATURE
 #ifndef MY_RX_MESSAGE_BUFFER_SIZE
@@ -1541,6 +1576,37 @@
 #define MY_OTA_FLASH_JDECID (0x1F65)
 #endif
 
+/**
+ * @def MY_OTA_WINDOW_SIZE
+ * @brief Number of FW blocks requested at once during an OTA update (max 32).
+ *
+ * With the default of 1 every block is requested and awaited separately. A larger value sends
+ * one ST_FIRMWARE_REQUEST_WINDOW for the next blocks, accepts the replies in any order and only
+ * re-requests the blocks that got lost. The controller must support ST_FIRMWARE_REQUEST_WINDOW,
+ * if none of the window requests are answered the node falls back to one block at a time.
+ */
+#ifndef MY_OTA_WINDOW_SIZE
+#define MY_OTA_WINDOW_SIZE (1u)
+#endif
+
+/**
+ * @def MY_OTA_SKIP_VERIFY_FLASH
+ * @brief Define this to skip reading the whole FW image back from flash to check its CRC.
+ *
+ * The CRC is accumulated while the blocks are received. By default the image is also read back
+ * once after the last block, which detects flash write errors. With this flag only the received
+ * data is checked, so the update completes without another pass over the flash.
+ */
+//#define MY_OTA_SKIP_VERIFY_FLASH
+
+/**
+ * @def MY_OTA_VERIFY_FLASH
+ * @brief Read the FW image back from flash to check its CRC, set unless @ref MY_OTA_SKIP_VERIFY_FLASH is defined.
+ */
+#if !defined(MY_OTA_SKIP_VERIFY_FLASH) && !defined(MY_OTA_VERIFY_FLASH)
+#define MY_OTA_VERIFY_FLASH
+#endif
+
 /**
  * @def MY_DISABLE_REMOTE_RESET
  * @brief Disables over-the-air reset of node
@@ -1578,6 +1644,41 @@
 #define MY_GATEWAY_MAX_CLIENTS (1u)
 #endif
 
+/**
+ * @def MY_GATEWAY_RX_BATCH_SIZE
+ * @brief Max number of controller messages handled per gatewayTransportProcess() call.
+ *
+ * Buffered messages are handled in batches instead of one per loop, the limit keeps the radio
+ * serviced during bulk commands from the controller.
+ */
+#ifndef MY_GATEWAY_RX_BATCH_SIZE
+#define MY_GATEWAY_RX_BATCH_SIZE (8u)
+#endif
+
+/**
+ * @def MY_GATEWAY_BINARY_PROTOCOL_FEATURE
+ * @brief Define this to let the controller switch its connection to the binary protocol.
+ *
+ * Binary frames are a length byte followed by the raw MyMessage header and payload, which saves
+ * the text formatting and parsing on both ends. A connection starts with the text protocol, the
+ * controller sends the handshake 0xFF 'M' 'S' <version> to switch it to binary. The gateway
+ * answers with the same handshake carrying the version it speaks, everything following that
+ * answer is sent as binary frames. Supported by the serial and TCP gateways.
+ */
+//#define MY_GATEWAY_BINARY_PROTOCOL_FEATURE
+
+/**
+ * @def MY_GATEWAY_BINARY_PROTOCOL
+ * @brief Define this to start every controller connection with the binary protocol.
+ *
+ * The gateway sends its handshake when the connection is established, no negotiation is needed.
+ * Implies @ref MY_GATEWAY_BINARY_PROTOCOL_FEATURE.
+ */
+//#define MY_GATEWAY_BINARY_PROTOCOL
+#if defined(MY_GATEWAY_BINARY_PROTOCOL) && !defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+#define MY_GATEWAY_BINARY_PROTOCOL_FEATURE
+#endif
+
 /**
  * @def MY_INCLUSION_MODE_FEATURE
  * @brief Define this to enable the inclusion mode feature.
@@ -1729,6 +1830,23 @@
  */
 //#define MY_MQTT_CLIENT_PUBLISH_RETAIN
 
+/**
+ * @def MY_MQTT_RX_QUEUE_SIZE
+ * @brief Number of received controller messages the MQTT gateway buffers (127 max).
+ *
+ * A single PubSubClient loop() can deliver many publishes, e.g. when the controller restores
+ * actuator states. Messages arriving while the queue is full are dropped and counted.
+ * Every entry is a MyMessage, so MCU gateways default to a small queue; raise it if the log
+ * reports dropped messages and RAM allows.
+ */
+#ifndef MY_MQTT_RX_QUEUE_SIZE
+#if defined(MY_GATEWAY_LINUX)
+#define MY_MQTT_RX_QUEUE_SIZE (64u)
+#else
+#define MY_MQTT_RX_QUEUE_SIZE (2u)
+#endif
+#endif
+
 /**
  * @def MY_MQTT_PASSWORD
  * @brief Used for authenticated MQTT connections.
@@ -2077,10 +2195,13 @@
  * | @ref MY_SIGNING_NODE_WHITELISTING | Defines a whitelist of trusted nodes | "#define" in the top of your sketch | @verbatim --my-signing-whitelist="<WHITELIST>" @endverbatim
  * | @ref MY_SIGNING_ATSHA204_PIN | Change default ATSHA204A communication pin | "#define" in the top of your sketch | Not supported
  * | @ref MY_SIGNING_SOFT_RANDOMSEED_PIN | Change default software RNG seed pin | "#define" in the top of your sketch | Not supported
+ * | @ref MY_SIGNING_SOFT_NONCE_TABLE_SIZE | Change number of nonces soft signing keeps outstanding | "#define" in the top of your sketch | Not supported
+ * | @ref MY_SIGNING_SOFT_VERIFY_WORKERS | Verify signatures on worker threads | Not supported | @verbatim --my-signing-verify-workers=<N> @endverbatim
  * | @ref MY_RF24_ENABLE_ENCRYPTION | Enables encryption on RF24 radios | "#define" in the top of your sketch | @verbatim --my-rf24-encryption-enabled @endverbatim
  * | @ref MY_RFM69_ENABLE_ENCRYPTION | Enables encryption on %RFM69 radios | "#define" in the top of your sketch | @verbatim --my-rfm69-encryption-enabled @endverbatim
  * | @ref MY_RFM95_ENABLE_ENCRYPTION | Enables encryption on %RFM95 radios | "#define" in the top of your sketch | @verbatim --my-rfm95-encryption-enabled @endverbatim
  * | @ref MY_NRF5_ESB_ENABLE_ENCRYPTION | Enables encryption on nRF5 radios | "#define" in the top of your sketch | Not supported
+ * | @ref MY_ENCRYPTION_CIPHERTEXT_STEALING | Sends encrypted messages without padding them to the %AES block size | "#define" in the top of your sketch | @verbatim --my-encryption-ciphertext-stealing @endverbatim
  * | @ref MY_NODE_LOCK_FEATURE | Enables the node locking feature | "#define" in the top of your sketch | Not supported
  * | @ref MY_NODE_UNLOCK_PIN | Change default unlock pin | "#define" in the top of your sketch | Not supported
  * | @ref MY_NODE_LOCK_COUNTER_MAX | Change default "malicious activity" counter max value | "#define" in the top of your sketch | Not supported
@@ -2243,6 +2364,33 @@
 #define MY_SIGNING_SOFT_RANDOMSEED_PIN (7)
 #endif
 
+/**
+ * @def MY_SIGNING_SOFT_NONCE_TABLE_SIZE
+ * @brief Number of nonces soft signing can have outstanding for verification at the same time
+ *
+ * Every nonce handed out is remembered together with the node that requested it, so signed
+ * messages from different nodes can be verified in any order. When the table is full the oldest
+ * nonce is dropped. Each entry costs 37 bytes of RAM. Linux gateways track every node (max 254),
+ * MCU gateways and repeaters default to 4 entries. Other nodes only ever wait on one nonce and
+ * default to 1.
+ */
+#if defined(DOXYGEN)
+#define MY_SIGNING_SOFT_NONCE_TABLE_SIZE
+#elif !defined(MY_SIGNING_SOFT_NONCE_TABLE_SIZE) && defined(__linux__)
+#define MY_SIGNING_SOFT_NONCE_TABLE_SIZE (254)
+#endif
+
+/**
+ * @def MY_SIGNING_SOFT_VERIFY_WORKERS
+ * @brief Number of threads verifying signatures of received messages (Linux only, max 64)
+ *
+ * A gateway serving many signing nodes spends most of its time calculating HMACs. With this set,
+ * signatures are checked by a pool of worker threads instead, so throughput scales with the
+ * number of cores. Nonce bookkeeping stays on the main thread and verified messages are processed
+ * in the order they arrived. Disabled by default, which verifies on the main thread.
+ */
+//#define MY_SIGNING_SOFT_VERIFY_WORKERS (4)
+
 /**
  * @def MY_LOCK_DEVICE
  * @brief Enable read back protection
@@ -2314,6 +2462,18 @@
 #endif
 #endif
 
+/**
+ * @def MY_ENCRYPTION_CIPHERTEXT_STEALING
+ * @brief Send encrypted messages at their plain length instead of padding them to 16 or 32 bytes.
+ *
+ * Messages longer than one %AES block are encrypted with CBC ciphertext stealing, shorter ones
+ * are still padded to 16 bytes. This saves up to 15 bytes of airtime per message.
+ *
+ * This flag changes the frame format and has to be identical on ALL nodes in the network.
+ * RFM69 encrypts in hardware and is not affected.
+ */
+//#define MY_ENCRYPTION_CIPHERTEXT_STEALING
+
 /**
  * @def MY_ENCRYPTION_FEATURE
  * @ingroup internals
@@ -2396,6 +2556,28 @@
  * @brief These options control platform specific configurations.
  * @{
  */
+/**
+ * @def MY_EEPROM_COMMIT_DELAY_MS
+ * @brief ESP8266/ESP32: Commit EEPROM changes to flash after no write happened for this long
+ *
+ * Every commit erases and rewrites a whole flash sector, which stalls the node for tens of
+ * milliseconds and wears the flash. Changes are kept in RAM and committed together once writing
+ * has settled, before sleeping and before rebooting. Set to 0 to commit every write.
+ */
+#ifndef MY_EEPROM_COMMIT_DELAY_MS
+#define MY_EEPROM_COMMIT_DELAY_MS (1000ul)
+#endif
+
+/**
+ * @def MY_EEPROM_COMMIT_MAX_DELAY_MS
+ * @brief ESP8266/ESP32: Maximum time an EEPROM change waits for its commit
+ *
+ * Bounds how much is lost on power failure while writes keep coming in.
+ */
+#ifndef MY_EEPROM_COMMIT_MAX_DELAY_MS
+#define MY_EEPROM_COMMIT_MAX_DELAY_MS (10*1000ul)
+#endif
+
 /**
  * @defgroup ESP8266SettingGrpPub ESP8266
  * @ingroup PlatformSettingGrpPub
@@ -2483,6 +2665,32 @@
 #ifndef MY_LINUX_CONFIG_FILE
 #define MY_LINUX_CONFIG_FILE "/etc/mysensors.conf"
 #endif
+
+/**
+ * @def MY_LINUX_EVENT_LOOP
+ * @brief Wait for events with epoll instead of polling every 10ms.
+ *
+ * The gateway sleeps until the controller socket(s), the serial port or the radio IRQ
+ * need attention, which lowers both latency and idle CPU usage. Radios without an IRQ pin
+ * (e.g. RF24 without @ref MY_RF24_IRQ_PIN) are still polled, see @ref MY_LINUX_EVENT_LOOP_TIMER_MS.
+ */
+//#define MY_LINUX_EVENT_LOOP
+
+/**
+ * @def MY_LINUX_EVENT_LOOP_TIMER_MS
+ * @brief Housekeeping period of the event loop in milliseconds.
+ *
+ * Bounds how long the loop sleeps without any event, so timeouts of the transport state
+ * machine, LED blinking and the sketch loop() keep running. wait() and other calls with a
+ * deadline wake up at their deadline instead. Defaults to 10ms if the radio has to be polled.
+ */
+#ifndef MY_LINUX_EVENT_LOOP_TIMER_MS
+#if defined(MY_RADIO_RF24) && !defined(MY_RF24_IRQ_PIN)
+#define MY_LINUX_EVENT_LOOP_TIMER_MS (10ul)
+#else
+#define MY_LINUX_EVENT_LOOP_TIMER_MS (100ul)
+#endif
+#endif
 /** @}*/ // End of LinuxSettingGrpPub group
 /** @}*/ // End of PlatformSettingGrpPub group
 
@@ -2511,6 +2719,15 @@
 #define MY_NODE_TYPE "NODE"
 #endif
 
+// Soft signing nonce table, sized once the node type is known (see MY_SIGNING_SOFT_NONCE_TABLE_SIZE)
+#if !defined(MY_SIGNING_SOFT_NONCE_TABLE_SIZE)
+#if defined(MY_GATEWAY_FEATURE) || defined(MY_REPEATER_FEATURE)
+#define MY_SIGNING_SOFT_NONCE_TABLE_SIZE (4)
+#else
+#define MY_SIGNING_SOFT_NONCE_TABLE_SIZE (1)
+#endif
+#endif
+
 // DEBUG
 #if defined(MY_DISABLED_SERIAL) && !defined(MY_DEBUG_OTA)
 #undef MY_DEBUG
@@ -2639,6 +2856,7 @@
 #define MY_LINUX_SERIAL_GROUPNAME
 #define MY_LINUX_SERIAL_PTY
 #define MY_LINUX_IS_SERIAL_PTY
+#define MY_LINUX_EVENT_LOOP
 // inclusion mode
 #define MY_INCLUSION_MODE_FEATURE
 #define MY_INCLUSION_BUTTON_FEATURE
@@ -2654,6 +2872,7 @@
 #define MY_REPEATER_FEATURE
 #define MY_PASSIVE_NODE
 #define MY_MQTT_CLIENT_PUBLISH_RETAIN
+#define MY_MQTT_RX_QUEUE_SIZE
 #define MY_MQTT_PASSWORD
 #define MY_MQTT_USER
 #define MY_MQTT_CLIENT_ID
@@ -2690,6 +2909,9 @@
 #define MY_GATEWAY_TINYGSM
 #define MY_GATEWAY_MQTT_CLIENT
 #define MY_GATEWAY_SERIAL
+#define MY_GATEWAY_BINARY_PROTOCOL_FEATURE
+#define MY_GATEWAY_BINARY_PROTOCOL
+#define MY_GATEWAY_RX_BATCH_SIZE
 #define MY_IP_ADDRESS
 #define MY_IP_GATEWAY_ADDRESS
 #define MY_IP_SUBNET_ADDRESS
@@ -2713,11 +2935,13 @@
 #define MY_SECURITY_SIMPLE_PASSWD
 #define MY_SIGNING_SIMPLE_PASSWD
 #define MY_ENCRYPTION_SIMPLE_PASSWD
+#define MY_ENCRYPTION_CIPHERTEXT_STEALING
 #define MY_SIGNING_ATSHA204
 #define MY_SIGNING_SOFT
 #define MY_SIGNING_REQUEST_SIGNATURES
 #define MY_SIGNING_WEAK_SECURITY
 #define MY_SIGNING_NODE_WHITELISTING
+#define MY_SIGNING_SOFT_VERIFY_WORKERS
 #define MY_DEBUG_VERBOSE_SIGNING
 #define MY_SIGNING_FEATURE
 #define MY_ENCRYPTION_FEATURE
@@ -2728,6 +2952,9 @@
 #define MY_RS485
 #define MY_RS485_DE_PIN
 #define MY_RS485_DE_INVERSE
+#define MY_RS485_CRC16
+#define MY_RS485_ACK
+#define MY_RS485_ACK_TIMEOUT_MS
 #define MY_RS485_HWSERIAL
 // PJON
 #define MY_PJON
@@ -27,7 +27,8 @@ extern MyMessage _msgTmp;
 
 inline void gatewayTransportProcess(void)
 {
-	if (gatewayTransportAvailable()) {
+	// Handle buffered messages in batches, but leave time for the radio
+	for (uint8_t i = 0; i < MY_GATEWAY_RX_BATCH_SIZE && gatewayTransportAvailable(); i++) {
 		_msg = gatewayTransportReceive();
 		if (_msg.getDestination() == GATEWAY_ADDRESS) {
 
@@ -51,6 +51,7 @@
 * | | GWT | TPS   | ETH OK                    | Connected to network
 * |!| GWT | TPS   | ETH FAIL                  | Connection failed
 * | | GWT | IMQ   | TOPIC=%%s,MSG RECEIVE     | MQTT message received on topic [%%s]
+* |!| GWT | IMQ   | QUEUE FULL,DROPPED=%%d    | MQTT receive queue full, message dropped, [%%d] dropped in total
 * | | GWT | RMQ   | CONNECTING...             | Connecting to MQTT broker
 * | | GWT | RMQ   | OK                        | Connected to MQTT broker
 * |!| GWT | RMQ   | FAIL                      | Connection to MQTT broker failed
@@ -59,6 +60,9 @@
 * |!| GWT | TPC   | DHCP FAIL                 | DHCP request failed
 * | | GWT | RFC   | C=%%d,MSG=%%s             | Received message [%%s] from client [%%d]
 * |!| GWT | RFC   | C=%%d,MSG TOO LONG        | Received message from client [%%d] too long
+* |!| GWT | RFC   | PARSE ERROR=%%d           | Received line rejected, PROTOCOL_PARSE_ERROR_* code [%%d]
+* | | GWT | RFC   | BINARY PROTOCOL           | Client switched to the binary protocol
+* |!| GWT | RFC   | INVALID BINARY FRAME      | Received binary frame or handshake dropped
 * | | GWT | TSA   | UDP MSG=%%s               | Received UDP message [%%s]
 * | | GWT | TSA   | ETH OK                    | Connected to network
 * |!| GWT | TSA   | ETH FAIL                  | Connection failed
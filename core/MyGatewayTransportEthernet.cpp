@@ -86,8 +86,18 @@ typedef struct {
 	char string[MY_GATEWAY_MAX_RECEIVE_LENGTH];
 	// cppcheck-suppress unusedStructMember
 	uint8_t idx;
+#if defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+	// cppcheck-suppress unusedStructMember
+	bool binary;
+#endif
 } inputBuffer;
 
+#if defined(MY_GATEWAY_BINARY_PROTOCOL)
+#define GATEWAY_BINARY_DEFAULT (true)
+#else
+#define GATEWAY_BINARY_DEFAULT (false)
+#endif
+
 #if defined(MY_GATEWAY_ESP8266) || defined(MY_GATEWAY_ESP32)
 // Some re-defines to make code more readable below
 #define EthernetServer WiFiServer
@@ -140,6 +150,83 @@ void _w5100_spi_en(const bool enable)
 #endif
 }
 
+// Parse a received line, rejected lines are logged with the parser error
+bool _parseLine(const char *line, const size_t length)
+{
+	if (!length) {
+		// Empty line, e.g. the LF of a CR LF terminator
+		return false;
+	}
+	const uint8_t error = protocolParseSerial(_ethernetMsg, line, length);
+	if (error != PROTOCOL_PARSE_OK) {
+		GATEWAY_DEBUG(PSTR("!GWT:RFC:PARSE ERROR=%" PRIu8 "\n"), error);
+		return false;
+	}
+	return true;
+}
+
+#if !defined(MY_USE_UDP)
+// Reset the input of a new connection, sends the handshake if it starts with the binary protocol
+void _resetInput(EthernetClient &c, inputBuffer &input)
+{
+	input.idx = 0;
+#if defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+	input.binary = GATEWAY_BINARY_DEFAULT;
+	if (input.binary) {
+		uint8_t handshake[PROTOCOL_BINARY_HANDSHAKE_SIZE];
+		(void)c.write(handshake, protocolBinaryHandshake(handshake));
+	}
+#else
+	(void)c;
+#endif
+}
+
+// Write message in the protocol of the connection, text is formatted once for all connections
+int _writeToClient(EthernetClient &c, const inputBuffer &input, const MyMessage &message,
+                   char *&text)
+{
+#if defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+	if (input.binary) {
+		uint8_t frame[PROTOCOL_BINARY_FRAME_MAX_SIZE];
+		return c.write(frame, protocolMyMessage2Binary(message, frame));
+	}
+#else
+	(void)input;
+#endif
+	if (!text) {
+		text = protocolMyMessage2Serial(message);
+	}
+	return c.write((const uint8_t *)text, strlen(text));
+}
+
+#if defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+// Check if the next byte belongs to the binary parser: the connection speaks the binary protocol
+// or the byte is part of a handshake, which never starts a text line
+bool _isBinaryInput(const inputBuffer &input, const uint8_t nextByte)
+{
+	const uint8_t firstByte = input.idx ? (uint8_t)input.string[0] : nextByte;
+	return input.binary || firstByte == PROTOCOL_BINARY_MAGIC;
+}
+
+// Feed a byte to the binary parser
+// returns true once a message was parsed
+bool _readBinary(EthernetClient &c, inputBuffer &input, const uint8_t inByte)
+{
+	const uint8_t result = protocolBinaryParse(_ethernetMsg, (uint8_t *)input.string, input.idx,
+	                       inByte);
+	if (result == PROTOCOL_BINARY_HANDSHAKE) {
+		GATEWAY_DEBUG(PSTR("GWT:RFC:BINARY PROTOCOL\n"));
+		input.binary = true;
+		uint8_t handshake[PROTOCOL_BINARY_HANDSHAKE_SIZE];
+		(void)c.write(handshake, protocolBinaryHandshake(handshake));
+	} else if (result == PROTOCOL_BINARY_INVALID) {
+		GATEWAY_DEBUG(PSTR("!GWT:RFC:INVALID BINARY FRAME\n"));
+	}
+	return (result == PROTOCOL_BINARY_MESSAGE);
+}
+#endif
+#endif /* End of !MY_USE_UDP */
+
 #if !defined(MY_IP_ADDRESS) && defined(MY_GATEWAY_W5100)
 void gatewayTransportRenewIP(void)
 {
@@ -213,6 +300,7 @@ bool gatewayTransportInit(void)
 	if (client.connect(_ethernetControllerIP, MY_PORT)) {
 #endif /* End of MY_CONTROLLER_URL_ADDRESS */
 		GATEWAY_DEBUG(PSTR("GWT:TIN:ETH OK\n"));
+		_resetInput(client, inputString);
 		_w5100_spi_en(false);
 		gatewayTransportSend(buildGw(_msgTmp, I_GATEWAY_READY).set(F(MSG_GW_STARTUP_COMPLETE)));
 		_w5100_spi_en(true);
@@ -239,7 +327,11 @@ bool gatewayTransportInit(void)
 bool gatewayTransportSend(MyMessage &message)
 {
 	int nbytes = 0;
+#if defined(MY_GATEWAY_CLIENT_MODE) && defined(MY_USE_UDP)
 	char *_ethernetMessage = protocolMyMessage2Serial(message);
+#else
+	char *_ethernetMessage = NULL;	// Formatted on first use
+#endif
 
 	setIndication(INDICATION_GW_TX);
 
@@ -263,6 +355,7 @@ bool gatewayTransportSend(MyMessage &message)
 		if (client.connect(_ethernetControllerIP, MY_PORT)) {
 #endif /* End of MY_CONTROLLER_URL_ADDRESS */
 			GATEWAY_DEBUG(PSTR("GWT:TPS:ETH OK\n"));
+			_resetInput(client, inputString);
 			_w5100_spi_en(false);
 			gatewayTransportSend(buildGw(_msgTmp, I_GATEWAY_READY).set(MSG_GW_STARTUP_COMPLETE));
 			_w5100_spi_en(true);
@@ -274,17 +367,22 @@ bool gatewayTransportSend(MyMessage &message)
 			return false;
 		}
 	}
-	nbytes = client.write((const uint8_t *)_ethernetMessage, strlen(_ethernetMessage));
+	nbytes = _writeToClient(client, inputString, message, _ethernetMessage);
 #endif /* End of MY_USE_UDP */
 #else /* Else part of MY_GATEWAY_CLIENT_MODE */
 	// Send message to connected clients
-#if defined(MY_GATEWAY_ESP8266) || defined(MY_GATEWAY_ESP32)
+#if defined(MY_GATEWAY_ESP8266) || defined(MY_GATEWAY_ESP32) || (defined(MY_GATEWAY_LINUX) && defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE))
 	for (uint8_t i = 0; i < ARRAY_SIZE(clients); i++) {
 		if (clients[i] && clients[i].connected()) {
-			nbytes += clients[i].write((uint8_t *)_ethernetMessage, strlen(_ethernetMessage));
+			nbytes += _writeToClient(clients[i], inputString[i], message, _ethernetMessage);
 		}
 	}
+#elif defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+	if (client && client.connected()) {
+		nbytes = _writeToClient(client, inputString, message, _ethernetMessage);
+	}
 #else /* Else part of MY_GATEWAY_ESPxx*/
+	_ethernetMessage = protocolMyMessage2Serial(message);
 	nbytes = _ethernetServer.write(_ethernetMessage);
 #endif /* End of MY_GATEWAY_ESPxx */
 #endif /* End of MY_GATEWAY_CLIENT_MODE */
@@ -295,19 +393,76 @@ bool gatewayTransportSend(MyMessage &message)
 #if defined(MY_USE_UDP)
 // Nothing to do here
 #else
-#if (defined(MY_GATEWAY_ESP8266) || defined(MY_GATEWAY_ESP32) || defined(MY_GATEWAY_LINUX)) && !defined(MY_GATEWAY_CLIENT_MODE)
+#if defined(MY_GATEWAY_LINUX) && !defined(MY_GATEWAY_CLIENT_MODE)
+bool _readFromClient(uint8_t i)
+{
+	// Take whole lines from the client's receive buffer instead of going byte by byte
+	while (clients[i].available()) {
+#if defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+		if (_isBinaryInput(inputString[i], (uint8_t)clients[i].peek())) {
+			if (_readBinary(clients[i], inputString[i], (uint8_t)clients[i].read())) {
+				return true;
+			}
+			continue;
+		}
+#endif
+		if (!inputString[i].idx) {
+			// Parse complete lines straight from the receive buffer
+			size_t length;
+			const char *line = clients[i].readLineInPlace(&length);
+			if (line) {
+				GATEWAY_DEBUG(PSTR("GWT:RFC:C=%" PRIu8 ",MSG=%.*s\n"), i, (int)length, line);
+				if (_parseLine(line, length)) {
+					return true;
+				}
+				continue;
+			}
+		}
+		// Partial line, collect it in the input buffer
+		bool eol;
+		inputString[i].idx += clients[i].readLine(&inputString[i].string[inputString[i].idx],
+		                      MY_GATEWAY_MAX_RECEIVE_LENGTH - 1 - inputString[i].idx, &eol);
+		if (eol) {
+			// Add string terminator and prepare for the next message
+			inputString[i].string[inputString[i].idx] = 0;
+			GATEWAY_DEBUG(PSTR("GWT:RFC:C=%" PRIu8 ",MSG=%s\n"), i, inputString[i].string);
+			const uint8_t length = inputString[i].idx;
+			inputString[i].idx = 0;
+			if (_parseLine(inputString[i].string, length)) {
+				return true;
+			}
+		} else if (inputString[i].idx >= MY_GATEWAY_MAX_RECEIVE_LENGTH - 1) {
+			// Incoming message too long. Throw away
+			GATEWAY_DEBUG(PSTR("!GWT:RFC:C=%" PRIu8 ",MSG TOO LONG\n"), i);
+			inputString[i].idx = 0;
+			// Finished with this client's message. Next loop() we'll see if there's more to read.
+			break;
+		}
+	}
+	return false;
+}
+#elif (defined(MY_GATEWAY_ESP8266) || defined(MY_GATEWAY_ESP32)) && !defined(MY_GATEWAY_CLIENT_MODE)
 bool _readFromClient(uint8_t i)
 {
 	while (clients[i].connected() && clients[i].available()) {
 		const char inChar = clients[i].read();
+#if defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+		if (_isBinaryInput(inputString[i], (uint8_t)inChar)) {
+			if (_readBinary(clients[i], inputString[i], (uint8_t)inChar)) {
+				return true;
+			}
+			continue;
+		}
+#endif
 		if (inputString[i].idx < MY_GATEWAY_MAX_RECEIVE_LENGTH - 1) {
 			// if newline then command is complete
 			if (inChar == '\n' || inChar == '\r') {
 				// Add string terminator and prepare for the next message
 				inputString[i].string[inputString[i].idx] = 0;
 				GATEWAY_DEBUG(PSTR("GWT:RFC:C=%" PRIu8 ",MSG=%s\n"), i, inputString[i].string);
+				const uint8_t length = inputString[i].idx;
 				inputString[i].idx = 0;
-				if (protocolSerial2MyMessage(_ethernetMsg, inputString[i].string)) {
+				if (_parseLine(inputString[i].string, length)) {
 					return true;
 				}
 			} else {
@@ -329,14 +484,23 @@ bool _readFromClient(void)
 {
 	while (client.connected() && client.available()) {
 		const char inChar = client.read();
+#if defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+		if (_isBinaryInput(inputString, (uint8_t)inChar)) {
+			if (_readBinary(client, inputString, (uint8_t)inChar)) {
+				return true;
+			}
+			continue;
+		}
+#endif
 		if (inputString.idx < MY_GATEWAY_MAX_RECEIVE_LENGTH - 1) {
 			// if newline then command is complete
 			if (inChar == '\n' || inChar == '\r') {
 				// Add string terminator and prepare for the next message
 				inputString.string[inputString.idx] = 0;
 				GATEWAY_DEBUG(PSTR("GWT:RFC:MSG=%s\n"), inputString.string);
+				const uint8_t length = inputString.idx;
 				inputString.idx = 0;
-				if (protocolSerial2MyMessage(_ethernetMsg, inputString.string)) {
+				if (_parseLine(inputString.string, length)) {
 					return true;
 				}
 
@@ -370,11 +534,11 @@ bool gatewayTransportAvailable(void)
 	int packet_size = _ethernetServer.parsePacket();
 
 	if (packet_size) {
-		_ethernetServer.read(inputString.string, MY_GATEWAY_MAX_RECEIVE_LENGTH);
-		inputString.string[packet_size] = 0;
+		const int length = _ethernetServer.read(inputString.string, MY_GATEWAY_MAX_RECEIVE_LENGTH - 1);
+		inputString.string[length > 0 ? length : 0] = 0;
 		GATEWAY_DEBUG(PSTR("GWT:TSA:UDP MSG=%s\n"), inputString.string);
 		_w5100_spi_en(false);
-		const bool ok = protocolSerial2MyMessage(_ethernetMsg, inputString.string);
+		const bool ok = _parseLine(inputString.string, length > 0 ? length : 0);
 		if (ok) {
 			setIndication(INDICATION_GW_RX);
 		}
@@ -389,6 +553,7 @@ bool gatewayTransportAvailable(void)
 		if (client.connect(_ethernetControllerIP, MY_PORT)) {
 #endif /* End of MY_CONTROLLER_URL_ADDRESS */
 			GATEWAY_DEBUG(PSTR("GWT:TSA:ETH OK\n"));
+			_resetInput(client, inputString);
 			_w5100_spi_en(false);
 			gatewayTransportSend(buildGw(_msgTmp, I_GATEWAY_READY).set(F(MSG_GW_STARTUP_COMPLETE)));
 			_w5100_spi_en(true);
@@ -419,7 +584,7 @@ bool gatewayTransportAvailable(void)
 			//check if there are any new clients
 			if (_ethernetServer.hasClient()) {
 				clients[i] = _ethernetServer.available();
-				inputString[i].idx = 0;
+				_resetInput(clients[i], inputString[i]);
 				GATEWAY_DEBUG(PSTR("GWT:TSA:C=%" PRIu8 ",CONNECTED\n"), i);
 				gatewayTransportSend(buildGw(_msgTmp, I_GATEWAY_READY).set(MSG_GW_STARTUP_COMPLETE));
 				// Send presentation of locally attached sensors (and node if applicable)
@@ -453,6 +618,7 @@ bool gatewayTransportAvailable(void)
 			client.stop();
 			client = newclient;
 			GATEWAY_DEBUG(PSTR("GWT:TSA:ETH OK\n"));
+			_resetInput(client, inputString);
 			_w5100_spi_en(false);
 			gatewayTransportSend(buildGw(_msgTmp, I_GATEWAY_READY).set(MSG_GW_STARTUP_COMPLETE));
 			_w5100_spi_en(true);
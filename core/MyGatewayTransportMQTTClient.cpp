@@ -44,6 +44,11 @@
 // Topic structure: MY_MQTT_PUBLISH_TOPIC_PREFIX/NODE-ID/SENSOR-ID/CMD-TYPE/ACK-FLAG/SUB-TYPE
 
 #include "MyGatewayTransport.h"
+#include "drivers/CircularBuffer/SPSCCircularBuffer.h"
+
+#if (MY_MQTT_RX_QUEUE_SIZE < 1) || (MY_MQTT_RX_QUEUE_SIZE > 127)
+#error MY_MQTT_RX_QUEUE_SIZE must be between 1 and 127
+#endif
 
 // housekeeping, remove for 3.0.0
 #ifdef MY_ESP8266_SSID
@@ -165,8 +170,11 @@ static EthernetClient _MQTT_ethClient;
 
 static PubSubClient _MQTT_client(_MQTT_ethClient);
 static bool _MQTT_connecting = true;
-static bool _MQTT_available = false;
 static MyMessage _MQTT_msg;
+// Messages parsed by incomingMQTT(), a single loop() can deliver several publishes
+static MyMessage _MQTT_rxQueueStorage[MY_MQTT_RX_QUEUE_SIZE];
+static SPSCCircularBuffer<MyMessage> _MQTT_rxQueue(_MQTT_rxQueueStorage, MY_MQTT_RX_QUEUE_SIZE);
+static uint16_t _MQTT_rxDropped = 0;
 
 // cppcheck-suppress constParameter
 bool gatewayTransportSend(MyMessage &message)
@@ -189,7 +197,15 @@ bool gatewayTransportSend(MyMessage &message)
 void incomingMQTT(char *topic, uint8_t *payload, unsigned int length)
 {
 	GATEWAY_DEBUG(PSTR("GWT:IMQ:TOPIC=%s, MSG RECEIVED\n"), topic);
-	_MQTT_available = protocolMQTT2MyMessage(_MQTT_msg, topic, payload, length);
+	MyMessage *msg = _MQTT_rxQueue.getFront();
+	if (msg == NULL) {
+		_MQTT_rxDropped++;
+		GATEWAY_DEBUG(PSTR("!GWT:IMQ:QUEUE FULL,DROPPED=%" PRIu16 "\n"), _MQTT_rxDropped);
+		return;
+	}
+	if (protocolMQTT2MyMessage(*msg, topic, payload, length)) {
+		(void)_MQTT_rxQueue.pushFront(msg);
+	}
 	setIndication(INDICATION_GW_RX);
 }
 
@@ -383,13 +399,25 @@ bool gatewayTransportAvailable(void)
 		}
 		return false;
 	}
-	_MQTT_client.loop();
-	return _MQTT_available;
+	if (_MQTT_rxQueue.empty()) {
+		_MQTT_client.loop();
+	}
+	return !_MQTT_rxQueue.empty();
 }
 
 MyMessage & gatewayTransportReceive(void)
 {
-	// Return the last parsed message
-	_MQTT_available = false;
+	// Return the oldest parsed message
+	MyMessage *msg = _MQTT_rxQueue.getBack();
+	if (msg != NULL) {
+		_MQTT_msg = *msg;
+		(void)_MQTT_rxQueue.popBack();
+	}
+#if defined(MY_LINUX_EVENT_LOOP)
+	if (!_MQTT_rxQueue.empty()) {
+		// Leftovers of a batch must not wait for the next socket event
+		eventLoopPending();
+	}
+#endif
 	return _MQTT_msg;
 }
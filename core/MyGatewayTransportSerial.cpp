@@ -29,11 +29,31 @@ extern MyMessage _msgTmp;
 char _serialInputString[MY_GATEWAY_MAX_RECEIVE_LENGTH];    // A buffer for incoming commands from serial interface
 uint8_t _serialInputPos;
 MyMessage _serialMsg;
+#if defined(MY_GATEWAY_BINARY_PROTOCOL)
+bool _serialBinary = true;	// Controller speaks the binary protocol
+#elif defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+bool _serialBinary = false;	// Controller speaks the binary protocol
+#endif
+
+#if defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+void _serialSendHandshake(void)
+{
+	uint8_t handshake[PROTOCOL_BINARY_HANDSHAKE_SIZE];
+	(void)MY_SERIALDEVICE.write(handshake, protocolBinaryHandshake(handshake));
+}
+#endif
 
 // cppcheck-suppress constParameter
 bool gatewayTransportSend(MyMessage &message)
 {
 	setIndication(INDICATION_GW_TX);
+#if defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+	if (_serialBinary) {
+		uint8_t frame[PROTOCOL_BINARY_FRAME_MAX_SIZE];
+		(void)MY_SERIALDEVICE.write(frame, protocolMyMessage2Binary(message, frame));
+		return true;
+	}
+#endif
 	MY_SERIALDEVICE.print(protocolMyMessage2Serial(message));
 	// Serial print is always successful
 	return true;
@@ -41,6 +61,9 @@ bool gatewayTransportSend(MyMessage &message)
 
 bool gatewayTransportInit(void)
 {
+#if defined(MY_GATEWAY_BINARY_PROTOCOL)
+	_serialSendHandshake();
+#endif
 	(void)gatewayTransportSend(buildGw(_msgTmp, I_GATEWAY_READY).set(MSG_GW_STARTUP_COMPLETE));
 	// Send presentation of locally attached sensors (and node if applicable)
 	presentNode();
@@ -52,12 +75,29 @@ bool gatewayTransportAvailable(void)
 	while (MY_SERIALDEVICE.available()) {
 		// get the new byte:
 		const char inChar = (char)MY_SERIALDEVICE.read();
+#if defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+		// A line starting with the handshake magic is not text
+		const uint8_t firstByte = _serialInputPos ? (uint8_t)_serialInputString[0] : (uint8_t)inChar;
+		if (_serialBinary || firstByte == PROTOCOL_BINARY_MAGIC) {
+			const uint8_t result = protocolBinaryParse(_serialMsg, (uint8_t *)_serialInputString,
+			                       _serialInputPos, (uint8_t)inChar);
+			if (result == PROTOCOL_BINARY_HANDSHAKE) {
+				_serialBinary = true;
+				_serialSendHandshake();
+			} else if (result == PROTOCOL_BINARY_MESSAGE) {
+				setIndication(INDICATION_GW_RX);
+				return true;
+			}
+			continue;
+		}
+#endif
 		// if the incoming character is a newline, set a flag
 		// so the main loop can do something about it:
 		if (_serialInputPos < MY_GATEWAY_MAX_RECEIVE_LENGTH - 1) {
 			if (inChar == '\n') {
 				_serialInputString[_serialInputPos] = 0;
-				const bool ok = protocolSerial2MyMessage(_serialMsg, _serialInputString);
+				const bool ok = (protocolParseSerial(_serialMsg, _serialInputString,
+				                                     _serialInputPos) == PROTOCOL_PARSE_OK);
 				if (ok) {
 					setIndication(INDICATION_GW_RX);
 				}
@@ -235,6 +235,7 @@ typedef enum {
 	ST_IMAGE					= 5,	//!< Image
 	ST_FIRMWARE_CONFIRM	= 6, //!< Mark running firmware as valid (MyOTAFirmwareUpdateNVM + mcuboot)
 	ST_FIRMWARE_RESPONSE_RLE = 7,	//!< Response FW block with run length encoded data
+	ST_FIRMWARE_REQUEST_WINDOW = 8,	//!< Request a window of FW blocks, answered with one ST_FIRMWARE_RESPONSE per requested block, highest block first
 } mysensors_stream_t;
 
 /// @brief Type of payload
@@ -34,12 +34,14 @@ SPIFlash _flash(MY_OTA_FLASH_SS, MY_OTA_FLASH_JDECID);
 #ifndef MCUBOOT_PRESENT
 #define _flash_initialize()	_flash.initialize()
 #define _flash_readByte(addr)	_flash.readByte(addr)
+#define _flash_readBytes(addr, buf, len)	_flash.readBytes(addr, buf, len)
 #define _flash_writeBytes( dstaddr, data, size) _flash.writeBytes( dstaddr, data, size)
 #define  _flash_blockErase32K(num)  _flash.blockErase32K(num)
 #define _flash_busy() _flash.busy()
 #else
 #define _flash_initialize()	true
 #define _flash_readByte(addr)	(*((uint8_t *)(addr)))
+#define _flash_readBytes(addr, buf, len)	(void)memcpy(buf, (const void *)(addr), len)
 #define  _flash_blockErase32K(num)  Flash.erase((uint32_t *)FLASH_AREA_IMAGE_1_OFFSET_0, FLASH_AREA_IMAGE_1_SIZE_0)
 #define _flash_busy() false
 #endif
@@ -49,8 +51,82 @@ LOCAL bool _firmwareUpdateOngoing = false;
 LOCAL uint32_t _firmwareLastRequest;
 LOCAL uint16_t _firmwareBlock;
 LOCAL uint8_t _firmwareRetry;
+LOCAL uint8_t _firmwareWindow;
+LOCAL uint32_t _firmwareWindowMissing;
+#if MY_OTA_WINDOW_SIZE > 1
+LOCAL bool _firmwareWindowConfirmed;
+#endif
+LOCAL uint16_t _firmwareCrc;
+LOCAL uint16_t _firmwareCrcBlock;
 LOCAL bool _firmwareResponse(uint16_t block, uint8_t *data);
 
+// CRC16 (0xA001, reflected) lookup table, one nibble per step. The high nibbles of the entries are
+// all different, _firmwareCrcIndex maps them back to the entry, so the CRC can also run backwards.
+static const uint16_t _firmwareCrcTable[16] PROGMEM = {
+	0x0000, 0xCC01, 0xD801, 0x1400, 0xF001, 0x3C00, 0x2800, 0xE401,
+	0xA001, 0x6C00, 0x7800, 0xB401, 0x5000, 0x9C01, 0x8801, 0x4400
+};
+static const uint8_t _firmwareCrcIndex[16] PROGMEM = {
+	0x0, 0x3, 0x6, 0x5, 0xF, 0xC, 0x9, 0xA, 0xE, 0xD, 0x8, 0xB, 0x1, 0x2, 0x7, 0x4
+};
+
+#if defined(MY_OTA_VERIFY_FLASH)
+// Only the flash read back pass runs the CRC forwards
+LOCAL uint16_t _firmwareCrcUpdate(uint16_t crc, const uint8_t *data, const uint8_t length)
+{
+	for (uint8_t i = 0; i < length; i++) {
+		crc = (crc >> 4) ^ pgm_read_word(&_firmwareCrcTable[(crc ^ data[i]) & 0x0F]);
+		crc = (crc >> 4) ^ pgm_read_word(&_firmwareCrcTable[(crc ^ (data[i] >> 4)) & 0x0F]);
+	}
+	return crc;
+}
+#endif
+
+// Inverse of _firmwareCrcUpdate(): returns the CRC before data was added
+LOCAL uint16_t _firmwareCrcUndo(uint16_t crc, const uint8_t *data, const uint8_t length)
+{
+	for (uint8_t i = length; i > 0; i--) {
+		uint8_t index = pgm_read_byte(&_firmwareCrcIndex[crc >> 12]);
+		crc = ((crc ^ pgm_read_word(&_firmwareCrcTable[index])) << 4) | (index ^ (data[i - 1] >> 4));
+		index = pgm_read_byte(&_firmwareCrcIndex[crc >> 12]);
+		crc = ((crc ^ pgm_read_word(&_firmwareCrcTable[index])) << 4) | (index ^ (data[i - 1] & 0x0F));
+	}
+	return crc;
+}
+
+// Number of blocks in the current window, which ends at block 0 at the latest
+LOCAL uint8_t _firmwareWindowLength(void)
+{
+	return _firmwareBlock < _firmwareWindow ? (uint8_t)_firmwareBlock : _firmwareWindow;
+}
+
+// Open a window covering the next blocks below _firmwareBlock, all of them missing
+LOCAL void _firmwareWindowStart(void)
+{
+	const uint8_t length = _firmwareWindowLength();
+	_firmwareWindowMissing = length >= 32 ? 0xFFFFFFFFul : (1ul << length) - 1;
+}
+
+// Blocks arrive from the end of the image, so the CRC runs backwards from the expected value.
+// Once every block is in it is back at the initial value, unless the image is corrupt.
+LOCAL void _firmwareCrcAccumulate(const uint16_t block, const uint8_t *data)
+{
+	if (block != _firmwareCrcBlock - 1) {
+		// Arrived ahead of a block above it, picked up from flash once that one is in
+		return;
+	}
+	_firmwareCrc = _firmwareCrcUndo(_firmwareCrc, data, FIRMWARE_BLOCK_SIZE);
+	_firmwareCrcBlock--;
+	uint8_t buffer[FIRMWARE_BLOCK_SIZE];
+	while (_firmwareCrcBlock && (uint16_t)(_firmwareBlock - _firmwareCrcBlock) < _firmwareWindowLength() &&
+	        !(_firmwareWindowMissing & (1ul << (_firmwareBlock - _firmwareCrcBlock)))) {
+		_flash_readBytes(((_firmwareCrcBlock - 1) * FIRMWARE_BLOCK_SIZE) + FIRMWARE_START_OFFSET, buffer,
+		                 FIRMWARE_BLOCK_SIZE);
+		_firmwareCrc = _firmwareCrcUndo(_firmwareCrc, buffer, FIRMWARE_BLOCK_SIZE);
+		_firmwareCrcBlock--;
+	}
+}
+
 LOCAL void readFirmwareSettings(void)
 {
 	hwReadConfigBlock((void*)&_nodeFirmwareConfig, (void*)EEPROM_FIRMWARE_TYPE_ADDRESS,
@@ -61,6 +137,15 @@ LOCAL void firmwareOTAUpdateRequest(void)
 {
 	const uint32_t enterMS = hwMillis();
 	if (_firmwareUpdateOngoing && (enterMS - _firmwareLastRequest > MY_OTA_RETRY_DELAY)) {
+#if MY_OTA_WINDOW_SIZE > 1
+		if (!_firmwareRetry && _firmwareWindow > 1 && !_firmwareWindowConfirmed) {
+			// No window request was ever answered, the controller does not know ST_FIRMWARE_REQUEST_WINDOW
+			OTA_DEBUG(PSTR("!OTA:FRQ:WIN OFF\n"));
+			_firmwareWindow = 1;
+			_firmwareWindowStart();
+			_firmwareRetry = MY_OTA_RETRY + 1;
+		}
+#endif
 		if (!_firmwareRetry) {
 			setIndication(INDICATION_ERR_FW_TIMEOUT);
 			OTA_DEBUG(PSTR("!OTA:FRQ:FW UPD FAIL\n"));	// fw update failed
@@ -70,6 +155,22 @@ LOCAL void firmwareOTAUpdateRequest(void)
 		}
 		_firmwareRetry--;
 		_firmwareLastRequest = enterMS;
+#if MY_OTA_WINDOW_SIZE > 1
+		if (_firmwareWindow > 1) {
+			// (Re-)request the blocks of the current window that have not arrived yet
+			requestFirmwareWindow_t firmwareRequest;
+			firmwareRequest.type = _nodeFirmwareConfig.type;
+			firmwareRequest.version = _nodeFirmwareConfig.version;
+			firmwareRequest.block = (_firmwareBlock - 1);
+			firmwareRequest.missing = _firmwareWindowMissing;
+			OTA_DEBUG(PSTR("OTA:FRQ:FW REQ,T=%04" PRIX16 ",V=%04" PRIX16 ",B=%04" PRIX16 ",M=%08" PRIX32 "\n"),
+			          _nodeFirmwareConfig.type, _nodeFirmwareConfig.version, _firmwareBlock - 1,
+			          _firmwareWindowMissing); // request FW update window
+			(void)_sendRoute(build(_msgTmp, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_STREAM,
+			                       ST_FIRMWARE_REQUEST_WINDOW, false).set(&firmwareRequest, sizeof(requestFirmwareWindow_t)));
+			return;
+		}
+#endif
 		// Time to (re-)request firmware block from controller
 		requestFirmwareBlock_t firmwareRequest;
 		firmwareRequest.type = _nodeFirmwareConfig.type;
@@ -108,6 +209,13 @@ LOCAL bool firmwareOTAUpdateProcess(void)
 				// wait until flash erased
 				while ( _flash_busy() ) {}
 				_firmwareBlock = _nodeFirmwareConfig.blocks;
+				_firmwareWindow = MY_OTA_WINDOW_SIZE;
+#if MY_OTA_WINDOW_SIZE > 1
+				_firmwareWindowConfirmed = false;
+#endif
+				_firmwareWindowStart();
+				_firmwareCrc = _nodeFirmwareConfig.crc;
+				_firmwareCrcBlock = _nodeFirmwareConfig.blocks;
 				_firmwareUpdateOngoing = true;
 				// reset flags
 				_firmwareRetry = MY_OTA_RETRY + 1;
@@ -192,32 +300,38 @@ LOCAL bool isFirmwareUpdateOngoing(void)
 {
 	return _firmwareUpdateOngoing;
 }
-// do a crc16 on the whole received firmware
+// check the crc16 of the received firmware
 LOCAL bool transportIsValidFirmware(void)
 {
-	// init crc
+#if defined(MY_OTA_VERIFY_FLASH)
+	// Read the image back, this also catches blocks that did not make it into flash correctly
 	uint16_t crc = ~0;
-	for (uint32_t i = 0; i < _nodeFirmwareConfig.blocks * FIRMWARE_BLOCK_SIZE; ++i) {
-		crc ^= _flash_readByte(i + FIRMWARE_START_OFFSET);
-		for (int8_t j = 0; j < 8; ++j) {
-			if (crc & 1) {
-				crc = (crc >> 1) ^ 0xA001;
-			} else {
-				crc = (crc >> 1);
-			}
-		}
+	uint8_t buffer[FIRMWARE_BLOCK_SIZE];
+	for (uint16_t block = 0; block < _nodeFirmwareConfig.blocks; block++) {
+		_flash_readBytes((block * FIRMWARE_BLOCK_SIZE) + FIRMWARE_START_OFFSET, buffer,
+		                 FIRMWARE_BLOCK_SIZE);
+		crc = _firmwareCrcUpdate(crc, buffer, FIRMWARE_BLOCK_SIZE);
 	}
+	const bool valid = crc == _nodeFirmwareConfig.crc;
+#else
+	// Accumulated while receiving, (C) is the initial value FFFF for a valid image
+	const uint16_t crc = _firmwareCrc;
+	const bool valid = !_firmwareCrcBlock && crc == (uint16_t)~0;
+#endif
 	OTA_DEBUG(PSTR("OTA:CRC:B=%04" PRIX16 ",C=%04" PRIX16 ",F=%04" PRIX16 "\n"),
 	          _nodeFirmwareConfig.blocks,crc,
 	          _nodeFirmwareConfig.crc);
-	return crc == _nodeFirmwareConfig.crc;
+	return valid;
 }
 
 LOCAL bool _firmwareResponse(uint16_t block, uint8_t *data)
 {
 	if (_firmwareUpdateOngoing) {
 		OTA_DEBUG(PSTR("OTA:FWP:RECV B=%04" PRIX16 "\n"), block);	// received FW block
-		if (block != _firmwareBlock - 1) {
+		// Position of the block in the current window, blocks outside or already stored are rejected
+		const uint16_t offset = _firmwareBlock - 1 - block;
+		if (block >= _firmwareBlock || offset >= _firmwareWindowLength() ||
+		        !(_firmwareWindowMissing & (1ul << offset))) {
 			OTA_DEBUG(PSTR("!OTA:FWP:WRONG FWB\n"));	// received FW block
 			// wrong firmware block received
 			setIndication(INDICATION_FW_UPDATE_RX_ERR);
@@ -227,13 +341,13 @@ LOCAL bool _firmwareResponse(uint16_t block, uint8_t *data)
 		setIndication(INDICATION_FW_UPDATE_RX);
 		// Save block to flash
 #ifdef MCUBOOT_PRESENT
-		uint32_t addr = ((size_t)(((_firmwareBlock - 1) * FIRMWARE_BLOCK_SIZE)) + (size_t)(
+		uint32_t addr = ((size_t)((block * FIRMWARE_BLOCK_SIZE)) + (size_t)(
 		                     FIRMWARE_START_OFFSET));
 		if (addr<FLASH_AREA_IMAGE_SCRATCH_OFFSET_0) {
 			Flash.write_block( (uint32_t *)addr, (uint32_t *)data, FIRMWARE_BLOCK_SIZE>>2);
 		}
 #else
-		_flash_writeBytes( ((_firmwareBlock - 1) * FIRMWARE_BLOCK_SIZE) + FIRMWARE_START_OFFSET,
+		_flash_writeBytes( (block * FIRMWARE_BLOCK_SIZE) + FIRMWARE_START_OFFSET,
 		                   data, FIRMWARE_BLOCK_SIZE);
 #endif
 		// wait until flash written
@@ -241,7 +355,7 @@ LOCAL bool _firmwareResponse(uint16_t block, uint8_t *data)
 #ifdef OTA_EXTRA_FLASH_DEBUG
 		{
 			char prbuf[8];
-			uint32_t addr = ((_firmwareBlock - 1) * FIRMWARE_BLOCK_SIZE) + FIRMWARE_START_OFFSET;
+			uint32_t addr = (block * FIRMWARE_BLOCK_SIZE) + FIRMWARE_START_OFFSET;
 			OTA_DEBUG(PSTR("OTA:FWP:FL DUMP "));
 			sprintf_P(prbuf,PSTR("%04" PRIX16 ":"), (uint16_t)addr);
 			MY_SERIALDEVICE.print(prbuf);
@@ -253,7 +367,21 @@ LOCAL bool _firmwareResponse(uint16_t block, uint8_t *data)
 			OTA_DEBUG(PSTR("\n"));
 		}
 #endif
-		_firmwareBlock--;
+		_firmwareWindowMissing &= ~(1ul << offset);
+		_firmwareCrcAccumulate(block, data);
+#if MY_OTA_WINDOW_SIZE > 1
+		_firmwareWindowConfirmed = true;
+#endif
+		if (_firmwareWindowMissing) {
+			// The controller sends a window in descending block order. While lower blocks are still
+			// due, wait for them and re-request the holes if the stream stalls. Otherwise the holes
+			// got lost, re-request them right away
+			_firmwareRetry = MY_OTA_RETRY + 1;
+			_firmwareLastRequest = (_firmwareWindowMissing >> offset) ? hwMillis() : 0;
+			return true;
+		}
+		_firmwareBlock -= _firmwareWindowLength();
+		_firmwareWindowStart();
 		if (!_firmwareBlock) {
 			// We're done! Do a checksum and reboot.
 			OTA_DEBUG(PSTR("OTA:FWP:FW END\n"));	// received FW block
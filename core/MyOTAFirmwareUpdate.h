@@ -46,8 +46,10 @@
 * | | OTA | FWP | CRC OK                      | FW CRC verification OK
 * |!| OTA | FWP | CRC FAIL                    | FW CRC verification failed
 * | | OTA | FRQ | FW REQ,T=%04X,V=%04X,B=%04X | Request FW update, FW type (T), version (V), block (B)
+* | | OTA | FRQ | FW REQ,T=%04X,V=%04X,B=%04X,M=%08X | Request FW window, FW type (T), version (V), top block (B), missing blocks (M)
+* |!| OTA | FRQ | WIN OFF                     | Controller did not answer the window request, fall back to single blocks
 * |!| OTA | FRQ | FW UPD FAIL                 | FW update failed
-* | | OTA | CRC | B=%04X,C=%04X,F=%04X        | FW CRC verification. FW blocks (B), calculated CRC (C), FW CRC (F)
+* | | OTA | CRC | B=%04X,C=%04X,F=%04X        | FW CRC verification. FW blocks (B), calculated CRC (C), FW CRC (F). With @ref MY_OTA_SKIP_VERIFY_FLASH, C is the CRC run backwards from F and is FFFF for a valid FW
 *
 *
 * @brief API declaration for MyOTAFirmwareUpdate
@@ -79,6 +81,9 @@
 #ifndef MY_OTA_RETRY_DELAY
 #define MY_OTA_RETRY_DELAY		(500u)				//!< Number of milliseconds before re-requesting a FW block
 #endif
+#if MY_OTA_WINDOW_SIZE < 1 || MY_OTA_WINDOW_SIZE > 32
+#error MY_OTA_WINDOW_SIZE must be between 1 and 32
+#endif
 #ifndef MCUBOOT_PRESENT
 #define FIRMWARE_START_OFFSET	(10u)				//!< Start offset for firmware in flash (DualOptiboot wants to keeps a signature first)
 #else
@@ -147,6 +152,16 @@ typedef struct {
 	uint16_t block;								//!< Block index
 } __attribute__((packed)) requestFirmwareBlock_t;
 
+/**
+* @brief FW block window request structure
+*/
+typedef struct {
+	uint16_t type;								//!< Type of config
+	uint16_t version;							//!< Version of config
+	uint16_t block;								//!< Index of the first (highest) block in the window
+	uint32_t missing;							//!< Blocks to send in descending order, bit n requests block (block - n)
+} __attribute__((packed)) requestFirmwareWindow_t;
+
 /**
 * @brief  FW block reply structure
 */
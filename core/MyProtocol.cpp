@@ -26,66 +26,103 @@
 char _fmtBuffer[MY_GATEWAY_MAX_SEND_LENGTH];
 char _convBuffer[MAX_PAYLOAD_SIZE * 2 + 1];
 
-bool protocolSerial2MyMessage(MyMessage &message, char *inputString)
+// Hex digit value, 0xFF if c is not a hex digit
+static uint8_t _protocolH2I(const char c)
 {
-	char *str, *p;
-	uint8_t index = 0;
-	mysensors_command_t command = C_INVALID_7;
+	if (c >= '0' && c <= '9') {
+		return c - '0';
+	} else if (c >= 'a' && c <= 'f') {
+		return c - 'a' + 10;
+	} else if (c >= 'A' && c <= 'F') {
+		return c - 'A' + 10;
+	}
+	return 0xFF;
+}
+
+uint8_t protocolParseSerial(MyMessage &message, const char *input, const size_t length)
+{
+	const char *end = input + length;
+	// Remove trailing carriage return and newline characters
+	while (end > input && (end[-1] == '\r' || end[-1] == '\n')) {
+		end--;
+	}
+	// Header: destination;sensor;command;echo request;type
+	uint8_t field[5];
+	for (uint8_t index = 0; index < 5; index++) {
+		const char *start = input;
+		uint16_t value = 0;
+		while (input < end && *input != ';') {
+			const uint8_t digit = (uint8_t)(*input - '0');
+			if (digit > 9) {
+				return PROTOCOL_PARSE_ERROR_NUMBER;
+			}
+			value = value * 10 + digit;
+			if (value > UINT8_MAX) {
+				return PROTOCOL_PARSE_ERROR_RANGE;
+			}
+			input++;
+		}
+		if (input == start) {
+			return PROTOCOL_PARSE_ERROR_FIELDS;
+		}
+		field[index] = (uint8_t)value;
+		if (input < end) {
+			// Skip separator
+			input++;
+		} else if (index < 4) {
+			return PROTOCOL_PARSE_ERROR_FIELDS;
+		}
+	}
+	const mysensors_command_t command = static_cast<mysensors_command_t>(field[2]);
+	if (command > C_STREAM || field[3] > 1) {
+		return PROTOCOL_PARSE_ERROR_RANGE;
+	}
+	const size_t payloadLength = end - input;
+	if (payloadLength > (command == C_STREAM ? MAX_PAYLOAD_SIZE * 2 : MAX_PAYLOAD_SIZE)) {
+		return PROTOCOL_PARSE_ERROR_PAYLOAD;
+	}
+
 	message.setSender(GATEWAY_ADDRESS);
 	message.setLast(GATEWAY_ADDRESS);
 	message.setEcho(false);
+	message.setDestination(field[0]);
+	message.setSensor(field[1]);
+	message.setCommand(command);
+	message.setRequestEcho(field[3]);
+	message.setType(field[4]);
 
-	// Extract command data coming on serial line
-	for (str = strtok_r(inputString, ";", &p); // split using semicolon
-	        str && index < 5; // loop while str is not null an max 4 times
-	        str = strtok_r(NULL, ";", &p), index++ // get subsequent tokens
-	    ) {
-		switch (index) {
-		case 0: // Radio id (destination)
-			message.setDestination(atoi(str));
-			break;
-		case 1: // Child id
-			message.setSensor(atoi(str));
-			break;
-		case 2: // Message type
-			command = static_cast<mysensors_command_t>(atoi(str));
-			message.setCommand(command);
-			break;
-		case 3: // Should we request echo from destination?
-			message.setRequestEcho(atoi(str) ? 1 : 0);
-			break;
-		case 4: // Data type
-			message.setType(atoi(str));
-			break;
-		}
-	}
-	// payload
-	if (str == NULL) {
+	char *data = (char *)message.getCustom();
+	if (!payloadLength) {
 		// no payload, set default value
 		message.set((uint8_t)0);
 	} else if (command == C_STREAM) {
-		// stream payload
-		uint8_t bvalue[MAX_PAYLOAD_SIZE];
-		uint8_t blen = 0;
-		while (*str) {
-			uint8_t val;
-			val = convertH2I(*str++) << 4;
-			val += convertH2I(*str++);
-			bvalue[blen] = val;
-			blen++;
+		// stream payload, decoded straight into the message
+		if (payloadLength & 1) {
+			return PROTOCOL_PARSE_ERROR_PAYLOAD;
 		}
-		message.set(bvalue, blen);
+		for (uint8_t i = 0; i < payloadLength / 2; i++) {
+			const uint8_t high = _protocolH2I(*input++);
+			const uint8_t low = _protocolH2I(*input++);
+			if ((high | low) > 0x0F) {
+				return PROTOCOL_PARSE_ERROR_PAYLOAD;
+			}
+			data[i] = (char)((high << 4) | low);
+		}
+		message.setLength(payloadLength / 2);
+		message.setPayloadType(P_CUSTOM);
 	} else {
 		// regular payload
-		char *value = str;
-		// Remove trailing carriage return and newline character (if it exists)
-		const uint8_t lastCharacter = strlen(value) - 1;
-		if (value[lastCharacter] == '\r' || value[lastCharacter] == '\n') {
-			value[lastCharacter] = '\0';
-		}
-		message.set(value);
+		(void)memcpy((void *)data, (const void *)input, payloadLength);
+		data[payloadLength] = 0;
+		message.setLength(payloadLength);
+		message.setPayloadType(P_STRING);
 	}
-	return (index == 5);
+	return PROTOCOL_PARSE_OK;
+}
+
+bool protocolSerial2MyMessage(MyMessage &message, char *inputString)
+{
+	return (protocolParseSerial(message, inputString, strlen(inputString)) == PROTOCOL_PARSE_OK);
 }
 
 char *protocolMyMessage2Serial(const MyMessage &message)
@@ -165,3 +202,56 @@ bool protocolMQTT2MyMessage(MyMessage &message, char *topic, uint8_t *payload,
 	// Return true if input valid
 	return (index == 5);
 }
+
+#if defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+uint8_t protocolMyMessage2Binary(const MyMessage &message, uint8_t *buffer)
+{
+	// Signatures are not forwarded, only the header and the payload
+	const uint8_t length = HEADER_SIZE + message.getLength();
+	buffer[0] = length;
+	(void)memcpy((void *)&buffer[1], (const void *)&message, length);
+	return 1u + length;
+}
+
+uint8_t protocolBinaryParse(MyMessage &message, uint8_t *frame, uint8_t &pos, const uint8_t inByte)
+{
+	frame[pos++] = inByte;
+	if (frame[0] == PROTOCOL_BINARY_MAGIC) {
+		if (pos < PROTOCOL_BINARY_HANDSHAKE_SIZE) {
+			return PROTOCOL_BINARY_PENDING;
+		}
+		pos = 0;
+		// Any version is accepted, the controller has to fall back to the one we answer with
+		return (frame[1] == 'M' && frame[2] == 'S' && frame[3] != 0) ? PROTOCOL_BINARY_HANDSHAKE :
+		       PROTOCOL_BINARY_INVALID;
+	}
+	if (frame[0] < HEADER_SIZE || frame[0] > MAX_MESSAGE_SIZE) {
+		// Not a length byte, drop it to find the next frame
+		pos = 0;
+		return PROTOCOL_BINARY_INVALID;
+	}
+	if (pos <= frame[0]) {
+		return PROTOCOL_BINARY_PENDING;
+	}
+	pos = 0;
+	(void)memcpy((void *)&message, (const void *)&frame[1], frame[0]);
+	if (frame[0] != HEADER_SIZE + message.getLength()) {
+		return PROTOCOL_BINARY_INVALID;
+	}
+	message.setVersion();
+	message.setSender(GATEWAY_ADDRESS);
+	message.setLast(GATEWAY_ADDRESS);
+	message.setEcho(false);
+	message.setSigned(false);
+	return PROTOCOL_BINARY_MESSAGE;
+}
+
+uint8_t protocolBinaryHandshake(uint8_t *buffer)
+{
+	buffer[0] = PROTOCOL_BINARY_MAGIC;
+	buffer[1] = 'M';
+	buffer[2] = 'S';
+	buffer[3] = PROTOCOL_BINARY_VERSION;
+	return PROTOCOL_BINARY_HANDSHAKE_SIZE;
+}
+#endif
@@ -22,6 +22,19 @@
 
 #include "MySensorsCore.h"
 
+// protocolParseSerial() results
+#define PROTOCOL_PARSE_OK               (0u)    // Message parsed
+#define PROTOCOL_PARSE_ERROR_FIELDS     (1u)    // Header field missing or empty
+#define PROTOCOL_PARSE_ERROR_NUMBER     (2u)    // Header field is not a decimal number
+#define PROTOCOL_PARSE_ERROR_RANGE      (3u)    // Header field out of range
+#define PROTOCOL_PARSE_ERROR_PAYLOAD    (4u)    // Payload too long or invalid hex
+
+// parse(message, input, length)
+// parse length characters of a protocol line into a message element, in a single pass and without
+// modifying the input. Trailing CR/LF are ignored, no string terminator is needed.
+// returns PROTOCOL_PARSE_OK or the reason the input was rejected
+uint8_t protocolParseSerial(MyMessage &message, const char *input, const size_t length);
+
 // parse(message, inputString)
 // parse a string into a message element
 // returns true if successfully parsed the input string
@@ -35,4 +48,33 @@ char *protocolMyMessage2MQTT(const char *prefix, const MyMessage &message);
 bool protocolMQTT2MyMessage(MyMessage &message, char *topic, uint8_t *payload,
                             const unsigned int length);
 
+#if defined(MY_GATEWAY_BINARY_PROTOCOL_FEATURE)
+#define PROTOCOL_BINARY_VERSION         (1u)    // Binary protocol version sent in the handshake
+#define PROTOCOL_BINARY_MAGIC           (0xFFu) // First handshake byte, never starts a text line or frame
+#define PROTOCOL_BINARY_HANDSHAKE_SIZE  (4u)    // 0xFF 'M' 'S' <version>
+#define PROTOCOL_BINARY_FRAME_MAX_SIZE  (1u + MAX_MESSAGE_SIZE) // Length byte, header and payload
+
+// protocolBinaryParse() results
+#define PROTOCOL_BINARY_PENDING         (0u)    // More bytes needed
+#define PROTOCOL_BINARY_MESSAGE         (1u)    // Message parsed
+#define PROTOCOL_BINARY_HANDSHAKE       (2u)    // Handshake received, answer with protocolBinaryHandshake()
+#define PROTOCOL_BINARY_INVALID         (3u)    // Frame or handshake dropped
+
+#if MY_GATEWAY_MAX_RECEIVE_LENGTH < PROTOCOL_BINARY_FRAME_MAX_SIZE
+#error MY_GATEWAY_MAX_RECEIVE_LENGTH too small to hold a binary frame
+#endif
+
+// Format MyMessage as a binary frame: length byte, raw header and payload
+// returns the frame size
+uint8_t protocolMyMessage2Binary(const MyMessage &message, uint8_t *buffer);
+
+// Feed one received byte, frame collects up to PROTOCOL_BINARY_FRAME_MAX_SIZE bytes at pos
+// returns PROTOCOL_BINARY_MESSAGE once a frame was parsed into message
+uint8_t protocolBinaryParse(MyMessage &message, uint8_t *frame, uint8_t &pos, const uint8_t inByte);
+
+// Write the handshake of this gateway to buffer
+// returns the handshake size
+uint8_t protocolBinaryHandshake(uint8_t *buffer);
+#endif
+
 #endif
@@ -54,7 +54,7 @@ void _callbackTransportReady(void)
 	}
 }
 
-void _process(void)
+void _process(const uint32_t timeoutMS)
 {
 #if defined(MY_DEBUG_VERBOSE_CORE)
 	if (processLock) {
@@ -76,10 +76,21 @@ void _process(void)
 	transportProcess();
 #endif
 
+#if defined(MY_HW_HAS_CONFIG_PROCESS)
+	// Write back pending EEPROM changes, also while the sketch is in wait()
+	hwConfigProcess();
+#endif
+
 #if defined(__linux__)
+#if defined(MY_LINUX_EVENT_LOOP)
+	// Sleep until a socket, serial port or radio IRQ needs attention, or the caller's deadline
+	(void)eventLoopWait(timeoutMS);
+#else
+	(void)timeoutMS;
 	// To avoid high cpu usage
 	usleep(10000); // 10ms
 #endif
+#endif
 #if defined(MY_DEBUG_VERBOSE_CORE)
 	processLock--;
 #endif
@@ -498,6 +509,13 @@ bool _processInternalCoreMessage(void)
 			} else if (debug_msg == 'M') {	// free memory
 				(void)_sendRoute(build(_msgTmp, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL,
 				                       I_DEBUG).set(hwFreeMem()));
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+			} else if (debug_msg == 'Q') {	// RX queue statistics
+				char stats[MAX_PAYLOAD_SIZE + 1];
+				transportHALGetRxQueueStats(stats);
+				(void)_sendRoute(build(_msgTmp, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL,
+				                       I_DEBUG).set(stats));
+#endif
 			} else if (debug_msg == 'E') {	// clear MySensors eeprom area and reboot
 				(void)_sendRoute(build(_msgTmp, GATEWAY_ADDRESS, NODE_SENSOR_ID, C_INTERNAL, I_DEBUG).set("OK"));
 				for (uint16_t i = EEPROM_START; i<EEPROM_LOCAL_CONFIG_ADDRESS; i++) {
@@ -562,8 +580,9 @@ void wait(const uint32_t waitingMS)
 	waitLock++;
 #endif
 	const uint32_t enteringMS = hwMillis();
-	while (hwMillis() - enteringMS < waitingMS) {
-		_process();
+	uint32_t elapsedMS;
+	while ((elapsedMS = hwMillis() - enteringMS) < waitingMS) {
+		_process(waitingMS - elapsedMS);
 	}
 #if defined(MY_DEBUG_VERBOSE_CORE)
 	waitLock--;
@@ -583,8 +602,9 @@ bool wait(const uint32_t waitingMS, const mysensors_command_t cmd)
 	//_msg.setCommand(!cmd);
 	_msg.setCommand(C_INVALID_7);
 	bool expectedResponse = false;
-	while ((hwMillis() - enteringMS < waitingMS) && !expectedResponse) {
-		_process();
+	uint32_t elapsedMS;
+	while (((elapsedMS = hwMillis() - enteringMS) < waitingMS) && !expectedResponse) {
+		_process(waitingMS - elapsedMS);
 		expectedResponse = (_msg.getCommand() == cmd);
 	}
 #if defined(MY_DEBUG_VERBOSE_CORE)
@@ -606,8 +626,9 @@ bool wait(const uint32_t waitingMS, const mysensors_command_t cmd, const uint8_t
 	//_msg.setCommand(!cmd);
 	_msg.setCommand(C_INVALID_7);
 	bool expectedResponse = false;
-	while ( (hwMillis() - enteringMS < waitingMS) && !expectedResponse ) {
-		_process();
+	uint32_t elapsedMS;
+	while ( ((elapsedMS = hwMillis() - enteringMS) < waitingMS) && !expectedResponse ) {
+		_process(waitingMS - elapsedMS);
 		expectedResponse = (_msg.getCommand() == cmd && _msg.getType() == msgType);
 	}
 #if defined(MY_DEBUG_VERBOSE_CORE)
@@ -658,10 +679,12 @@ int8_t _sleep(const uint32_t sleepingMS, const bool smartSleep, const uint8_t in
 	if (!isTransportReady()) {
 		CORE_DEBUG(PSTR("!MCO:SLP:TNR\n"));	// sleeping not possible, transport not ready
 		const uint32_t sleepEnterMS = hwMillis();
+		const uint32_t reconnectMS = sleepingTimeMS < MY_SLEEP_TRANSPORT_RECONNECT_TIMEOUT_MS ?
+		                             sleepingTimeMS : MY_SLEEP_TRANSPORT_RECONNECT_TIMEOUT_MS;
 		uint32_t sleepDeltaMS = 0;
 		while (!isTransportReady() && (sleepDeltaMS < sleepingTimeMS) &&
 		        (sleepDeltaMS < MY_SLEEP_TRANSPORT_RECONNECT_TIMEOUT_MS)) {
-			_process();
+			_process(reconnectMS - sleepDeltaMS);
 			sleepDeltaMS = hwMillis() - sleepEnterMS;
 		}
 		// sleep remainder
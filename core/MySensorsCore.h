@@ -433,8 +433,10 @@ void _checkNodeLock(void);
 void _begin(void);
 /**
 * @brief Main framework process
+* @param timeoutMS Longest time to sleep for events on platforms that can (Linux event loop),
+* callers waiting for a deadline pass the time left.
 */
-void _process(void);
+void _process(const uint32_t timeoutMS = UINT32_MAX);
 /**
 * @brief Processes internal core message
 * @return True if no further processing required
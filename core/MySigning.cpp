@@ -36,6 +36,14 @@
 #if defined(MY_SIGNING_SOFT) && defined(MY_SIGNING_ATSHA204)
 #error You have to pick one and only one signing backend
 #endif
+#if defined(MY_SIGNING_SOFT_VERIFY_WORKERS)
+#if !defined(__linux__) || !defined(MY_SIGNING_SOFT)
+#error MY_SIGNING_SOFT_VERIFY_WORKERS is only supported with MY_SIGNING_SOFT on Linux
+#endif
+#if MY_SIGNING_SOFT_VERIFY_WORKERS < 1 || MY_SIGNING_SOFT_VERIFY_WORKERS > 64
+#error MY_SIGNING_SOFT_VERIFY_WORKERS must be between 1 and 64
+#endif
+#endif
 #ifdef MY_SIGNING_FEATURE
 static uint8_t _doSign[32];      // Bitfield indicating which sensors require signed communication
 static uint8_t _doWhitelist[32]; // Bitfield indicating which sensors require salted signatures
@@ -69,6 +77,8 @@ extern bool signerAtsha204SoftCheckTimer(void);
 extern bool signerAtsha204SoftGetNonce(MyMessage &msg);
 extern void signerAtsha204SoftPutNonce(MyMessage &msg);
 extern bool signerAtsha204SoftVerifyMsg(MyMessage &msg);
+extern bool signerAtsha204SoftVerifyNonce(MyMessage &msg, uint8_t *nonce);
+extern bool signerAtsha204SoftVerifySignature(MyMessage &msg, uint8_t *nonce, uint8_t *hmac);
 extern bool signerAtsha204SoftSignMsg(MyMessage &msg);
 #define signerBackendInit       signerAtsha204SoftInit
 #define signerBackendCheckTimer signerAtsha204SoftCheckTimer
@@ -91,6 +101,19 @@ extern bool signerAtsha204SignMsg(MyMessage &msg);
 #define signerBackendSignMsg    signerAtsha204SignMsg
 #endif
 static bool skipSign(MyMessage &msg);
+// Outcome of the verification checks, SIGN_VERIFY_BACKEND means the signature itself has to be checked
+enum {
+	SIGN_VERIFY_PASS = 0,   // No verification required
+	SIGN_VERIFY_REJECT,     // Unsigned message that should have been signed
+	SIGN_VERIFY_INVALID,    // Signing system is not in a valid state
+	SIGN_VERIFY_FAIL,       // Signature verification failed
+	SIGN_VERIFY_OK,         // Signature verified
+	SIGN_VERIFY_BACKEND     // Signature has to be verified by the backend
+};
+#if defined(MY_SIGNING_REQUEST_SIGNATURES)
+static uint8_t signerVerifyMsgCheck(MyMessage &msg);
+static bool signerVerifyMsgResult(MyMessage &msg, const uint8_t status);
+#endif
 #else // not MY_SIGNING_FEATURE
 #define signerBackendCheckTimer() true
 #endif // MY_SIGNING_FEATURE
@@ -136,6 +159,9 @@ void signerInit(void)
 		SIGN_DEBUG(PSTR("SGN:INI:BND OK\n"));
 	}
 #endif
+#if defined(MY_SIGNING_SOFT_VERIFY_WORKERS)
+	signerVerifyWorkersInit();
+#endif
 }
 
 void signerPresentation(MyMessage &msg, uint8_t destination)
@@ -222,9 +248,10 @@ bool signerSignMsg(MyMessage &msg)
 					// Other messages could come in-between. We trust _process() takes care of them
 					unsigned long enter = hwMillis();
 					_msgSign = msg; // Copy the message to sign since buffer might be touched in _process()
-					while (hwMillis() - enter < MY_VERIFICATION_TIMEOUT_MS &&
+					unsigned long elapsed;
+					while ((elapsed = hwMillis() - enter) < MY_VERIFICATION_TIMEOUT_MS &&
 					        _signingNonceStatus==SIGN_WAITING_FOR_NONCE) {
-						_process();
+						_process(MY_VERIFICATION_TIMEOUT_MS - elapsed);
 					}
 					if (hwMillis() - enter > MY_VERIFICATION_TIMEOUT_MS) {
 						SIGN_DEBUG(PSTR("!SGN:SGN:NCE TMO\n")); // Timeout waiting for nonce!
@@ -267,11 +294,161 @@ bool signerSignMsg(MyMessage &msg)
 // cppcheck-suppress constParameter
 bool signerVerifyMsg(MyMessage &msg)
 {
-	bool verificationResult = true;
 	// Before processing message, reject unsigned messages if signing is required and check signature
 	// (if it is signed and addressed to us)
 	// Note that we do not care at all about any signature found if we do not require signing
 #if defined(MY_SIGNING_FEATURE) && defined(MY_SIGNING_REQUEST_SIGNATURES)
+	uint8_t status = signerVerifyMsgCheck(msg);
+	if (status == SIGN_VERIFY_BACKEND) {
+		status = signerBackendVerifyMsg(msg) ? SIGN_VERIFY_OK : SIGN_VERIFY_FAIL;
+	}
+	return signerVerifyMsgResult(msg, status);
+#else
+	(void)msg;
+	return true;
+#endif // MY_SIGNING_REQUEST_SIGNATURES
+}
+
+#if defined(MY_SIGNING_SOFT_VERIFY_WORKERS)
+// Received messages are queued in arrival order. Signatures are checked by the workers, everything
+// else (nonce lookup, signing requirements and node lock counters) is done by the main thread when a
+// message enters or leaves the queue.
+#define SIGN_VERIFY_QUEUE_SIZE (32u)
+#define SIGN_VERIFY_RUNNING    (0xFFu) // status of an entry a worker is processing
+
+typedef struct {
+	MyMessage msg;           //!< The received message
+	uint8_t nonce[32+9+1];   //!< Nonce and whitelist salt the signature is checked against
+	uint8_t hmac[32];        //!< Worker scratch buffer for the calculated signature
+	uint8_t status;          //!< SIGN_VERIFY_* status of the message
+} signing_verify_entry_t;
+
+static signing_verify_entry_t _signing_verify_queue[SIGN_VERIFY_QUEUE_SIZE];
+static uint8_t _signing_verify_head = 0;     // oldest message, next to be handed back
+static uint8_t _signing_verify_next = 0;     // next message workers look at
+static uint8_t _signing_verify_tail = 0;     // next free entry
+static uint8_t _signing_verify_workers = 0;  // number of running workers
+static pthread_mutex_t _signing_verify_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t _signing_verify_cond = PTHREAD_COND_INITIALIZER;
+
+#define SIGN_VERIFY_INDEX(i) ((i) % SIGN_VERIFY_QUEUE_SIZE)
+
+static void *signerVerifyWorker(void *arg)
+{
+	(void)arg;
+	(void)pthread_mutex_lock(&_signing_verify_mutex);
+	for (;;) {
+		// Skip messages that do not need the backend
+		while (_signing_verify_next != _signing_verify_tail &&
+		        _signing_verify_queue[_signing_verify_next].status != SIGN_VERIFY_BACKEND) {
+			_signing_verify_next = SIGN_VERIFY_INDEX(_signing_verify_next + 1);
+		}
+		if (_signing_verify_next == _signing_verify_tail) {
+			(void)pthread_cond_wait(&_signing_verify_cond, &_signing_verify_mutex);
+			continue;
+		}
+		signing_verify_entry_t *entry = &_signing_verify_queue[_signing_verify_next];
+		_signing_verify_next = SIGN_VERIFY_INDEX(_signing_verify_next + 1);
+		entry->status = SIGN_VERIFY_RUNNING;
+		(void)pthread_mutex_unlock(&_signing_verify_mutex);
+
+		// The entry is owned by this worker until its status is updated
+		const bool verified = signerAtsha204SoftVerifySignature(entry->msg, entry->nonce, entry->hmac);
+
+		(void)pthread_mutex_lock(&_signing_verify_mutex);
+		entry->status = verified ? SIGN_VERIFY_OK : SIGN_VERIFY_FAIL;
+#if defined(MY_LINUX_EVENT_LOOP)
+		eventLoopNotify();
+#endif
+	}
+	return NULL;
+}
+
+void signerVerifyWorkersInit(void)
+{
+	while (_signing_verify_workers < MY_SIGNING_SOFT_VERIFY_WORKERS) {
+		pthread_t thread;
+		const int ret = pthread_create(&thread, NULL, signerVerifyWorker, NULL);
+		if (ret != 0) {
+			// Messages are verified by the main thread if no worker could be started
+			logError("Failed to start signature verification worker: %s\n", strerror(ret));
+			break;
+		}
+		(void)pthread_detach(thread);
+		_signing_verify_workers++;
+	}
+}
+
+bool signerVerifyMsgQueueFull(void)
+{
+	(void)pthread_mutex_lock(&_signing_verify_mutex);
+	const bool full = SIGN_VERIFY_INDEX(_signing_verify_tail + 1) == _signing_verify_head;
+	(void)pthread_mutex_unlock(&_signing_verify_mutex);
+	return full;
+}
+
+bool signerVerifyMsgSubmit(MyMessage &msg)
+{
+	if (signerVerifyMsgQueueFull()) {
+		return false;
+	}
+	// Only the main thread adds entries, so the free entry can be filled without holding the lock
+	signing_verify_entry_t *entry = &_signing_verify_queue[_signing_verify_tail];
+	entry->msg = msg;
+#if defined(MY_SIGNING_REQUEST_SIGNATURES)
+	entry->status = signerVerifyMsgCheck(entry->msg);
+	if (entry->status == SIGN_VERIFY_BACKEND) {
+		// The nonce is consumed right away, so it cannot be handed out or used twice
+		if (!signerAtsha204SoftVerifyNonce(entry->msg, entry->nonce)) {
+			entry->status = SIGN_VERIFY_FAIL;
+		} else if (!_signing_verify_workers) {
+			entry->status = signerAtsha204SoftVerifySignature(entry->msg, entry->nonce,
+			                entry->hmac) ? SIGN_VERIFY_OK : SIGN_VERIFY_FAIL;
+		}
+	}
+#else
+	entry->status = SIGN_VERIFY_PASS;
+#endif
+	(void)pthread_mutex_lock(&_signing_verify_mutex);
+	_signing_verify_tail = SIGN_VERIFY_INDEX(_signing_verify_tail + 1);
+	if (entry->status == SIGN_VERIFY_BACKEND) {
+		(void)pthread_cond_signal(&_signing_verify_cond);
+	}
+	(void)pthread_mutex_unlock(&_signing_verify_mutex);
+	return true;
+}
+
+bool signerVerifyMsgCollect(MyMessage &msg, bool *verified)
+{
+	(void)pthread_mutex_lock(&_signing_verify_mutex);
+	signing_verify_entry_t *entry = &_signing_verify_queue[_signing_verify_head];
+	if (_signing_verify_head == _signing_verify_tail || entry->status == SIGN_VERIFY_BACKEND ||
+	        entry->status == SIGN_VERIFY_RUNNING) {
+		(void)pthread_mutex_unlock(&_signing_verify_mutex);
+		return false;
+	}
+	msg = entry->msg;
+	const uint8_t status = entry->status;
+	if (_signing_verify_next == _signing_verify_head) {
+		// Workers have not looked at this message yet, keep them within the queued messages
+		_signing_verify_next = SIGN_VERIFY_INDEX(_signing_verify_next + 1);
+	}
+	_signing_verify_head = SIGN_VERIFY_INDEX(_signing_verify_head + 1);
+	(void)pthread_mutex_unlock(&_signing_verify_mutex);
+#if defined(MY_SIGNING_REQUEST_SIGNATURES)
+	*verified = signerVerifyMsgResult(msg, status);
+#else
+	(void)status;
+	*verified = true;
+#endif
+	return true;
+}
+#endif // MY_SIGNING_SOFT_VERIFY_WORKERS
+
+#if defined(MY_SIGNING_FEATURE) && defined(MY_SIGNING_REQUEST_SIGNATURES)
+// Helper for signerVerifyMsg() to decide if and how msg has to be verified
+static uint8_t signerVerifyMsgCheck(MyMessage &msg)
+{
 	// If we are a node, or we are a gateway and the sender require signatures (or just a strict gw)
 	// and we are the destination...
 #if defined(MY_SIGNING_WEAK_SECURITY)
@@ -281,45 +458,53 @@ bool signerVerifyMsg(MyMessage &msg)
 #endif
 		// Internal messages of certain types are not verified
 		if (skipSign(msg)) {
-			verificationResult = true;
+			return SIGN_VERIFY_PASS;
 		} else if (!msg.getSigned()) {
 			// Got unsigned message that should have been signed
 			SIGN_DEBUG(PSTR("!SGN:VER:NSG\n")); // Message is not signed, but it should have been!
-			verificationResult = false;
-		} else {
+			return SIGN_VERIFY_REJECT;
+		} else if (!stateValid) {
 			// Before starting, validate that our state is good, or signing will fail
-			if (!stateValid) {
-				SIGN_DEBUG(PSTR("!SGN:VER:STATE\n")); // Signing system is not in a valid state
-				verificationResult = false;
-			} else {
-				if (!signerBackendVerifyMsg(msg)) {
-					SIGN_DEBUG(PSTR("!SGN:VER:FAIL\n")); // Signature verification failed!
-					verificationResult = false;
-				} else {
-					SIGN_DEBUG(PSTR("SGN:VER:OK\n"));
-				}
-			}
+			SIGN_DEBUG(PSTR("!SGN:VER:STATE\n")); // Signing system is not in a valid state
+			return SIGN_VERIFY_INVALID;
+		} else {
+			return SIGN_VERIFY_BACKEND;
+		}
+	}
+	return SIGN_VERIFY_PASS;
+}
+
+// Helper for signerVerifyMsg() to complete verification of msg once the backend is done
+static bool signerVerifyMsgResult(MyMessage &msg, const uint8_t status)
+{
+	if (status == SIGN_VERIFY_PASS) {
+		return true;
+	} else if (status == SIGN_VERIFY_REJECT) {
+		return false;
+	}
+	const bool verificationResult = (status == SIGN_VERIFY_OK);
+	if (status == SIGN_VERIFY_FAIL) {
+		SIGN_DEBUG(PSTR("!SGN:VER:FAIL\n")); // Signature verification failed!
+	} else if (verificationResult) {
+		SIGN_DEBUG(PSTR("SGN:VER:OK\n"));
+	}
 #if defined(MY_NODE_LOCK_FEATURE)
-			if (verificationResult) {
-				// On successful verification, clear lock counters
-				nof_nonce_requests = 0;
-				nof_failed_verifications = 0;
-			} else {
-				nof_failed_verifications++;
-				SIGN_DEBUG(PSTR("SGN:VER:LEFT=%" PRIu8 "\n"), MY_NODE_LOCK_COUNTER_MAX-nof_failed_verifications);
-				if (nof_failed_verifications >= MY_NODE_LOCK_COUNTER_MAX) {
-					_nodeLock("TMFV"); // Too many failed verifications
-				}
-			}
-#endif
-			msg.setSigned(false); // Clear the sign-flag now as verification is completed
+	if (verificationResult) {
+		// On successful verification, clear lock counters
+		nof_nonce_requests = 0;
+		nof_failed_verifications = 0;
+	} else {
+		nof_failed_verifications++;
+		SIGN_DEBUG(PSTR("SGN:VER:LEFT=%" PRIu8 "\n"), MY_NODE_LOCK_COUNTER_MAX-nof_failed_verifications);
+		if (nof_failed_verifications >= MY_NODE_LOCK_COUNTER_MAX) {
+			_nodeLock("TMFV"); // Too many failed verifications
 		}
 	}
-#else
-	(void)msg;
-#endif // MY_SIGNING_REQUEST_SIGNATURES
+#endif
+	msg.setSigned(false); // Clear the sign-flag now as verification is completed
 	return verificationResult;
 }
+#endif // MY_SIGNING_REQUEST_SIGNATURES
 
 int signerMemcmp(const void* a, const void* b, size_t sz)
 {
@@ -373,7 +558,8 @@ static bool skipSign(MyMessage &msg)
 	} else if (msg.getCommand() == C_STREAM &&
 	           (msg.getType() == ST_SOUND            ||
 	            msg.getType() == ST_IMAGE            ||
-	            msg.getType() == ST_FIRMWARE_REQUEST || msg.getType() == ST_FIRMWARE_RESPONSE )) {
+	            msg.getType() == ST_FIRMWARE_REQUEST || msg.getType() == ST_FIRMWARE_RESPONSE ||
+	            msg.getType() == ST_FIRMWARE_REQUEST_WINDOW)) {
 		ret = true;
 	}
 	if (ret) {
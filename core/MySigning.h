@@ -711,6 +711,49 @@ bool signerSignMsg(MyMessage &msg);
  */
 bool signerVerifyMsg(MyMessage &msg);
 
+#if defined(MY_SIGNING_SOFT_VERIFY_WORKERS) || defined(DOXYGEN)
+/**
+ * @brief Starts the signature verification workers.
+ *
+ * Called by @ref signerInit(). If no worker can be started, queued messages are verified by the
+ * calling thread.
+ */
+void signerVerifyWorkersInit(void);
+
+/**
+ * @brief Check if the verification queue can take another message.
+ *
+ * @returns @c true if @ref signerVerifyMsgSubmit() would refuse a message.
+ */
+bool signerVerifyMsgQueueFull(void);
+
+/**
+ * @brief Queues a received message for verification by the worker threads.
+ *
+ * Does the same checks as @ref signerVerifyMsg(), but leaves the signature calculation to a
+ * worker. The nonce is consumed right away by the calling thread. Every received message has to
+ * pass this queue, also those that are not verified, so @ref signerVerifyMsgCollect() returns them
+ * in arrival order.
+ * \n@b Usage: Linux gateways with @ref MY_SIGNING_SOFT_VERIFY_WORKERS, main thread only.
+ *
+ * @param msg The message to verify.
+ * @returns @c false if the queue is full, the message was not taken.
+ */
+bool signerVerifyMsgSubmit(MyMessage &msg);
+
+/**
+ * @brief Picks up the oldest queued message once it has been verified.
+ *
+ * Completes verification like @ref signerVerifyMsg() does (node lock counters, sign-flag).
+ * Main thread only.
+ *
+ * @param msg Buffer receiving the message.
+ * @param verified Set to the verification result, see @ref signerVerifyMsg().
+ * @returns @c false if the queue is empty or the oldest message is still being verified.
+ */
+bool signerVerifyMsgCollect(MyMessage &msg, bool *verified);
+#endif
+
 /**
  * @brief Do a timing neutral memory comparison.
  *
@@ -40,12 +40,24 @@
 #define SIGN_DEBUG(x,...)
 #endif
 
-static unsigned long _signing_timestamp;
-static bool _signing_verification_ongoing = false;
+#if MY_SIGNING_SOFT_NONCE_TABLE_SIZE < 1 || MY_SIGNING_SOFT_NONCE_TABLE_SIZE > 254
+#error MY_SIGNING_SOFT_NONCE_TABLE_SIZE must be between 1 and 254
+#endif
+
+// Marks an unused entry in the nonce table
+#define SIGNING_NONCE_FREE (255u) // BROADCAST_ADDRESS, never a requester
+
+typedef struct {
+	uint8_t nodeId;            //!< Node the nonce was handed out to
+	unsigned long timestamp;   //!< hwMillis() when the nonce was generated
+	uint8_t nonce[32];         //!< The nonce
+} signing_nonce_entry_t;
+
+static signing_nonce_entry_t _signing_nonce_table[MY_SIGNING_SOFT_NONCE_TABLE_SIZE];
 static bool _signing_init_ok = false;
 static uint8_t _signing_verifying_nonce[32+9+1];
 static uint8_t _signing_nonce[32+9+1];
-static uint8_t _signing_hmac_key[SIZE_SIGNING_SOFT_HMAC_KEY];
+static SHA256HMACKey_t _signing_hmac_key;
 static uint8_t _signing_hmac[32];
 static uint8_t _signing_node_serial_info[SIZE_SIGNING_SOFT_SERIAL];
 
@@ -53,12 +65,19 @@ static uint8_t _signing_node_serial_info[SIZE_SIGNING_SOFT_SERIAL];
 static const whitelist_entry_t _signing_whitelist[] = MY_SIGNING_NODE_WHITELISTING;
 #endif
 
-static void signerCalculateSignature(MyMessage &msg, const bool signing);
+static void signerCalculateSignature(MyMessage &msg, uint8_t *nonce, uint8_t *hmac);
+static signing_nonce_entry_t *signerNonceFind(const uint8_t nodeId);
+static signing_nonce_entry_t *signerNonceAlloc(const uint8_t nodeId);
+static void signerNonceFree(signing_nonce_entry_t *entry);
 static void signerAtsha204AHmac(uint8_t *dest, const uint8_t *nonce, const uint8_t *data);
 
 bool signerAtsha204SoftInit(void)
 {
+	uint8_t key[SIZE_SIGNING_SOFT_HMAC_KEY];
 	_signing_init_ok = true;
+	for (uint8_t i = 0; i < MY_SIGNING_SOFT_NONCE_TABLE_SIZE; i++) {
+		signerNonceFree(&_signing_nonce_table[i]);
+	}
 	// initialize pseudo-RNG
 	hwRandomNumberInit();
 	// Set secrets
@@ -66,9 +85,10 @@ bool signerAtsha204SoftInit(void)
 	if (strnlen(MY_SIGNING_SIMPLE_PASSWD, 32) < 8) {
 		SIGN_DEBUG(PSTR("!SGN:BND:PWD<8\n")); //Password is too short to be acceptable
 		_signing_init_ok = false;
+		(void)memset((void *)key, 0x00, sizeof(key));
 	} else {
-		(void)memset((void *)_signing_hmac_key, 0x00, sizeof(_signing_hmac_key));
-		(void)memcpy((void *)_signing_hmac_key, MY_SIGNING_SIMPLE_PASSWD, strnlen(MY_SIGNING_SIMPLE_PASSWD,
+		(void)memset((void *)key, 0x00, sizeof(key));
+		(void)memcpy((void *)key, MY_SIGNING_SIMPLE_PASSWD, strnlen(MY_SIGNING_SIMPLE_PASSWD,
 		             32));
 		(void)memset((void *)_signing_node_serial_info, 0x00, sizeof(_signing_node_serial_info));
 		(void)memcpy((void *)_signing_node_serial_info, MY_SIGNING_SIMPLE_PASSWD,
@@ -76,11 +96,14 @@ bool signerAtsha204SoftInit(void)
 		_signing_node_serial_info[8] = getNodeId();
 	}
 #else
-	hwReadConfigBlock((void *)_signing_hmac_key, (void *)EEPROM_SIGNING_SOFT_HMAC_KEY_ADDRESS,
+	hwReadConfigBlock((void *)key, (void *)EEPROM_SIGNING_SOFT_HMAC_KEY_ADDRESS,
 	                  SIZE_SIGNING_SOFT_HMAC_KEY);
 	hwReadConfigBlock((void *)_signing_node_serial_info, (void *)EEPROM_SIGNING_SOFT_SERIAL_ADDRESS,
 	                  SIZE_SIGNING_SOFT_SERIAL);
 #endif
+	// The key never changes, hash its pads once instead of for every HMAC
+	SHA256HMACKeyInit(&_signing_hmac_key, key, SIZE_SIGNING_SOFT_HMAC_KEY);
+	(void)memset((void *)key, 0x00, sizeof(key));
 
 	uint16_t chk = 0;
 	for (uint8_t i = 0; i < SIZE_SIGNING_SOFT_SERIAL; i++) {
@@ -103,25 +126,19 @@ bool signerAtsha204SoftCheckTimer(void)
 	if (!_signing_init_ok) {
 		return false;
 	}
-	if (_signing_verification_ongoing) {
-		unsigned long time_now = hwMillis();
-		// If timestamp is taken so late a rollover can take place during the timeout,
-		// offset both timestamp and current time to make sure no rollover takes place during the
-		// timeout
-		if (_signing_timestamp + MY_VERIFICATION_TIMEOUT_MS < _signing_timestamp) {
-			_signing_timestamp += MY_VERIFICATION_TIMEOUT_MS;
-			time_now += MY_VERIFICATION_TIMEOUT_MS;
-		}
-		if (time_now > _signing_timestamp + MY_VERIFICATION_TIMEOUT_MS) {
-			SIGN_DEBUG(PSTR("!SGN:BND:TMR\n")); //Verification timeout
-			// Purge nonce
-			(void)memset((void *)_signing_nonce, 0xAA, sizeof(_signing_nonce));
-			(void)memset((void *)_signing_verifying_nonce, 0xAA, sizeof(_signing_verifying_nonce));
-			_signing_verification_ongoing = false;
-			return false;
+	bool ret = true;
+	const unsigned long time_now = hwMillis();
+	for (uint8_t i = 0; i < MY_SIGNING_SOFT_NONCE_TABLE_SIZE; i++) {
+		signing_nonce_entry_t *entry = &_signing_nonce_table[i];
+		// Unsigned subtraction keeps the age correct across a hwMillis() rollover
+		if (entry->nodeId != SIGNING_NONCE_FREE &&
+		        time_now - entry->timestamp > MY_VERIFICATION_TIMEOUT_MS) {
+			SIGN_DEBUG(PSTR("!SGN:BND:TMR,ID=%" PRIu8 "\n"), entry->nodeId); //Verification timeout
+			signerNonceFree(entry);
+			ret = false;
 		}
 	}
-	return true;
+	return ret;
 }
 
 bool signerAtsha204SoftGetNonce(MyMessage &msg)
@@ -130,9 +147,12 @@ bool signerAtsha204SoftGetNonce(MyMessage &msg)
 		return false;
 	}
 
+	// msg is the nonce request, the nonce is handed to the node that sent it
+	signing_nonce_entry_t *entry = signerNonceAlloc(msg.getSender());
+
 #ifdef MY_HW_HAS_GETENTROPY
 	// Try to get MAX_PAYLOAD_SIZE random bytes
-	while (hwGetentropy(&_signing_verifying_nonce, MAX_PAYLOAD_SIZE) != MAX_PAYLOAD_SIZE);
+	while (hwGetentropy(entry->nonce, MAX_PAYLOAD_SIZE) != MAX_PAYLOAD_SIZE);
 #else
 	// We used a basic whitening technique that XORs a random byte with the current hwMillis() counter
 	// and then the byte is hashed (SHA256) to produce the resulting nonce
@@ -140,24 +160,17 @@ bool signerAtsha204SoftGetNonce(MyMessage &msg)
 	for (uint8_t i = 0; i < sizeof(randBuffer); i++) {
 		randBuffer[i] = random(256) ^ (hwMillis() & 0xFF);
 	}
-	SHA256(_signing_verifying_nonce, randBuffer, sizeof(randBuffer));
+	SHA256(entry->nonce, randBuffer, sizeof(randBuffer));
 #endif
 
 	if (MAX_PAYLOAD_SIZE < 32) {
 		// We set the part of the 32-byte nonce that does not fit into a message to 0xAA
-		(void)memset((void *)&_signing_verifying_nonce[MAX_PAYLOAD_SIZE], 0xAA, 32u - MAX_PAYLOAD_SIZE);
+		(void)memset((void *)&entry->nonce[MAX_PAYLOAD_SIZE], 0xAA, 32u - MAX_PAYLOAD_SIZE);
 	}
 
 	// Transfer the first part of the nonce to the message
-	msg.set(_signing_verifying_nonce, MIN((uint8_t)MAX_PAYLOAD_SIZE, (uint8_t)32));
-	_signing_verification_ongoing = true;
-	_signing_timestamp = hwMillis(); // Set timestamp to determine when to purge nonce
-	// Be a little fancy to handle turnover (prolong the time allowed to timeout after turnover)
-	// Note that if message is "too" quick, and arrives before turnover, it will be rejected
-	// but this is consider such a rare case that it is accepted and rejects are 'safe'
-	if (_signing_timestamp + MY_VERIFICATION_TIMEOUT_MS < hwMillis()) {
-		_signing_timestamp = 0;
-	}
+	msg.set(entry->nonce, MIN((uint8_t)MAX_PAYLOAD_SIZE, (uint8_t)32));
+	entry->timestamp = hwMillis(); // Set timestamp to determine when to purge nonce
 	return true;
 }
 
@@ -186,7 +199,15 @@ bool signerAtsha204SoftSignMsg(MyMessage &msg)
 
 	// Calculate signature of message
 	msg.setSigned(true); // make sure signing flag is set before signature is calculated
-	signerCalculateSignature(msg, true);
+#ifdef MY_DEBUG_VERBOSE_SIGNING
+	hwDebugBuf2Str(_signing_nonce, 32);
+	SIGN_DEBUG(PSTR("SGN:BND:NONCE=%s\n"), hwDebugPrintStr);
+#endif
+	signerCalculateSignature(msg, _signing_nonce, _signing_hmac);
+#ifdef MY_DEBUG_VERBOSE_SIGNING
+	hwDebugBuf2Str(_signing_hmac, 32);
+	SIGN_DEBUG(PSTR("SGN:BND:HMAC=%s\n"), hwDebugPrintStr);
+#endif
 #if defined(MY_SIGNING_NODE_WHITELISTING)
 	if (DO_WHITELIST(msg.getDestination())) {
 		// Salt the signature with the senders nodeId and the (hopefully) unique serial The Creator has
@@ -215,73 +236,139 @@ bool signerAtsha204SoftSignMsg(MyMessage &msg)
 
 bool signerAtsha204SoftVerifyMsg(MyMessage &msg)
 {
-	if (!_signing_verification_ongoing) {
-		SIGN_DEBUG(PSTR("!SGN:BND:VER ONGOING\n"));
+	if (!signerAtsha204SoftVerifyNonce(msg, _signing_verifying_nonce)) {
 		return false;
-	} else {
-		// Make sure we have not expired
-		if (!signerCheckTimer()) {
-			return false;
-		}
+	}
+#ifdef MY_DEBUG_VERBOSE_SIGNING
+	hwDebugBuf2Str(_signing_verifying_nonce, 32);
+	SIGN_DEBUG(PSTR("SGN:BND:NONCE=%s\n"), hwDebugPrintStr);
+#endif
+	const bool ret = signerAtsha204SoftVerifySignature(msg, _signing_verifying_nonce, _signing_hmac);
+#ifdef MY_DEBUG_VERBOSE_SIGNING
+	hwDebugBuf2Str(_signing_hmac, 32);
+	SIGN_DEBUG(PSTR("SGN:BND:HMAC=%s\n"), hwDebugPrintStr);
+#endif
+	return ret;
+}
 
-		_signing_verification_ongoing = false;
+bool signerAtsha204SoftVerifyNonce(MyMessage &msg, uint8_t *nonce)
+{
+	signing_nonce_entry_t *entry = signerNonceFind(msg.getSender());
+	if (entry == NULL) {
+		SIGN_DEBUG(PSTR("!SGN:BND:VER ONGOING,ID=%" PRIu8 "\n"), msg.getSender());
+		return false;
+	}
+	// Make sure we have not expired
+	if (hwMillis() - entry->timestamp > MY_VERIFICATION_TIMEOUT_MS) {
+		SIGN_DEBUG(PSTR("!SGN:BND:TMR,ID=%" PRIu8 "\n"), entry->nodeId); //Verification timeout
+		signerNonceFree(entry);
+		return false;
+	}
 
-		if (msg.data[msg.getLength()] != SIGNING_IDENTIFIER) {
-			SIGN_DEBUG(PSTR("!SGN:BND:VER,IDENT=%" PRIu8 "\n"), msg.data[msg.getLength()]);
-			return false;
-		}
+	// A nonce is only good for one verification attempt
+	(void)memcpy((void *)nonce, (const void *)entry->nonce, 32);
+	signerNonceFree(entry);
 
-		signerCalculateSignature(msg, false); // Get signature of message
+	if (msg.data[msg.getLength()] != SIGNING_IDENTIFIER) {
+		SIGN_DEBUG(PSTR("!SGN:BND:VER,IDENT=%" PRIu8 "\n"), msg.data[msg.getLength()]);
+		return false;
+	}
 
 #ifdef MY_SIGNING_NODE_WHITELISTING
-		// Look up the senders nodeId in our whitelist and salt the signature with that data
-		size_t j;
-		for (j = 0; j < NUM_OF(_signing_whitelist); j++) {
-			if (_signing_whitelist[j].nodeId == msg.getSender()) {
-				// We can reuse the nonce buffer now since it is no longer needed
-				(void)memcpy((void *)_signing_verifying_nonce, (const void *)_signing_hmac, 32);
-				_signing_verifying_nonce[32] = msg.getSender();
-				(void)memcpy((void *)&_signing_verifying_nonce[33], (const void *)_signing_whitelist[j].serial, 9);
-				SHA256(_signing_hmac, _signing_verifying_nonce, 32+1+9);
-				SIGN_DEBUG(PSTR("SGN:BND:VER WHI,ID=%" PRIu8 "\n"), msg.getSender());
+	// Look up the senders nodeId in our whitelist, the signature is salted with that data once
+	// it has been calculated
+	size_t j;
+	for (j = 0; j < NUM_OF(_signing_whitelist); j++) {
+		if (_signing_whitelist[j].nodeId == msg.getSender()) {
+			nonce[32] = msg.getSender();
+			(void)memcpy((void *)&nonce[33], (const void *)_signing_whitelist[j].serial, 9);
+			SIGN_DEBUG(PSTR("SGN:BND:VER WHI,ID=%" PRIu8 "\n"), msg.getSender());
 #ifdef MY_DEBUG_VERBOSE_SIGNING
-				hwDebugBuf2Str(_signing_whitelist[j].serial, 9);
-				SIGN_DEBUG(PSTR("SGN:BND:VER WHI,SERIAL=%s\n"), hwDebugPrintStr);
+			hwDebugBuf2Str(_signing_whitelist[j].serial, 9);
+			SIGN_DEBUG(PSTR("SGN:BND:VER WHI,SERIAL=%s\n"), hwDebugPrintStr);
 #endif
-				break;
-			}
-		}
-		if (j == NUM_OF(_signing_whitelist)) {
-			SIGN_DEBUG(PSTR("!SGN:BND:VER WHI,ID=%" PRIu8 " MISSING\n"), msg.getSender());
-			return false;
+			break;
 		}
+	}
+	if (j == NUM_OF(_signing_whitelist)) {
+		SIGN_DEBUG(PSTR("!SGN:BND:VER WHI,ID=%" PRIu8 " MISSING\n"), msg.getSender());
+		return false;
+	}
+#endif
+	return true;
+}
+
+bool signerAtsha204SoftVerifySignature(MyMessage &msg, uint8_t *nonce, uint8_t *hmac)
+{
+	signerCalculateSignature(msg, nonce, hmac); // Get signature of message
+
+#ifdef MY_SIGNING_NODE_WHITELISTING
+	// Salt the signature with the senders nodeId and serial signerAtsha204SoftVerifyNonce() put
+	// behind the nonce. We can reuse the nonce buffer now since it is no longer needed
+	(void)memcpy((void *)nonce, (const void *)hmac, 32);
+	SHA256(hmac, nonce, 32+1+9);
 #endif
 
-		// Overwrite the first byte in the signature with the signing identifier
-		_signing_hmac[0] = SIGNING_IDENTIFIER;
+	// Overwrite the first byte in the signature with the signing identifier
+	hmac[0] = SIGNING_IDENTIFIER;
+
+	// Compare the calculated signature with the provided signature
+	if (signerMemcmp(&msg.data[msg.getLength()], hmac,
+	                 MIN((uint8_t)(MAX_PAYLOAD_SIZE - msg.getLength()), (uint8_t)32))) {
+		return false;
+	} else {
+		return true;
+	}
+}
+
+// Helper to look up the outstanding nonce handed out to nodeId (NULL if there is none)
+static signing_nonce_entry_t *signerNonceFind(const uint8_t nodeId)
+{
+	for (uint8_t i = 0; i < MY_SIGNING_SOFT_NONCE_TABLE_SIZE; i++) {
+		if (_signing_nonce_table[i].nodeId == nodeId) {
+			return &_signing_nonce_table[i];
+		}
+	}
+	return NULL;
+}
 
-		// Compare the calculated signature with the provided signature
-		if (signerMemcmp(&msg.data[msg.getLength()], _signing_hmac,
-		                 MIN((uint8_t)(MAX_PAYLOAD_SIZE - msg.getLength()), (uint8_t)32))) {
-			return false;
-		} else {
-			return true;
+// Helper to pick the table entry for a new nonce to nodeId. A node only ever has one outstanding
+// nonce, so its previous entry is reused. Otherwise a free entry is taken, and when the table is
+// full the oldest nonce is evicted.
+static signing_nonce_entry_t *signerNonceAlloc(const uint8_t nodeId)
+{
+	signing_nonce_entry_t *entry = signerNonceFind(nodeId);
+	if (entry == NULL) {
+		entry = signerNonceFind(SIGNING_NONCE_FREE);
+	}
+	if (entry == NULL) {
+		const unsigned long time_now = hwMillis();
+		entry = &_signing_nonce_table[0];
+		for (uint8_t i = 1; i < MY_SIGNING_SOFT_NONCE_TABLE_SIZE; i++) {
+			if (time_now - _signing_nonce_table[i].timestamp > time_now - entry->timestamp) {
+				entry = &_signing_nonce_table[i];
+			}
 		}
+		SIGN_DEBUG(PSTR("!SGN:BND:NCE EVICT,ID=%" PRIu8 "\n"), entry->nodeId); // Nonce table full
 	}
+	entry->nodeId = nodeId;
+	return entry;
+}
+
+// Helper to purge a nonce and return its entry to the table
+static void signerNonceFree(signing_nonce_entry_t *entry)
+{
+	(void)memset((void *)entry->nonce, 0xAA, sizeof(entry->nonce));
+	entry->nodeId = SIGNING_NONCE_FREE;
 }
 
-// Helper to calculate signature of msg (returned in _signing_hmac)
-static void signerCalculateSignature(MyMessage &msg, const bool signing)
+// Helper to calculate signature of msg into hmac. The 32 byte nonce is purged when used. No globals
+// are touched so verification workers can call this concurrently.
+static void signerCalculateSignature(MyMessage &msg, uint8_t *nonce, uint8_t *hmac)
 {
 	// Signature is calculated on everything expect the first byte in the header
 	uint8_t bytes_left = msg.getLength()+HEADER_SIZE-1;
 	int16_t current_pos = 1-(int16_t)HEADER_SIZE; // Start at the second byte in the header
-	uint8_t* nonce = signing ? _signing_nonce : _signing_verifying_nonce;
-
-#ifdef MY_DEBUG_VERBOSE_SIGNING
-	hwDebugBuf2Str(nonce, 32);
-	SIGN_DEBUG(PSTR("SGN:BND:NONCE=%s\n"), hwDebugPrintStr);
-#endif
 
 	uint8_t _signing_temp_message[32];
 
@@ -291,7 +378,7 @@ static void signerCalculateSignature(MyMessage &msg, const bool signing)
 		(void)memset((void *)_signing_temp_message, 0x00, sizeof(_signing_temp_message));
 		(void)memcpy((void *)_signing_temp_message, (const void *)&msg.data[current_pos], bytes_to_include);
 
-		signerAtsha204AHmac(_signing_hmac, nonce, _signing_temp_message);
+		signerAtsha204AHmac(hmac, nonce, _signing_temp_message);
 		// Purge nonce when used
 		(void)memset((void *)nonce, 0xAA, 32);
 
@@ -300,18 +387,14 @@ static void signerCalculateSignature(MyMessage &msg, const bool signing)
 
 		if (bytes_left) {
 			// We will do another pass, use current HMAC as nonce for the next HMAC
-			(void)memcpy((void *)nonce, (const void *)_signing_hmac, 32);
+			(void)memcpy((void *)nonce, (const void *)hmac, 32);
 		}
 	}
-#ifdef MY_DEBUG_VERBOSE_SIGNING
-	hwDebugBuf2Str(_signing_hmac, 32);
-	SIGN_DEBUG(PSTR("SGN:BND:HMAC=%s\n"), hwDebugPrintStr);
-#endif
 }
 
 // Helper to calculate a ATSHA204A specific HMAC-SHA256 using provided 32 byte nonce and data
 // (zero padded to 32 bytes)
-// The pointer to the HMAC is returned, but the HMAC is also stored in _signing_hmac
+// dest doubles as scratch for the intermediate digest and must not overlap nonce
 static void signerAtsha204AHmac(uint8_t *dest, const uint8_t *nonce, const uint8_t *data)
 {
 	// ATSHA204 calculates the HMAC with a PSK and a SHA256 digest of the following data:
@@ -353,11 +436,11 @@ static void signerAtsha204AHmac(uint8_t *dest, const uint8_t *nonce, const uint8
 	_signing_buffer[6 + 32] = 0x23; // SN[1]
 	// _signing_buffer[7 + 32..31 + 32] => 0x00;
 	(void)memcpy((void *)&_signing_buffer[64], (const void *)nonce, 32);
-	SHA256(_signing_hmac, _signing_buffer, 96);
+	SHA256(dest, _signing_buffer, 96);
 
 	// Feed "message" to HMAC calculator
 	(void)memset((void *)_signing_buffer, 0x00, sizeof(_signing_buffer));
-	(void)memcpy((void *)&_signing_buffer[32], (const void *)_signing_hmac, 32);
+	(void)memcpy((void *)&_signing_buffer[32], (const void *)dest, 32);
 	_signing_buffer[0 + 64] = 0x11; // OPCODE
 	_signing_buffer[1 + 64] = 0x04; // Mode
 	//_signing_buffer[2 + 64] = 0x00; // SlotID(1)
@@ -369,7 +452,7 @@ static void signerAtsha204AHmac(uint8_t *dest, const uint8_t *nonce, const uint8
 	_signing_buffer[21 + 64] = 0x23;
 	//_signing_buffer[22 + 64] = 0x00; // SN[0]
 	//_signing_buffer[23 + 64] = 0x00; // SN[1]
-	SHA256HMAC(dest, _signing_hmac_key, 32, _signing_buffer, 88);
+	SHA256HMAC(dest, &_signing_hmac_key, _signing_buffer, 88);
 }
 
 #endif //MY_SIGNING_SOFT
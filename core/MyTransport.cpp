@@ -607,11 +607,18 @@ bool transportWait(const uint32_t waitingMS, const uint8_t cmd, const uint8_t ms
 	// invalidate msg type
 	_msg.setType(!msgType);
 	bool expectedResponse = false;
-	while ((hwMillis() - enterMS < waitingMS) && !expectedResponse) {
+	uint32_t elapsedMS;
+	while (((elapsedMS = hwMillis() - enterMS) < waitingMS) && !expectedResponse) {
 		// process incoming messages
 		transportProcessFIFO();
 		doYield();
 		expectedResponse = (_msg.getCommand() == cmd && _msg.getType() == msgType);
+#if defined(MY_LINUX_EVENT_LOOP)
+		if (!expectedResponse) {
+			// Sleep until the radio IRQ or the deadline instead of spinning
+			(void)eventLoopWait(waitingMS - elapsedMS);
+		}
+#endif
 	}
 	return expectedResponse;
 }
@@ -656,28 +663,40 @@ void transportProcessMessage(void)
 	if (!transportHALReceive(&_msg, &payloadLength)) {
 		return;
 	}
-	// get message length and limit size
-	const uint8_t msgLength = _msg.getLength();
-	// calculate expected length
-
-	const uint8_t command = _msg.getCommand();
-	const uint8_t type = _msg.getType();
-	const uint8_t sender = _msg.getSender();
-	const uint8_t last = _msg.getLast();
-	const uint8_t destination = _msg.getDestination();
-
 	TRANSPORT_DEBUG(PSTR("TSF:MSG:READ,%" PRIu8 "-%" PRIu8 "-%" PRIu8 ",s=%" PRIu8 ",c=%" PRIu8 ",t=%"
 	                     PRIu8 ",pt=%" PRIu8 ",l=%" PRIu8 ",sg=%" PRIu8 ":%s\n"),
-	                sender, last, destination, _msg.getSensor(), command, type, _msg.getPayloadType(), msgLength,
-	                _msg.getSigned(), ((command == C_INTERNAL &&
-	                                    type == I_NONCE_RESPONSE) ? "<NONCE>" : _msg.getString(_convBuf)));
-
+	                _msg.getSender(), _msg.getLast(), _msg.getDestination(), _msg.getSensor(),
+	                _msg.getCommand(), _msg.getType(), _msg.getPayloadType(), _msg.getLength(),
+	                _msg.getSigned(), ((_msg.getCommand() == C_INTERNAL &&
+	                                    _msg.getType() == I_NONCE_RESPONSE) ? "<NONCE>" : _msg.getString(_convBuf)));
+
+#if defined(MY_SIGNING_SOFT_VERIFY_WORKERS)
+	// Signature is checked by a worker, transportProcessFIFO() picks the message up again in order.
+	// transportProcessFIFO() only reads a message when there is room in the queue.
+	if (!signerVerifyMsgSubmit(_msg)) {
+		TRANSPORT_DEBUG(PSTR("!TSF:MSG:SIGN QUEUE FULL\n"));
+	}
+	// Do not let transportWait() act on a message that has not been verified yet
+	_msg.setCommand(C_INVALID_7);
+#else
 	// Reject messages that do not pass verification
 	if (!signerVerifyMsg(_msg)) {
 		setIndication(INDICATION_ERR_SIGN);
 		TRANSPORT_DEBUG(PSTR("!TSF:MSG:SIGN VERIFY FAIL\n"));
 		return;
 	}
+	transportProcessVerifiedMessage();
+#endif
+}
+
+void transportProcessVerifiedMessage(void)
+{
+	const uint8_t msgLength = _msg.getLength();
+	const uint8_t command = _msg.getCommand();
+	const uint8_t type = _msg.getType();
+	const uint8_t sender = _msg.getSender();
+	const uint8_t last = _msg.getLast();
+	const uint8_t destination = _msg.getDestination();
 
 	// update routing table if msg not from parent
 #if defined(MY_REPEATER_FEATURE)
@@ -971,10 +990,34 @@ void transportProcessFIFO(void)
 #endif
 
 	uint8_t _processedMessages = MAX_SUBSEQ_MSGS;
+#if defined(MY_SIGNING_SOFT_VERIFY_WORKERS)
+	// queue msgs for verification while there is room, then process those verified in arrival order.
+	// Do not poll the driver when the queue is full, it would drop what it cannot buffer.
+	while (!signerVerifyMsgQueueFull() && transportHALDataAvailable() && _processedMessages--) {
+		transportProcessMessage();
+	}
+	bool verified;
+	while (signerVerifyMsgCollect(_msg, &verified)) {
+		if (!verified) {
+			setIndication(INDICATION_ERR_SIGN);
+			TRANSPORT_DEBUG(PSTR("!TSF:MSG:SIGN VERIFY FAIL\n"));
+		} else {
+			transportProcessVerifiedMessage();
+		}
+	}
+#else
 	// process all msgs in FIFO or counter exit
 	while (transportHALDataAvailable() && _processedMessages--) {
 		transportProcessMessage();
 	}
+#endif
+#if defined(MY_LINUX_EVENT_LOOP)
+	// The counter only wraps when the batch limit stopped the loop above. The IRQ already
+	// fired for what is left in the FIFO, so do not wait for the next event to fetch it.
+	if (_processedMessages == UINT8_MAX && transportHALDataAvailable()) {
+		eventLoopPending();
+	}
+#endif
 #if defined(MY_OTA_FIRMWARE_FEATURE)
 	if (isTransportReady()) {
 		// only process if transport ok
@@ -107,6 +107,7 @@
 * | | TSF | MSG   | REL MSG										| Relay message
 * | | TSF | MSG   | REL PxNG,HP=%%d						| Relay PING/PONG message, increment hop counter (HP)
 * |!| TSF | MSG   | SIGN VERIFY FAIL					| Signing verification failed
+* |!| TSF | MSG   | SIGN QUEUE FULL					| No room to queue the message for signature verification, message dropped
 * |!| TSF | MSG   | REL MSG,NORP							| Node received a message for relaying, but node is not a repeater, message skipped
 * |!| TSF | MSG   | SIGN FAIL									| Signing message failed
 * |!| TSF | MSG   | GWL FAIL									| GW uplink failed
@@ -396,6 +397,10 @@ void transportProcessFIFO(void);
 */
 void transportProcessMessage(void);
 /**
+* @brief Process a received message in _msg once its signature has been verified
+*/
+void transportProcessVerifiedMessage(void);
+/**
 * @brief Assign node ID
 * @param newNodeId New node ID
 * @return true if node ID is valid and successfully assigned
@@ -0,0 +1,202 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+/**
+* @file SPSCCircularBuffer.h
+*
+* Lock-free circular buffering for a single producer and a single consumer.
+*/
+
+#ifndef SPSCCircularBuffer_h
+#define SPSCCircularBuffer_h
+
+#include <stdint.h>
+
+#if defined(__linux__)
+#define SPSC_CACHE_LINE_SIZE (64)	//!< Keep producer and consumer indices on separate cache lines
+#else
+#define SPSC_CACHE_LINE_SIZE (1)	//!< No caches to separate on MCUs
+#endif
+
+/**
+ * Drop-in variant of CircularBuffer for exactly one producer (getFront/pushFront) and one
+ * consumer (getBack/popBack), e.g. an interrupt handler feeding the main loop.
+ * Instead of a critical section, each side only writes its own index and publishes it with
+ * release semantics, the other side reads it with acquire semantics.
+ * Indices run over twice the size to tell a full buffer from an empty one, hence at most
+ * 127 records with the default uint8_t index type S. S must be lock-free on the target.
+ */
+template <class T, class S = uint8_t> class SPSCCircularBuffer
+{
+public:
+	/**
+	 * Constructor
+	 * @param buffer   Preallocated buffer of at least size records.
+	 * @param size     Number of records available in the buffer, half the range of S max.
+	 */
+	SPSCCircularBuffer(T* buffer, const S size)
+		: m_size(size), m_buff(buffer)
+	{
+		clear();
+	}
+
+	/**
+	 * Replace the buffer, e.g. once its size is known at runtime.
+	 * Must not run concurrently with the producer or the consumer.
+	 * @param buffer   Preallocated buffer of at least size records.
+	 * @param size     Number of records available in the buffer.
+	 */
+	void init(T* buffer, const S size)
+	{
+		m_buff = buffer;
+		m_size = size;
+		clear();
+	}
+
+	/**
+	  * Clear all entries in the circular buffer.
+	  * Must not run concurrently with the producer or the consumer.
+	  */
+	void clear(void)
+	{
+		__atomic_store_n(&m_front, 0, __ATOMIC_RELEASE);
+		__atomic_store_n(&m_back, 0, __ATOMIC_RELEASE);
+	}
+
+	/**
+	 * Test if the circular buffer is empty.
+	 * @return True, when empty.
+	 */
+	inline bool empty(void) const
+	{
+		return !available();
+	}
+
+	/**
+	 * Test if the circular buffer is full.
+	 * @return True, when full.
+	 */
+	inline bool full(void) const
+	{
+		return available() == m_size;
+	}
+
+	/**
+	 * Return the number of records stored in the buffer.
+	 * @return number of records.
+	 */
+	inline S available(void) const
+	{
+		const S front = __atomic_load_n(&m_front, __ATOMIC_ACQUIRE);
+		const S back = __atomic_load_n(&m_back, __ATOMIC_ACQUIRE);
+		return (front + 2 * m_size - back) % (2 * m_size);
+	}
+
+	/**
+	 * Aquire unused record on front of the buffer, for writing (producer only).
+	 * After filling the record, it has to be pushed to actually
+	 * add it to the buffer.
+	 * @return Pointer to record, or NULL when buffer is full.
+	 */
+	T* getFront(void) const
+	{
+		if (full()) {
+			return static_cast<T*>(NULL);
+		}
+		return get(__atomic_load_n(&m_front, __ATOMIC_RELAXED));
+	}
+
+	/**
+	 * Push record to front of the buffer (producer only).
+	 * @param record   Record to push. If record was aquired previously (using getFront) its
+	 *                 data will not be copied as it is already present in the buffer.
+	 * @return True, when record was pushed successfully.
+	 */
+	bool pushFront(T* record)
+	{
+		if (full()) {
+			return false;
+		}
+		const S front = __atomic_load_n(&m_front, __ATOMIC_RELAXED);
+		T* f = get(front);
+		if (f != record) {
+			*f = *record;
+		}
+		// Publish the record only after its data is written
+		__atomic_store_n(&m_front, next(front), __ATOMIC_RELEASE);
+		return true;
+	}
+
+	/**
+	 * Aquire record on back of the buffer, for reading (consumer only).
+	 * After reading the record, it has to be pop'ed to actually
+	 * remove it from the buffer.
+	 * @return Pointer to record, or NULL when buffer is empty.
+	 */
+	T* getBack(void) const
+	{
+		if (empty()) {
+			return static_cast<T*>(NULL);
+		}
+		return get(__atomic_load_n(&m_back, __ATOMIC_RELAXED));
+	}
+
+	/**
+	 * Remove record from back of the buffer (consumer only).
+	 * @return True, when record was pop'ed successfully.
+	 */
+	bool popBack(void)
+	{
+		if (empty()) {
+			return false;
+		}
+		// Hand the slot back only after its data was read
+		__atomic_store_n(&m_back, next(__atomic_load_n(&m_back, __ATOMIC_RELAXED)),
+		                 __ATOMIC_RELEASE);
+		return true;
+	}
+
+protected:
+	/**
+	 * Internal getter for records.
+	 * @param idx   Index in the range [0, 2 * size).
+	 * @return Ptr to record.
+	 */
+	inline T * get(const S idx) const
+	{
+		return &(m_buff[idx < m_size ? idx : idx - m_size]);
+	}
+
+	/**
+	 * Internal index increment.
+	 * @param idx   Index in the range [0, 2 * size).
+	 * @return Following index.
+	 */
+	inline S next(const S idx) const
+	{
+		return idx + 1 < 2 * m_size ? idx + 1 : 0;
+	}
+
+	S                  m_size;     //!< Total number of records that can be stored in the buffer.
+	T*                 m_buff;     //!< Ptr to buffer holding all records.
+	alignas(SPSC_CACHE_LINE_SIZE) S m_front;  //!< Index of front element, written by the producer.
+	alignas(SPSC_CACHE_LINE_SIZE) S m_back;   //!< Index of back element, written by the consumer.
+};
+
+#endif // SPSCCircularBuffer_h
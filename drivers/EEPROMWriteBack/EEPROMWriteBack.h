@@ -0,0 +1,138 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+/**
+* @file EEPROMWriteBack.h
+*
+* Deferred commit for flash emulated EEPROM.
+*/
+
+#ifndef EEPROMWriteBack_h
+#define EEPROMWriteBack_h
+
+#include <stdint.h>
+
+/**
+ * Write-back policy for EEPROM emulations that keep a RAM copy and write it to flash on commit()
+ * (ESP8266/ESP32 EEPROM library). Every commit erases and rewrites a whole flash sector, so
+ * changes are collected and committed once writing has been idle for a while, but never later
+ * than a maximum delay after the first pending change.
+ * Pass the EEPROM class as template parameter, it needs read(int), write(int, uint8_t) and
+ * bool commit().
+ */
+template <class T> class EEPROMWriteBack
+{
+public:
+	/**
+	 * Constructor
+	 * @param eeprom     EEPROM emulation to write to.
+	 * @param delayMS    Commit when no write happened for this long, 0 commits every write.
+	 * @param maxDelayMS Commit at the latest this long after the first pending write.
+	 */
+	EEPROMWriteBack(T &eeprom, const uint32_t delayMS, const uint32_t maxDelayMS)
+		: m_eeprom(eeprom), m_delay(delayMS), m_maxDelay(maxDelayMS), m_dirty(false), m_first(0),
+		  m_last(0)
+	{
+	}
+
+	/**
+	 * Write a byte, it is committed by process() or flush().
+	 * Writing a value that is already stored does not mark the EEPROM dirty.
+	 * @param addr  Address to write.
+	 * @param value Value to write.
+	 * @param now   Current time in ms.
+	 */
+	void write(const int addr, const uint8_t value, const uint32_t now)
+	{
+		if (m_eeprom.read(addr) == value) {
+			return;
+		}
+		m_eeprom.write(addr, value);
+		if (!m_dirty) {
+			m_dirty = true;
+			m_first = now;
+		}
+		m_last = now;
+		if (!m_delay) {
+			(void)flush();
+		}
+	}
+
+	/**
+	 * Test if pending writes have to be committed now.
+	 * @param now Current time in ms.
+	 * @return True, when dirty and idle for the commit delay or pending for the maximum delay.
+	 */
+	bool due(const uint32_t now) const
+	{
+		return m_dirty && (now - m_last >= m_delay || now - m_first >= m_maxDelay);
+	}
+
+	/**
+	 * Commit pending writes when due(). A failed commit is retried after the commit delay.
+	 * @param now Current time in ms.
+	 * @return True, when a commit was done.
+	 */
+	bool process(const uint32_t now)
+	{
+		if (!due(now)) {
+			return false;
+		}
+		if (!flush()) {
+			m_first = now;
+			m_last = now;
+			return false;
+		}
+		return true;
+	}
+
+	/**
+	 * Commit pending writes right away (before reboot or sleep).
+	 * @return False, when the commit failed and writes are still pending.
+	 */
+	bool flush(void)
+	{
+		if (m_dirty) {
+			if (!m_eeprom.commit()) {
+				return false;
+			}
+			m_dirty = false;
+		}
+		return true;
+	}
+
+	/**
+	 * Test if there are writes that have not been committed.
+	 * @return True, when dirty.
+	 */
+	inline bool dirty(void) const
+	{
+		return m_dirty;
+	}
+
+private:
+	T &m_eeprom;              //!< EEPROM emulation
+	const uint32_t m_delay;    //!< Idle time before commit
+	const uint32_t m_maxDelay; //!< Maximum time a write stays pending
+	bool m_dirty;              //!< Writes pending
+	uint32_t m_first;          //!< Time of first pending write
+	uint32_t m_last;           //!< Time of last write
+};
+
+#endif // EEPROMWriteBack_h
@@ -0,0 +1,170 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+// Controller protocol throughput, text against binary (MY_GATEWAY_BINARY_PROTOCOL_FEATURE):
+// - outbound: protocolMyMessage2Serial() against protocolMyMessage2Binary();
+// - inbound: protocolParseSerial() on whole lines against protocolBinaryParse() byte by byte.
+// The messages mix float, byte, integer, string and custom payloads, as a gateway sees them.
+// Every decoded message is compared with the one it was encoded from.
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+
+#define MY_GATEWAY_BINARY_PROTOCOL_FEATURE
+#define MY_MQTT_SUBSCRIBE_TOPIC_PREFIX "mygateway1-in"
+
+#include "MyConfig.h"
+#include "core/MySensorsCore.h"
+#include "core/MyHelperFunctions.cpp"
+#include "core/MyMessage.cpp"
+#include "hal/architecture/Linux/drivers/core/noniso.cpp"
+#include "core/MyProtocol.cpp"
+
+#define MESSAGE_SET (4096u)
+#define MESSAGES (2000000u)
+
+static MyMessage messages[MESSAGE_SET];
+static char lines[MESSAGE_SET][MY_GATEWAY_MAX_SEND_LENGTH];
+static uint8_t lineLengths[MESSAGE_SET];
+static uint8_t frames[MESSAGE_SET][PROTOCOL_BINARY_FRAME_MAX_SIZE];
+static uint8_t frameLengths[MESSAGE_SET];
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void createMessages(void)
+{
+	srand(1);
+	for (uint32_t i = 0; i < MESSAGE_SET; i++) {
+		MyMessage &msg = messages[i];
+		msg.clear();
+		msg.setSender((uint8_t)(1 + rand() % 254));
+		msg.setDestination(GATEWAY_ADDRESS);
+		msg.setSensor((uint8_t)(rand() % 255));
+		msg.setCommand(C_SET);
+		msg.setType((uint8_t)(rand() % 57));
+		switch (i % 5) {
+		case 0:
+			msg.set((float)(rand() % 100000) / 100.0f, 2);
+			break;
+		case 1:
+			msg.set((uint8_t)rand());
+			break;
+		case 2:
+			msg.set((int32_t)rand() - RAND_MAX / 2);
+			break;
+		case 3:
+			msg.set("ON");
+			break;
+		default: {
+			// Hex encoded in text, which has to fit into MAX_PAYLOAD_SIZE again on the way in
+			uint8_t custom[MAX_PAYLOAD_SIZE / 2];
+			for (uint8_t n = 0; n < sizeof(custom); n++) {
+				custom[n] = (uint8_t)rand();
+			}
+			msg.set(custom, 1 + rand() % sizeof(custom));
+			break;
+		}
+		}
+	}
+}
+
+int main(void)
+{
+	bool ok = true;
+	uint64_t bytes;
+	double start, elapsed;
+
+	createMessages();
+	printf("%u messages\n", MESSAGES);
+
+	bytes = 0;
+	start = now();
+	for (uint32_t i = 0; i < MESSAGES; i++) {
+		const uint32_t n = i % MESSAGE_SET;
+		const char *line = protocolMyMessage2Serial(messages[n]);
+		const size_t length = strlen(line);
+		if (i < MESSAGE_SET) {
+			(void)memcpy(lines[n], line, length);
+			lineLengths[n] = (uint8_t)length;
+		}
+		bytes += length;
+	}
+	elapsed = now() - start;
+	printf("outbound text    %7.2f Mmsg/s  %5.1f bytes/msg\n", MESSAGES / elapsed / 1e6,
+	       (double)bytes / MESSAGES);
+
+	bytes = 0;
+	start = now();
+	for (uint32_t i = 0; i < MESSAGES; i++) {
+		const uint32_t n = i % MESSAGE_SET;
+		const uint8_t length = protocolMyMessage2Binary(messages[n], frames[n]);
+		frameLengths[n] = length;
+		bytes += length;
+	}
+	elapsed = now() - start;
+	printf("outbound binary  %7.2f Mmsg/s  %5.1f bytes/msg\n", MESSAGES / elapsed / 1e6,
+	       (double)bytes / MESSAGES);
+
+	MyMessage msg;
+	uint32_t mismatches = 0;
+	start = now();
+	for (uint32_t i = 0; i < MESSAGES; i++) {
+		const uint32_t n = i % MESSAGE_SET;
+		if (protocolParseSerial(msg, lines[n], lineLengths[n]) != PROTOCOL_PARSE_OK ||
+		        msg.getDestination() != messages[n].getSender() || msg.getSensor() != messages[n].getSensor() ||
+		        msg.getType() != messages[n].getType()) {
+			mismatches++;
+		}
+	}
+	elapsed = now() - start;
+	printf("inbound text     %7.2f Mmsg/s\n", MESSAGES / elapsed / 1e6);
+	ok &= !mismatches;
+
+	uint8_t frame[PROTOCOL_BINARY_FRAME_MAX_SIZE];
+	uint8_t pos = 0;
+	mismatches = 0;
+	start = now();
+	for (uint32_t i = 0; i < MESSAGES; i++) {
+		const uint32_t n = i % MESSAGE_SET;
+		uint8_t result = PROTOCOL_BINARY_PENDING;
+		for (uint8_t b = 0; b < frameLengths[n]; b++) {
+			result = protocolBinaryParse(msg, frame, pos, frames[n][b]);
+		}
+		if (result != PROTOCOL_BINARY_MESSAGE || msg.getDestination() != messages[n].getDestination() ||
+		        msg.getSensor() != messages[n].getSensor() || msg.getType() != messages[n].getType() ||
+		        msg.getLength() != messages[n].getLength() ||
+		        memcmp(msg.data, messages[n].data, msg.getLength())) {
+			mismatches++;
+		}
+	}
+	elapsed = now() - start;
+	printf("inbound binary   %7.2f Mmsg/s\n", MESSAGES / elapsed / 1e6);
+	ok &= !mismatches;
+
+	if (!ok) {
+		printf("decoded messages differ from the encoded ones\n");
+	}
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,230 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+// OTA firmware CRC16 verification of a 32KB image, old against new:
+// - old: bitwise CRC loop over the image with one readByte() per byte, as before the nibble tables;
+// - verify: transportIsValidFirmware(), the default read back pass, table CRC over readBytes() bursts;
+// - incremental: _firmwareCrcUndo() per received block, all that is left with MY_OTA_SKIP_VERIFY_FLASH.
+// The flash is memory backed, so the numbers show the CPU cost and the number of flash
+// transactions, which dominate on a real SPI flash.
+
+#include <stdint.h>
+#include <time.h>
+
+#include "MyConfig.h"
+
+// The OTA code only needs the stubs below, not the whole core
+#define MySensorsCore_h
+#define GATEWAY_ADDRESS ((uint8_t)0)
+#define NODE_SENSOR_ID ((uint8_t)255)
+
+#include "core/MyEepromAddresses.h"
+#include "core/MyIndication.h"
+#include "core/MyHelperFunctions.cpp"
+#include "core/MyMessage.cpp"
+#include "hal/architecture/Linux/drivers/core/noniso.cpp"
+
+static uint32_t hwMillis(void)
+{
+	return 0;
+}
+
+static void hwReadConfigBlock(void *buf, void *addr, size_t length)
+{
+	(void)addr;
+	(void)memset(buf, 0, length);
+}
+
+static void hwWriteConfigBlock(void *buf, void *addr, size_t length)
+{
+	(void)buf;
+	(void)addr;
+	(void)length;
+}
+
+static void hwReboot(void)
+{
+}
+
+void setIndication(const indication_t ind)
+{
+	(void)ind;
+}
+
+static uint8_t getNodeId(void)
+{
+	return 42;
+}
+
+static inline MyMessage& build(MyMessage &msg, const uint8_t destination, const uint8_t sensor,
+                               const mysensors_command_t command, const uint8_t type, const bool requestEcho = false)
+{
+	msg.setSender(getNodeId());
+	msg.setDestination(destination);
+	msg.setSensor(sensor);
+	msg.setType(type);
+	msg.setCommand(command);
+	msg.setRequestEcho(requestEcho);
+	return msg;
+}
+
+static bool _sendRoute(MyMessage &message)
+{
+	(void)message;
+	return true;
+}
+
+#define FLASH_SIZE (32768u + 16u)
+// Memory backed flash counting the transactions a real SPI flash would see
+class SPIFlash
+{
+public:
+	SPIFlash(uint8_t slaveSelectPin, uint16_t jedecID) : reads(0)
+	{
+		(void)slaveSelectPin;
+		(void)jedecID;
+	}
+	bool initialize(void)
+	{
+		return true;
+	}
+	uint8_t readByte(uint32_t addr)
+	{
+		reads++;
+		return mem[addr];
+	}
+	void readBytes(uint32_t addr, void *buf, uint16_t len)
+	{
+		reads++;
+		(void)memcpy(buf, &mem[addr], len);
+	}
+	void writeBytes(uint32_t addr, const void *buf, uint16_t len)
+	{
+		(void)memcpy(&mem[addr], buf, len);
+	}
+	void blockErase32K(uint32_t addr)
+	{
+		(void)memset(&mem[addr], 0xFF, 32768u);
+	}
+	bool busy(void)
+	{
+		return false;
+	}
+	uint32_t reads;
+	uint8_t mem[FLASH_SIZE];
+};
+
+MyMessage _msg;
+MyMessage _msgTmp;
+
+// Only the CRC part of the OTA code is measured
+#pragma GCC diagnostic ignored "-Wunused-function"
+#include "core/MyOTAFirmwareUpdate.cpp"
+
+#define BLOCKS ((uint16_t)(32768u / FIRMWARE_BLOCK_SIZE))
+#define ROUNDS (200u)
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// transportIsValidFirmware() before the nibble tables
+static uint16_t oldCrc(void)
+{
+	uint16_t crc = ~0;
+	for (uint32_t i = 0; i < _nodeFirmwareConfig.blocks * FIRMWARE_BLOCK_SIZE; ++i) {
+		crc ^= _flash_readByte(i + FIRMWARE_START_OFFSET);
+		for (int8_t j = 0; j < 8; ++j) {
+			if (crc & 1) {
+				crc = (crc >> 1) ^ 0xA001;
+			} else {
+				crc = (crc >> 1);
+			}
+		}
+	}
+	return crc;
+}
+
+// What _firmwareResponse() adds per block, blocks arrive from the end of the image
+static uint16_t incrementalCrc(void)
+{
+	uint16_t crc = _nodeFirmwareConfig.crc;
+	for (uint16_t block = BLOCKS; block > 0; block--) {
+		crc = _firmwareCrcUndo(crc, &_flash.mem[((block - 1) * FIRMWARE_BLOCK_SIZE) +
+		                                                 FIRMWARE_START_OFFSET], FIRMWARE_BLOCK_SIZE);
+	}
+	return crc;
+}
+
+int main(void)
+{
+	srand(1);
+	for (uint32_t i = 0; i < FLASH_SIZE; i++) {
+		_flash.mem[i] = (uint8_t)rand();
+	}
+	_nodeFirmwareConfig.blocks = BLOCKS;
+	_nodeFirmwareConfig.crc = 0;
+	_nodeFirmwareConfig.crc = oldCrc();
+
+	bool ok = true;
+	volatile uint16_t sink = 0;
+	printf("CRC16 of a %u byte image (%u blocks), %u rounds\n", BLOCKS * FIRMWARE_BLOCK_SIZE, BLOCKS,
+	       ROUNDS);
+
+	_flash.reads = 0;
+	double start = now();
+	for (uint32_t i = 0; i < ROUNDS; i++) {
+		sink = oldCrc();
+		ok &= sink == _nodeFirmwareConfig.crc;
+	}
+	double elapsed = (now() - start) / ROUNDS;
+	printf("old bitwise, readByte   %8.1f us/image  %6u flash reads\n", elapsed * 1e6,
+	       _flash.reads / ROUNDS);
+
+	_flash.reads = 0;
+	start = now();
+	for (uint32_t i = 0; i < ROUNDS; i++) {
+		ok &= transportIsValidFirmware();
+	}
+	elapsed = (now() - start) / ROUNDS;
+	printf("table, readBytes        %8.1f us/image  %6u flash reads\n", elapsed * 1e6,
+	       _flash.reads / ROUNDS);
+
+	_flash.reads = 0;
+	start = now();
+	for (uint32_t i = 0; i < ROUNDS; i++) {
+		sink = incrementalCrc();
+		ok &= sink == (uint16_t)~0;
+	}
+	elapsed = (now() - start) / ROUNDS;
+	printf("incremental, per block  %8.3f us/block  %6u flash reads\n", elapsed * 1e6 / BLOCKS,
+	       _flash.reads / ROUNDS);
+
+	// A flipped bit has to show up in both directions
+	_flash.mem[FIRMWARE_START_OFFSET + 1234] ^= 0x04;
+	ok &= !transportIsValidFirmware() && incrementalCrc() != (uint16_t)~0;
+
+	if (!ok) {
+		printf("CRC mismatch\n");
+	}
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
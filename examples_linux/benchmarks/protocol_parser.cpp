@@ -0,0 +1,103 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+// Controller text protocol parser throughput, old against new:
+// - old: the former strtok_r/atoi protocolSerial2MyMessage(), on a writable copy of every line
+//   as the gateway transports handed it their receive buffer;
+// - new: protocolParseSerial() straight from the receive buffer.
+// The lines mix all commands, C_STREAM included. Every parsed message is compared with the one
+// the old parser produced, the malformed and truncated input cases live in tests/Linux.
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+
+#define MY_MQTT_SUBSCRIBE_TOPIC_PREFIX "mygateway1-in"
+
+#include "MyConfig.h"
+#include "core/MySensorsCore.h"
+#include "core/MyHelperFunctions.cpp"
+#include "core/MyMessage.cpp"
+#include "hal/architecture/Linux/drivers/core/noniso.cpp"
+#include "core/MyProtocol.cpp"
+#include "tests/Linux/protocol_lines.h"
+
+#define LINE_SET (4096u)
+#define LINES (2000000u)
+
+static char lines[LINE_SET][MY_GATEWAY_MAX_RECEIVE_LENGTH];
+static uint8_t lineLengths[LINE_SET];
+static MyMessage expected[LINE_SET];
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint32_t randomLine(void)
+{
+	return (uint32_t)rand();
+}
+
+int main(void)
+{
+	uint64_t bytes = 0;
+	srand(1);
+	for (uint32_t i = 0; i < LINE_SET; i++) {
+		lineLengths[i] = (uint8_t)protocolLine(lines[i], randomLine);
+		bytes += lineLengths[i];
+	}
+	printf("%u lines, %.1f bytes/line\n", LINES, (double)bytes / LINE_SET);
+
+	char buffer[MY_GATEWAY_MAX_RECEIVE_LENGTH];
+	uint32_t failures = 0;
+	double start = now();
+	for (uint32_t i = 0; i < LINES; i++) {
+		const uint32_t n = i % LINE_SET;
+		(void)memcpy(buffer, lines[n], lineLengths[n] + 1u);
+		failures += !legacyProtocolSerial2MyMessage(expected[n], buffer);
+	}
+	double elapsed = now() - start;
+	printf("old strtok_r/atoi  %7.2f Mlines/s  %6.1f ns/line\n", LINES / elapsed / 1e6,
+	       elapsed * 1e9 / LINES);
+
+	MyMessage msg;
+	uint32_t mismatches = 0;
+	start = now();
+	for (uint32_t i = 0; i < LINES; i++) {
+		const uint32_t n = i % LINE_SET;
+		if (protocolParseSerial(msg, lines[n], lineLengths[n]) != PROTOCOL_PARSE_OK ||
+		        msg.getDestination() != expected[n].getDestination() ||
+		        msg.getSensor() != expected[n].getSensor() || msg.getType() != expected[n].getType() ||
+		        msg.getLength() != expected[n].getLength() ||
+		        memcmp(msg.data, expected[n].data, msg.getLength())) {
+			mismatches++;
+		}
+	}
+	elapsed = now() - start;
+	printf("new single pass    %7.2f Mlines/s  %6.1f ns/line\n", LINES / elapsed / 1e6,
+	       elapsed * 1e9 / LINES);
+
+	if (failures || mismatches) {
+		printf("parsers disagree: %u old failures, %u mismatches\n", failures, mismatches);
+	}
+	return failures || mismatches ? EXIT_FAILURE : EXIT_SUCCESS;
+}
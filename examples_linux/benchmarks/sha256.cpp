@@ -0,0 +1,135 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+// Generic SHA256 throughput per block kernel, portable C and SHA extensions when the CPU has them:
+// - bulk: 1 MiB hashed through SHA256Add() in one call;
+// - bytewise: the same data one byte per call through the single-instance API, as the
+//   signing backends used to feed it;
+// - HMAC: 32-byte soft signing sized messages, with the key hashed every time and with a
+//   key precomputed by SHA256HMACKeyInit().
+// The known answers are checked in tests/Linux/sha256.cpp, here only the kernels are compared.
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+
+#include "MyConfig.h"
+#include "core/MySensorsCore.h"
+#include "hal/crypto/generic/MyCryptoGeneric.cpp"
+
+#define BULK_SIZE (1024u * 1024u)
+#define BULK_ROUNDS (32u)
+#define BYTEWISE_ROUNDS (4u)
+#define HMAC_ROUNDS (500000u)
+
+typedef void (*kernel_t)(uint32_t *state, const uint8_t *data, size_t blocks);
+
+static uint8_t bulk[BULK_SIZE];
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void bench(const char *name, const kernel_t kernel, uint8_t *digest)
+{
+#if defined(SHA256_HW_DISPATCH)
+	SHA256CompressImpl = kernel;
+#else
+	(void)kernel;
+#endif
+	uint8_t hash[HASH_LENGTH];
+	SHA256Context_t ctx;
+	printf("%s kernel\n", name);
+
+	double start = now();
+	for (uint32_t i = 0; i < BULK_ROUNDS; i++) {
+		SHA256Init(&ctx);
+		SHA256Add(&ctx, bulk, BULK_SIZE);
+		SHA256Result(&ctx, hash);
+	}
+	double elapsed = now() - start;
+	printf("  bulk           %8.1f MB/s\n", BULK_SIZE * (double)BULK_ROUNDS / elapsed / 1e6);
+	(void)memcpy(digest, hash, HASH_LENGTH);
+
+	start = now();
+	for (uint32_t i = 0; i < BYTEWISE_ROUNDS; i++) {
+		SHA256Init();
+		for (uint32_t n = 0; n < BULK_SIZE; n++) {
+			SHA256Add(bulk[n]);
+		}
+		SHA256Result(hash);
+	}
+	elapsed = now() - start;
+	printf("  bytewise       %8.1f MB/s\n", BULK_SIZE * (double)BYTEWISE_ROUNDS / elapsed / 1e6);
+	(void)memcpy(digest + HASH_LENGTH, hash, HASH_LENGTH);
+
+	const uint8_t *key = bulk;
+	uint8_t message[HASH_LENGTH];
+	(void)memcpy(message, bulk + 64, sizeof(message));
+	start = now();
+	for (uint32_t i = 0; i < HMAC_ROUNDS; i++) {
+		SHA256HMAC(message, key, 32, message, sizeof(message));
+	}
+	elapsed = now() - start;
+	printf("  HMAC           %8.0f ns/message\n", elapsed * 1e9 / HMAC_ROUNDS);
+	(void)memcpy(digest + 2 * HASH_LENGTH, message, HASH_LENGTH);
+
+	SHA256HMACKey_t hmacKey;
+	SHA256HMACKeyInit(&hmacKey, key, 32);
+	(void)memcpy(message, bulk + 64, sizeof(message));
+	start = now();
+	for (uint32_t i = 0; i < HMAC_ROUNDS; i++) {
+		SHA256HMAC(message, &hmacKey, message, sizeof(message));
+	}
+	elapsed = now() - start;
+	printf("  HMAC, key init %8.0f ns/message\n", elapsed * 1e9 / HMAC_ROUNDS);
+	(void)memcpy(digest + 3 * HASH_LENGTH, message, HASH_LENGTH);
+}
+
+int main(void)
+{
+	srand(1);
+	for (uint32_t i = 0; i < BULK_SIZE; i++) {
+		bulk[i] = (uint8_t)rand();
+	}
+
+	bool ok = true;
+	uint8_t generic[4 * HASH_LENGTH];
+	bench("generic", SHA256CompressGeneric, generic);
+	// Bulk and bytewise hash the same data, so do both HMAC chains
+	ok &= !memcmp(generic, generic + HASH_LENGTH, HASH_LENGTH);
+	ok &= !memcmp(generic + 2 * HASH_LENGTH, generic + 3 * HASH_LENGTH, HASH_LENGTH);
+#if defined(SHA256_HW_DISPATCH)
+	if (SHA256HwAvailable()) {
+		uint8_t hw[4 * HASH_LENGTH];
+		bench("SHA extension", SHA256CompressHw, hw);
+		ok &= !memcmp(generic, hw, sizeof(hw));
+	} else {
+		printf("no SHA extensions on this CPU\n");
+	}
+#endif
+
+	if (!ok) {
+		printf("kernels or APIs disagree\n");
+	}
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,139 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+// Contention benchmark of the RF24 RX queue handoff: one thread plays the IRQ handler and
+// pushes messages, the other plays the main loop and pops them. CircularBuffer is guarded by
+// the pthread mutex MY_CRITICAL_SECTION takes on Linux with MY_RF24_IRQ_PIN, SPSCCircularBuffer
+// only uses acquire/release indices. Every popped record is checked, so a broken queue fails
+// the run instead of reporting a number.
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Recursive like the Linux HAL mutex, CircularBuffer nests its critical sections
+static pthread_mutex_t hw_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+
+static __inline__ void __hwUnlock(const uint8_t *__s)
+{
+	pthread_mutex_unlock(&hw_mutex);
+	(void)__s;
+}
+
+static __inline__ uint8_t __hwLock()
+{
+	pthread_mutex_lock(&hw_mutex);
+	return 1;
+}
+
+// Same critical section as hal/architecture/Linux/MyHwLinuxGeneric.h with MY_RF24_IRQ_PIN
+#define MY_CRITICAL_SECTION for (uint8_t __atomic_loop \
+	__attribute__((__cleanup__(__hwUnlock))) = __hwLock(); __atomic_loop; __atomic_loop = 0)
+
+#include "drivers/CircularBuffer/CircularBuffer.h"
+#include "drivers/CircularBuffer/SPSCCircularBuffer.h"
+
+#define MESSAGES (2000000u)
+#define QUEUE_SIZE (20u)	// MY_RX_MESSAGE_BUFFER_SIZE default
+
+// Same layout as transportQueuedMessage in MyTransportRF24.cpp
+typedef struct {
+	uint8_t m_len;
+	uint8_t m_data[32];
+	uint32_t m_time;
+} queued_message_t;
+
+static queued_message_t storage[QUEUE_SIZE];
+
+template <class Q> struct run_t {
+	Q *queue;
+	uint32_t full;	// pushes that found the queue full and retried
+	uint32_t errors;
+};
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+template <class Q> static void *producer(void *arg)
+{
+	run_t<Q> *run = (run_t<Q> *)arg;
+	for (uint32_t i = 0; i < MESSAGES; i++) {
+		queued_message_t *msg;
+		while ((msg = run->queue->getFront()) == NULL) {
+			run->full++;
+			sched_yield();
+		}
+		msg->m_len = (uint8_t)(i % 32u) + 1u;
+		msg->m_time = i;
+		(void)memset(msg->m_data, (int)(i & 0xFF), msg->m_len);
+		run->queue->pushFront(msg);
+	}
+	return NULL;
+}
+
+template <class Q> static void *consumer(void *arg)
+{
+	run_t<Q> *run = (run_t<Q> *)arg;
+	for (uint32_t i = 0; i < MESSAGES; i++) {
+		queued_message_t *msg;
+		while ((msg = run->queue->getBack()) == NULL) {
+			sched_yield();
+		}
+		if (msg->m_time != i || msg->m_len != (uint8_t)(i % 32u) + 1u ||
+		        msg->m_data[msg->m_len - 1] != (uint8_t)(i & 0xFF)) {
+			run->errors++;
+		}
+		run->queue->popBack();
+	}
+	return NULL;
+}
+
+template <class Q> static bool bench(const char *name, Q *queue)
+{
+	run_t<Q> run = { queue, 0, 0 };
+	pthread_t prod, cons;
+	const double start = now();
+	pthread_create(&cons, NULL, consumer<Q>, &run);
+	pthread_create(&prod, NULL, producer<Q>, &run);
+	pthread_join(prod, NULL);
+	pthread_join(cons, NULL);
+	const double elapsed = now() - start;
+	printf("%-20s %8.2f Mmsg/s  %6.1f ns/msg  full retries %u  errors %u\n", name,
+	       MESSAGES / elapsed / 1e6, elapsed * 1e9 / MESSAGES, run.full, run.errors);
+	return run.errors == 0 && queue->empty();
+}
+
+int main(void)
+{
+	CircularBuffer<queued_message_t> locked(storage, QUEUE_SIZE);
+	SPSCCircularBuffer<queued_message_t, uint16_t> lockfree(storage, QUEUE_SIZE);
+	bool ok = true;
+
+	printf("%u messages through a %u entry queue\n", MESSAGES, QUEUE_SIZE);
+	ok &= bench("CircularBuffer", &locked);
+	ok &= bench("SPSCCircularBuffer", &lockfree);
+	return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
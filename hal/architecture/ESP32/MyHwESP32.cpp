@@ -24,6 +24,10 @@
 
 #include "MyHwESP32.h"
 
+// EEPROM.commit() rewrites a whole flash sector, collect changes and commit them in one go
+static EEPROMWriteBack<EEPROMClass> _eepromWriteBack(EEPROM, MY_EEPROM_COMMIT_DELAY_MS,
+        MY_EEPROM_COMMIT_MAX_DELAY_MS);
+
 bool hwInit(void)
 {
 #if !defined(MY_DISABLED_SERIAL)
@@ -48,10 +52,26 @@ void hwWriteConfigBlock(void *buf, void *addr, size_t length)
 {
 	uint8_t *src = static_cast<uint8_t *>(buf);
 	int offs = reinterpret_cast<int>(addr);
+	const uint32_t now = hwMillis();
 	while (length-- > 0) {
-		EEPROM.write(offs++, *src++);
+		_eepromWriteBack.write(offs++, *src++, now);
 	}
-	EEPROM.commit();
+}
+
+void hwConfigFlush(void)
+{
+	(void)_eepromWriteBack.flush();
+}
+
+void hwConfigProcess(void)
+{
+	(void)_eepromWriteBack.process(hwMillis());
+}
+
+void hwReboot(void)
+{
+	hwConfigFlush();
+	ESP.restart();
 }
 
 uint8_t hwReadConfig(const int addr)
@@ -63,9 +83,7 @@ uint8_t hwReadConfig(const int addr)
 
 void hwWriteConfig(const int addr, uint8_t value)
 {
-	if (hwReadConfig(addr) != value) {
-		hwWriteConfigBlock(&value, reinterpret_cast<void *>(addr), 1);
-	}
+	hwWriteConfigBlock(&value, reinterpret_cast<void *>(addr), 1);
 }
 
 bool hwUniqueID(unique_id_t *uniqueID)
@@ -93,6 +111,7 @@ ssize_t hwGetentropy(void *__buffer, size_t __length)
 int8_t hwSleep(uint32_t ms)
 {
 	esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000);
+	hwConfigFlush();
 	esp_light_sleep_start();
 	return MY_WAKE_UP_BY_TIMER;
 }
@@ -108,6 +127,7 @@ int8_t hwSleep(const uint8_t interrupt, const uint8_t mode, uint32_t ms)
 	}
 	esp_sleep_enable_gpio_wakeup();
 	esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000);
+	hwConfigFlush();
 	esp_light_sleep_start();
 	gpio_wakeup_disable((gpio_num_t)interrupt);
 	return 0;
@@ -133,6 +153,7 @@ int8_t hwSleep(const uint8_t interrupt1, const uint8_t mode1, const uint8_t inte
 	}
 	esp_sleep_enable_gpio_wakeup();
 	esp_sleep_enable_timer_wakeup((uint64_t)ms * 1000);
+	hwConfigFlush();
 	esp_light_sleep_start();
 	gpio_wakeup_disable((gpio_num_t)interrupt1);
 	gpio_wakeup_disable((gpio_num_t)interrupt2);
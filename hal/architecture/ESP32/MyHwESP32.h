@@ -40,6 +40,7 @@
 
 #include <WiFi.h>
 #include "EEPROM.h"
+#include "drivers/EEPROMWriteBack/EEPROMWriteBack.h"
 #include <SPI.h>
 
 #ifdef __cplusplus
@@ -70,7 +71,6 @@
 #define hwDigitalRead(__pin) digitalRead(__pin)
 #define hwPinMode(__pin, __value) pinMode(__pin, __value)
 #define hwWatchdogReset()
-#define hwReboot() ESP.restart()
 #define hwMillis() millis()
 #define hwMicros() micros()
 #define hwRandomNumberInit() randomSeed(esp_random())
@@ -81,6 +81,10 @@ void hwReadConfigBlock(void *buf, void *addr, size_t length);
 void hwWriteConfigBlock(void *buf, void *addr, size_t length);
 void hwWriteConfig(const int addr, uint8_t value);
 uint8_t hwReadConfig(const int addr);
+void hwConfigFlush(void);
+void hwConfigProcess(void);
+#define MY_HW_HAS_CONFIG_PROCESS
+void hwReboot(void);
 ssize_t hwGetentropy(void *__buffer, size_t __length);
 #define MY_HW_HAS_GETENTROPY
 
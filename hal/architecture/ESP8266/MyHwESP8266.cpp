@@ -19,6 +19,10 @@
 
 #include "MyHwESP8266.h"
 
+// EEPROM.commit() rewrites a whole flash sector, collect changes and commit them in one go
+static EEPROMWriteBack<EEPROMClass> _eepromWriteBack(EEPROM, MY_EEPROM_COMMIT_DELAY_MS,
+        MY_EEPROM_COMMIT_MAX_DELAY_MS);
+
 bool hwInit(void)
 {
 #if !defined(MY_DISABLED_SERIAL)
@@ -45,11 +49,26 @@ void hwWriteConfigBlock(void *buf, void *addr, size_t length)
 {
 	uint8_t *src = static_cast<uint8_t *>(buf);
 	int pos = reinterpret_cast<int>(addr);
+	const uint32_t now = hwMillis();
 	while (length-- > 0) {
-		EEPROM.write(pos++, *src++);
+		_eepromWriteBack.write(pos++, *src++, now);
 	}
-	// see implementation, commit only executed if diff
-	EEPROM.commit();
+}
+
+void hwConfigFlush(void)
+{
+	(void)_eepromWriteBack.flush();
+}
+
+void hwConfigProcess(void)
+{
+	(void)_eepromWriteBack.process(hwMillis());
+}
+
+void hwReboot(void)
+{
+	hwConfigFlush();
+	ESP.restart();
 }
 
 uint8_t hwReadConfig(const int addr)
@@ -23,6 +23,7 @@
 #include <ESP8266WiFi.h>
 #include <WiFiUdp.h>
 #include <EEPROM.h>
+#include "drivers/EEPROMWriteBack/EEPROMWriteBack.h"
 
 #ifdef __cplusplus
 #include <Arduino.h>
@@ -45,7 +46,6 @@
 #define hwDigitalRead(__pin) digitalRead(__pin)
 #define hwPinMode(__pin, __value) pinMode(__pin, __value)
 #define hwWatchdogReset() wdt_reset()
-#define hwReboot() ESP.restart()
 #define hwMillis() millis()
 // The use of randomSeed switch to pseudo random number. Keep hwRandomNumberInit empty
 #define hwRandomNumberInit()
@@ -56,6 +56,10 @@ void hwReadConfigBlock(void *buf, void *addr, size_t length);
 void hwWriteConfigBlock(void *buf, void *addr, size_t length);
 void hwWriteConfig(const int addr, uint8_t value);
 uint8_t hwReadConfig(const int addr);
+void hwConfigFlush(void);
+void hwConfigProcess(void);
+#define MY_HW_HAS_CONFIG_PROCESS
+void hwReboot(void);
 ssize_t hwGetentropy(void *__buffer, size_t __length);
 //#define MY_HW_HAS_GETENTROPY
 
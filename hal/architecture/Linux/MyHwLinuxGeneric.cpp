@@ -24,6 +24,13 @@ static FILE *randomFp = NULL;
 
 bool hwInit(void)
 {
+#ifdef MY_LINUX_EVENT_LOOP
+	// Must be up before any serial port or socket is opened, they register themselves
+	if (eventLoopInit(MY_LINUX_EVENT_LOOP_TIMER_MS) != 0) {
+		logError("Unable to initialize the event loop.\n");
+		exit(1);
+	}
+#endif
 	MY_SERIALDEVICE.begin(MY_BAUD_RATE);
 #ifdef MY_GATEWAY_SERIAL
 #ifdef MY_LINUX_SERIAL_GROUPNAME
@@ -34,7 +41,8 @@ bool hwInit(void)
 #endif
 #endif
 
-	if (eeprom.init(conf.eeprom_file, conf.eeprom_size) != 0) {
+	if (eeprom.init(conf.eeprom_file, conf.eeprom_size, conf.eeprom_flush_interval * 1000,
+	                conf.eeprom_atomic_flush) != 0) {
 		exit(1);
 	}
 
@@ -51,6 +59,16 @@ void hwWriteConfigBlock(void *buf, void *addr, size_t length)
 	eeprom.writeBlock(buf, addr, length);
 }
 
+void hwConfigFlush(void)
+{
+	(void)eeprom.flush();
+}
+
+void hwConfigProcess(void)
+{
+	eeprom.process();
+}
+
 uint8_t hwReadConfig(const int addr)
 {
 	return eeprom.readByte(addr);
@@ -31,14 +31,30 @@
 #include "config.h"
 #include "MySensorsCore.h"
 
+static volatile sig_atomic_t exitSignal = 0;
+
 void handle_sigint(int sig)
 {
-	if (sig == SIGINT) {
+	if (sig != SIGINT && sig != SIGTERM) {
+		return;
+	}
+	if (exitSignal) {
+		// Second signal, the main loop is stuck: leave without flushing
+		_exit(EXIT_FAILURE);
+	}
+	// Only async-signal-safe calls here, the main loop flushes and exits
+	exitSignal = sig;
+#ifdef MY_LINUX_EVENT_LOOP
+	eventLoopNotify();
+#endif
+}
+
+static void shutdown_on_signal(void)
+{
+	if (exitSignal == SIGINT) {
 		logNotice("Received SIGINT\n\n");
-	} else if (sig == SIGTERM) {
-		logNotice("Received SIGTERM\n\n");
 	} else {
-		return;
+		logNotice("Received SIGTERM\n\n");
 	}
 
 #ifdef MY_RF24_IRQ_PIN
@@ -49,6 +65,8 @@ void handle_sigint(int sig)
 	MY_SERIALDEVICE.end();
 #endif
 
+	hwConfigFlush();
+
 	logClose();
 
 	exit(EXIT_SUCCESS);
@@ -441,6 +459,12 @@ int main(int argc, char *argv[])
 		logSetSyslog(LOG_CONS, LOG_USER);
 	}
 
+	if (conf.log_async_ring_size) {
+		if (logSetAsync(conf.log_async_ring_size) != 0) {
+			logError("Failed to start async logging.\n");
+		}
+	}
+
 	logInfo("Starting gateway...\n");
 	logInfo("Protocol version - %s\n", MYSENSORS_LIBRARY_VERSION);
 
@@ -478,11 +502,12 @@ int main(int argc, char *argv[])
 		free(config_file);
 	}
 
-	for (;;) {
+	while (!exitSignal) {
 		_process();  // Process incoming data
 		if (loop) {
 			loop(); // Call sketch loop
 		}
 	}
+	shutdown_on_signal();
 	return 0;
 }
@@ -57,6 +57,7 @@
 #define snprintf_P(...) snprintf( __VA_ARGS__ )
 #define memcpy_P memcpy
 #define pgm_read_byte(p) (*(p))
+#define pgm_read_word(p) (*(p))
 #define pgm_read_dword(p) (*(p))
 #define pgm_read_byte_near(p) (*(p))
 
@@ -31,7 +31,165 @@
 #include <sys/time.h>
 #include <netinet/tcp.h>
 #include <errno.h>
+#include <sys/uio.h>
+#include <algorithm>
+#include <map>
+#include <vector>
 #include "log.h"
+#include "config.h"
+#include "eventloop.h"
+
+/**
+ * Receive buffer of a connection. EthernetClient objects are copied around by value, so the
+ * buffers are kept here, indexed by socket, and released when the socket is closed.
+ */
+struct RxBuffer {
+	uint8_t data[ETHERNETCLIENT_RX_BUFFER_SIZE];
+	size_t head;
+	size_t tail;
+};
+
+static std::map<int, RxBuffer> rxBuffers;
+
+static RxBuffer &_rxBuffer(int sock)
+{
+	std::map<int, RxBuffer>::iterator it = rxBuffers.find(sock);
+	if (it == rxBuffers.end()) {
+		RxBuffer &rx = rxBuffers[sock];
+		rx.head = 0;
+		rx.tail = 0;
+		return rx;
+	}
+	return it->second;
+}
+
+// Returns the number of buffered bytes, refilling the buffer with one recv() if it is empty
+static size_t _rxFill(int sock, RxBuffer &rx)
+{
+	if (rx.head == rx.tail) {
+		rx.head = 0;
+		rx.tail = 0;
+		const ssize_t rc = recv(sock, rx.data, sizeof(rx.data), MSG_DONTWAIT);
+		if (rc > 0) {
+			rx.tail = rc;
+		}
+	}
+	return rx.tail - rx.head;
+}
+
+// Data left in the buffer won't make the socket readable again, keep the event loop awake
+static void _rxConsumed(const RxBuffer &rx)
+{
+	if (rx.head != rx.tail) {
+		eventLoopPending();
+	}
+}
+
+/**
+ * Send queue of a connection: a ring buffer with room for ethernet_tx_high_water bytes, only
+ * allocated while the socket doesn't take all data. Kept by socket like the receive buffers.
+ */
+struct TxQueue {
+	std::vector<uint8_t> data;
+	size_t head;
+	size_t used;
+};
+
+static std::map<int, TxQueue> txQueues;
+
+static size_t _txHighWater(void)
+{
+	return conf.ethernet_tx_high_water > 0 ? (size_t)conf.ethernet_tx_high_water :
+	       ETHERNETCLIENT_TX_HIGH_WATER;
+}
+
+// Send the queued bytes followed by buf with a single sendmsg() and queue whatever the socket
+// doesn't take. Returns false if the connection failed or is stuck above the high-water mark.
+static bool _txSend(int sock, const uint8_t *buf, size_t size)
+{
+	std::map<int, TxQueue>::iterator it = txQueues.find(sock);
+	TxQueue *tx = (it != txQueues.end()) ? &it->second : NULL;
+	const size_t queued = tx ? tx->used : 0;
+	struct iovec iov[3];
+	size_t count = 0;
+
+	if (queued) {
+		const size_t first = std::min(queued, tx->data.size() - tx->head);
+		iov[count].iov_base = &tx->data[tx->head];
+		iov[count++].iov_len = first;
+		if (first < queued) {
+			iov[count].iov_base = &tx->data[0];
+			iov[count++].iov_len = queued - first;
+		}
+	}
+	if (size) {
+		iov[count].iov_base = const_cast<uint8_t *>(buf);
+		iov[count++].iov_len = size;
+	}
+	if (!count) {
+		return true;
+	}
+
+	struct msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = count;
+	ssize_t rc = sendmsg(sock, &msg, MSG_NOSIGNAL | MSG_DONTWAIT);
+	if (rc == -1) {
+		if (errno != EAGAIN && errno != EWOULDBLOCK) {
+			logError("send: %s\n", strerror(errno));
+			return false;
+		}
+		rc = 0;
+	}
+
+	size_t sent = rc;
+	if (queued) {
+		const size_t n = std::min(sent, queued);
+		tx->head = (tx->head + n) % tx->data.size();
+		tx->used -= n;
+		sent -= n;
+	}
+	const size_t rest = size - sent;
+	if (rest) {
+		const size_t highWater = _txHighWater();
+		if (!tx) {
+			tx = &txQueues[sock];
+			tx->data.resize(highWater);
+			tx->head = 0;
+			tx->used = 0;
+		}
+		if (tx->used + rest > highWater) {
+			logError("Ethernet client %d has %zu bytes queued, disconnecting.\n", sock, tx->used + rest);
+			return false;
+		}
+		const size_t tail = (tx->head + tx->used) % highWater;
+		const size_t first = std::min(rest, highWater - tail);
+		memcpy(&tx->data[tail], buf + sent, first);
+		memcpy(&tx->data[0], buf + sent + first, rest - first);
+		tx->used += rest;
+	}
+
+	if (tx && !tx->used) {
+		txQueues.erase(sock);
+		tx = NULL;
+	}
+	if ((queued != 0) != (tx != NULL)) {
+		// Wake up once the socket takes more, available() sends the rest
+		(void)eventLoopWatchWrite(sock, tx != NULL);
+	}
+	return true;
+}
+
+// Give up on a connection that failed or is stuck. Shut it down instead of closing it, the
+// socket number stays valid until the owner notices the disconnect and calls stop().
+static void _txDisconnect(int sock)
+{
+	if (txQueues.erase(sock)) {
+		(void)eventLoopWatchWrite(sock, 0);
+	}
+	shutdown(sock, SHUT_RDWR);
+}
 
 EthernetClient::EthernetClient() : _sock(-1)
 {
@@ -100,6 +258,7 @@ int EthernetClient::connect(const char* host, uint16_t port)
 	void *addr = &(((struct sockaddr_in*)p->ai_addr)->sin_addr);
 	inet_ntop(p->ai_family, addr, s, sizeof s);
 	logDebug("connected to %s\n", s);
+	(void)eventLoopAdd(_sock);
 
 	freeaddrinfo(servinfo); // all done with this structure
 	if (use_bind) {
@@ -121,24 +280,16 @@ size_t EthernetClient::write(uint8_t b)
 
 size_t EthernetClient::write(const uint8_t *buf, size_t size)
 {
-	int bytes = 0;
-
 	if (_sock == -1) {
 		return 0;
 	}
 
-	while (size > 0) {
-		int rc = send(_sock, buf + bytes, size, MSG_NOSIGNAL | MSG_DONTWAIT);
-		if (rc == -1) {
-			logError("send: %s\n", strerror(errno));
-			close();
-			break;
-		}
-		bytes += rc;
-		size -= rc;
+	if (!_txSend(_sock, buf, size)) {
+		_txDisconnect(_sock);
+		return 0;
 	}
 
-	return bytes;
+	return size;
 }
 
 size_t EthernetClient::write(const char *str)
@@ -155,41 +306,118 @@ size_t EthernetClient::write(const char *buffer, size_t size)
 
 int EthernetClient::available()
 {
-	int count = 0;
+	if (_sock == -1) {
+		return 0;
+	}
 
-	if (_sock != -1) {
-		ioctl(_sock, SIOCINQ, &count);
+	if (txQueues.count(_sock) && !_txSend(_sock, NULL, 0)) {
+		_txDisconnect(_sock);
 	}
 
-	return count;
+	return _rxFill(_sock, _rxBuffer(_sock));
 }
 
 int EthernetClient::read()
 {
-	uint8_t b;
-	if ( recv(_sock, &b, 1, MSG_DONTWAIT) > 0 ) {
-		// recv worked
-		return b;
-	} else {
+	if (_sock == -1) {
+		return -1;
+	}
+
+	RxBuffer &rx = _rxBuffer(_sock);
+	if (_rxFill(_sock, rx) == 0) {
 		// No data available
 		return -1;
 	}
+
+	const uint8_t b = rx.data[rx.head++];
+	_rxConsumed(rx);
+	return b;
 }
 
 int EthernetClient::read(uint8_t *buf, size_t bytes)
 {
-	return recv(_sock, buf, bytes, MSG_DONTWAIT);
+	if (_sock == -1) {
+		return -1;
+	}
+
+	RxBuffer &rx = _rxBuffer(_sock);
+	if (rx.head == rx.tail) {
+		// Nothing buffered, receive straight into the caller's buffer
+		return recv(_sock, buf, bytes, MSG_DONTWAIT);
+	}
+
+	const size_t n = std::min(bytes, rx.tail - rx.head);
+	memcpy(buf, &rx.data[rx.head], n);
+	rx.head += n;
+	_rxConsumed(rx);
+	return n;
 }
 
 int EthernetClient::peek()
 {
-	uint8_t b;
+	if (_sock == -1) {
+		return -1;
+	}
 
-	if (recv(_sock, &b, 1, MSG_PEEK | MSG_DONTWAIT) > 0) {
-		return b;
-	} else {
+	RxBuffer &rx = _rxBuffer(_sock);
+	if (_rxFill(_sock, rx) == 0) {
 		return -1;
 	}
+
+	return rx.data[rx.head];
+}
+
+size_t EthernetClient::readLine(char *buf, size_t size, bool *eol)
+{
+	*eol = false;
+	if (_sock == -1) {
+		return 0;
+	}
+
+	RxBuffer &rx = _rxBuffer(_sock);
+	const size_t count = std::min(size, _rxFill(_sock, rx));
+	const uint8_t *start = &rx.data[rx.head];
+	const uint8_t *end = static_cast<const uint8_t *>(memchr(start, '\n', count));
+	const uint8_t *cr = static_cast<const uint8_t *>(memchr(start, '\r', end ? end - start : count));
+	if (cr) {
+		end = cr;
+	}
+
+	const size_t n = end ? (size_t)(end - start) : count;
+	memcpy(buf, start, n);
+	rx.head += n;
+	if (end) {
+		// Consume the terminator
+		rx.head++;
+		*eol = true;
+	}
+	_rxConsumed(rx);
+	return n;
+}
+
+const char *EthernetClient::readLineInPlace(size_t *length)
+{
+	if (_sock == -1) {
+		return NULL;
+	}
+
+	RxBuffer &rx = _rxBuffer(_sock);
+	const size_t count = _rxFill(_sock, rx);
+	const char *start = reinterpret_cast<const char *>(&rx.data[rx.head]);
+	const char *end = static_cast<const char *>(memchr(start, '\n', count));
+	const char *cr = static_cast<const char *>(memchr(start, '\r', end ? end - start : count));
+	if (cr) {
+		end = cr;
+	}
+	if (!end) {
+		return NULL;
+	}
+
+	*length = end - start;
+	// Consume the line and its terminator
+	rx.head += *length + 1;
+	_rxConsumed(rx);
+	return start;
 }
 
 void EthernetClient::flush()
@@ -197,6 +425,15 @@ void EthernetClient::flush()
 	int count = 0;
 
 	if (_sock != -1) {
+		while (txQueues.count(_sock)) {
+			if (!_txSend(_sock, NULL, 0)) {
+				_txDisconnect(_sock);
+				return;
+			}
+			if (txQueues.count(_sock)) {
+				usleep(1000);
+			}
+		}
 		while (true) {
 			ioctl(_sock, SIOCOUTQ, &count);
 			if (count == 0) {
@@ -231,6 +468,8 @@ void EthernetClient::stop()
 	         1000000);
 
 	// free up the socket descriptor
+	rxBuffers.erase(_sock);
+	txQueues.erase(_sock);
 	::close(_sock);
 	_sock = -1;
 }
@@ -282,6 +521,8 @@ uint8_t EthernetClient::connected()
 void EthernetClient::close()
 {
 	if (_sock != -1) {
+		rxBuffers.erase(_sock);
+		txQueues.erase(_sock);
 		::close(_sock);
 		_sock = -1;
 	}
@@ -37,6 +37,14 @@
 #define ETHERNETCLIENT_W5100_CLOSE_WAIT 0x1C
 #define ETHERNETCLIENT_W5100_LAST_ACK 0x1D
 
+#ifndef ETHERNETCLIENT_RX_BUFFER_SIZE
+#define ETHERNETCLIENT_RX_BUFFER_SIZE 2048 //!< Size of the per connection receive buffer.
+#endif
+
+#ifndef ETHERNETCLIENT_TX_HIGH_WATER
+#define ETHERNETCLIENT_TX_HIGH_WATER 65536 //!< Default for ethernet_tx_high_water in mysensors.conf.
+#endif
+
 /**
  * EthernetClient class
  */
@@ -78,11 +86,15 @@ public:
 	 */
 	virtual size_t write(uint8_t b);
 	/**
-	 * @brief Write at most 'size' bytes.
+	 * @brief Write 'size' bytes without blocking.
+	 *
+	 * Whatever the socket doesn't take right away is queued and sent together with later
+	 * writes, or once the socket becomes writable again (see available()). A connection that
+	 * has more than ethernet_tx_high_water bytes queued is considered stuck and shut down.
 	 *
 	 * @param buf Buffer to read from.
 	 * @param size of the buffer.
-	 * @return 0 if FAILURE or the number of bytes sent.
+	 * @return 0 if FAILURE or the number of bytes sent or queued.
 	 */
 	virtual size_t write(const uint8_t *buf, size_t size);
 	/**
@@ -103,6 +115,9 @@ public:
 	/**
 	 * @brief Returns the number of bytes available for reading.
 	 *
+	 * If the receive buffer is empty it is refilled with a single recv(). Queued outgoing
+	 * data is sent first, as far as the socket takes it.
+	 *
 	 * @return number of bytes available.
 	 */
 	virtual int available();
@@ -127,7 +142,28 @@ public:
 	 */
 	virtual int peek();
 	/**
-	 * @brief Waits until all outgoing bytes in buffer have been sent.
+	 * @brief Read up to the next line terminator ('\\n' or '\\r').
+	 *
+	 * Copies buffered bytes until a terminator is found or 'size' bytes were copied. The
+	 * terminator itself is consumed but not copied.
+	 *
+	 * @param buf buffer to write to.
+	 * @param size of the buffer.
+	 * @param eol set to true if a line terminator was found.
+	 * @return number of bytes copied to buf.
+	 */
+	size_t readLine(char *buf, size_t size, bool *eol);
+	/**
+	 * @brief Read the next line without copying it out of the receive buffer.
+	 *
+	 * Nothing is consumed if the buffer doesn't hold a complete line, use readLine() then.
+	 *
+	 * @param length set to the line length, without the terminator.
+	 * @return pointer to the line, valid until the next read, or NULL.
+	 */
+	const char *readLineInPlace(size_t *length);
+	/**
+	 * @brief Waits until all queued and outgoing bytes in buffer have been sent.
 	 */
 	virtual void flush();
 	/**
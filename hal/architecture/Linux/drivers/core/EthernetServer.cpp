@@ -30,6 +30,7 @@
 #include <errno.h>
 #include <fcntl.h>
 #include "log.h"
+#include "eventloop.h"
 #include "EthernetClient.h"
 
 EthernetServer::EthernetServer(uint16_t port, uint16_t max_clients) : port(port),
@@ -104,6 +105,7 @@ void EthernetServer::begin(IPAddress address)
 	freeaddrinfo(servinfo);
 
 	fcntl(sockfd, F_SETFL, O_NONBLOCK);
+	(void)eventLoopAdd(sockfd);
 
 	struct sockaddr_in *ipv4 = (struct sockaddr_in *)p->ai_addr;
 	void *addr = &(ipv4->sin_addr);
@@ -156,11 +158,10 @@ size_t EthernetServer::write(const uint8_t *buffer, size_t size)
 {
 	size_t n = 0;
 
+	// No status() check per client, write() never blocks and shuts down failed connections
 	for (size_t i = 0; i < clients.size(); ++i) {
 		EthernetClient client(clients[i]);
-		if (client.status() == ETHERNETCLIENT_W5100_ESTABLISHED) {
-			n += client.write(buffer, size);
-		}
+		n += client.write(buffer, size);
 	}
 
 	return n;
@@ -204,6 +205,7 @@ void EthernetServer::_accept()
 
 	new_clients.push_back(new_fd);
 	clients.push_back(new_fd);
+	(void)eventLoopAdd(new_fd);
 
 	void *addr = &(((struct sockaddr_in*)&client_addr)->sin_addr);
 	inet_ntop(client_addr.ss_family, addr, ipstr, sizeof ipstr);
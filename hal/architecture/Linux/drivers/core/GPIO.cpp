@@ -19,177 +19,268 @@
 
 #include "GPIO.h"
 #include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/gpio.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include "log.h"
 
+#define GPIO_CONSUMER "mysgw"
+#define GPIO_SYSFS_DIR "/sys/class/gpio"
+// Kernels since 6.6 hand out dynamic GPIO bases from 512, so the numbers of the first chip keep
+// starting at 0 with this subtracted
+#define GPIO_DYNAMIC_BASE 512
+
+// Chips driving the pin header, numbered from 0 whatever their chip index or base
+// (on the Raspberry Pi 5 the header is gpiochip4 on older kernels and based at 571)
+static const char *headerChipLabels[] = { "pinctrl-bcm2835", "pinctrl-bcm2711", "pinctrl-rp1" };
+
 // Declare a single default instance
 GPIOClass GPIO = GPIOClass();
 
-GPIOClass::GPIOClass()
+// Looks up the sysfs base of the chip with the given label and number of lines, skipping
+// the count bases in used that earlier chips with the same label took
+static int sysfsBaseOf(const char *label, uint32_t lines, const int *used, int count)
 {
-	FILE *f;
 	DIR* dp;
-	char file[64];
+	FILE *f;
+	char file[300];
+	int found = -1;
 
-	dp = opendir("/sys/class/gpio");
+	dp = opendir(GPIO_SYSFS_DIR);
 	if (dp == NULL) {
-		logError("Could not open /sys/class/gpio directory");
-		exit(1);
+		return -1;
 	}
 
-	lastPinNum = 0;
-
-	while (true) {
+	while (found < 0) {
 		dirent *de = readdir(dp);
 		if (de == NULL) {
 			break;
 		}
 
-		if (strncmp("gpiochip", de->d_name, 8) == 0) {
-			snprintf(file, sizeof(file), "/sys/class/gpio/%s/base", de->d_name);
-			f = fopen(file, "r");
-			int base;
-			if (fscanf(f, "%d", &base) == EOF) {
-				logError("Failed to open %s\n", file);
-				base = 0;
+		int base;
+		if (sscanf(de->d_name, "gpiochip%d", &base) != 1) {
+			continue;
+		}
+
+		char sysfsLabel[GPIO_MAX_NAME_SIZE + 1] = "";
+		unsigned int ngpio = 0;
+		snprintf(file, sizeof(file), GPIO_SYSFS_DIR "/%s/label", de->d_name);
+		if ((f = fopen(file, "r")) != NULL) {
+			if (fgets(sysfsLabel, sizeof(sysfsLabel), f) != NULL) {
+				sysfsLabel[strcspn(sysfsLabel, "\n")] = '\0';
 			}
 			fclose(f);
-
-			snprintf(file, sizeof(file), "/sys/class/gpio/%s/ngpio", de->d_name);
-			f = fopen(file, "r");
-			int ngpio;
-			if (fscanf(f, "%d", &ngpio) == EOF) {
-				logError("Failed to open %s\n", file);
+		}
+		snprintf(file, sizeof(file), GPIO_SYSFS_DIR "/%s/ngpio", de->d_name);
+		if ((f = fopen(file, "r")) != NULL) {
+			if (fscanf(f, "%u", &ngpio) != 1) {
 				ngpio = 0;
 			}
 			fclose(f);
+		}
+		if (ngpio != lines || strcmp(sysfsLabel, label) != 0) {
+			continue;
+		}
 
-			int max = ngpio + base - 1;
-			if (lastPinNum < max) {
-				lastPinNum = max;
+		found = base;
+		for (int i = 0; i < count; ++i) {
+			if (used[i] == base) {
+				found = -1;
 			}
 		}
 	}
 	closedir(dp);
 
-	exportedPins = new uint8_t[lastPinNum + 1];
+	return found;
+}
+
+GPIOClass::GPIOClass()
+{
+	DIR* dp;
+	char file[64];
+	int lastChip = -1;
+
+	lastPinNum = -1;
+	chipCount = 0;
+	chipFds = NULL;
+	chipLines = NULL;
+	chipBases = NULL;
+	lineFds = NULL;
+	lineModes = NULL;
+
+	dp = opendir("/dev");
+	if (dp == NULL) {
+		logError("Could not open /dev directory\n");
+		exit(1);
+	}
+
+	while (true) {
+		dirent *de = readdir(dp);
+		if (de == NULL) {
+			break;
+		}
+
+		int chip;
+		if (sscanf(de->d_name, "gpiochip%d", &chip) == 1 && chip > lastChip) {
+			lastChip = chip;
+		}
+	}
+	closedir(dp);
+
+	chipCount = lastChip + 1;
+	chipFds = new int[chipCount];
+	chipLines = new int[chipCount];
+	chipBases = new int[chipCount];
+
+	int *sysfsBases = new int[chipCount];
+	bool *headerChips = new bool[chipCount];
+
+	for (int i = 0; i < chipCount; ++i) {
+		struct gpiochip_info info;
+
+		chipLines[i] = 0;
+		chipBases[i] = -1;
+		sysfsBases[i] = -1;
+		headerChips[i] = false;
+		snprintf(file, sizeof(file), "/dev/gpiochip%d", i);
+		chipFds[i] = open(file, O_RDWR | O_CLOEXEC);
+		if (chipFds[i] < 0) {
+			continue;
+		}
+		if (ioctl(chipFds[i], GPIO_GET_CHIPINFO_IOCTL, &info) < 0) {
+			logError("Failed to get info of %s: %s\n", file, strerror(errno));
+			close(chipFds[i]);
+			chipFds[i] = -1;
+			continue;
+		}
+		chipLines[i] = info.lines;
+		sysfsBases[i] = sysfsBaseOf(info.label, info.lines, sysfsBases, i);
+		for (size_t j = 0; j < sizeof(headerChipLabels) / sizeof(headerChipLabels[0]); ++j) {
+			if (strcmp(info.label, headerChipLabels[j]) == 0) {
+				headerChips[i] = true;
+			}
+		}
+	}
+
+	// Pins keep the numbers the sysfs interface gave them: header chips first, then chips with
+	// a sysfs base, then the rest one after the other
+	for (int i = 0; i < chipCount; ++i) {
+		if (headerChips[i]) {
+			placeChip(i, 0);
+		}
+	}
+	for (int i = 0; i < chipCount; ++i) {
+		if (!headerChips[i] && sysfsBases[i] >= 0) {
+			placeChip(i, sysfsBases[i] >= GPIO_DYNAMIC_BASE ? sysfsBases[i] - GPIO_DYNAMIC_BASE :
+			          sysfsBases[i]);
+		}
+	}
+	for (int i = 0; i < chipCount; ++i) {
+		if (!headerChips[i] && sysfsBases[i] < 0 && chipFds[i] != -1) {
+			placeChip(i, lastPinNum + 1);
+		}
+	}
+
+	delete [] sysfsBases;
+	delete [] headerChips;
+
+	if (lastPinNum > 255) {
+		lastPinNum = 255;
+	}
+
+	lineFds = new int[lastPinNum + 1];
+	lineModes = new uint8_t[lastPinNum + 1];
 
 	for (int i = 0; i < lastPinNum + 1; ++i) {
-		exportedPins[i] = 0;
+		lineFds[i] = -1;
+		lineModes[i] = INPUT;
 	}
 }
 
 GPIOClass::GPIOClass(const GPIOClass& other)
 {
-	lastPinNum = other.lastPinNum;
-
-	exportedPins = new uint8_t[lastPinNum + 1];
-	for (int i = 0; i < lastPinNum + 1; ++i) {
-		exportedPins[i] = other.exportedPins[i];
-	}
+	copy(other);
 }
 
 GPIOClass::~GPIOClass()
 {
-	FILE *f;
-
-	for (int i = 0; i < lastPinNum + 1; ++i) {
-		if (exportedPins[i]) {
-			f = fopen("/sys/class/gpio/unexport", "w");
-			fprintf(f, "%d\n", i);
-			fclose(f);
-		}
-	}
-
-	delete [] exportedPins;
+	destroy();
 }
 
 void GPIOClass::pinMode(uint8_t pin, uint8_t mode)
 {
-	FILE *f;
+	struct gpio_v2_line_request req;
+	int chip;
+	uint32_t offset;
 
-	if (pin > lastPinNum) {
+	if (!lineOf(pin, &chip, &offset)) {
+		return;
+	}
+	if (lineFds[pin] != -1 && lineModes[pin] == mode) {
 		return;
 	}
 
-	f = fopen("/sys/class/gpio/export", "w");
-	fprintf(f, "%d\n", pin);
-	fclose(f);
+	releaseLine(pin);
 
-	int counter = 0;
-	char file[128];
-	sprintf(file, "/sys/class/gpio/gpio%d/direction", pin);
+	memset(&req, 0, sizeof(req));
+	req.offsets[0] = offset;
+	req.num_lines = 1;
+	req.config.flags = (mode == INPUT) ? GPIO_V2_LINE_FLAG_INPUT : GPIO_V2_LINE_FLAG_OUTPUT;
+	strncpy(req.consumer, GPIO_CONSUMER, sizeof(req.consumer) - 1);
 
-	while ((f = fopen(file,"w")) == NULL) {
-		// Wait 10 seconds for the file to be accessible if not open on first attempt
-		sleep(1);
-		counter++;
-		if (counter > 10) {
-			logError("Could not open /sys/class/gpio/gpio%u/direction", pin);
-			exit(1);
-		}
-	}
-	if (mode == INPUT) {
-		fprintf(f, "in\n");
-	} else {
-		fprintf(f, "out\n");
+	if (ioctl(chipFds[chip], GPIO_V2_GET_LINE_IOCTL, &req) < 0) {
+		logError("Could not request GPIO line for pin %u: %s\n", pin, strerror(errno));
+		exit(1);
 	}
 
-	exportedPins[pin] = 1;
-
-	fclose(f);
+	lineFds[pin] = req.fd;
+	lineModes[pin] = mode;
 }
 
 void GPIOClass::digitalWrite(uint8_t pin, uint8_t value)
 {
-	FILE *f;
-	char file[128];
+	struct gpio_v2_line_values values;
 
 	if (pin > lastPinNum) {
 		return;
 	}
-	if (0 == exportedPins[pin]) {
+	if (-1 == lineFds[pin]) {
 		pinMode(pin, OUTPUT);
 	}
 
-	sprintf(file, "/sys/class/gpio/gpio%d/value", pin);
-	f = fopen(file, "w");
+	values.mask = 1;
+	values.bits = (value == 0) ? 0 : 1;
 
-	if (value == 0)	{
-		fprintf(f, "0\n");
-	} else {
-		fprintf(f, "1\n");
+	if (ioctl(lineFds[pin], GPIO_V2_LINE_SET_VALUES_IOCTL, &values) < 0) {
+		logError("digitalWrite: failed to write pin %u: %s\n", pin, strerror(errno));
 	}
-
-	fclose(f);
 }
 
 uint8_t GPIOClass::digitalRead(uint8_t pin)
 {
-	FILE *f;
-	char file[128];
+	struct gpio_v2_line_values values;
 
 	if (pin > lastPinNum) {
 		return 0;
 	}
-	if (0 == exportedPins[pin]) {
+	if (-1 == lineFds[pin]) {
 		pinMode(pin, INPUT);
 	}
 
-	sprintf(file, "/sys/class/gpio/gpio%d/value", pin);
-	f = fopen(file, "r");
+	values.mask = 1;
+	values.bits = 0;
 
-	int i;
-	if (fscanf(f, "%d", &i) == EOF) {
-		logError("digitalRead: failed to read pin %u\n", pin);
-		i = 0;
+	if (ioctl(lineFds[pin], GPIO_V2_LINE_GET_VALUES_IOCTL, &values) < 0) {
+		logError("digitalRead: failed to read pin %u: %s\n", pin, strerror(errno));
+		return 0;
 	}
-	fclose(f);
-	return i;
+	return (values.bits & 1) ? HIGH : LOW;
 }
 
 uint8_t GPIOClass::digitalPinToInterrupt(uint8_t pin)
@@ -197,15 +288,133 @@ uint8_t GPIOClass::digitalPinToInterrupt(uint8_t pin)
 	return pin;
 }
 
+int GPIOClass::requestEvent(uint8_t pin, uint64_t edgeFlags)
+{
+	struct gpio_v2_line_request req;
+	int chip;
+	uint32_t offset;
+
+	if (!lineOf(pin, &chip, &offset)) {
+		logError("requestEvent: pin %u does not exist\n", pin);
+		return -1;
+	}
+
+	// A line can only be requested once
+	releaseLine(pin);
+
+	memset(&req, 0, sizeof(req));
+	req.offsets[0] = offset;
+	req.num_lines = 1;
+	req.config.flags = GPIO_V2_LINE_FLAG_INPUT | edgeFlags;
+	strncpy(req.consumer, GPIO_CONSUMER, sizeof(req.consumer) - 1);
+
+	if (ioctl(chipFds[chip], GPIO_V2_GET_LINE_IOCTL, &req) < 0) {
+		logError("requestEvent: could not request events for pin %u: %s\n", pin, strerror(errno));
+		return -1;
+	}
+
+	lineFds[pin] = req.fd;
+	lineModes[pin] = INPUT;
+
+	return req.fd;
+}
+
+void GPIOClass::releaseLine(uint8_t pin)
+{
+	if (pin > lastPinNum || lineFds[pin] == -1) {
+		return;
+	}
+
+	close(lineFds[pin]);
+	lineFds[pin] = -1;
+}
+
 GPIOClass& GPIOClass::operator=(const GPIOClass& other)
 {
 	if (this != &other) {
-		lastPinNum = other.lastPinNum;
+		destroy();
+		copy(other);
+	}
+	return *this;
+}
 
-		exportedPins = new uint8_t[lastPinNum + 1];
-		for (int i = 0; i < lastPinNum + 1; ++i) {
-			exportedPins[i] = other.exportedPins[i];
+bool GPIOClass::lineOf(uint8_t pin, int *chip, uint32_t *offset)
+{
+	if (pin > lastPinNum) {
+		return false;
+	}
+
+	for (int i = 0; i < chipCount; ++i) {
+		if (chipBases[i] >= 0 && pin >= chipBases[i] && pin < chipBases[i] + chipLines[i]) {
+			*chip = i;
+			*offset = pin - chipBases[i];
+			return true;
 		}
 	}
-	return *this;
+	return false;
+}
+
+void GPIOClass::placeChip(int chip, int base)
+{
+	if (chipFds[chip] == -1 || chipLines[chip] == 0) {
+		return;
+	}
+	if (base > 255) {
+		logDebug("gpiochip%d: pins from %d cannot be used\n", chip, base);
+		return;
+	}
+	for (int i = 0; i < chipCount; ++i) {
+		if (chipBases[i] >= 0 && base < chipBases[i] + chipLines[i] &&
+		        chipBases[i] < base + chipLines[chip]) {
+			logDebug("gpiochip%d: pins %d-%d are taken by gpiochip%d\n", chip, base,
+			         base + chipLines[chip] - 1, i);
+			return;
+		}
+	}
+	chipBases[chip] = base;
+	if (lastPinNum < base + chipLines[chip] - 1) {
+		lastPinNum = base + chipLines[chip] - 1;
+	}
+}
+
+void GPIOClass::copy(const GPIOClass& other)
+{
+	lastPinNum = other.lastPinNum;
+	chipCount = other.chipCount;
+
+	chipFds = new int[chipCount];
+	chipLines = new int[chipCount];
+	chipBases = new int[chipCount];
+	for (int i = 0; i < chipCount; ++i) {
+		chipFds[i] = (other.chipFds[i] == -1) ? -1 : dup(other.chipFds[i]);
+		chipLines[i] = other.chipLines[i];
+		chipBases[i] = other.chipBases[i];
+	}
+
+	lineFds = new int[lastPinNum + 1];
+	lineModes = new uint8_t[lastPinNum + 1];
+	for (int i = 0; i < lastPinNum + 1; ++i) {
+		lineFds[i] = (other.lineFds[i] == -1) ? -1 : dup(other.lineFds[i]);
+		lineModes[i] = other.lineModes[i];
+	}
+}
+
+void GPIOClass::destroy()
+{
+	for (int i = 0; i < lastPinNum + 1; ++i) {
+		if (lineFds[i] != -1) {
+			close(lineFds[i]);
+		}
+	}
+	for (int i = 0; i < chipCount; ++i) {
+		if (chipFds[i] != -1) {
+			close(chipFds[i]);
+		}
+	}
+
+	delete [] lineFds;
+	delete [] lineModes;
+	delete [] chipFds;
+	delete [] chipLines;
+	delete [] chipBases;
 }
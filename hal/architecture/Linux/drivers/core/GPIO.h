@@ -30,6 +30,12 @@
 
 /**
  * @brief GPIO class
+ *
+ * Uses the GPIO character devices (/dev/gpiochipN) through the v2 line ioctls. Pins keep the
+ * numbers of the sysfs GPIO interface, that is the base of the chip in /sys/class/gpio plus the
+ * line offset, with the dynamic base 512 of newer kernels taken off. The chip of the Raspberry Pi
+ * pin header is always based at 0, chips sysfs does not know are numbered after the others. Each
+ * line is requested once and the handle is held open, so a read or a write is a single ioctl.
  */
 class GPIOClass
 {
@@ -75,6 +81,22 @@ public:
 	 * @return The same parameter pin number.
 	 */
 	uint8_t digitalPinToInterrupt(uint8_t pin);
+	/**
+	 * @brief Requests edge events for a pin, replacing any line handle held for it.
+	 *
+	 * The returned descriptor stays owned by the GPIOClass and also serves digitalRead().
+	 *
+	 * @param pin The number of the pin.
+	 * @param edgeFlags GPIO_V2_LINE_FLAG_EDGE_* flags of the edges to report.
+	 * @return The event descriptor or -1 on error.
+	 */
+	int requestEvent(uint8_t pin, uint64_t edgeFlags);
+	/**
+	 * @brief Releases the line handle or event descriptor held for a pin.
+	 *
+	 * @param pin The number of the pin.
+	 */
+	void releaseLine(uint8_t pin);
 	/**
 	 * @brief Overloaded assign operator.
 	 *
@@ -83,7 +105,37 @@ public:
 
 private:
 	int lastPinNum; //!< @brief Highest pin number supported.
-	uint8_t *exportedPins; //!< @brief Array with information of which pins were exported.
+	int chipCount; //!< @brief Number of GPIO chips found.
+	int *chipFds; //!< @brief Descriptors of the opened GPIO chips.
+	int *chipLines; //!< @brief Number of lines of each GPIO chip.
+	int *chipBases; //!< @brief Pin number of line 0 of each GPIO chip, -1 if it has no pins.
+	int *lineFds; //!< @brief Line handle or event descriptor held for each pin, -1 if none.
+	uint8_t *lineModes; //!< @brief Direction each line handle was requested with.
+
+	/**
+	 * @brief Finds the chip and line offset of a pin.
+	 *
+	 * @param pin The number of the pin.
+	 * @param chip Index of the chip the pin belongs to.
+	 * @param offset Line offset of the pin on that chip.
+	 * @return true if the pin exists.
+	 */
+	bool lineOf(uint8_t pin, int *chip, uint32_t *offset);
+	/**
+	 * @brief Gives the pins from base to a chip, unless they are taken by another chip.
+	 *
+	 * @param chip Index of the chip.
+	 * @param base Pin number of line 0 of the chip.
+	 */
+	void placeChip(int chip, int base);
+	/**
+	 * @brief Duplicates the descriptors held by other.
+	 */
+	void copy(const GPIOClass& other);
+	/**
+	 * @brief Closes all descriptors and frees memory.
+	 */
+	void destroy();
 };
 
 extern GPIOClass GPIO;
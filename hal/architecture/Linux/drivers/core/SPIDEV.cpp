@@ -41,6 +41,11 @@ uint8_t SPIDEVClass::mode = SPI_MODE0;
 uint32_t SPIDEVClass::speed = SPI_CLOCK_BASE;
 uint8_t SPIDEVClass::bit_order = MSBFIRST;
 struct spi_ioc_transfer SPIDEVClass::tr = {0,0,0,0,0,8,0,0,0,0};	// 8 bits_per_word, 0 cs_change
+uint8_t SPIDEVClass::batchDepth = 0;
+uint8_t SPIDEVClass::batchLength = 0;
+uint32_t SPIDEVClass::batchUsed = 0;
+struct spi_ioc_transfer SPIDEVClass::batch[SPI_BATCH_MAX_TRANSFERS];
+uint8_t SPIDEVClass::batchBuffer[SPI_BATCH_BUFFER_SIZE];
 
 SPIDEVClass::SPIDEVClass()
 {
@@ -169,6 +174,9 @@ uint8_t SPIDEVClass::transfer(uint8_t data)
 
 	pthread_mutex_lock(&spiMutex);
 
+	// Keep the order of the operations, the answer is needed right away
+	flushBatch();
+
 	tr.tx_buf = (unsigned long)&tx[0];
 	tr.rx_buf = (unsigned long)&rx[0];
 	tr.len = 1;
@@ -191,6 +199,26 @@ void SPIDEVClass::transfernb(char* tbuf, char* rbuf, uint32_t len)
 
 	pthread_mutex_lock(&spiMutex);
 
+	if (batchDepth) {
+		if (batchLength == SPI_BATCH_MAX_TRANSFERS || batchUsed + len > SPI_BATCH_BUFFER_SIZE) {
+			flushBatch();
+		}
+		if (len <= SPI_BATCH_BUFFER_SIZE) {
+			// The caller may reuse tbuf right away, queue a copy
+			memcpy(&batchBuffer[batchUsed], tbuf, len);
+			batch[batchLength] = tr;
+			batch[batchLength].tx_buf = (unsigned long)&batchBuffer[batchUsed];
+			batch[batchLength].rx_buf = 0;
+			batch[batchLength].len = len;
+			batch[batchLength].speed_hz = speed;
+			batchLength++;
+			batchUsed += len;
+
+			pthread_mutex_unlock(&spiMutex);
+			return;
+		}
+	}
+
 	tr.tx_buf = (unsigned long)tbuf;
 	tr.rx_buf = (unsigned long)rbuf;
 	tr.len = len;
@@ -210,12 +238,32 @@ void SPIDEVClass::transfern(char* buf, uint32_t len)
 	transfernb(buf, buf, len);
 }
 
+void SPIDEVClass::beginBatch()
+{
+	// Released by endBatch()
+	pthread_mutex_lock(&spiMutex);
+	batchDepth++;
+}
+
+void SPIDEVClass::endBatch()
+{
+	if (batchDepth && !--batchDepth) {
+		flushBatch();
+	}
+	pthread_mutex_unlock(&spiMutex);
+}
+
 void SPIDEVClass::beginTransaction(SPISettings settings)
 {
 	int ret;
 
 	pthread_mutex_lock(&spiMutex);
 
+	// Queued transfers were meant for the current settings
+	if (settings.dmode != mode || settings.clock != speed || settings.border != bit_order) {
+		flushBatch();
+	}
+
 	/*
 	 * spi mode
 	 */
@@ -366,3 +414,24 @@ void SPIDEVClass::init()
 
 	pthread_mutex_unlock(&spiMutex);
 }
+
+void SPIDEVClass::flushBatch()
+{
+	if (!batchLength) {
+		return;
+	}
+
+	// Release chip select between the transfers, but not after the last one
+	for (uint8_t i = 0; i < batchLength; i++) {
+		batch[i].cs_change = (i + 1 < batchLength) ? 1 : 0;
+	}
+
+	int ret = ioctl(fd, SPI_IOC_MESSAGE(batchLength), batch);
+	if (ret < 1) {
+		logError("Can't send spi message.\n");
+		abort();
+	}
+
+	batchLength = 0;
+	batchUsed = 0;
+}
@@ -27,6 +27,15 @@
 #include <linux/spi/spidev.h>
 
 #define SPI_HAS_TRANSACTION
+#define SPI_HAS_BATCH
+
+#ifndef SPI_BATCH_MAX_TRANSFERS
+#define SPI_BATCH_MAX_TRANSFERS 16	//!< Transfers submitted with a single SPI_IOC_MESSAGE
+#endif
+
+#ifndef SPI_BATCH_BUFFER_SIZE
+#define SPI_BATCH_BUFFER_SIZE 512	//!< Bytes of transmit data held by a batch
+#endif
 
 #define MSBFIRST 0
 #define LSBFIRST SPI_LSB_FIRST
@@ -172,6 +181,19 @@ public:
 	* @param len Length of the data
 	*/
 	static void transfern(char* buf, uint32_t len);
+	/**
+	 * @brief Start collecting transfers into a batch.
+	 *
+	 * Until endBatch(), transfernb() and transfern() only queue their data, nothing is received
+	 * into rbuf. The batch is submitted as one SPI_IOC_MESSAGE with chip select released between
+	 * the transfers, so only write operations whose answer isn't needed may be batched.
+	 * Batches nest and hold the SPI lock.
+	 */
+	static void beginBatch();
+	/**
+	 * @brief Submit the transfers collected since beginBatch().
+	 */
+	static void endBatch();
 	/**
 	 * @brief Start SPI transaction.
 	 *
@@ -203,8 +225,17 @@ private:
 	static uint32_t speed; //!< @brief SPI speed.
 	static uint8_t bit_order; //!< @brief SPI bit order.
 	static struct spi_ioc_transfer tr; //!< @brief Auxiliar struct for data transfer.
+	static uint8_t batchDepth; //!< @brief Nesting level of beginBatch().
+	static uint8_t batchLength; //!< @brief Number of queued transfers.
+	static uint32_t batchUsed; //!< @brief Bytes used in batchBuffer.
+	static struct spi_ioc_transfer batch[SPI_BATCH_MAX_TRANSFERS]; //!< @brief Queued transfers.
+	static uint8_t batchBuffer[SPI_BATCH_BUFFER_SIZE]; //!< @brief Copy of the queued transmit data.
 
 	static void init();
+	/**
+	 * @brief Send the queued transfers, must be called with the SPI lock held.
+	 */
+	static void flushBatch();
 };
 
 extern SPIDEVClass SPIDEV;
@@ -29,6 +29,7 @@
 #include <errno.h>
 #include <sys/stat.h>
 #include "log.h"
+#include "eventloop.h"
 #include "SerialPort.h"
 
 SerialPort::SerialPort(const char *port, bool isPty) : serialPort(std::string(port)), isPty(isPty)
@@ -175,6 +176,8 @@ bool SerialPort::open(int bauds)
 
 	usleep(10000);
 
+	(void)eventLoopAdd(sd);
+
 	return true;
 }
 
@@ -18,27 +18,38 @@
  */
 
 #include <stdlib.h>
+#include <stdio.h>
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
 #include <string.h>
 #include <errno.h>
 #include "log.h"
 #include "SoftEeprom.h"
 
-SoftEeprom::SoftEeprom() : _length(0), _fileName(NULL), _values(NULL)
+static uint32_t _softEepromMillis(void)
 {
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000ull + ts.tv_nsec / 1000000);
 }
 
-SoftEeprom::SoftEeprom(const SoftEeprom& other)
+SoftEeprom::SoftEeprom() : _length(0), _fileName(NULL), _values(NULL), _mapped(false),
+	_atomicFlush(false), _flushInterval(0), _lastFlush(0), _pageSize(0), _isDirty(false)
 {
-	_fileName = strdup(other._fileName);
+}
 
-	_length = other._length;
-	_values = new uint8_t[_length];
-	for (size_t i = 0; i < _length; ++i) {
-		_values[i] = other._values[i];
-	}
+SoftEeprom::SoftEeprom(const SoftEeprom& other) : _length(0), _fileName(NULL), _values(NULL),
+	_mapped(false), _atomicFlush(false), _flushInterval(0), _lastFlush(0), _pageSize(0),
+	_isDirty(false)
+{
+	_copy(other);
 }
 
 SoftEeprom::~SoftEeprom()
@@ -46,7 +57,8 @@ SoftEeprom::~SoftEeprom()
 	destroy();
 }
 
-int SoftEeprom::init(const char *fileName, size_t length)
+int SoftEeprom::init(const char *fileName, size_t length, uint32_t flushInterval,
+                     bool atomicFlush)
 {
 	struct stat fileInfo;
 
@@ -59,7 +71,12 @@ int SoftEeprom::init(const char *fileName, size_t length)
 	}
 
 	_length = length;
-	_values = new uint8_t[_length];
+	_flushInterval = flushInterval;
+	_atomicFlush = atomicFlush;
+	_pageSize = sysconf(_SC_PAGESIZE);
+	_dirty.assign((_length + _pageSize - 1) / _pageSize, false);
+	_isDirty = false;
+	_lastFlush = _softEepromMillis();
 
 	if (stat(_fileName, &fileInfo) != 0) {
 		//File does not exist.  Create it.
@@ -71,17 +88,19 @@ int SoftEeprom::init(const char *fileName, size_t length)
 		}
 		// Fill the eeprom with 1s
 		for (size_t i = 0; i < _length; ++i) {
-			_values[i] = 0xFF;
+			myFile.put((char)0xFF);
 		}
-		myFile.write((const char*)_values, _length);
 		myFile.close();
 	} else if (fileInfo.st_size < 0 || (size_t)fileInfo.st_size != _length) {
 		logError("EEPROM file %s is not the correct size of %zu.  Please remove the file and a new one will be created.\n",
 		         _fileName, _length);
 		destroy();
 		return -1;
-	} else {
-		//Read config into local memory.
+	}
+
+	if (_atomicFlush) {
+		//Read config into local memory, the file is replaced on flush.
+		_values = new uint8_t[_length];
 		std::ifstream myFile(_fileName, std::ios::in | std::ios::binary);
 		if (!myFile) {
 			logError("Unable to open EEPROM file %s for reading.\n", _fileName);
@@ -89,6 +108,21 @@ int SoftEeprom::init(const char *fileName, size_t length)
 		}
 		myFile.read((char*)_values, _length);
 		myFile.close();
+	} else {
+		int fd = open(_fileName, O_RDWR);
+		if (fd == -1) {
+			logError("Unable to open EEPROM file %s: %s\n", _fileName, strerror(errno));
+			return -1;
+		}
+		void *map = mmap(NULL, _length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		// The mapping keeps its own reference to the file
+		close(fd);
+		if (map == MAP_FAILED) {
+			logError("Unable to map EEPROM file %s: %s\n", _fileName, strerror(errno));
+			return -1;
+		}
+		_values = static_cast<uint8_t *>(map);
+		_mapped = true;
 	}
 
 	return 0;
@@ -97,13 +131,21 @@ int SoftEeprom::init(const char *fileName, size_t length)
 void SoftEeprom::destroy()
 {
 	if (_values) {
-		delete[] _values;
+		(void)flush();
+		if (_mapped) {
+			munmap(_values, _length);
+		} else {
+			delete[] _values;
+		}
 		_values = NULL;
 	}
 	if (_fileName) {
 		free(_fileName);
 		_fileName = NULL;
 	}
+	_mapped = false;
+	_isDirty = false;
+	_dirty.clear();
 	_length = 0;
 }
 
@@ -137,14 +179,14 @@ void SoftEeprom::writeBlock(void* buf, void* addr, size_t length)
 
 		memcpy(_values+offs, buf, length);
 
-		std::ofstream myFile(_fileName, std::ios::out | std::ios::in | std::ios::binary);
-		if (!myFile) {
-			logError("Unable to write config to file %s.\n", _fileName);
-			return;
+		for (size_t page = offs / _pageSize; page <= (offs + length - 1) / _pageSize; ++page) {
+			_dirty[page] = true;
+		}
+		_isDirty = true;
+
+		if (_flushInterval == 0) {
+			(void)flush();
 		}
-		myFile.seekp(offs);
-		myFile.write((const char*)buf, length);
-		myFile.close();
 	}
 }
 
@@ -163,19 +205,131 @@ void SoftEeprom::writeByte(int addr, uint8_t value)
 	}
 }
 
-SoftEeprom& SoftEeprom::operator=(const SoftEeprom& other)
+int SoftEeprom::flush()
 {
-	if (this != &other) {
-		delete[] _values;
-		free(_fileName);
+	int ret = 0;
 
-		_fileName = strdup(other._fileName);
+	if (!_isDirty) {
+		return 0;
+	}
 
-		_length = other._length;
-		_values = new uint8_t[_length];
-		for (size_t i = 0; i < _length; ++i) {
-			_values[i] = other._values[i];
+	if (_mapped) {
+		// Sync each run of consecutive dirty pages with a single call
+		size_t page = 0;
+		while (page < _dirty.size()) {
+			if (!_dirty[page]) {
+				page++;
+				continue;
+			}
+			const size_t first = page;
+			while (page < _dirty.size() && _dirty[page]) {
+				_dirty[page++] = false;
+			}
+			const size_t end = std::min(page * _pageSize, _length);
+			if (msync(_values + first * _pageSize, end - first * _pageSize, MS_SYNC) == -1) {
+				logError("Unable to write config to file %s: %s\n", _fileName, strerror(errno));
+				ret = -1;
+			}
 		}
+	} else if (_atomicFlush) {
+		ret = _replaceFile();
+		_dirty.assign(_dirty.size(), false);
+	} else {
+		ret = _writePages();
+	}
+
+	_isDirty = false;
+	_lastFlush = _softEepromMillis();
+	return ret;
+}
+
+void SoftEeprom::process()
+{
+	if (_isDirty && _softEepromMillis() - _lastFlush >= _flushInterval) {
+		(void)flush();
+	}
+}
+
+int SoftEeprom::_replaceFile()
+{
+	const size_t nameLength = strlen(_fileName) + sizeof(".tmp");
+	char *tmpName = new char[nameLength];
+	int ret = -1;
+
+	snprintf(tmpName, nameLength, "%s.tmp", _fileName);
+
+	int fd = open(tmpName, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd == -1) {
+		logError("Unable to create %s: %s\n", tmpName, strerror(errno));
+	} else {
+		const bool written = write(fd, _values, _length) == (ssize_t)_length && fsync(fd) == 0;
+		close(fd);
+		if (!written) {
+			logError("Unable to write config to file %s: %s\n", tmpName, strerror(errno));
+			unlink(tmpName);
+		} else if (rename(tmpName, _fileName) != 0) {
+			logError("Unable to replace %s: %s\n", _fileName, strerror(errno));
+			unlink(tmpName);
+		} else {
+			ret = 0;
+		}
+	}
+
+	delete[] tmpName;
+	return ret;
+}
+
+int SoftEeprom::_writePages()
+{
+	int fd = open(_fileName, O_WRONLY);
+	if (fd == -1) {
+		logError("Unable to open EEPROM file %s: %s\n", _fileName, strerror(errno));
+		return -1;
+	}
+
+	int ret = 0;
+	for (size_t page = 0; page < _dirty.size(); ++page) {
+		if (!_dirty[page]) {
+			continue;
+		}
+		_dirty[page] = false;
+		const size_t offs = page * _pageSize;
+		const size_t length = std::min(_pageSize, _length - offs);
+		if (pwrite(fd, _values + offs, length, offs) != (ssize_t)length) {
+			logError("Unable to write config to file %s: %s\n", _fileName, strerror(errno));
+			ret = -1;
+		}
+	}
+	if (fsync(fd) != 0) {
+		ret = -1;
+	}
+	close(fd);
+
+	return ret;
+}
+
+void SoftEeprom::_copy(const SoftEeprom& other)
+{
+	_fileName = other._fileName ? strdup(other._fileName) : NULL;
+
+	_length = other._length;
+	_values = new uint8_t[_length];
+	memcpy(_values, other._values, _length);
+	// A copy can't share the mapping, it writes the changed pages back in place
+	_mapped = false;
+	_atomicFlush = other._atomicFlush;
+	_flushInterval = other._flushInterval;
+	_lastFlush = other._lastFlush;
+	_pageSize = other._pageSize;
+	_dirty = other._dirty;
+	_isDirty = other._isDirty;
+}
+
+SoftEeprom& SoftEeprom::operator=(const SoftEeprom& other)
+{
+	if (this != &other) {
+		destroy();
+		_copy(other);
 	}
 	return *this;
 }
@@ -19,13 +19,19 @@
 
 /**
 * This a software emulation of EEPROM that uses a file for data storage.
-* A copy of the eeprom values are also held in memory for faster reading.
+* The file is memory mapped and written back on flush(), either right after every change or
+* periodically, which coalesces bursts of single byte writes (e.g. routing table updates).
+* With atomic flushing, changes are kept in memory and the whole file is replaced through a
+* temporary file instead, so a crash never leaves a partially written file behind. Copies of
+* the object always keep their values in memory.
 */
 
 #ifndef SoftEeprom_h
 #define SoftEeprom_h
 
 #include <stdint.h>
+#include <stddef.h>
+#include <vector>
 
 /**
  * SoftEeprom class
@@ -51,9 +57,13 @@ public:
 	 *
 	 * @param fileName filepath where the data is saved.
 	 * @param length eeprom size in bytes.
+	 * @param flushInterval minimum time in milliseconds between two writes to the file,
+	 * 0 writes every change right away.
+	 * @param atomicFlush replace the file through a temporary file on every flush.
 	 * @return 0 if SUCCESS or -1 if FAILURE.
 	 */
-	int init(const char *fileName, size_t length);
+	int init(const char *fileName, size_t length, uint32_t flushInterval = 0,
+	         bool atomicFlush = false);
 	/**
 	 * @brief Clear all allocated memory variables.
 	 *
@@ -89,6 +99,16 @@ public:
 	 * @param value to write.
 	 */
 	void writeByte(int addr, uint8_t value);
+	/**
+	 * @brief Write pending changes to the file.
+	 *
+	 * @return 0 if SUCCESS or -1 if FAILURE.
+	 */
+	int flush();
+	/**
+	 * @brief Flush pending changes if the flush interval has elapsed.
+	 */
+	void process();
 	/**
 	 * @brief Overloaded assign operator.
 	 *
@@ -98,7 +118,31 @@ public:
 private:
 	size_t _length; //!< @brief Eeprom max size.
 	char *_fileName; //!< @brief file where the eeprom values are stored.
-	uint8_t *_values; //!< @brief copy of the eeprom values held in memory for a faster reading.
+	uint8_t *_values; //!< @brief eeprom values, either the file mapping or a copy in memory.
+	bool _mapped; //!< @brief true if _values is a shared mapping of the file.
+	bool _atomicFlush; //!< @brief replace the whole file on flush.
+	uint32_t _flushInterval; //!< @brief minimum time between two flushes in ms.
+	uint32_t _lastFlush; //!< @brief time of the last flush in ms.
+	size_t _pageSize; //!< @brief granularity of the dirty map.
+	std::vector<bool> _dirty; //!< @brief pages changed since the last flush.
+	bool _isDirty; //!< @brief true if any page is dirty.
+
+	/**
+	 * @brief Allocate a copy of other's values and settings.
+	 */
+	void _copy(const SoftEeprom& other);
+	/**
+	 * @brief Write the whole eeprom to a temporary file and rename it over the eeprom file.
+	 *
+	 * @return 0 if SUCCESS or -1 if FAILURE.
+	 */
+	int _replaceFile();
+	/**
+	 * @brief Write the dirty pages of an unmapped copy back to the eeprom file in place.
+	 *
+	 * @return 0 if SUCCESS or -1 if FAILURE.
+	 */
+	int _writePages();
 };
 
 #endif
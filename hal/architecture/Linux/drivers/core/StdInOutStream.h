@@ -57,6 +57,7 @@ public:
 	 * @return -1 if error else, number of bytes written.
 	 */
 	size_t write(uint8_t b);
+	using Print::write; // write(str) and write(buf, size)
 	/**
 	 * @brief Not supported.
 	 *
@@ -55,11 +55,17 @@ int config_parse(const char *config_file)
 	conf.log_pipe = 0;
 	conf.log_pipe_file = NULL;
 	conf.syslog = 0;
+	conf.log_async_ring_size = 0;
 	conf.eeprom_file = NULL;
 	conf.eeprom_size = 0;
+	conf.eeprom_flush_interval = 0;
+	conf.eeprom_atomic_flush = 0;
 	conf.soft_hmac_key = NULL;
 	conf.soft_serial_key = NULL;
 	conf.aes_key = NULL;
+	conf.rx_queue_size = 0;
+	conf.rx_queue_stats_interval = 0;
+	conf.ethernet_tx_high_water = 0;
 
 	while (fgets(buf, 1024, fptr)) {
 		if (buf[0] != '#' && buf[0] != 10 && buf[0] != 13) {
@@ -134,6 +140,17 @@ int config_parse(const char *config_file)
 						return -1;
 					}
 				}
+			} else if (!strncmp(buf, "log_async_ring_size=", 20)) {
+				if (_config_parse_int(&(buf[20]), "log_async_ring_size", &conf.log_async_ring_size)) {
+					fclose(fptr);
+					return -1;
+				} else {
+					if (conf.log_async_ring_size < 0 || conf.log_async_ring_size > 65536) {
+						logError("log_async_ring_size value must be between 0 and 65536 in configuration.\n");
+						fclose(fptr);
+						return -1;
+					}
+				}
 			} else if (!strncmp(buf, "eeprom_file=", 12)) {
 				if (_config_parse_string(&(buf[12]), "eeprom_file", &conf.eeprom_file)) {
 					fclose(fptr);
@@ -150,6 +167,28 @@ int config_parse(const char *config_file)
 						return -1;
 					}
 				}
+			} else if (!strncmp(buf, "eeprom_flush_interval=", 22)) {
+				if (_config_parse_int(&(buf[22]), "eeprom_flush_interval", &conf.eeprom_flush_interval)) {
+					fclose(fptr);
+					return -1;
+				} else {
+					if (conf.eeprom_flush_interval < 0) {
+						logError("eeprom_flush_interval value must be 0 or greater in configuration.\n");
+						fclose(fptr);
+						return -1;
+					}
+				}
+			} else if (!strncmp(buf, "eeprom_atomic_flush=", 20)) {
+				if (_config_parse_int(&(buf[20]), "eeprom_atomic_flush", &conf.eeprom_atomic_flush)) {
+					fclose(fptr);
+					return -1;
+				} else {
+					if (conf.eeprom_atomic_flush != 0 && conf.eeprom_atomic_flush != 1) {
+						logError("eeprom_atomic_flush must be 1 or 0 in configuration.\n");
+						fclose(fptr);
+						return -1;
+					}
+				}
 			} else if (!strncmp(buf, "soft_hmac_key=", 14)) {
 				if (_config_parse_string(&(buf[14]), "soft_hmac_key", &conf.soft_hmac_key)) {
 					fclose(fptr);
@@ -165,6 +204,40 @@ int config_parse(const char *config_file)
 					fclose(fptr);
 					return -1;
 				}
+			} else if (!strncmp(buf, "rx_queue_size=", 14)) {
+				if (_config_parse_int(&(buf[14]), "rx_queue_size", &conf.rx_queue_size)) {
+					fclose(fptr);
+					return -1;
+				} else {
+					if (conf.rx_queue_size < 0 || conf.rx_queue_size > 32767) {
+						logError("rx_queue_size value must be between 0 and 32767 in configuration.\n");
+						fclose(fptr);
+						return -1;
+					}
+				}
+			} else if (!strncmp(buf, "rx_queue_stats_interval=", 24)) {
+				if (_config_parse_int(&(buf[24]), "rx_queue_stats_interval",
+				                      &conf.rx_queue_stats_interval)) {
+					fclose(fptr);
+					return -1;
+				} else {
+					if (conf.rx_queue_stats_interval < 0) {
+						logError("rx_queue_stats_interval value must be 0 or greater in configuration.\n");
+						fclose(fptr);
+						return -1;
+					}
+				}
+			} else if (!strncmp(buf, "ethernet_tx_high_water=", 23)) {
+				if (_config_parse_int(&(buf[23]), "ethernet_tx_high_water", &conf.ethernet_tx_high_water)) {
+					fclose(fptr);
+					return -1;
+				} else {
+					if (conf.ethernet_tx_high_water < 0) {
+						logError("ethernet_tx_high_water value must be 0 or greater in configuration.\n");
+						fclose(fptr);
+						return -1;
+					}
+				}
 			} else {
 				logWarning("Unknown config option \"%s\".\n", buf);
 			}
@@ -237,9 +310,38 @@ int _config_create(const char *config_file)
 	                            "# Enable logging to syslog.\n" \
 	                            "syslog=0\n" \
 	                            "\n" \
+	                            "# Number of log lines (rounded up to a power of two) buffered\n" \
+	                            "# for a background thread that writes them to the outputs\n" \
+	                            "# above, so logging never blocks message processing. Lines\n" \
+	                            "# arriving while the buffer is full are dropped and counted.\n" \
+	                            "# 0 writes every line right away. 1024 is a good start.\n" \
+	                            "log_async_ring_size=0\n" \
+	                            "\n" \
 	                            "# EEPROM settings\n" \
 	                            "eeprom_file=/etc/mysensors.eeprom\n" \
 	                            "eeprom_size=1024\n" \
+	                            "# Seconds to collect EEPROM changes before writing them to the\n" \
+	                            "# file, 0 writes every change right away.\n" \
+	                            "eeprom_flush_interval=5\n" \
+	                            "# Write changes to a temporary file and rename it over the EEPROM\n" \
+	                            "# file, so a power loss never leaves a half written file behind.\n" \
+	                            "eeprom_atomic_flush=0\n" \
+	                            "\n" \
+	                            "# RX queue settings\n" \
+	                            "# Note: Only used by RF24 with an IRQ pin.\n" \
+	                            "#\n" \
+	                            "# Number of received messages buffered for the gateway,\n" \
+	                            "# 0 uses the MY_RX_MESSAGE_BUFFER_SIZE the gateway was built with.\n" \
+	                            "rx_queue_size=0\n" \
+	                            "# Seconds between RX queue statistics (size, high-water mark,\n" \
+	                            "# dropped messages, latency) in the log, 0 disables them.\n" \
+	                            "rx_queue_stats_interval=0\n" \
+	                            "\n" \
+	                            "# Ethernet gateway settings\n" \
+	                            "# Bytes queued for a controller connection that doesn't keep up,\n" \
+	                            "# a connection with more pending data is dropped so it can't hold\n" \
+	                            "# back the others. 0 uses the default of 65536.\n" \
+	                            "ethernet_tx_high_water=0\n" \
 	                            "\n" \
 	                            "# Software signing settings\n" \
 	                            "# Note: The gateway must have been built with signing\n" \
@@ -34,11 +34,17 @@ struct config {
 	int log_pipe;
 	char *log_pipe_file;
 	int syslog;
+	int log_async_ring_size;
 	char *eeprom_file;
 	int eeprom_size;
+	int eeprom_flush_interval;
+	int eeprom_atomic_flush;
 	char *soft_hmac_key;
 	char *soft_serial_key;
 	char *aes_key;
+	int rx_queue_size;
+	int rx_queue_stats_interval;
+	int ethernet_tx_high_water;
 };
 
 extern struct config conf;
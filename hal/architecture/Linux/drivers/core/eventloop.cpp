@@ -0,0 +1,191 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#include "eventloop.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "log.h"
+
+#define EVENTLOOP_MAX_EVENTS 16
+// Set in the upper half of epoll_event.data.u64 for descriptors demoted to edge-triggered
+#define EVENTLOOP_EDGE_FLAG (1ull << 32)
+// Set in the upper half of epoll_event.data.u64 for descriptors also watched for writability
+#define EVENTLOOP_WRITE_FLAG (1ull << 33)
+
+static int epollFd = -1;
+static int wakeupFd = -1;
+static uint32_t maxWaitMs = 0;
+static bool pending = false;
+
+static int _eventLoopCtl(int op, int fd, uint32_t events, uint64_t data)
+{
+	struct epoll_event ev;
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = events;
+	ev.data.u64 = data;
+	return epoll_ctl(epollFd, op, fd, &ev);
+}
+
+int eventLoopInit(uint32_t timerMs)
+{
+	if (epollFd != -1) {
+		return 0;
+	}
+
+	if ((epollFd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+		logError("epoll_create1: %s\n", strerror(errno));
+		return -1;
+	}
+
+	if ((wakeupFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+		logError("eventfd: %s\n", strerror(errno));
+		eventLoopClose();
+		return -1;
+	}
+
+	if (eventLoopAdd(wakeupFd) != 0) {
+		eventLoopClose();
+		return -1;
+	}
+
+	maxWaitMs = timerMs;
+	return 0;
+}
+
+int eventLoopAdd(int fd)
+{
+	if (epollFd == -1 || fd < 0) {
+		return 0;
+	}
+
+	if (_eventLoopCtl(EPOLL_CTL_ADD, fd, EPOLLIN, (uint32_t)fd) == -1) {
+		if (errno == EEXIST) {
+			return 0;
+		}
+		logError("epoll_ctl: failed to add fd %d: %s\n", fd, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+int eventLoopWatchWrite(int fd, int enable)
+{
+	if (epollFd == -1 || fd < 0) {
+		return 0;
+	}
+
+	const int rc = enable ? _eventLoopCtl(EPOLL_CTL_MOD, fd, EPOLLIN | EPOLLOUT,
+	                                      EVENTLOOP_WRITE_FLAG | (uint32_t)fd) :
+	               _eventLoopCtl(EPOLL_CTL_MOD, fd, EPOLLIN, (uint32_t)fd);
+	if (rc == -1) {
+		logError("epoll_ctl: failed to modify fd %d: %s\n", fd, strerror(errno));
+		return -1;
+	}
+
+	return 0;
+}
+
+void eventLoopRemove(int fd)
+{
+	if (epollFd == -1 || fd < 0) {
+		return;
+	}
+
+	(void)epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+void eventLoopNotify(void)
+{
+	const uint64_t one = 1;
+
+	if (wakeupFd != -1) {
+		if (write(wakeupFd, &one, sizeof(one)) == -1 && errno != EAGAIN) {
+			logError("eventLoopNotify: %s\n", strerror(errno));
+		}
+	}
+}
+
+void eventLoopPending(void)
+{
+	pending = true;
+}
+
+int eventLoopWait(uint32_t timeoutMs)
+{
+	struct epoll_event events[EVENTLOOP_MAX_EVENTS];
+	uint64_t counter;
+	int ready;
+
+	if (epollFd == -1) {
+		return -1;
+	}
+
+	// Wake up for the caller's deadline, but at least every housekeeping period
+	const int timeout = pending ? 0 : (int)(timeoutMs < maxWaitMs ? timeoutMs : maxWaitMs);
+	pending = false;
+	do {
+		ready = epoll_wait(epollFd, events, EVENTLOOP_MAX_EVENTS, timeout);
+	} while (ready == -1 && errno == EINTR);
+
+	if (ready == -1) {
+		logError("epoll_wait: %s\n", strerror(errno));
+		return -1;
+	}
+
+	for (int i = 0; i < ready; i++) {
+		const int fd = (int)(uint32_t)events[i].data.u64;
+		const bool edge = (events[i].data.u64 & EVENTLOOP_EDGE_FLAG) != 0;
+		const bool write = (events[i].data.u64 & EVENTLOOP_WRITE_FLAG) != 0;
+
+		if (fd == wakeupFd) {
+			// Reset the counter so the descriptor stops being readable
+			if (read(fd, &counter, sizeof(counter)) == -1 && errno != EAGAIN) {
+				logError("eventLoopWait: %s\n", strerror(errno));
+			}
+		} else if (!(events[i].events & EPOLLIN) && !edge && !write) {
+			// Hang-up without data, e.g. a PTY nobody has opened yet. Level-triggered this
+			// would wake us up forever, so only report it again once it changes state.
+			(void)_eventLoopCtl(EPOLL_CTL_MOD, fd, EPOLLIN | EPOLLET, EVENTLOOP_EDGE_FLAG | (uint32_t)fd);
+		} else if ((events[i].events & EPOLLIN) && edge) {
+			// Data arrived, the owner may read it piecewise: back to level-triggered
+			(void)_eventLoopCtl(EPOLL_CTL_MOD, fd, EPOLLIN, (uint32_t)fd);
+		}
+	}
+
+	return ready;
+}
+
+void eventLoopClose(void)
+{
+	if (wakeupFd != -1) {
+		close(wakeupFd);
+		wakeupFd = -1;
+	}
+	if (epollFd != -1) {
+		close(epollFd);
+		epollFd = -1;
+	}
+}
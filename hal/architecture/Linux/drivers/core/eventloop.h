@@ -0,0 +1,92 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+#ifndef eventloop_h
+#define eventloop_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Create the epoll instance and the wakeup eventfd.
+ *
+ * @param timerMs longest time eventLoopWait() sleeps without an event, in milliseconds.
+ * @return 0 if SUCCESS or -1 if FAILURE.
+ */
+int eventLoopInit(uint32_t timerMs);
+/**
+ * @brief Watch a file descriptor for readability.
+ *
+ * Closing the descriptor removes it from the event loop, so there is no need to call
+ * eventLoopRemove() before close(). Does nothing if the event loop is not initialized.
+ *
+ * @param fd file descriptor to watch.
+ * @return 0 if SUCCESS or -1 if FAILURE.
+ */
+int eventLoopAdd(int fd);
+/**
+ * @brief Also report a watched file descriptor when it becomes writable.
+ *
+ * For connections with queued outgoing data, turn it off again once the queue is empty.
+ *
+ * @param fd file descriptor added with eventLoopAdd().
+ * @param enable non-zero to wait for writability, 0 for readability only.
+ * @return 0 if SUCCESS or -1 if FAILURE.
+ */
+int eventLoopWatchWrite(int fd, int enable);
+/**
+ * @brief Stop watching a file descriptor.
+ *
+ * @param fd file descriptor to remove.
+ */
+void eventLoopRemove(int fd);
+/**
+ * @brief Wake up a pending eventLoopWait(). Safe to call from any thread.
+ */
+void eventLoopNotify(void);
+/**
+ * @brief Make the next eventLoopWait() return immediately.
+ *
+ * For data that was already pulled into a user space buffer, where the descriptor itself
+ * no longer reports readiness. Main thread only, use eventLoopNotify() from other threads.
+ */
+void eventLoopPending(void);
+/**
+ * @brief Block until a watched descriptor is ready, eventLoopNotify() is called
+ * or the timeout expires.
+ *
+ * The timeout is capped at the housekeeping period given to eventLoopInit().
+ *
+ * @param timeoutMs remaining time of the caller's deadline in milliseconds.
+ * @return number of ready sources, 0 on timeout or -1 if FAILURE.
+ */
+int eventLoopWait(uint32_t timeoutMs);
+/**
+ * @brief Release all event loop resources.
+ */
+void eventLoopClose(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
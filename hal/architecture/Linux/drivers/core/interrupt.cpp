@@ -32,11 +32,15 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <sched.h>
+#include <linux/gpio.h>
 #include "log.h"
+#include "eventloop.h"
+#include "GPIO.h"
 
 struct ThreadArgs {
 	void (*func)();
 	int gpioPin;
+	int fd;
 };
 
 volatile bool interruptsEnabled = true;
@@ -44,27 +48,6 @@ static pthread_mutex_t intMutex = PTHREAD_MUTEX_INITIALIZER;
 
 static pthread_t *threadIds[256] = {NULL};
 
-// sysFds:
-//	Map a file descriptor from the /sys/class/gpio/gpioX/value
-static int sysFds[256] = {
-	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-	    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
-    };
-
 /*
  * Part of wiringPi: Simple way to get your program running at high priority
  * with realtime schedulling.
@@ -86,24 +69,19 @@ int piHiPri(const int pri)
 
 void *interruptHandler(void *args)
 {
-	int fd;
 	struct pollfd polls;
-	char c;
+	struct gpio_v2_line_event event;
 	struct ThreadArgs *arguments = (struct ThreadArgs *)args;
 	int gpioPin = arguments->gpioPin;
+	int fd = arguments->fd;
 	void (*func)() = arguments->func;
 	delete arguments;
 
 	(void)piHiPri(55);	// Only effective if we run as root
 
-	if ((fd = sysFds[gpioPin]) == -1) {
-		logError("Failed to attach interrupt for pin %d\n", gpioPin);
-		return NULL;
-	}
-
 	// Setup poll structure
 	polls.fd     = fd;
-	polls.events = POLLPRI | POLLERR;
+	polls.events = POLLIN | POLLERR;
 
 	while (1) {
 		// Wait for it ...
@@ -112,14 +90,9 @@ void *interruptHandler(void *args)
 			logError("Error waiting for interrupt: %s\n", strerror(errno));
 			break;
 		}
-		// Do a dummy read to clear the interrupt
-		//	A one character read appars to be enough.
-		if (lseek (fd, 0, SEEK_SET) < 0) {
-			logError("Interrupt handler error: %s\n", strerror(errno));
-			break;
-		}
-		if (read (fd, &c, 1) < 0) {
-			logError("Interrupt handler error: %s\n", strerror(errno));
+		// Consume the event, the descriptor stays readable while events are queued
+		if (read(fd, &event, sizeof(event)) != sizeof(event)) {
+			logError("Interrupt handler error on pin %d: %s\n", gpioPin, strerror(errno));
 			break;
 		}
 		// Call user function.
@@ -127,98 +100,57 @@ void *interruptHandler(void *args)
 		if (interruptsEnabled) {
 			pthread_mutex_unlock(&intMutex);
 			func();
+			// Let the main loop process whatever the handler queued
+			eventLoopNotify();
 		} else {
 			pthread_mutex_unlock(&intMutex);
 		}
 	}
 
-	close(fd);
-
 	return NULL;
 }
 
 void attachInterrupt(uint8_t gpioPin, void (*func)(), uint8_t mode)
 {
-	FILE *fd;
-	char fName[40];
-	char c;
-	int count;
-
-	if (threadIds[gpioPin] == NULL) {
-		threadIds[gpioPin] = new pthread_t;
-	} else {
-		// Cancel the existing thread for that pin
-		pthread_cancel(*threadIds[gpioPin]);
-		// Wait a bit
-		usleep(1000);
-	}
-
-	// Export pin for interrupt
-	if ((fd = fopen("/sys/class/gpio/export", "w")) == NULL) {
-		logError("attachInterrupt: Unable to export pin %d for interrupt: %s\n", gpioPin, strerror(errno));
-		exit(1);
-	}
-	fprintf(fd, "%d\n", gpioPin);
-	fclose(fd);
-
-	// Wait a bit the system to create /sys/class/gpio/gpio<GPIO number>
-	usleep(1000);
-
-	snprintf(fName, sizeof(fName), "/sys/class/gpio/gpio%d/direction", gpioPin) ;
-	if ((fd = fopen (fName, "w")) == NULL) {
-		logError("attachInterrupt: Unable to open GPIO direction interface for pin %d: %s\n",
-		         gpioPin, strerror(errno));
-		exit(1) ;
-	}
-	fprintf(fd, "in\n") ;
-	fclose(fd) ;
-
-	snprintf(fName, sizeof(fName), "/sys/class/gpio/gpio%d/edge", gpioPin) ;
-	if ((fd = fopen(fName, "w")) == NULL) {
-		logError("attachInterrupt: Unable to open GPIO edge interface for pin %d: %s\n", gpioPin,
-		         strerror(errno));
-		exit(1) ;
-	}
+	uint64_t edgeFlags;
+	int fd;
 
 	switch (mode) {
 	case CHANGE:
-		fprintf(fd, "both\n");
+		edgeFlags = GPIO_V2_LINE_FLAG_EDGE_RISING | GPIO_V2_LINE_FLAG_EDGE_FALLING;
 		break;
 	case FALLING:
-		fprintf(fd, "falling\n");
+		edgeFlags = GPIO_V2_LINE_FLAG_EDGE_FALLING;
 		break;
 	case RISING:
-		fprintf(fd, "rising\n");
+		edgeFlags = GPIO_V2_LINE_FLAG_EDGE_RISING;
 		break;
 	case NONE:
-		fprintf(fd, "none\n");
-		break;
+		detachInterrupt(gpioPin);
+		return;
 	default:
 		logError("attachInterrupt: Invalid mode\n");
-		fclose(fd);
 		return;
 	}
-	fclose(fd);
 
-	if (sysFds[gpioPin] == -1) {
-		snprintf(fName, sizeof(fName), "/sys/class/gpio/gpio%d/value", gpioPin);
-		if ((sysFds[gpioPin] = open(fName, O_RDONLY)) < 0) {
-			logError("Error reading pin %d: %s\n", gpioPin, strerror(errno));
-			exit(1);
-		}
+	if (threadIds[gpioPin] == NULL) {
+		threadIds[gpioPin] = new pthread_t;
+	} else {
+		// Cancel the existing thread for that pin
+		pthread_cancel(*threadIds[gpioPin]);
+		pthread_join(*threadIds[gpioPin], NULL);
 	}
 
-	// Clear any initial pending interrupt
-	ioctl(sysFds[gpioPin], FIONREAD, &count);
-	for (int i = 0; i < count; ++i) {
-		if (read(sysFds[gpioPin], &c, 1) == -1) {
-			logError("attachInterrupt: failed to read pin status: %s\n", strerror(errno));
-		}
+	// Replaces any handle held for the pin, pending edges start from here
+	if ((fd = GPIO.requestEvent(gpioPin, edgeFlags)) < 0) {
+		logError("attachInterrupt: Unable to request events for pin %d\n", gpioPin);
+		exit(1);
 	}
 
 	struct ThreadArgs *threadArgs = new struct ThreadArgs;
 	threadArgs->func = func;
 	threadArgs->gpioPin = gpioPin;
+	threadArgs->fd = fd;
 
 	// Create a thread passing the pin and function
 	pthread_create(threadIds[gpioPin], NULL, interruptHandler, (void *)threadArgs);
@@ -229,23 +161,13 @@ void detachInterrupt(uint8_t gpioPin)
 	// Cancel the thread
 	if (threadIds[gpioPin] != NULL) {
 		pthread_cancel(*threadIds[gpioPin]);
+		pthread_join(*threadIds[gpioPin], NULL);
 		delete threadIds[gpioPin];
 		threadIds[gpioPin] = NULL;
 	}
 
-	// Close filehandle
-	if (sysFds[gpioPin] != -1) {
-		close(sysFds[gpioPin]);
-		sysFds[gpioPin] = -1;
-	}
-
-	FILE *fp = fopen("/sys/class/gpio/unexport", "w");
-	if (fp == NULL) {
-		logError("Unable to unexport pin %d for interrupt\n", gpioPin);
-		exit(1);
-	}
-	fprintf(fp, "%d", gpioPin);
-	fclose(fp);
+	// Release the event descriptor
+	GPIO.releaseLine(gpioPin);
 }
 
 void interrupts()
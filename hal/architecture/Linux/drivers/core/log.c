@@ -27,6 +27,9 @@
 #include <string.h>
 #include <time.h>
 #include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
 
 static const char *_log_level_colors[] = {
 	"\x1b[1;5;91m", "\x1b[1;91m", "\x1b[91m", "\x1b[31m", "\x1b[33m", "\x1b[34m", "\x1b[32m", "\x1b[36m"
@@ -44,6 +47,251 @@ static int _log_pipe_fd = -1;
 
 static FILE *_log_file_fp = NULL;
 
+/*
+ * Async mode: producers format a line into a fixed-size record of a bounded MPSC ring (per-slot
+ * sequence numbers, producers claim slots with a CAS on the head) and a background thread adds
+ * the timestamp and writes batches of records to the sinks.
+ * Stopping is bounded: a producer interrupted between claiming and publishing a slot (e.g. by the
+ * signal that stops the gateway) never publishes it, so the writer gives up on such slots after
+ * LOG_ASYNC_DRAIN_TIMEOUT_MS. The ring stays allocated until the process exits, other threads
+ * may still be pushing into it.
+ */
+#define LOG_ASYNC_RECORD_SIZE 256
+#define LOG_ASYNC_DRAIN_TIMEOUT_MS 100
+#define LOG_ASYNC_STOP_TIMEOUT_MS 500
+#define LOG_ASYNC_TEXT_SIZE (LOG_ASYNC_RECORD_SIZE - sizeof(uint64_t) - sizeof(time_t) - 2 * sizeof(uint16_t))
+
+struct log_record {
+	uint64_t seq;
+	time_t time;
+	uint16_t level;
+	uint16_t len;
+	char text[LOG_ASYNC_TEXT_SIZE];
+};
+
+static uint8_t _log_async = 0;
+static uint8_t _log_async_stop = 0;
+static uint8_t _log_async_done = 0;
+static struct log_record *_log_ring = NULL;
+static uint64_t _log_ring_mask = 0;
+static uint64_t _log_ring_head = 0;
+static uint64_t _log_ring_tail = 0;
+static uint32_t _log_dropped = 0;
+static sem_t _log_sem;
+static pthread_t _log_thread;
+
+static void _log_date(char *date, size_t size, time_t t)
+{
+	struct tm lt;
+
+	localtime_r(&t, &lt);
+	date[strftime(date, size, "%b %d %H:%M:%S", &lt)] = '\0';
+}
+
+static void _log_write(const struct log_record *rec)
+{
+	if (!_log_quiet || _log_file_fp != NULL) {
+		char date[16];
+		_log_date(date, sizeof(date), rec->time);
+
+		if (_log_file_fp != NULL) {
+			fprintf(_log_file_fp, "%s %-5s %s", date, _log_level_names[rec->level], rec->text);
+		}
+
+		if (!_log_quiet) {
+#ifdef LOG_DISABLE_COLOR
+			fprintf(stderr, "%s %-5s %s", date, _log_level_names[rec->level], rec->text);
+#else
+			fprintf(stderr, "%s %s%-5s\x1b[0m %s", date, _log_level_colors[rec->level],
+			        _log_level_names[rec->level], rec->text);
+#endif
+		}
+	}
+
+	if (_log_syslog) {
+		syslog(rec->level, "%s", rec->text);
+	}
+
+	if (_log_pipe) {
+		if (_log_pipe_fd < 0) {
+			_log_pipe_fd = open(_log_pipe_file, O_WRONLY | O_NONBLOCK);
+		}
+		if (_log_pipe_fd > 0) {
+			if (write(_log_pipe_fd, rec->text, rec->len) < 0) {
+				close(_log_pipe_fd);
+				_log_pipe_fd = -1;
+			}
+		}
+	}
+}
+
+static void _log_async_push(int level, const char *fmt, va_list args)
+{
+	uint64_t pos = __atomic_load_n(&_log_ring_head, __ATOMIC_RELAXED);
+	struct log_record *rec;
+
+	for (;;) {
+		rec = &_log_ring[pos & _log_ring_mask];
+		const uint64_t seq = __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE);
+		const int64_t dif = (int64_t)(seq - pos);
+		if (dif == 0) {
+			if (__atomic_compare_exchange_n(&_log_ring_head, &pos, pos + 1, 1, __ATOMIC_RELAXED,
+			                                __ATOMIC_RELAXED)) {
+				break;
+			}
+		} else if (dif < 0) {
+			// Ring is full, the writer thread is behind
+			__atomic_add_fetch(&_log_dropped, 1, __ATOMIC_RELAXED);
+			return;
+		} else {
+			pos = __atomic_load_n(&_log_ring_head, __ATOMIC_RELAXED);
+		}
+	}
+
+	int len = vsnprintf(rec->text, sizeof(rec->text), fmt, args);
+	if (len < 0) {
+		len = 0;
+		rec->text[0] = '\0';
+	} else if ((size_t)len >= sizeof(rec->text)) {
+		// Truncated, keep the line terminated
+		len = sizeof(rec->text) - 1;
+		rec->text[len - 1] = '\n';
+	}
+	rec->len = (uint16_t)len;
+	rec->level = (uint16_t)level;
+	rec->time = time(NULL);
+	__atomic_store_n(&rec->seq, pos + 1, __ATOMIC_RELEASE);
+	sem_post(&_log_sem);
+}
+
+static uint64_t _log_now_ms(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+// Write whatever is published between tail and head, skipping slots that were never published
+static void _log_async_skip_unpublished(void)
+{
+	const uint64_t head = __atomic_load_n(&_log_ring_head, __ATOMIC_ACQUIRE);
+
+	for (; _log_ring_tail != head; _log_ring_tail++) {
+		struct log_record *rec = &_log_ring[_log_ring_tail & _log_ring_mask];
+		if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) == _log_ring_tail + 1) {
+			_log_write(rec);
+		}
+	}
+}
+
+static void *_log_async_thread(void *arg)
+{
+	uint32_t reported = 0;
+	uint64_t deadline = 0;
+	(void)arg;
+
+	// Signals are handled by the main thread, which also stops this one
+	sigset_t set;
+	sigfillset(&set);
+	pthread_sigmask(SIG_BLOCK, &set, NULL);
+
+	for (;;) {
+		if (!deadline) {
+			while (sem_wait(&_log_sem) != 0 && errno == EINTR);
+		} else {
+			// Stopping, poll for the slots still being filled
+			struct timespec ts = { 0, 1000000 };
+			nanosleep(&ts, NULL);
+		}
+
+		// Drain everything published so far, then flush the sinks once for the whole batch
+		uint32_t written = 0;
+		for (;;) {
+			struct log_record *rec = &_log_ring[_log_ring_tail & _log_ring_mask];
+			if (__atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != _log_ring_tail + 1) {
+				break;
+			}
+			_log_write(rec);
+			__atomic_store_n(&rec->seq, _log_ring_tail + _log_ring_mask + 1, __ATOMIC_RELEASE);
+			_log_ring_tail++;
+			written++;
+		}
+
+		const uint32_t dropped = __atomic_load_n(&_log_dropped, __ATOMIC_RELAXED);
+		if (dropped != reported && _log_level >= LOG_WARNING) {
+			struct log_record rec;
+			rec.time = time(NULL);
+			rec.level = LOG_WARNING;
+			rec.len = snprintf(rec.text, sizeof(rec.text), "Log ring full, %u messages dropped\n",
+			                   dropped - reported);
+			_log_write(&rec);
+			reported = dropped;
+			written++;
+		}
+
+		if (written) {
+			if (_log_file_fp != NULL) {
+				fflush(_log_file_fp);
+			}
+			if (!_log_quiet) {
+				fflush(stderr);
+			}
+		}
+
+		if (__atomic_load_n(&_log_async_stop, __ATOMIC_ACQUIRE)) {
+			if (__atomic_load_n(&_log_ring_head, __ATOMIC_ACQUIRE) == _log_ring_tail) {
+				break;
+			}
+			if (!deadline) {
+				deadline = _log_now_ms() + LOG_ASYNC_DRAIN_TIMEOUT_MS;
+			} else if (_log_now_ms() >= deadline) {
+				_log_async_skip_unpublished();
+				if (_log_file_fp != NULL) {
+					fflush(_log_file_fp);
+				}
+				if (!_log_quiet) {
+					fflush(stderr);
+				}
+				break;
+			}
+		}
+	}
+	__atomic_store_n(&_log_async_done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+/*
+ * Stop the writer thread and wait a bounded time for it to drain the ring. Runs from the signal
+ * handler too, so it neither joins the thread nor frees the ring. Returns 0 if the writer did not
+ * finish in time, it may still be using the sinks then.
+ */
+static int _log_async_close(void)
+{
+	if (!_log_async) {
+		return 1;
+	}
+	if (!__atomic_exchange_n(&_log_async_stop, 1, __ATOMIC_ACQ_REL)) {
+		sem_post(&_log_sem);
+	}
+	for (int i = 0; i < LOG_ASYNC_STOP_TIMEOUT_MS &&
+	        !__atomic_load_n(&_log_async_done, __ATOMIC_ACQUIRE); i++) {
+		struct timespec ts = { 0, 1000000 };
+		nanosleep(&ts, NULL);
+	}
+	if (!__atomic_load_n(&_log_async_done, __ATOMIC_ACQUIRE)) {
+		return 0;
+	}
+	// Later messages are written directly, pushes already under way still land in the ring
+	_log_async = 0;
+	return 1;
+}
+
+static void _log_async_atexit(void)
+{
+	(void)_log_async_close();
+}
+
 void logSetQuiet(uint8_t enable)
 {
 	_log_quiet = enable ? 1 : 0;
@@ -97,8 +345,58 @@ int logSetFile(char *file)
 	return 0;
 }
 
+int logSetAsync(uint32_t ring_size)
+{
+	// A ring is never freed, see _log_async_close()
+	if (_log_async || _log_ring != NULL || ring_size == 0) {
+		return -1;
+	}
+
+	// Round up to a power of two so a slot is found by masking the sequence number
+	uint64_t size = 1;
+	while (size < ring_size) {
+		size <<= 1;
+	}
+
+	_log_ring = (struct log_record *)calloc(size, sizeof(struct log_record));
+	if (_log_ring == NULL) {
+		return -1;
+	}
+	for (uint64_t i = 0; i < size; i++) {
+		_log_ring[i].seq = i;
+	}
+	_log_ring_mask = size - 1;
+	_log_ring_head = 0;
+	_log_ring_tail = 0;
+	_log_async_stop = 0;
+	_log_async_done = 0;
+
+	if (sem_init(&_log_sem, 0, 0) != 0) {
+		free(_log_ring);
+		_log_ring = NULL;
+		return -1;
+	}
+	if (pthread_create(&_log_thread, NULL, _log_async_thread, NULL) != 0) {
+		sem_destroy(&_log_sem);
+		free(_log_ring);
+		_log_ring = NULL;
+		return -1;
+	}
+	pthread_detach(_log_thread);
+	_log_async = 1;
+	// Write out whatever is still queued if the gateway exits without logClose()
+	atexit(_log_async_atexit);
+
+	return 0;
+}
+
 void logClose(void)
 {
+	if (!_log_async_close()) {
+		// The writer thread is stuck on a sink, leave the sinks to the process exit
+		return;
+	}
+
 	if (_log_syslog) {
 		closelog();
 		_log_syslog = 0;
@@ -129,17 +427,23 @@ void vlog(int level, const char *fmt, va_list args)
 		return;
 	}
 
-	if (!_log_quiet || _log_file_fp != NULL) {
-		/* Get current time */
-		time_t t = time(NULL);
-		struct tm *lt = localtime(&t);
+	if (_log_async) {
+		_log_async_push(level, fmt, args);
+		return;
+	}
+
+	// Every sink consumes its own copy, args cannot be walked twice
+	va_list ap;
 
+	if (!_log_quiet || _log_file_fp != NULL) {
 		char date[16];
-		date[strftime(date, sizeof(date), "%b %d %H:%M:%S", lt)] = '\0';
+		_log_date(date, sizeof(date), time(NULL));
 
 		if (_log_file_fp != NULL) {
 			fprintf(_log_file_fp, "%s %-5s ", date, _log_level_names[level]);
-			vfprintf(_log_file_fp, fmt, args);
+			va_copy(ap, args);
+			vfprintf(_log_file_fp, fmt, ap);
+			va_end(ap);
 			fflush(_log_file_fp);
 		}
 
@@ -147,16 +451,22 @@ void vlog(int level, const char *fmt, va_list args)
 #ifdef LOG_DISABLE_COLOR
 			(void)_log_level_colors;
 			fprintf(stderr, "%s %-5s ", date, _log_level_names[level]);
-			vfprintf(stderr, fmt, args);
+			va_copy(ap, args);
+			vfprintf(stderr, fmt, ap);
+			va_end(ap);
 #else
 			fprintf(stderr, "%s %s%-5s\x1b[0m ", date, _log_level_colors[level], _log_level_names[level]);
-			vfprintf(stderr, fmt, args);
+			va_copy(ap, args);
+			vfprintf(stderr, fmt, ap);
+			va_end(ap);
 #endif
 		}
 	}
 
 	if (_log_syslog) {
-		vsyslog(level, fmt, args);
+		va_copy(ap, args);
+		vsyslog(level, fmt, ap);
+		va_end(ap);
 	}
 
 	if (_log_pipe) {
@@ -164,10 +474,12 @@ void vlog(int level, const char *fmt, va_list args)
 			_log_pipe_fd = open(_log_pipe_file, O_WRONLY | O_NONBLOCK);
 		}
 		if (_log_pipe_fd > 0) {
-			if (vdprintf(_log_pipe_fd, fmt, args) < 0) {
+			va_copy(ap, args);
+			if (vdprintf(_log_pipe_fd, fmt, ap) < 0) {
 				close(_log_pipe_fd);
 				_log_pipe_fd = -1;
 			}
+			va_end(ap);
 		}
 
 	}
@@ -40,6 +40,7 @@ void logSetLevel(int level);
 void logSetSyslog(int options, int facility);
 int logSetPipe(char *pipe_file);
 int logSetFile(char *file);
+int logSetAsync(uint32_t ring_size);
 void logClose(void);
 
 void vlog(int level, const char *fmt, va_list args);
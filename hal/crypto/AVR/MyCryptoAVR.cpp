@@ -33,6 +33,25 @@ void SHA256HMAC(uint8_t *dest, const uint8_t *key, size_t keyLength, const uint8
 	hmac_sha256(dest, key, keyLength << 3, data, dataLength << 3);
 }
 
+void SHA256HMACKeyInit(SHA256HMACKey_t *hmacKey, const uint8_t *key, size_t keyLength)
+{
+	hmac_sha256_ctx_t ctx;
+	hmac_sha256_init(&ctx, key, keyLength << 3);
+	(void)memcpy((void *)hmacKey->inner, (const void *)ctx.a.h, sizeof(hmacKey->inner));
+	(void)memcpy((void *)hmacKey->outer, (const void *)ctx.b.h, sizeof(hmacKey->outer));
+}
+
+void SHA256HMAC(uint8_t *dest, const SHA256HMACKey_t *hmacKey, const uint8_t *data,
+                size_t dataLength)
+{
+	hmac_sha256_ctx_t ctx;
+	(void)memcpy((void *)ctx.a.h, (const void *)hmacKey->inner, sizeof(ctx.a.h));
+	(void)memcpy((void *)ctx.b.h, (const void *)hmacKey->outer, sizeof(ctx.b.h));
+	ctx.a.length = SHA256_BLOCK_BITS;	// key pad block
+	ctx.b.length = SHA256_BLOCK_BITS;
+	hmac_sha256_keyed(dest, &ctx, data, dataLength << 3);
+}
+
 
 // AES
 AES_ctx aes_ctx;
@@ -59,3 +59,44 @@ void hmac_sha256(void *dest, const void *key, uint16_t keylength_b, const void *
 	sha256_lastBlock(&s, dest, SHA256_HASH_BITS);
 	sha256_ctx2hash((sha256_hash_t *)dest, &s);
 }
+
+void hmac_sha256_init(hmac_sha256_ctx_t *s, const void *key, uint16_t keylength_b)
+{
+	uint8_t buffer[HMAC_SHA256_BLOCK_BYTES];
+
+	(void)memset((void *)buffer, 0x00, HMAC_SHA256_BLOCK_BYTES);
+
+	/* if key is larger than a block we have to hash it*/
+	if (keylength_b > SHA256_BLOCK_BITS) {
+		sha256((sha256_hash_t *)buffer, key, keylength_b);
+	} else {
+		(void)memcpy((void *)buffer, (const void *)key, (keylength_b + 7) / 8);
+	}
+
+	for (uint8_t i = 0; i < SHA256_BLOCK_BYTES; ++i) {
+		buffer[i] ^= IPAD;
+	}
+	sha256_init(&s->a);
+	sha256_nextBlock(&s->a, buffer);
+	for (uint8_t i = 0; i < HMAC_SHA256_BLOCK_BYTES; ++i) {
+		buffer[i] ^= IPAD ^ OPAD;
+	}
+	sha256_init(&s->b);
+	sha256_nextBlock(&s->b, buffer);
+}
+
+void hmac_sha256_keyed(void *dest, const hmac_sha256_ctx_t *s, const void *msg,
+                       uint32_t msglength_b)
+{
+	sha256_ctx_t a = s->a;
+	while (msglength_b >= HMAC_SHA256_BLOCK_BITS) {
+		sha256_nextBlock(&a, msg);
+		msg = (uint8_t *)msg + HMAC_SHA256_BLOCK_BYTES;
+		msglength_b -= HMAC_SHA256_BLOCK_BITS;
+	}
+	sha256_lastBlock(&a, msg, msglength_b);
+	sha256_ctx2hash((sha256_hash_t *)dest, &a); /* save inner hash temporary to dest */
+	a = s->b;
+	sha256_lastBlock(&a, dest, SHA256_HASH_BITS);
+	sha256_ctx2hash((sha256_hash_t *)dest, &a);
+}
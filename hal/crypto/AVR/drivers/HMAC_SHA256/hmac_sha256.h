@@ -75,4 +75,24 @@ typedef struct {
 void hmac_sha256(void *dest, const void *key, uint16_t keylength_b, const void *msg,
                  uint32_t msglength_b);
 
+/**
+* @brief initialise a HMAC context with the hashed key pads
+*
+* @param s pointer to the HMAC context, a holds the inner and b the outer hash state
+* @param key pointer to the key that's is needed for the HMAC calculation
+* @param keylength_b length of the key
+*/
+void hmac_sha256_init(hmac_sha256_ctx_t *s, const void *key, uint16_t keylength_b);
+
+/**
+* @brief SHA256 HMAC function using a context from hmac_sha256_init()
+*
+* @param dest pointer to the location where the hash value is going to be written to
+* @param s pointer to the initialised HMAC context, it is not modified
+* @param msg pointer to the message that's going to be hashed
+* @param msglength_b length of the message
+*/
+void hmac_sha256_keyed(void *dest, const hmac_sha256_ctx_t *s, const void *msg,
+                       uint32_t msglength_b);
+
 #endif
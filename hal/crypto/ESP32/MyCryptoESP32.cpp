@@ -46,6 +46,26 @@ void SHA256HMAC(uint8_t *dest, const uint8_t *key, size_t keyLength, const uint8
 	mbedtls_md_free(&ctx);
 }
 
+// mbedtls cannot resume from a midstate, the key is kept and hashed per call
+void SHA256HMACKeyInit(SHA256HMACKey_t *hmacKey, const uint8_t *key, size_t keyLength)
+{
+	(void)memset((void *)hmacKey->key, 0x00, sizeof(hmacKey->key));
+	if (keyLength > sizeof(hmacKey->key)) {
+		// Hash long keys, the HMAC result is identical
+		SHA256(hmacKey->key, key, keyLength);
+		keyLength = 32;
+	} else {
+		(void)memcpy((void *)hmacKey->key, (const void *)key, keyLength);
+	}
+	hmacKey->keyLength = keyLength;
+}
+
+void SHA256HMAC(uint8_t *dest, const SHA256HMACKey_t *hmacKey, const uint8_t *data,
+                size_t dataLength)
+{
+	SHA256HMAC(dest, hmacKey->key, hmacKey->keyLength, data, dataLength);
+}
+
 // ESP32 AES128 CBC
 static mbedtls_aes_context aes_ctx;
 
@@ -45,6 +45,44 @@ void SHA256(uint8_t *dest, const uint8_t *data, size_t dataLength);
 void SHA256HMAC(uint8_t *dest, const uint8_t *key, size_t keyLength, const uint8_t *data,
                 size_t dataLength);
 
+/**
+* @brief Precomputed HMAC key
+*
+* Holds the SHA256 states after hashing the inner and outer key pads, which saves two of the
+* four block compressions of every HMAC calculated with a fixed key.
+*/
+typedef struct {
+#if defined(ARDUINO_ARCH_ESP32)
+	uint8_t key[64];	//!< HMAC key, mbedtls cannot resume from a midstate
+	uint8_t keyLength;	//!< Size of HMAC key
+#else
+	uint32_t inner[8];	//!< State after hashing key ^ ipad
+	uint32_t outer[8];	//!< State after hashing key ^ opad
+#endif
+} SHA256HMACKey_t;
+
+/**
+* @brief Precompute a HMAC key for use with SHA256HMAC()
+*
+* @param hmacKey Precomputed key to initialise.
+* @param key Buffer with HMAC key.
+* @param keyLength Size of HMAC key.
+*/
+void SHA256HMACKeyInit(SHA256HMACKey_t *hmacKey, const uint8_t *key, size_t keyLength);
+
+/**
+* @brief SHA256 HMAC calculation with a precomputed key
+*
+* The returned hash size is always 32 bytes.
+*
+* @param dest Buffer to return 32-byte hash.
+* @param hmacKey Key initialised by SHA256HMACKeyInit().
+* @param data Buffer with data to add.
+* @param dataLength Size of data buffer.
+*/
+void SHA256HMAC(uint8_t *dest, const SHA256HMACKey_t *hmacKey, const uint8_t *data,
+                size_t dataLength);
+
 /**
 * @brief AES128CBCInit
 * @param key AES encryption key, 16 bytes
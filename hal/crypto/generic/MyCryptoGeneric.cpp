@@ -22,24 +22,24 @@
 void SHA256HMAC(uint8_t *dest, const uint8_t *key, size_t keyLength, const uint8_t *data,
                 size_t dataLength)
 {
-	SHA256HMACInit(key, keyLength);
-	SHA256HMACAdd(data, dataLength);
-	SHA256HMACResult(dest);
+	SHA256HMACKey_t hmacKey;
+	SHA256HMACKeyInit(&hmacKey, key, keyLength);
+	SHA256HMAC(dest, &hmacKey, data, dataLength);
 }
 
-AES _aes;
+AES128Context_t _aes;
 
 void AES128CBCInit(const uint8_t *key)
 {
-	_aes.set_key((byte *)key, 16);
+	AES128Init(&_aes, key);
 }
 
 void AES128CBCEncrypt(uint8_t *iv, uint8_t *buffer, const size_t dataLength)
 {
-	_aes.cbc_encrypt((byte *)buffer, (byte *)buffer, dataLength / 16, iv);
+	AES128EncryptCBC(&_aes, iv, buffer, dataLength / AES128_BLOCK_LENGTH);
 }
 
 void AES128CBCDecrypt(uint8_t *iv, uint8_t *buffer, const size_t dataLength)
 {
-	_aes.cbc_decrypt((byte *)buffer, (byte *)buffer, dataLength / 16, iv);
+	AES128DecryptCBC(&_aes, iv, buffer, dataLength / AES128_BLOCK_LENGTH);
 }
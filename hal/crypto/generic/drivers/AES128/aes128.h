@@ -0,0 +1,77 @@
+/*
+* The MySensors Arduino library handles the wireless radio link and protocol
+* between your home built sensors/actuators and HA controller of choice.
+* The sensors forms a self healing radio network with optional repeaters. Each
+* repeater and gateway builds a routing tables in EEPROM which keeps track of the
+* network topology allowing messages to be routed to nodes.
+*
+* Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+* Copyright (C) 2013-2022 Sensnology AB
+* Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+*
+* Documentation: http://www.mysensors.org
+* Support Forum: http://forum.mysensors.org
+*
+* This program is free software; you can redistribute it and/or
+* modify it under the terms of the GNU General Public License
+* version 2 as published by the Free Software Foundation.
+*
+*/
+
+#ifndef _AES128_H_
+#define _AES128_H_
+
+#define AES128_BLOCK_LENGTH 16	//!< AES128_BLOCK_LENGTH
+#define AES128_ROUNDS 10	//!< AES128_ROUNDS
+
+/**
+* @brief AES128 key schedule
+*/
+typedef struct {
+	uint32_t encKeys[4 * (AES128_ROUNDS + 1)];	//!< Encryption round keys
+	uint32_t decKeys[4 * (AES128_ROUNDS + 1)];	//!< Decryption round keys (equivalent inverse cipher)
+	uint8_t hw;	//!< Round keys are stored as bytes for the AES instructions
+} AES128Context_t;
+
+/**
+* @brief Expand a key into a AES128 context
+* @param ctx Context to initialise.
+* @param key AES key, 16 bytes.
+*/
+void AES128Init(AES128Context_t *ctx, const uint8_t *key);
+
+/**
+* @brief Encrypt a single block
+* @param ctx Initialised context.
+* @param dest Buffer to return 16-byte cipher text, may be identical to src.
+* @param src 16-byte plain text.
+*/
+void AES128EncryptBlock(const AES128Context_t *ctx, uint8_t *dest, const uint8_t *src);
+
+/**
+* @brief Decrypt a single block
+* @param ctx Initialised context.
+* @param dest Buffer to return 16-byte plain text, may be identical to src.
+* @param src 16-byte cipher text.
+*/
+void AES128DecryptBlock(const AES128Context_t *ctx, uint8_t *dest, const uint8_t *src);
+
+/**
+* @brief CBC encrypt blocks in place
+* @param ctx Initialised context.
+* @param iv Initialization vector, 16 bytes, returns the last cipher block for chaining.
+* @param buffer Buffer to encrypt.
+* @param blocks Number of 16-byte blocks.
+*/
+void AES128EncryptCBC(const AES128Context_t *ctx, uint8_t *iv, uint8_t *buffer, size_t blocks);
+
+/**
+* @brief CBC decrypt blocks in place
+* @param ctx Initialised context.
+* @param iv Initialization vector, 16 bytes, returns the last cipher block for chaining.
+* @param buffer Buffer to decrypt.
+* @param blocks Number of 16-byte blocks.
+*/
+void AES128DecryptCBC(const AES128Context_t *ctx, uint8_t *iv, uint8_t *buffer, size_t blocks);
+
+#endif
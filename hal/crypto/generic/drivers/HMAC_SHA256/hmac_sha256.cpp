@@ -20,23 +20,60 @@
 
 #include "hmac_sha256.h"
 
-void SHA256HMACInit(const uint8_t *key, size_t keyLength)
+// Key and context behind the single-instance API, kept for existing callers
+SHA256HMACKey_t SHA256HMACkey;
+
+static void SHA256HMACPadState(uint32_t *state, const uint8_t *keyBlock, const uint8_t pad)
 {
-	(void)memset((void *)&SHA256keyBuffer, 0x00, BLOCK_LENGTH);
+	uint8_t block[BLOCK_LENGTH];
+	SHA256Context_t ctx;
+	for (uint8_t i = 0; i < BLOCK_LENGTH; i++) {
+		block[i] = keyBlock[i] ^ pad;
+	}
+	SHA256Init(&ctx);
+	SHA256Add(&ctx, block, BLOCK_LENGTH);
+	(void)memcpy((void *)state, (const void *)ctx.state, sizeof(ctx.state));
+}
+
+// Resume a calculation after the key pad block
+static void SHA256HMACStart(SHA256Context_t *ctx, const uint32_t *midstate)
+{
+	(void)memcpy((void *)ctx->state, (const void *)midstate, sizeof(ctx->state));
+	ctx->length = BLOCK_LENGTH;
+	ctx->bufferOffset = 0;
+}
+
+void SHA256HMACKeyInit(SHA256HMACKey_t *hmacKey, const uint8_t *key, size_t keyLength)
+{
+	uint8_t keyBlock[BLOCK_LENGTH];
+	(void)memset((void *)keyBlock, 0x00, BLOCK_LENGTH);
 	if (keyLength > BLOCK_LENGTH) {
 		// Hash long keys
-		SHA256Init();
-		SHA256Add(key, keyLength);
-		SHA256Result(SHA256keyBuffer);
+		SHA256(keyBlock, key, keyLength);
 	} else {
 		// Block length keys are used as is
-		(void)memcpy((void *)SHA256keyBuffer, (const void *)key, keyLength);
-	}
-	// Start inner hash
-	SHA256Init();
-	for (uint8_t i = 0; i < BLOCK_LENGTH; i++) {
-		SHA256Add(SHA256keyBuffer[i] ^ HMAC_IPAD);
+		(void)memcpy((void *)keyBlock, (const void *)key, keyLength);
 	}
+	SHA256HMACPadState(hmacKey->inner, keyBlock, HMAC_IPAD);
+	SHA256HMACPadState(hmacKey->outer, keyBlock, HMAC_OPAD);
+}
+
+void SHA256HMAC(uint8_t *dest, const SHA256HMACKey_t *hmacKey, const uint8_t *data,
+                size_t dataLength)
+{
+	SHA256Context_t ctx;
+	SHA256HMACStart(&ctx, hmacKey->inner);
+	SHA256Add(&ctx, data, dataLength);
+	SHA256Result(&ctx, dest);
+	SHA256HMACStart(&ctx, hmacKey->outer);
+	SHA256Add(&ctx, dest, HASH_LENGTH);
+	SHA256Result(&ctx, dest);
+}
+
+void SHA256HMACInit(const uint8_t *key, size_t keyLength)
+{
+	SHA256HMACKeyInit(&SHA256HMACkey, key, keyLength);
+	SHA256HMACStart(&SHA256context, SHA256HMACkey.inner);
 }
 
 void SHA256HMACAdd(const uint8_t data)
@@ -55,10 +92,7 @@ void SHA256HMACResult(uint8_t *dest)
 	// Complete inner hash
 	SHA256Result(innerHash);
 	// Calculate outer hash
-	SHA256Init();
-	for (uint8_t i = 0; i < BLOCK_LENGTH; i++) {
-		SHA256Add(SHA256keyBuffer[i] ^ HMAC_OPAD);
-	}
+	SHA256HMACStart(&SHA256context, SHA256HMACkey.outer);
 	SHA256Add(innerHash, HASH_LENGTH);
 	SHA256Result(dest);
-}
\ No newline at end of file
+}
@@ -31,143 +31,257 @@ const uint32_t SHA256K[] PROGMEM = {
 	0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
 };
 
-const uint8_t SHA256InitState[] PROGMEM = {
-	0x67,0xe6,0x09,0x6a, // H0
-	0x85,0xae,0x67,0xbb, // H1
-	0x72,0xf3,0x6e,0x3c, // H2
-	0x3a,0xf5,0x4f,0xa5, // H3
-	0x7f,0x52,0x0e,0x51, // H4
-	0x8c,0x68,0x05,0x9b, // H5
-	0xab,0xd9,0x83,0x1f, // H6
-	0x19,0xcd,0xe0,0x5b  // H7
+const uint32_t SHA256InitState[] PROGMEM = {
+	0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19
 };
 
-_SHA256buffer_t SHA256buffer;
-uint8_t SHA256bufferOffset;
-_SHA256state_t SHA256state;
-uint32_t SHA256byteCount;
-uint8_t SHA256keyBuffer[BLOCK_LENGTH];
+// Context behind the single-instance API, kept for existing callers
+SHA256Context_t SHA256context;
 
-void SHA256Init(void)
+static uint32_t SHA256ror32(const uint32_t number, const uint8_t bits)
 {
-	(void)memcpy_P((void *)&SHA256state.b, (const void *)&SHA256InitState, 32);
-	SHA256byteCount = 0;
-	SHA256bufferOffset = 0;
+	return ((number << (32 - bits)) | (number >> bits));
 }
 
-uint32_t SHA256ror32(const uint32_t number, const uint8_t bits)
+static uint32_t SHA256load32(const uint8_t *src)
 {
-	return ((number << (32 - bits)) | (number >> bits));
+	return ((uint32_t)src[0] << 24) | ((uint32_t)src[1] << 16) | ((uint32_t)src[2] << 8) | src[3];
 }
 
-void SHA256hashBlock(void)
+static void SHA256store32(uint8_t *dest, const uint32_t value)
 {
+	dest[0] = value >> 24;
+	dest[1] = value >> 16;
+	dest[2] = value >> 8;
+	dest[3] = value;
+}
+
+static void SHA256CompressGeneric(uint32_t *state, const uint8_t *data, size_t blocks)
+{
+	uint32_t w[16];
 	uint32_t a, b, c, d, e, f, g, h, t1, t2;
 
-	a = SHA256state.w[0];
-	b = SHA256state.w[1];
-	c = SHA256state.w[2];
-	d = SHA256state.w[3];
-	e = SHA256state.w[4];
-	f = SHA256state.w[5];
-	g = SHA256state.w[6];
-	h = SHA256state.w[7];
-
-	for (uint8_t i = 0; i < 64; i++) {
-		if (i >= 16) {
-			t1 = SHA256buffer.w[i & 15] + SHA256buffer.w[(i - 7) & 15];
-			t2 = SHA256buffer.w[(i - 2) & 15];
-			t1 += SHA256ror32(t2, 17) ^ SHA256ror32(t2, 19) ^ (t2 >> 10);
-			t2 = SHA256buffer.w[(i - 15) & 15];
-			t1 += SHA256ror32(t2, 7) ^ SHA256ror32(t2, 18) ^ (t2 >> 3);
-			SHA256buffer.w[i & 15] = t1;
+	while (blocks--) {
+		for (uint8_t i = 0; i < 16; i++) {
+			w[i] = SHA256load32(data + 4 * i);
+		}
+		a = state[0];
+		b = state[1];
+		c = state[2];
+		d = state[3];
+		e = state[4];
+		f = state[5];
+		g = state[6];
+		h = state[7];
+
+		for (uint8_t i = 0; i < 64; i++) {
+			if (i >= 16) {
+				t1 = w[i & 15] + w[(i - 7) & 15];
+				t2 = w[(i - 2) & 15];
+				t1 += SHA256ror32(t2, 17) ^ SHA256ror32(t2, 19) ^ (t2 >> 10);
+				t2 = w[(i - 15) & 15];
+				t1 += SHA256ror32(t2, 7) ^ SHA256ror32(t2, 18) ^ (t2 >> 3);
+				w[i & 15] = t1;
+			}
+			t1 = h;
+			t1 += SHA256ror32(e, 6) ^ SHA256ror32(e, 11) ^ SHA256ror32(e, 25); // ∑1(e)
+			t1 += g ^ (e & (g ^ f)); // Ch(e,f,g)
+			t1 += pgm_read_dword(SHA256K + i); // Ki
+			t1 += w[i & 15]; // Wi
+			t2 = SHA256ror32(a, 2) ^ SHA256ror32(a, 13) ^ SHA256ror32(a, 22); // ∑0(a)
+			t2 += ((b & c) | (a & (b | c))); // Maj(a,b,c)
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
 		}
-		t1 = h;
-		t1 += SHA256ror32(e, 6) ^ SHA256ror32(e, 11) ^ SHA256ror32(e, 25); // ∑1(e)
-		t1 += g ^ (e & (g ^ f)); // Ch(e,f,g)
-		t1 += pgm_read_dword(SHA256K + i); // Ki
-		t1 += SHA256buffer.w[i & 15]; // Wi
-		t2 = SHA256ror32(a, 2) ^ SHA256ror32(a, 13) ^ SHA256ror32(a, 22); // ∑0(a)
-		t2 += ((b & c) | (a & (b | c))); // Maj(a,b,c)
-		h = g;
-		g = f;
-		f = e;
-		e = d + t1;
-		d = c;
-		c = b;
-		b = a;
-		a = t1 + t2;
+		state[0] += a;
+		state[1] += b;
+		state[2] += c;
+		state[3] += d;
+		state[4] += e;
+		state[5] += f;
+		state[6] += g;
+		state[7] += h;
+		data += BLOCK_LENGTH;
 	}
-	SHA256state.w[0] += a;
-	SHA256state.w[1] += b;
-	SHA256state.w[2] += c;
-	SHA256state.w[3] += d;
-	SHA256state.w[4] += e;
-	SHA256state.w[5] += f;
-	SHA256state.w[6] += g;
-	SHA256state.w[7] += h;
-}
-
-void SHA256addUncounted(const uint8_t data)
-{
-	SHA256buffer.b[SHA256bufferOffset ^ 3] = data;
-	SHA256bufferOffset++;
-	if (SHA256bufferOffset == BLOCK_LENGTH) {
-		SHA256hashBlock();
-		SHA256bufferOffset = 0;
+}
+
+// Only x86-64 has a hardware kernel, other CPUs use the portable one
+#if defined(__linux__) && defined(__GNUC__) && defined(__x86_64__)
+#define SHA256_HW_DISPATCH	//!< Select SHA extensions at runtime if the CPU has them
+#endif
+
+#if defined(SHA256_HW_DISPATCH) && defined(__x86_64__)
+#include <cpuid.h>
+#include <immintrin.h>
+
+// Intel SHA extensions, the state is kept as ABEF/CDGH register pairs
+__attribute__((target("sha,sse4.1")))
+static void SHA256CompressShaNi(uint32_t *state, const uint8_t *data, size_t blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+	__m128i w[4];
+	__m128i msg, tmp, abefSave, cdghSave;
+
+	tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[0]), 0xB1); // CDAB
+	__m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&state[4]), 0x1B); // EFGH
+	__m128i state0 = _mm_alignr_epi8(tmp, state1, 8); // ABEF
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0); // CDGH
+
+	while (blocks--) {
+		abefSave = state0;
+		cdghSave = state1;
+		for (uint8_t j = 0; j < 16; j++) {
+			if (j < 4) {
+				w[j] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)(data + 16 * j)), mask);
+			}
+			msg = _mm_add_epi32(w[j & 3], _mm_loadu_si128((const __m128i *)&SHA256K[4 * j]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+			if (j >= 3 && j < 15) {
+				tmp = _mm_alignr_epi8(w[j & 3], w[(j - 1) & 3], 4);
+				w[(j + 1) & 3] = _mm_sha256msg2_epu32(_mm_add_epi32(w[(j + 1) & 3], tmp), w[j & 3]);
+			}
+			msg = _mm_shuffle_epi32(msg, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+			if (j >= 1 && j < 13) {
+				w[(j - 1) & 3] = _mm_sha256msg1_epu32(w[(j - 1) & 3], w[j & 3]);
+			}
+		}
+		state0 = _mm_add_epi32(state0, abefSave);
+		state1 = _mm_add_epi32(state1, cdghSave);
+		data += BLOCK_LENGTH;
 	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B); // FEBA
+	state1 = _mm_shuffle_epi32(state1, 0xB1); // DCHG
+	_mm_storeu_si128((__m128i *)&state[0], _mm_blend_epi16(tmp, state1, 0xF0)); // DCBA
+	_mm_storeu_si128((__m128i *)&state[4], _mm_alignr_epi8(state1, tmp, 8)); // HGFE
 }
 
+static bool SHA256HwAvailable(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSSE3) || !(ecx & bit_SSE4_1)) {
+		return false;
+	}
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx)) {
+		return false;
+	}
+	return (ebx & bit_SHA) != 0;
+}
+#define SHA256CompressHw SHA256CompressShaNi	//!< SHA256CompressHw
+#endif
 
-void SHA256Add(const uint8_t data)
+#if defined(SHA256_HW_DISPATCH)
+typedef void (*SHA256Compress_t)(uint32_t *state, const uint8_t *data, size_t blocks);
+
+static void SHA256CompressResolve(uint32_t *state, const uint8_t *data, size_t blocks);
+static SHA256Compress_t SHA256CompressImpl = SHA256CompressResolve;
+
+// First call picks the kernel, racing threads store the same value
+static void SHA256CompressResolve(uint32_t *state, const uint8_t *data, size_t blocks)
 {
-	SHA256byteCount++;
-	SHA256addUncounted(data);
+	const SHA256Compress_t impl = SHA256HwAvailable() ? SHA256CompressHw : SHA256CompressGeneric;
+	__atomic_store_n(&SHA256CompressImpl, impl, __ATOMIC_RELAXED);
+	impl(state, data, blocks);
 }
 
-void SHA256Add(const uint8_t *data, size_t dataLength)
+static inline void SHA256Compress(uint32_t *state, const uint8_t *data, size_t blocks)
+{
+	__atomic_load_n(&SHA256CompressImpl, __ATOMIC_RELAXED)(state, data, blocks);
+}
+#else
+static inline void SHA256Compress(uint32_t *state, const uint8_t *data, size_t blocks)
 {
-	while (dataLength--) {
-		SHA256Add(*data++);
+	SHA256CompressGeneric(state, data, blocks);
+}
+#endif
+
+void SHA256Init(SHA256Context_t *ctx)
+{
+	for (uint8_t i = 0; i < 8; i++) {
+		ctx->state[i] = pgm_read_dword(SHA256InitState + i);
 	}
+	ctx->length = 0;
+	ctx->bufferOffset = 0;
 }
 
-void SHA256Result(uint8_t *dest)
+void SHA256Add(SHA256Context_t *ctx, const uint8_t *data, size_t dataLength)
 {
-	// Pad to complete the last block
-	SHA256addUncounted(0x80);
-	while (SHA256bufferOffset != 56) {
-		SHA256addUncounted(0x00);
+	ctx->length += dataLength;
+	if (ctx->bufferOffset) {
+		size_t fill = BLOCK_LENGTH - ctx->bufferOffset;
+		if (dataLength < fill) {
+			(void)memcpy((void *)&ctx->buffer[ctx->bufferOffset], (const void *)data, dataLength);
+			ctx->bufferOffset += dataLength;
+			return;
+		}
+		(void)memcpy((void *)&ctx->buffer[ctx->bufferOffset], (const void *)data, fill);
+		SHA256Compress(ctx->state, ctx->buffer, 1);
+		ctx->bufferOffset = 0;
+		data += fill;
+		dataLength -= fill;
+	}
+	// Whole blocks are hashed straight from the input
+	const size_t blocks = dataLength / BLOCK_LENGTH;
+	if (blocks) {
+		SHA256Compress(ctx->state, data, blocks);
+		data += blocks * BLOCK_LENGTH;
+		dataLength -= blocks * BLOCK_LENGTH;
 	}
+	(void)memcpy((void *)ctx->buffer, (const void *)data, dataLength);
+	ctx->bufferOffset = dataLength;
+}
 
-	// Append length in the last 8 bytes
-	SHA256addUncounted(0); // We're only using 32 bit lengths
-	SHA256addUncounted(0); // But SHA-1 supports 64 bit lengths
-	SHA256addUncounted(0); // So zero pad the top bits
-	SHA256addUncounted(SHA256byteCount >> 29); // Shifting to multiply by 8
-	SHA256addUncounted(SHA256byteCount >> 21); // as SHA-1 supports bitstreams as well as
-	SHA256addUncounted(SHA256byteCount >> 13); // byte.
-	SHA256addUncounted(SHA256byteCount >> 5);
-	SHA256addUncounted(SHA256byteCount << 3);
-
-	// Swap byte order back
-	for (uint8_t i = 0; i<8; i++) {
-		uint32_t a, b;
-		a = SHA256state.w[i];
-		b = a << 24;
-		b |= (a << 8) & 0x00ff0000;
-		b |= (a >> 8) & 0x0000ff00;
-		b |= a >> 24;
-		SHA256state.w[i] = b;
+void SHA256Result(SHA256Context_t *ctx, uint8_t *dest)
+{
+	// Pad to complete the last block, the bit length goes into the last 8 bytes
+	uint8_t offset = ctx->bufferOffset;
+	ctx->buffer[offset++] = 0x80;
+	if (offset > BLOCK_LENGTH - 8) {
+		(void)memset((void *)&ctx->buffer[offset], 0x00, BLOCK_LENGTH - offset);
+		SHA256Compress(ctx->state, ctx->buffer, 1);
+		offset = 0;
+	}
+	(void)memset((void *)&ctx->buffer[offset], 0x00, BLOCK_LENGTH - 8 - offset);
+	SHA256store32(&ctx->buffer[BLOCK_LENGTH - 8], (uint32_t)(ctx->length >> 29));
+	SHA256store32(&ctx->buffer[BLOCK_LENGTH - 4], (uint32_t)(ctx->length << 3));
+	SHA256Compress(ctx->state, ctx->buffer, 1);
+
+	for (uint8_t i = 0; i < 8; i++) {
+		SHA256store32(dest + 4 * i, ctx->state[i]);
 	}
-	(void)memcpy((void *)dest, (const void *)SHA256state.b, 32);
-	// Return pointer to hash (20 characters)
-	//return SHA256state.b;
+}
+
+void SHA256Init(void)
+{
+	SHA256Init(&SHA256context);
+}
+
+void SHA256Add(const uint8_t data)
+{
+	SHA256Add(&SHA256context, &data, 1);
+}
+
+void SHA256Add(const uint8_t *data, size_t dataLength)
+{
+	SHA256Add(&SHA256context, data, dataLength);
+}
+
+void SHA256Result(uint8_t *dest)
+{
+	SHA256Result(&SHA256context, dest);
 }
 
 void SHA256(uint8_t *dest, const uint8_t *data, size_t dataLength)
 {
-	SHA256Init();
-	SHA256Add(data, dataLength);
-	SHA256Result(dest);
+	SHA256Context_t ctx;
+	SHA256Init(&ctx);
+	SHA256Add(&ctx, data, dataLength);
+	SHA256Result(&ctx, dest);
 }
@@ -25,19 +25,40 @@
 #define BLOCK_LENGTH 64	//!< BLOCK_LENGTH
 
 /**
-* @brief buffer for SHA256 calculator
+* @brief SHA256 calculation context
+*
+* Holds the complete state of one hash calculation, independent calculations
+* can run concurrently on separate contexts.
 */
-union _SHA256buffer_t {
-	uint8_t b[BLOCK_LENGTH];			//!< SHA256 b
-	uint32_t w[BLOCK_LENGTH / 4];	//!< SHA256 w
-};
+typedef struct {
+	uint32_t state[HASH_LENGTH / 4];	//!< Intermediate hash value
+	uint64_t length;	//!< Total number of bytes added
+	uint8_t buffer[BLOCK_LENGTH];	//!< Input not yet hashed, less than one block
+	uint8_t bufferOffset;	//!< Number of bytes in buffer
+} SHA256Context_t;
 
 /**
-* @brief state variables for SHA256 calculator
+* @brief Initialise a SHA256 context
+* @param ctx Context to initialise.
+*/
+void SHA256Init(SHA256Context_t *ctx);
+
+/**
+* @brief Add data to a SHA256 calculation
+* @param ctx Initialised context.
+* @param data Buffer with data to add.
+* @param dataLength Size of data buffer.
+*/
+void SHA256Add(SHA256Context_t *ctx, const uint8_t *data, size_t dataLength);
+
+/**
+* @brief Complete a SHA256 calculation
+*
+* The context has to be initialised again before it can be reused.
+*
+* @param ctx Context to complete.
+* @param dest Buffer to return 32-byte hash.
 */
-union _SHA256state_t {
-	uint8_t b[HASH_LENGTH];	//!< SHA256 b
-	uint32_t w[HASH_LENGTH / 4]; //!< SHA256 w
-};
+void SHA256Result(SHA256Context_t *ctx, uint8_t *dest);
 
 #endif
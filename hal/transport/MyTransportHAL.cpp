@@ -26,6 +26,72 @@
 #define TRANSPORT_HAL_DEBUG(x,...)	//!< debug NULL
 #endif
 
+#if defined(MY_TRANSPORT_ENCRYPTION) && !defined(MY_RADIO_RFM69)
+#define TRANSPORT_HAL_AES_BLOCK_SIZE (16u)	//!< Encrypted frames are at least one AES block long
+
+#if defined(MY_ENCRYPTION_CIPHERTEXT_STEALING)
+// CBC with ciphertext stealing (CBC-CS2): the last partial block is sent truncated and swapped
+// with the penultimate one, the buffer has to hold length rounded up to the block size
+static void transportHALEncryptCTS(uint8_t *buffer, const uint8_t length)
+{
+	uint8_t IV[TRANSPORT_HAL_AES_BLOCK_SIZE] = { 0 };
+	const uint8_t blocks = (length + TRANSPORT_HAL_AES_BLOCK_SIZE - 1) / TRANSPORT_HAL_AES_BLOCK_SIZE;
+	const uint8_t last = length - (blocks - 1) * TRANSPORT_HAL_AES_BLOCK_SIZE;
+	(void)memset((void *)&buffer[length], 0, blocks * TRANSPORT_HAL_AES_BLOCK_SIZE - length);
+	AES128CBCEncrypt(IV, buffer, blocks * TRANSPORT_HAL_AES_BLOCK_SIZE);
+	if (last < TRANSPORT_HAL_AES_BLOCK_SIZE) {
+		uint8_t *penultimate = &buffer[(blocks - 2) * TRANSPORT_HAL_AES_BLOCK_SIZE];
+		uint8_t tmp[TRANSPORT_HAL_AES_BLOCK_SIZE];
+		(void)memcpy((void *)tmp, (const void *)penultimate, TRANSPORT_HAL_AES_BLOCK_SIZE);
+		(void)memcpy((void *)penultimate, (const void *)&penultimate[TRANSPORT_HAL_AES_BLOCK_SIZE],
+		             TRANSPORT_HAL_AES_BLOCK_SIZE);
+		(void)memcpy((void *)&penultimate[TRANSPORT_HAL_AES_BLOCK_SIZE], (const void *)tmp, last);
+	}
+}
+
+static void transportHALDecryptCTS(uint8_t *buffer, const uint8_t length)
+{
+	uint8_t IV[TRANSPORT_HAL_AES_BLOCK_SIZE] = { 0 };
+	const uint8_t blocks = (length + TRANSPORT_HAL_AES_BLOCK_SIZE - 1) / TRANSPORT_HAL_AES_BLOCK_SIZE;
+	const uint8_t last = length - (blocks - 1) * TRANSPORT_HAL_AES_BLOCK_SIZE;
+	if (last < TRANSPORT_HAL_AES_BLOCK_SIZE) {
+		uint8_t *penultimate = &buffer[(blocks - 2) * TRANSPORT_HAL_AES_BLOCK_SIZE];
+		uint8_t *partial = &penultimate[TRANSPORT_HAL_AES_BLOCK_SIZE];
+		// Decrypting the full block yields the stolen cipher text tail xor the zero padded last block
+		uint8_t block[TRANSPORT_HAL_AES_BLOCK_SIZE];
+		uint8_t zeroIV[TRANSPORT_HAL_AES_BLOCK_SIZE] = { 0 };
+		(void)memcpy((void *)block, (const void *)penultimate, TRANSPORT_HAL_AES_BLOCK_SIZE);
+		AES128CBCDecrypt(zeroIV, block, TRANSPORT_HAL_AES_BLOCK_SIZE);
+		for (uint8_t i = 0; i < last; i++) {
+			const uint8_t cipher = partial[i];
+			partial[i] = block[i] ^ cipher;
+			block[i] = cipher;
+		}
+		// Restore the penultimate cipher block, the last plain text block is already in place
+		(void)memcpy((void *)penultimate, (const void *)block, TRANSPORT_HAL_AES_BLOCK_SIZE);
+		AES128CBCDecrypt(IV, buffer, (blocks - 1) * TRANSPORT_HAL_AES_BLOCK_SIZE);
+	} else {
+		AES128CBCDecrypt(IV, buffer, length);
+	}
+}
+#endif
+#endif
+
+// Size of a message on air
+static inline uint8_t transportHALFrameLength(const uint8_t messageLength)
+{
+#if defined(MY_TRANSPORT_ENCRYPTION) && !defined(MY_RADIO_RFM69)
+#if defined(MY_ENCRYPTION_CIPHERTEXT_STEALING)
+	return messageLength > TRANSPORT_HAL_AES_BLOCK_SIZE ? messageLength : TRANSPORT_HAL_AES_BLOCK_SIZE;
+#else
+	return messageLength > TRANSPORT_HAL_AES_BLOCK_SIZE ? 2 * TRANSPORT_HAL_AES_BLOCK_SIZE :
+	       TRANSPORT_HAL_AES_BLOCK_SIZE;
+#endif
+#else
+	return messageLength;
+#endif
+}
+
 bool transportHALInit(void)
 {
 	TRANSPORT_HAL_DEBUG(PSTR("THA:INIT\n"));
@@ -102,10 +168,30 @@ bool transportHALReceive(MyMessage *inMsg, uint8_t *msgLength)
 #endif
 #if defined(MY_TRANSPORT_ENCRYPTION) && !defined(MY_RADIO_RFM69)
 	TRANSPORT_HAL_DEBUG(PSTR("THA:RCV:DECRYPT\n"));
+	if (payloadLength < TRANSPORT_HAL_AES_BLOCK_SIZE) {
+		setIndication(INDICATION_ERR_LENGTH);
+		TRANSPORT_HAL_DEBUG(PSTR("!THA:RCV:LEN=%" PRIu8 ",EXP=%" PRIu8 "\n"), payloadLength,
+		                    TRANSPORT_HAL_AES_BLOCK_SIZE); // not a valid cipher text
+		return false;
+	}
+	// decrypt data
+#if defined(MY_ENCRYPTION_CIPHERTEXT_STEALING)
+	if (payloadLength > MAX_MESSAGE_SIZE) {
+		setIndication(INDICATION_ERR_LENGTH);
+		TRANSPORT_HAL_DEBUG(PSTR("!THA:RCV:LEN=%" PRIu8 ",MAX=%" PRIu8 "\n"), payloadLength,
+		                    MAX_MESSAGE_SIZE); // longer than any message
+		return false;
+	}
+	// Decrypt a copy, the block swap works on the whole frame and not just on the header field
+	uint8_t rx_plain[MAX_MESSAGE_SIZE];
+	(void)memcpy((void *)rx_plain, (const void *)rx_data, payloadLength);
+	transportHALDecryptCTS(rx_plain, payloadLength);
+	(void)memcpy((void *)rx_data, (const void *)rx_plain, payloadLength);
+#else
 	// has to be adjusted, WIP!
 	uint8_t IV[16] = { 0 };
-	// decrypt data
 	AES128CBCDecrypt(IV, (uint8_t *)rx_data, payloadLength);
+#endif
 #if defined(MY_DEBUG_VERBOSE_TRANSPORT_HAL)
 	hwDebugBuf2Str((const uint8_t *)rx_data, payloadLength);
 	TRANSPORT_HAL_DEBUG(PSTR("THA:RCV:PLAIN=%s\n"), hwDebugPrintStr);
@@ -120,18 +206,14 @@ bool transportHALReceive(MyMessage *inMsg, uint8_t *msgLength)
 		return false;
 	}
 	*msgLength = tmp.getLength();
-#if defined(MY_TRANSPORT_ENCRYPTION) && !defined(MY_RADIO_RFM69)
-	// payload length = a multiple of blocksize length for decrypted messages, i.e. cannot be used for payload length check
-#else
 	// Reject payloads with incorrect length
-	const uint8_t expectedMessageLength = tmp.getExpectedMessageSize();
+	const uint8_t expectedMessageLength = transportHALFrameLength(tmp.getExpectedMessageSize());
 	if (payloadLength != expectedMessageLength) {
 		setIndication(INDICATION_ERR_LENGTH);
 		TRANSPORT_HAL_DEBUG(PSTR("!THA:RCV:LEN=%" PRIu8 ",EXP=%" PRIu8 "\n"), payloadLength,
 		                    expectedMessageLength); // invalid payload length
 		return false;
 	}
-#endif
 	TRANSPORT_HAL_DEBUG(PSTR("THA:RCV:MSG LEN=%" PRIu8 "\n"), payloadLength);
 	return true;
 }
@@ -151,18 +233,22 @@ bool transportHALSend(const uint8_t nextRecipient, const MyMessage *outMsg, cons
 
 #if defined(MY_TRANSPORT_ENCRYPTION) && !defined(MY_RADIO_RFM69)
 	TRANSPORT_HAL_DEBUG(PSTR("THA:SND:ENCRYPT\n"));
-	uint8_t *tx_data[MAX_MESSAGE_SIZE];
+	uint8_t tx_data[MAX_MESSAGE_SIZE];
 	// copy input data because it is read-only
-	(void)memcpy((void *)tx_data, (void *)&outMsg->last, len);
-	// We us IV vector filled with zeros but randomize unused bytes in encryption block
-	uint8_t IV[16] = { 0 };
-	const uint8_t finalLength = len > 16 ? 32 : 16;
+	(void)memcpy((void *)tx_data, (const void *)&outMsg->last, len);
+	const uint8_t finalLength = transportHALFrameLength(len);
 	// fill block with random data
 	for (uint8_t i = len; i < finalLength; i++) {
-		*((uint8_t *)tx_data + i) = random(256);
+		tx_data[i] = random(256);
 	}
 	//encrypt data
-	AES128CBCEncrypt(IV, (uint8_t *)tx_data, finalLength);
+#if defined(MY_ENCRYPTION_CIPHERTEXT_STEALING)
+	transportHALEncryptCTS(tx_data, finalLength);
+#else
+	// We us IV vector filled with zeros but randomize unused bytes in encryption block
+	uint8_t IV[16] = { 0 };
+	AES128CBCEncrypt(IV, tx_data, finalLength);
+#endif
 #if defined(MY_DEBUG_VERBOSE_TRANSPORT_HAL)
 	hwDebugBuf2Str((const uint8_t *)tx_data, finalLength);
 	TRANSPORT_HAL_DEBUG(PSTR("THA:SND:CIP=%s\n"), hwDebugPrintStr);
@@ -239,3 +325,10 @@ int16_t transportHALGetTxPowerLevel(void)
 	int16_t result = transportGetTxPowerLevel();
 	return result;
 }
+
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+void transportHALGetRxQueueStats(char *buf)
+{
+	transportGetRxQueueStats(buf);
+}
+#endif
@@ -52,14 +52,8 @@
 #if defined(MY_RADIO_NRF5_ESB)
 #error Receive message buffering not supported for NRF5 radio! Please define MY_NRF5_RX_BUFFER_SIZE
 #endif
-#if defined(MY_RADIO_RFM69)
-#error Receive message buffering not supported for RFM69!
-#endif
-#if defined(MY_RADIO_RFM95)
-#error Receive message buffering not supported for RFM95!
-#endif
-#if defined(MY_RS485)
-#error Receive message buffering not supported for RS485!
+#if defined(MY_RADIO_RFM69) && !defined(MY_RFM69_NEW_DRIVER)
+#error Receive message buffering requires the new RFM69 driver (MY_RFM69_NEW_DRIVER)!
 #endif
 #elif defined(MY_RX_MESSAGE_BUFFER_SIZE)
 #error Receive message buffering requires message buffering feature enabled!
@@ -172,5 +166,13 @@ bool transportHALSetTxPowerPercent(const uint8_t powerPercent);
 * @return TX power in dBm
 */
 int16_t transportHALGetTxPowerLevel(void);
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+/**
+* @brief transportGetRxQueueStats
+* @param buf receives "D=<dropped messages>,H=<high-water mark>,S=<queue size>",
+* at least MAX_PAYLOAD_SIZE + 1 bytes
+*/
+void transportHALGetRxQueueStats(char *buf);
+#endif
 
 #endif // MyTransportHAL_h
@@ -20,20 +20,55 @@
 #include "hal/transport/RF24/driver/RF24.h"
 
 #if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
-#include "drivers/CircularBuffer/CircularBuffer.h"
+#include "drivers/CircularBuffer/SPSCCircularBuffer.h"
+
+#if defined(__linux__)
+typedef uint16_t transportRxQueueIndex_t;	// runtime sized, see rx_queue_size in mysensors.conf
+#else
+typedef uint8_t transportRxQueueIndex_t;
+#endif
 
 typedef struct _transportQueuedMessage {
 	uint8_t m_len;                        // Length of the data
 	uint8_t m_data[MAX_MESSAGE_SIZE];   // The raw data
+#if defined(__linux__)
+	uint32_t m_time;                      // micros() when queued
+#endif
 } transportQueuedMessage;
 
+#if defined(__linux__)
+/** Buffer to store queued messages in, allocated by transportInit(). */
+static transportQueuedMessage *transportRxQueueStorage = NULL;
+#else
 /** Buffer to store queued messages in. */
 static transportQueuedMessage transportRxQueueStorage[MY_RX_MESSAGE_BUFFER_SIZE];
-/** Circular buffer, which uses the transportRxQueueStorage and administers stored messages. */
-static CircularBuffer<transportQueuedMessage> transportRxQueue(transportRxQueueStorage,
-        MY_RX_MESSAGE_BUFFER_SIZE);
-
-static volatile uint8_t transportLostMessageCount = 0;
+#endif
+/** Circular buffer, which uses the transportRxQueueStorage and administers stored messages.
+ *  Filled by the IRQ handler only and drained by the main loop only, so it needs no lock. */
+static SPSCCircularBuffer<transportQueuedMessage, transportRxQueueIndex_t> transportRxQueue(
+    transportRxQueueStorage, MY_RX_MESSAGE_BUFFER_SIZE);
+
+static transportRxQueueIndex_t transportRxQueueSize = MY_RX_MESSAGE_BUFFER_SIZE;
+static volatile uint32_t transportLostMessageCount = 0;
+static volatile transportRxQueueIndex_t transportRxQueueHighWater = 0;
+
+#if defined(__linux__)
+#define TRANSPORT_RX_LATENCY_BUCKETS (5)
+/** Queue latency histogram, <1ms, <10ms, <100ms, <1s, >=1s. */
+static uint32_t transportRxQueueLatency[TRANSPORT_RX_LATENCY_BUCKETS] = { 0 };
+static uint32_t transportRxQueueStatsMS = 0;
+
+static void transportLogRxQueueStats(void)
+{
+	logInfo("RF24 RX queue: size=%u,used=%u,high=%u,dropped=%u,"
+	        "latency<1ms=%u,<10ms=%u,<100ms=%u,<1s=%u,>=1s=%u\n",
+	        (unsigned)transportRxQueueSize, (unsigned)transportRxQueue.available(),
+	        (unsigned)transportRxQueueHighWater, (unsigned)transportLostMessageCount,
+	        (unsigned)transportRxQueueLatency[0], (unsigned)transportRxQueueLatency[1],
+	        (unsigned)transportRxQueueLatency[2], (unsigned)transportRxQueueLatency[3],
+	        (unsigned)transportRxQueueLatency[4]);
+}
+#endif
 
 static void transportRxCallback(void)
 {
@@ -42,21 +77,47 @@ static void transportRxCallback(void)
 	if (!transportRxQueue.full()) {
 		transportQueuedMessage* msg = transportRxQueue.getFront();
 		msg->m_len = RF24_readMessage(msg->m_data);		// Read payload & clear RX_DR
+#if defined(__linux__)
+		msg->m_time = micros();
+#endif
 		(void)transportRxQueue.pushFront(msg);
+		const transportRxQueueIndex_t used = transportRxQueue.available();
+		if (used > transportRxQueueHighWater) {
+			transportRxQueueHighWater = used;
+		}
 	} else {
 		// Queue is full. Discard message.
 		(void)RF24_readMessage(NULL);		// Read payload & clear RX_DR
-		// Keep track of messages lost. Max 255, prevent wrapping.
-		if (transportLostMessageCount < 255) {
-			++transportLostMessageCount;
-		}
+		// Keep track of messages lost.
+		++transportLostMessageCount;
 	}
 }
+
+void transportGetRxQueueStats(char *buf)
+{
+	uint32_t dropped;
+	transportRxQueueIndex_t highWater;
+	MY_CRITICAL_SECTION {
+		dropped = transportLostMessageCount;
+		highWater = transportRxQueueHighWater;
+	}
+	(void)snprintf(buf, MAX_PAYLOAD_SIZE + 1, "D=%" PRIu32 ",H=%u,S=%u", dropped,
+	               (unsigned)highWater, (unsigned)transportRxQueueSize);
+}
 #endif
 
 bool transportInit(void)
 {
 #if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+#if defined(__linux__)
+	if (transportRxQueueStorage == NULL) {
+		if (conf.rx_queue_size) {
+			transportRxQueueSize = conf.rx_queue_size;
+		}
+		transportRxQueueStorage = new transportQueuedMessage[transportRxQueueSize];
+		transportRxQueue.init(transportRxQueueStorage, transportRxQueueSize);
+	}
+#endif
 	RF24_registerReceiveCallback( transportRxCallback );
 #endif
 	return RF24_initialize();
@@ -82,6 +143,13 @@ bool transportDataAvailable(void)
 {
 #if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
 	(void)RF24_isDataAvailable;				// Prevent 'defined but not used' warning
+#if defined(__linux__)
+	if (conf.rx_queue_stats_interval &&
+	        hwMillis() - transportRxQueueStatsMS >= conf.rx_queue_stats_interval * 1000ul) {
+		transportRxQueueStatsMS = hwMillis();
+		transportLogRxQueueStats();
+	}
+#endif
 	return !transportRxQueue.empty();
 #else
 	return RF24_isDataAvailable();
@@ -101,6 +169,15 @@ uint8_t transportReceive(void *data)
 	if (msg) {
 		len = msg->m_len;
 		(void)memcpy(data, msg->m_data, len);
+#if defined(__linux__)
+		uint32_t latency = micros() - msg->m_time;
+		uint8_t bucket = 0;
+		while (bucket < TRANSPORT_RX_LATENCY_BUCKETS - 1 && latency >= 1000) {
+			latency /= 10;
+			bucket++;
+		}
+		transportRxQueueLatency[bucket]++;
+#endif
 		(void)transportRxQueue.popBack();
 	}
 #else
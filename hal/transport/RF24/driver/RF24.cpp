@@ -34,6 +34,22 @@ LOCAL uint8_t RF24_NODE_ADDRESS = RF24_BROADCAST_ADDRESS;
 
 #if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
 LOCAL RF24_receiveCallbackType RF24_receiveCallback = NULL;
+LOCAL volatile uint8_t RF24_txStatus = 0;
+#if defined(__linux__)
+static pthread_mutex_t RF24_txMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t RF24_txCond;
+static pthread_once_t RF24_txCondOnce = PTHREAD_ONCE_INIT;
+
+static void RF24_txCondInit(void)
+{
+	// TX timeout is a relative deadline, keep it immune to wall clock steps (NTP, RTC set)
+	pthread_condattr_t attr;
+	(void)pthread_condattr_init(&attr);
+	(void)pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	(void)pthread_cond_init(&RF24_txCond, &attr);
+	(void)pthread_condattr_destroy(&attr);
+}
+#endif
 #endif
 
 #if defined(__linux__)
@@ -56,6 +72,20 @@ LOCAL void RF24_ce(const bool level)
 	hwDigitalWrite(MY_RF24_CE_PIN, level);
 }
 
+LOCAL void RF24_beginBatch(void)
+{
+#if defined(SPI_HAS_BATCH)
+	RF24_SPI.beginBatch();
+#endif
+}
+
+LOCAL void RF24_endBatch(void)
+{
+#if defined(SPI_HAS_BATCH)
+	RF24_SPI.endBatch();
+#endif
+}
+
 LOCAL uint8_t RF24_spiMultiByteTransfer(const uint8_t cmd, uint8_t *buf, uint8_t len,
                                         const bool readMode)
 {
@@ -67,9 +97,12 @@ LOCAL uint8_t RF24_spiMultiByteTransfer(const uint8_t cmd, uint8_t *buf, uint8_t
 #endif
 
 	RF24_csn(LOW);
+#if !defined(__linux__)
 	// timing
 	delayMicroseconds(10);
+#endif
 #ifdef __linux__
+	// chip select and its timing are handled by the SPI driver
 	uint8_t *prx = RF24_spi_rxbuff;
 	uint8_t *ptx = RF24_spi_txbuff;
 	uint8_t size = len + 1; // Add register value to transmit buffer
@@ -114,8 +147,10 @@ LOCAL uint8_t RF24_spiMultiByteTransfer(const uint8_t cmd, uint8_t *buf, uint8_t
 #if !defined(MY_SOFTSPI) && defined(SPI_HAS_TRANSACTION)
 	RF24_SPI.endTransaction();
 #endif
+#if !defined(__linux__)
 	// timing
 	delayMicroseconds(10);
+#endif
 	return status;
 }
 
@@ -252,12 +287,14 @@ LOCAL void RF24_openWritingPipe(const uint8_t recipient)
 LOCAL void RF24_startListening(void)
 {
 	RF24_DEBUG(PSTR("RF24:STL\n"));	// start listening
+	RF24_beginBatch();
 	// toggle PRX
 	RF24_setRFConfiguration(RF24_CONFIGURATION | _BV(RF24_PWR_UP) | _BV(RF24_PRIM_RX) );
 	// all RX pipe addresses must be unique, therefore skip if node ID is RF24_BROADCAST_ADDRESS
 	if(RF24_NODE_ADDRESS!= RF24_BROADCAST_ADDRESS) {
 		RF24_setPipeLSB(RF24_REG_RX_ADDR_P0, RF24_NODE_ADDRESS);
 	}
+	RF24_endBatch();
 	// start listening
 	RF24_ce(HIGH);
 }
@@ -308,6 +345,8 @@ LOCAL bool RF24_sendMessage(const uint8_t recipient, const void *buf, const uint
                             const bool noACK)
 {
 	RF24_stopListening();
+	// only writes up to CE high, send them at once
+	RF24_beginBatch();
 	RF24_openWritingPipe(recipient);
 	RF24_DEBUG(PSTR("RF24:TXM:TO=%" PRIu8 ",LEN=%" PRIu8 "\n"), recipient, len); // send message
 	// flush TX FIFO
@@ -319,6 +358,19 @@ LOCAL bool RF24_sendMessage(const uint8_t recipient, const void *buf, const uint
 	// this command is affected in clones (e.g. Si24R1):  flipped NoACK bit when using W_TX_PAYLOAD_NO_ACK / W_TX_PAYLOAD
 	// AutoACK is disabled on the broadcasting pipe - NO_ACK prevents resending
 	(void)RF24_spiMultiByteTransfer(RF24_CMD_WRITE_TX_PAYLOAD, (uint8_t *)buf, len, false);
+	RF24_endBatch();
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+	RF24_txStatus = 0;
+	// go, TX starts after ~10us, CE high also enables PA+LNA on supported HW
+	RF24_ce(HIGH);
+	// the IRQ handler reports and clears TX_DS/MAX_RT, RX keeps being served meanwhile
+	uint8_t RF24_status = RF24_waitTxComplete();
+	RF24_ce(LOW);
+	if (!RF24_status) {
+		// no interrupt, fall back to the status register
+		RF24_status = RF24_setStatus(_BV(RF24_TX_DS) | _BV(RF24_MAX_RT));
+	}
+#else
 	// go, TX starts after ~10us, CE high also enables PA+LNA on supported HW
 	RF24_ce(HIGH);
 	// timeout counter to detect HW issues
@@ -330,6 +382,8 @@ LOCAL bool RF24_sendMessage(const uint8_t recipient, const void *buf, const uint
 	RF24_ce(LOW);
 	// reset interrupts
 	const uint8_t RF24_status = RF24_setStatus(_BV(RF24_RX_DR) | _BV(RF24_TX_DS) | _BV(RF24_MAX_RT));
+#endif
+	RF24_beginBatch();
 	// Max retries exceeded
 	if (RF24_status & _BV(RF24_MAX_RT)) {
 		// flush packet
@@ -339,6 +393,7 @@ LOCAL bool RF24_sendMessage(const uint8_t recipient, const void *buf, const uint
 	if (noACK) {
 		RF24_setRetries(RF24_SET_ARD, RF24_SET_ARC);
 	}
+	RF24_endBatch();
 	RF24_startListening();
 	// true if message sent
 	return (RF24_status & _BV(RF24_TX_DS) || noACK);
@@ -457,6 +512,19 @@ LOCAL bool RF24_getReceivedPowerDetector(void)
 #if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
 LOCAL void IRQ_HANDLER_ATTR RF24_irqHandler(void)
 {
+	// TX completion, clear it right away so the IRQ line can signal RX again
+	const uint8_t txStatus = RF24_getStatus() & (_BV(RF24_TX_DS) | _BV(RF24_MAX_RT));
+	if (txStatus) {
+		(void)RF24_setStatus(txStatus);
+#if defined(__linux__)
+		pthread_mutex_lock(&RF24_txMutex);
+		RF24_txStatus = txStatus;
+		pthread_cond_signal(&RF24_txCond);
+		pthread_mutex_unlock(&RF24_txMutex);
+#else
+		RF24_txStatus = txStatus;
+#endif
+	}
 	if (RF24_receiveCallback) {
 #if defined(MY_GATEWAY_SERIAL) && !defined(__linux__)
 		// Will stay for a while (several 100us) in this interrupt handler. Any interrupts from serial
@@ -478,7 +546,7 @@ LOCAL void IRQ_HANDLER_ATTR RF24_irqHandler(void)
 			do {
 				RF24_receiveCallback();		// Must call RF24_readMessage(), which will clear RX_DR IRQ !
 			} while (RF24_isDataAvailable());
-		} else {
+		} else if (!txStatus) {
 			// Occasionally interrupt is triggered but no data is available - clear RX interrupt only
 			RF24_setStatus(_BV(RF24_RX_DR));
 			logNotice("RF24: Recovered from a bad interrupt trigger.\n");
@@ -508,6 +576,31 @@ LOCAL void RF24_registerReceiveCallback(RF24_receiveCallbackType cb)
 		RF24_receiveCallback = cb;
 	}
 }
+
+LOCAL uint8_t RF24_waitTxComplete(void)
+{
+#if defined(__linux__)
+	struct timespec deadline;
+	clock_gettime(CLOCK_MONOTONIC, &deadline);
+	deadline.tv_nsec += RF24_TX_TIMEOUT_MS * 1000000l;
+	deadline.tv_sec += deadline.tv_nsec / 1000000000l;
+	deadline.tv_nsec %= 1000000000l;
+
+	pthread_mutex_lock(&RF24_txMutex);
+	while (!RF24_txStatus) {
+		if (pthread_cond_timedwait(&RF24_txCond, &RF24_txMutex, &deadline) == ETIMEDOUT) {
+			break;
+		}
+	}
+	pthread_mutex_unlock(&RF24_txMutex);
+#else
+	const uint32_t startTX_MS = hwMillis();
+	while (!RF24_txStatus && (hwMillis() - startTX_MS < RF24_TX_TIMEOUT_MS)) {
+		doYield();
+	}
+#endif
+	return RF24_txStatus;
+}
 #endif
 
 LOCAL bool RF24_initialize(void)
@@ -535,6 +628,9 @@ LOCAL bool RF24_initialize(void)
 	// Note: ESP8266 & SoftSPI currently do not support interrupt usage for SPI,
 	// therefore it is unsafe to use MY_RF24_IRQ_PIN with ESP8266/SoftSPI!
 	RF24_SPI.usingInterrupt(digitalPinToInterrupt(MY_RF24_IRQ_PIN));
+#if defined(__linux__)
+	(void)pthread_once(&RF24_txCondOnce, RF24_txCondInit);
+#endif
 	// attach interrupt
 	attachInterrupt(digitalPinToInterrupt(MY_RF24_IRQ_PIN), RF24_irqHandler, FALLING);
 #endif
@@ -111,6 +111,9 @@
 #ifndef SPI_HAS_TRANSACTION
 #error RF24 IRQ usage requires transactional SPI support
 #endif
+#if MY_RX_MESSAGE_BUFFER_SIZE > 127 && !defined(__linux__)
+#error MY_RX_MESSAGE_BUFFER_SIZE must not exceed 127
+#endif
 #else
 #ifdef MY_RX_MESSAGE_BUFFER_SIZE
 #error Receive message buffering requires RF24 IRQ usage
@@ -119,17 +122,17 @@
 
 
 // RF24 settings
-#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
-#define RF24_CONFIGURATION (uint8_t) ((RF24_CRC_16 << 2) | (1 << RF24_MASK_TX_DS) | (1 << RF24_MASK_MAX_RT))		//!< MY_RF24_CONFIGURATION
-#else
+// TX_DS and MAX_RT stay unmasked, with MY_RX_MESSAGE_BUFFER_FEATURE they signal TX completion
 #define RF24_CONFIGURATION (uint8_t) (RF24_CRC_16 << 2)		//!< RF24_CONFIGURATION
-#endif
 #define RF24_FEATURE (uint8_t)( _BV(RF24_EN_DPL))	//!<  RF24_FEATURE
 #define RF24_RF_SETUP (uint8_t)(( ((MY_RF24_DATARATE & 0b10 ) << 4) | ((MY_RF24_DATARATE & 0b01 ) << 3) | (MY_RF24_PA_LEVEL << 1) ) + 1) 		//!< RF24_RF_SETUP, +1 for Si24R1 and LNA
 
 // powerup delay
 #define RF24_POWERUP_DELAY_MS	(100u)		//!< Power up delay, allow VCC to settle, transport to become fully operational
 
+// TX timeout, covers RF24_SET_ARC retransmits at RF24_SET_ARD plus airtime
+#define RF24_TX_TIMEOUT_MS		(50u)		//!< Maximum time to wait for TX_DS or MAX_RT
+
 // pipes
 #define RF24_BROADCAST_PIPE		(1u)		//!< RF24_BROADCAST_PIPE
 #define RF24_NODE_PIPE			(0u)		//!< RF24_NODE_PIPE
@@ -146,6 +149,14 @@ LOCAL void RF24_csn(const bool level);
 */
 LOCAL void RF24_ce(const bool level);
 /**
+* @brief RF24_beginBatch, collect the following register writes into one SPI message (Linux spidev only)
+*/
+LOCAL void RF24_beginBatch(void);
+/**
+* @brief RF24_endBatch, send the register writes collected since RF24_beginBatch()
+*/
+LOCAL void RF24_endBatch(void);
+/**
 * @brief RF24_spiMultiByteTransfer
 * @param cmd
 * @param buf
@@ -400,6 +411,12 @@ typedef void (*RF24_receiveCallbackType)(void);
 * @param cb
 */
 LOCAL void RF24_registerReceiveCallback(RF24_receiveCallbackType cb);
+/**
+* @brief RF24_waitTxComplete
+* Wait until the IRQ handler reports TX_DS or MAX_RT, or RF24_TX_TIMEOUT_MS elapsed.
+* @return TX_DS/MAX_RT status bits, 0 on timeout
+*/
+LOCAL uint8_t RF24_waitTxComplete(void);
 #endif
 
 #endif // __RF24_H__
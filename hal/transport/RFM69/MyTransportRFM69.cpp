@@ -78,6 +78,17 @@ uint8_t transportReceive(void *data)
 	return RFM69_receive((uint8_t *)data, MAX_MESSAGE_SIZE);
 }
 
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+void transportGetRxQueueStats(char *buf)
+{
+	uint32_t dropped;
+	uint8_t highWater;
+	const uint8_t size = RFM69_getRxQueueStats(&dropped, &highWater);
+	(void)snprintf(buf, MAX_PAYLOAD_SIZE + 1, "D=%" PRIu32 ",H=%u,S=%u", dropped,
+	               (unsigned)highWater, (unsigned)size);
+}
+#endif
+
 void transportEncrypt(const char *key)
 {
 	RFM69_encrypt(key);
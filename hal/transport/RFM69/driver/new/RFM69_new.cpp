@@ -43,6 +43,9 @@
 
 rfm69_internal_t RFM69;	//!< internal variables
 volatile uint8_t RFM69_irq; //!< rfm69 irq flag
+static rfm69_packet_t RFM69_rxQueueStorage[RFM69_RX_QUEUE_SIZE];	//!< RX queue storage
+//! Received data packets, filled by RFM69_interruptHandling(), drained by RFM69_receive()
+static SPSCCircularBuffer<rfm69_packet_t> RFM69_rxQueue(RFM69_rxQueueStorage, RFM69_RX_QUEUE_SIZE);
 
 #if defined(__linux__)
 // SPI RX and TX buffers (max packet len + 1 byte for the command)
@@ -74,6 +77,20 @@ LOCAL void RFM69_concludeSPITransaction(void)
 #endif
 }
 
+LOCAL void RFM69_beginBatch(void)
+{
+#if defined(SPI_HAS_BATCH)
+	RFM69_SPI.beginBatch();
+#endif
+}
+
+LOCAL void RFM69_endBatch(void)
+{
+#if defined(SPI_HAS_BATCH)
+	RFM69_SPI.endBatch();
+#endif
+}
+
 LOCAL uint8_t RFM69_spiMultiByteTransfer(const uint8_t cmd, uint8_t *buf, uint8_t len,
         const bool aReadMode)
 {
@@ -198,8 +215,10 @@ LOCAL bool RFM69_initialise(const uint32_t frequencyHz)
 
 	// set variables
 	RFM69.address = RFM69_BROADCAST_ADDRESS;
-	RFM69.dataReceived = false;
 	RFM69.ackReceived = false;
+	RFM69.rxDropped = 0;
+	RFM69.rxHighWater = 0;
+	RFM69_rxQueue.clear();
 	RFM69.txSequenceNumber = 0;	// initialise TX sequence counter
 	RFM69.powerLevel = MY_RFM69_TX_POWER_DBM + 1;	// will be overwritten when set
 	RFM69.radioMode = RFM69_RADIO_MODE_SLEEP;
@@ -253,6 +272,14 @@ LOCAL void RFM69_interruptHandling(void)
 	const uint8_t regIrqFlags2 = RFM69_readReg(RFM69_REG_IRQFLAGS2);
 	if (RFM69.radioMode == RFM69_RADIO_MODE_RX && (regIrqFlags2 & RFM69_IRQFLAGS2_PAYLOADREADY)) {
 		(void)RFM69_setRadioMode(RFM69_RADIO_MODE_STDBY);
+		// read into the next free queue slot. ACKs are still accepted if the queue is full, they go
+		// through a scratch packet so a dropped packet does not overwrite the state of currentPacket
+		rfm69_packet_t scratch;
+		rfm69_packet_t *packet = RFM69_rxQueue.getFront();
+		if (packet == NULL) {
+			packet = &scratch;
+		}
+		bool valid = false;
 		// use the fifo level irq as indicator if header bytes received
 		if (regIrqFlags2 & RFM69_IRQFLAGS2_FIFOLEVEL) {
 			RFM69_prepareSPITransaction();
@@ -262,31 +289,30 @@ LOCAL void RFM69_interruptHandling(void)
 			data[0] = RFM69_REG_FIFO & RFM69_READ_REGISTER;
 			RFM69_SPI.transfern(data, 3);
 
-			RFM69.currentPacket.header.packetLen = data[1];
-			RFM69.currentPacket.header.recipient = data[2];
+			packet->header.packetLen = data[1];
+			packet->header.recipient = data[2];
 
-			if (RFM69.currentPacket.header.packetLen > RFM69_MAX_PACKET_LEN) {
-				RFM69.currentPacket.header.packetLen = RFM69_MAX_PACKET_LEN;
+			if (packet->header.packetLen > RFM69_MAX_PACKET_LEN) {
+				packet->header.packetLen = RFM69_MAX_PACKET_LEN;
 			}
 
 			data[0] = RFM69_REG_FIFO & RFM69_READ_REGISTER;
-			//SPI.transfern(data, RFM69.currentPacket.header.packetLen - 1); //TODO: Wrong packetLen?
-			RFM69_SPI.transfern(data, RFM69.currentPacket.header.packetLen);
-
-			//(void)memcpy((void *)&RFM69.currentPacket.data[2], (void *)&data[1], RFM69.currentPacket.header.packetLen - 2);   //TODO: Wrong packetLen?
-			(void)memcpy((void *)&RFM69.currentPacket.data[2], (void *)&data[1],
-			             RFM69.currentPacket.header.packetLen - 1);
-
-			if (RFM69.currentPacket.header.version >= RFM69_MIN_PACKET_HEADER_VERSION) {
-				RFM69.currentPacket.payloadLen = min(RFM69.currentPacket.header.packetLen - (RFM69_HEADER_LEN - 1),
-				                                     RFM69_MAX_PACKET_LEN);
-				RFM69.ackReceived = RFM69_getACKReceived(RFM69.currentPacket.header.controlFlags);
-				RFM69.dataReceived = !RFM69.ackReceived;
+			//SPI.transfern(data, packet->header.packetLen - 1); //TODO: Wrong packetLen?
+			RFM69_SPI.transfern(data, packet->header.packetLen);
+
+			//(void)memcpy((void *)&packet->data[2], (void *)&data[1], packet->header.packetLen - 2);   //TODO: Wrong packetLen?
+			(void)memcpy((void *)&packet->data[2], (void *)&data[1],
+			             packet->header.packetLen - 1);
+
+			if (packet->header.version >= RFM69_MIN_PACKET_HEADER_VERSION) {
+				packet->payloadLen = min(packet->header.packetLen - (RFM69_HEADER_LEN - 1),
+				                         RFM69_MAX_PACKET_LEN);
+				valid = true;
 			}
 #else
 			(void)RFM69_SPI.transfer(RFM69_REG_FIFO & RFM69_READ_REGISTER);
 			// set reading pointer
-			uint8_t *current = (uint8_t *)&RFM69.currentPacket;
+			uint8_t *current = (uint8_t *)packet;
 			bool headerRead = false;
 			// first read header
 			uint8_t readingLength = RFM69_HEADER_LEN;
@@ -295,14 +321,13 @@ LOCAL void RFM69_interruptHandling(void)
 				if (!readingLength && !headerRead) {
 					// header read
 					headerRead = true;
-					if (RFM69.currentPacket.header.version >= RFM69_MIN_PACKET_HEADER_VERSION) {
+					if (packet->header.version >= RFM69_MIN_PACKET_HEADER_VERSION) {
 						// read payload
-						readingLength = min(RFM69.currentPacket.header.packetLen - (RFM69_HEADER_LEN - 1),
+						readingLength = min(packet->header.packetLen - (RFM69_HEADER_LEN - 1),
 						                    RFM69_MAX_PACKET_LEN);
 						// save payload length
-						RFM69.currentPacket.payloadLen = readingLength;
-						RFM69.ackReceived = RFM69_getACKReceived(RFM69.currentPacket.header.controlFlags);
-						RFM69.dataReceived = !RFM69.ackReceived;
+						packet->payloadLen = readingLength;
+						valid = true;
 					}
 				}
 			}
@@ -310,12 +335,27 @@ LOCAL void RFM69_interruptHandling(void)
 			RFM69_csn(HIGH);
 			RFM69_concludeSPITransaction();
 		}
-		RFM69.currentPacket.RSSI = RFM69_readRSSI();
-		// radio remains in stdby until packet read
-	} else {
-		// back to RX
-		(void)RFM69_setRadioMode(RFM69_RADIO_MODE_RX);
+		packet->RSSI = RFM69_readRSSI();
+		if (valid) {
+			if (RFM69_getACKReceived(packet->header.controlFlags)) {
+				// ACK, picked up by RFM69_sendWithRetry()
+				RFM69.currentPacket = *packet;
+				RFM69.ackReceived = true;
+			} else if (packet != &scratch) {
+				(void)RFM69_rxQueue.pushFront(packet);
+				const uint8_t used = RFM69_rxQueue.available();
+				if (used > RFM69.rxHighWater) {
+					RFM69.rxHighWater = used;
+				}
+			} else {
+				// not ACKed, the sender will retry
+				RFM69_DEBUG(PSTR("!RFM69:IRH:RXQ FULL\n"));
+				RFM69.rxDropped++;
+			}
+		}
 	}
+	// packet copied, back to RX
+	(void)RFM69_setRadioMode(RFM69_RADIO_MODE_RX);
 }
 
 LOCAL void RFM69_handler(void)
@@ -330,8 +370,7 @@ LOCAL void RFM69_handler(void)
 
 LOCAL bool RFM69_available(void)
 {
-	if (RFM69.dataReceived) {
-		// data received - we are still in STDBY
+	if (!RFM69_rxQueue.empty()) {
 		return true;
 	} else if (RFM69.radioMode == RFM69_RADIO_MODE_TX) {
 		// still in TX
@@ -345,6 +384,13 @@ LOCAL bool RFM69_available(void)
 
 LOCAL uint8_t RFM69_receive(uint8_t *buf, const uint8_t maxBufSize)
 {
+	const rfm69_packet_t *packet = RFM69_rxQueue.getBack();
+	if (packet == NULL) {
+		return 0;
+	}
+	// keep the packet for RFM69_getReceivingRSSI()
+	RFM69.currentPacket = *packet;
+	(void)RFM69_rxQueue.popBack();
 	const uint8_t payloadLen = min(RFM69.currentPacket.payloadLen, maxBufSize);
 	const uint8_t sender = RFM69.currentPacket.header.sender;
 	const rfm69_sequenceNumber_t sequenceNumber = RFM69.currentPacket.header.sequenceNumber;
@@ -354,8 +400,6 @@ LOCAL uint8_t RFM69_receive(uint8_t *buf, const uint8_t maxBufSize)
 	if (buf != NULL) {
 		(void)memcpy((void *)buf, (void *)&RFM69.currentPacket.payload, payloadLen);
 	}
-	// clear data flag
-	RFM69.dataReceived = false;
 	if (RFM69_getACKRequested(controlFlags) && !RFM69_getACKReceived(controlFlags)) {
 #if defined(MY_GATEWAY_FEATURE) && (F_CPU>16*1000000ul)
 		// delay for fast GW and slow nodes
@@ -385,6 +429,8 @@ LOCAL bool RFM69_sendFrame(rfm69_packet_t *packet, const bool increaseSequenceCo
 	        ((hwMillis() - CSMA_START_MS) < MY_RFM69_CSMA_TIMEOUT_MS)) {
 		doYield();
 	}
+	// only writes from RX to TX, send them at once
+	RFM69_beginBatch();
 	// set radio to standby to load fifo
 	(void)RFM69_setRadioMode(RFM69_RADIO_MODE_STDBY);
 	if (increaseSequenceCounter) {
@@ -402,6 +448,7 @@ LOCAL bool RFM69_sendFrame(rfm69_packet_t *packet, const bool increaseSequenceCo
 
 	// send message
 	(void)RFM69_setRadioMode(RFM69_RADIO_MODE_TX); // irq upon txsent
+	RFM69_endBatch();
 	const uint32_t txStartMS = hwMillis();
 	while (!RFM69_irq && (hwMillis() - txStartMS < MY_RFM69_TX_TIMEOUT_MS)) {
 		doYield();
@@ -505,8 +552,6 @@ LOCAL bool RFM69_setRadioMode(const rfm69_radio_mode_t newRadioMode)
 		regMode = RFM69_OPMODE_SEQUENCER_OFF | RFM69_OPMODE_LISTEN_OFF | RFM69_OPMODE_SLEEP;
 		RFM69_DEBUG(PSTR("RFM69:RSL\n"));	// put radio to sleep
 	} else if (newRadioMode == RFM69_RADIO_MODE_RX) {
-		RFM69.dataReceived = false;
-		RFM69.ackReceived = false;
 		regMode = RFM69_OPMODE_SEQUENCER_ON | RFM69_OPMODE_LISTEN_OFF | RFM69_OPMODE_RECEIVER;
 		RFM69_writeReg(RFM69_REG_DIOMAPPING1, RFM69_DIOMAPPING1_DIO0_01); // Interrupt on PayloadReady, DIO0
 		// disable high power settings
@@ -630,19 +675,17 @@ LOCAL bool RFM69_sendWithRetry(const uint8_t recipient, const void *buffer,
 			// no ACK requested
 			return true;
 		}
-		// radio is in RX
+		// radio is in RX, data packets arriving meanwhile are queued and do not end the wait
+		RFM69.ackReceived = false;
 		const uint32_t enterMS = hwMillis();
-		while (hwMillis() - enterMS < RFM69_RETRY_TIMEOUT_MS && !RFM69.dataReceived) {
+		while (hwMillis() - enterMS < RFM69_RETRY_TIMEOUT_MS) {
 			RFM69_handler();
 			if (RFM69.ackReceived) {
-				// radio is in stdby
 				const uint8_t ACKsender = RFM69.currentPacket.header.sender;
 				const rfm69_sequenceNumber_t ACKsequenceNumber = RFM69.currentPacket.ACK.sequenceNumber;
 				const rfm69_controlFlags_t ACKflags = RFM69.currentPacket.header.controlFlags;
 				const rfm69_RSSI_t ACKRSSI = RFM69.currentPacket.ACK.RSSI;
 				RFM69.ackReceived = false;
-				// packet read, back to RX
-				RFM69_setRadioMode(RFM69_RADIO_MODE_RX);
 				if (ACKsender == recipient && ACKsequenceNumber == RFM69.txSequenceNumber) {
 					RFM69_DEBUG(PSTR("RFM69:SWR:ACK,FROM=%" PRIu8 ",SEQ=%" PRIu8 ",RSSI=%" PRIi16 "\n"), ACKsender,
 					            ACKsequenceNumber,
@@ -661,6 +704,13 @@ LOCAL bool RFM69_sendWithRetry(const uint8_t recipient, const void *buffer,
 	return false;
 }
 
+LOCAL uint8_t RFM69_getRxQueueStats(uint32_t *dropped, uint8_t *highWater)
+{
+	*dropped = RFM69.rxDropped;
+	*highWater = RFM69.rxHighWater;
+	return RFM69_RX_QUEUE_SIZE;
+}
+
 LOCAL int16_t RFM69_getSendingRSSI(void)
 {
 	// own RSSI, as measured by the recipient - ACK part
@@ -49,6 +49,7 @@
 * | | RFM69 | INIT | PIN,CS=%%d,IQP=%%d,IQN=%%d[,RST=%%d] | Pin configuration: chip select (CS), IRQ pin (IQP), IRQ number (IQN), Reset (RST)
 * | | RFM69 | INIT | HWV=%%d                              | HW version, see datasheet chapter 9
 * |!| RFM69 | INIT | SANCHK FAIL                          | Sanity check failed, check wiring or replace module
+* |!| RFM69 | IRH  | RXQ FULL                             | RX queue full, incoming packet dropped (not ACKed)
 * | | RFM69 | PTX  | NO ADJ                               | TX power level, no adjustment
 * | | RFM69 | PTX  | LEVEL=%%d dbM                        | TX power level, set to (LEVEL) dBm
 * | | RFM69 | SAC  | SEND ACK,TO=%%d,RSSI=%%d             | ACK sent to (TO), RSSI of incoming message (RSSI)
@@ -75,6 +76,7 @@
 #define _RFM69_h
 
 #include "RFM69registers_new.h"
+#include "drivers/CircularBuffer/SPSCCircularBuffer.h"
 
 #if !defined(RFM69_SPI)
 #define RFM69_SPI hwSPI //!< default SPI
@@ -141,6 +143,15 @@
 #define RFM69_RETRY_TIMEOUT_MS           (200ul)		//!< Timeout for ACK, adjustments needed if modem configuration changed (air time different)
 #define RFM69_MODE_READY_TIMEOUT_MS      (50ul)			//!< Timeout for mode ready
 
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+#define RFM69_RX_QUEUE_SIZE              (MY_RX_MESSAGE_BUFFER_SIZE)	//!< Received packets waiting for RFM69_receive()
+#else
+#define RFM69_RX_QUEUE_SIZE              (1u)				//!< Received packets waiting for RFM69_receive()
+#endif
+#if RFM69_RX_QUEUE_SIZE > 127
+#error MY_RX_MESSAGE_BUFFER_SIZE must not exceed 127
+#endif
+
 #define RFM69_ACK_REQUESTED              (7u)				//!< RFM69 header, controlFlag, bit 7
 #define RFM69_ACK_RECEIVED               (6u)				//!< RFM69 header, controlFlag, bit 6
 #define RFM69_ACK_RSSI_REPORT            (5u)				//!< RFM69 header, controlFlag, bit 5
@@ -322,16 +333,17 @@ typedef struct {
 */
 typedef struct {
 	uint8_t address;                           //!< Node address
-	rfm69_packet_t currentPacket;              //!< Buffer for current packet
+	rfm69_packet_t currentPacket;              //!< Last ACK or packet returned by RFM69_receive()
 	rfm69_sequenceNumber_t txSequenceNumber;   //!< RFM69_txSequenceNumber
 	rfm69_powerlevel_t powerLevel;             //!< TX power level dBm
 	uint8_t ATCtargetRSSI;                     //!< ATC: target RSSI
+	uint32_t rxDropped;                        //!< Packets dropped, RX queue full
+	uint8_t rxHighWater;                       //!< Max. packets in RX queue
 	// 8 bit
 	rfm69_radio_mode_t radioMode : 3;          //!< current transceiver state
-	bool dataReceived : 1;                     //!< data received
 	bool ackReceived : 1;                      //!< ACK received
 	bool ATCenabled : 1;                       //!< ATC enabled
-	uint8_t reserved : 2;                      //!< Reserved
+	uint8_t reserved : 3;                      //!< Reserved
 } rfm69_internal_t;
 
 #define LOCAL static		//!< static
@@ -390,6 +402,14 @@ LOCAL bool RFM69_available(void);
 */
 LOCAL uint8_t RFM69_receive(uint8_t *buf, const uint8_t maxBufSize);
 
+/**
+* @brief Get RX queue statistics
+* @param dropped Packets dropped because the queue was full
+* @param highWater Max. packets queued
+* @return Queue size
+*/
+LOCAL uint8_t RFM69_getRxQueueStats(uint32_t *dropped, uint8_t *highWater);
+
 /**
 * @brief RFM69_sendFrame
 * @param packet
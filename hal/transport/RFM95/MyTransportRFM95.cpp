@@ -64,6 +64,17 @@ uint8_t transportReceive(void *data)
 	return len;
 }
 
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+void transportGetRxQueueStats(char *buf)
+{
+	uint32_t dropped;
+	uint8_t highWater;
+	const uint8_t size = RFM95_getRxQueueStats(&dropped, &highWater);
+	(void)snprintf(buf, MAX_PAYLOAD_SIZE + 1, "D=%" PRIu32 ",H=%u,S=%u", dropped,
+	               (unsigned)highWater, (unsigned)size);
+}
+#endif
+
 void transportSleep(void)
 {
 	(void)RFM95_sleep();
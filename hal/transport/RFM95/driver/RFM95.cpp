@@ -37,6 +37,9 @@
 
 rfm95_internal_t RFM95;	//!< internal variables
 volatile uint8_t RFM95_irq; //<! rfm95 irq flag
+static rfm95_packet_t RFM95_rxQueueStorage[RFM95_RX_QUEUE_SIZE];	//!< RX queue storage
+//! Received data packets, filled by RFM95_interruptHandling(), drained by RFM95_receive()
+static SPSCCircularBuffer<rfm95_packet_t> RFM95_rxQueue(RFM95_rxQueueStorage, RFM95_RX_QUEUE_SIZE);
 
 #if defined(__linux__)
 // SPI RX and TX buffers (max packet len + 1 byte for the command)
@@ -53,6 +56,20 @@ LOCAL void RFM95_csn(const bool level)
 #endif
 }
 
+LOCAL void RFM95_beginBatch(void)
+{
+#if defined(SPI_HAS_BATCH)
+	RFM95_SPI.beginBatch();
+#endif
+}
+
+LOCAL void RFM95_endBatch(void)
+{
+#if defined(SPI_HAS_BATCH)
+	RFM95_SPI.endBatch();
+#endif
+}
+
 LOCAL uint8_t RFM95_spiMultiByteTransfer(const uint8_t cmd, uint8_t *buf, uint8_t len,
         const bool aReadMode)
 {
@@ -184,11 +201,17 @@ LOCAL bool RFM95_initialise(const uint32_t frequencyHz)
 	// set variables
 	RFM95.address = RFM95_BROADCAST_ADDRESS;
 	RFM95.ackReceived = false;
-	RFM95.dataReceived = false;
+	RFM95.rxDropped = 0;
+	RFM95.rxHighWater = 0;
+	RFM95_rxQueue.clear();
 	RFM95.txSequenceNumber = 0;	// initialise TX sequence counter
 	RFM95.powerLevel = 0;
 	RFM95.ATCenabled = false;
 	RFM95.ATCtargetRSSI = RFM95_RSSItoInternal(RFM95_TARGET_RSSI);
+	for (uint8_t i = 0; i < RFM95_RTT_PEERS; i++) {
+		RFM95.RTT[i].address = RFM95_BROADCAST_ADDRESS;
+	}
+	RFM95.RTTnext = 0;
 
 	// SPI init
 #if !defined(__linux__)
@@ -251,22 +274,57 @@ LOCAL void RFM95_interruptHandling(void)
 		if (!(irqFlags & RFM95_PAYLOAD_CRC_ERROR)) {
 			const uint8_t bufLen = min(RFM95_readReg(RFM95_REG_13_RX_NB_BYTES), (uint8_t)RFM95_MAX_PACKET_LEN);
 			if (bufLen >= RFM95_HEADER_LEN) {
+				// Read into the next free queue slot. If the queue is full, ACKs are still accepted: only
+				// header and ACK are read, into a scratch frame, so a dropped packet does not overwrite
+				// the RSSI/SNR/ACK state of currentPacket
+				rfm95_packet_t *packet = RFM95_rxQueue.getFront();
+				union {
+					struct {
+						rfm95_header_t header;
+						rfm95_ack_t ACK;
+					} __attribute__((packed));
+					uint8_t data[RFM95_HEADER_LEN + sizeof(rfm95_ack_t)];
+				} scratch;
+				uint8_t *data = packet != NULL ? packet->data : scratch.data;
+				const rfm95_header_t *header = packet != NULL ? &packet->header : &scratch.header;
 				// Reset the fifo read ptr to the beginning of the packet
 				(void)RFM95_writeReg(RFM95_REG_0D_FIFO_ADDR_PTR, RFM95_readReg(RFM95_REG_10_FIFO_RX_CURRENT_ADDR));
-				(void)RFM95_burstReadReg(RFM95_REG_00_FIFO, RFM95.currentPacket.data, bufLen);
-				RFM95.currentPacket.RSSI = static_cast<rfm95_RSSI_t>(RFM95_readReg(
-				                               RFM95_REG_1A_PKT_RSSI_VALUE)); // RSSI of latest packet received
-				RFM95.currentPacket.SNR = static_cast<rfm95_SNR_t>(RFM95_readReg(RFM95_REG_19_PKT_SNR_VALUE));
-				RFM95.currentPacket.payloadLen = bufLen - RFM95_HEADER_LEN;
-				if ((RFM95.currentPacket.header.version >= RFM95_MIN_PACKET_HEADER_VERSION) &&
-				        (RFM95_PROMISCUOUS || RFM95.currentPacket.header.recipient == RFM95.address ||
-				         RFM95.currentPacket.header.recipient == RFM95_BROADCAST_ADDRESS)) {
+				(void)RFM95_burstReadReg(RFM95_REG_00_FIFO, data,
+				                         packet != NULL ? bufLen : min(bufLen, (uint8_t)sizeof(scratch.data)));
+				const rfm95_RSSI_t RSSI = static_cast<rfm95_RSSI_t>(RFM95_readReg(
+				                              RFM95_REG_1A_PKT_RSSI_VALUE)); // RSSI of latest packet received
+				const rfm95_SNR_t SNR = static_cast<rfm95_SNR_t>(RFM95_readReg(RFM95_REG_19_PKT_SNR_VALUE));
+				if ((header->version >= RFM95_MIN_PACKET_HEADER_VERSION) &&
+				        (RFM95_PROMISCUOUS || header->recipient == RFM95.address ||
+				         header->recipient == RFM95_BROADCAST_ADDRESS)) {
 					// Message for us
-					RFM95.ackReceived = RFM95_getACKReceived(RFM95.currentPacket.header.controlFlags) &&
-					                    !RFM95_getACKRequested(RFM95.currentPacket.header.controlFlags);
-					RFM95.dataReceived = !RFM95.ackReceived;
+					if (RFM95_getACKReceived(header->controlFlags) &&
+					        !RFM95_getACKRequested(header->controlFlags)) {
+						// ACK, picked up by RFM95_sendWithRetry()
+						RFM95.currentPacket.header = *header;
+						RFM95.currentPacket.ACK = packet != NULL ? packet->ACK : scratch.ACK;
+						RFM95.currentPacket.payloadLen = bufLen - RFM95_HEADER_LEN;
+						RFM95.currentPacket.RSSI = RSSI;
+						RFM95.currentPacket.SNR = SNR;
+						RFM95.ackReceived = true;
+					} else if (packet != NULL) {
+						packet->payloadLen = bufLen - RFM95_HEADER_LEN;
+						packet->RSSI = RSSI;
+						packet->SNR = SNR;
+						(void)RFM95_rxQueue.pushFront(packet);
+						const uint8_t used = RFM95_rxQueue.available();
+						if (used > RFM95.rxHighWater) {
+							RFM95.rxHighWater = used;
+						}
+					} else {
+						// Not ACKed, the sender will retry
+						RFM95_DEBUG(PSTR("!RFM95:IRH:RXQ FULL\n"));
+						RFM95.rxDropped++;
+					}
 				}
 			}
+			// Packet copied, FIFO is cleared when switching from STDBY to RX
+			(void)RFM95_setRadioMode(RFM95_RADIO_MODE_RX);
 		} else {
 			// CRC error
 			RFM95_DEBUG(PSTR("!RFM95:IRH:CRC ERROR\n"));
@@ -293,8 +351,7 @@ LOCAL void RFM95_handler(void)
 
 LOCAL bool RFM95_available(void)
 {
-	if (RFM95.dataReceived) {
-		// data received - we are still in STDBY from IRQ handler
+	if (!RFM95_rxQueue.empty()) {
 		return true;
 	} else if (RFM95.radioMode == RFM95_RADIO_MODE_TX) {
 		return false;
@@ -307,6 +364,13 @@ LOCAL bool RFM95_available(void)
 
 LOCAL uint8_t RFM95_receive(uint8_t *buf, const uint8_t maxBufSize)
 {
+	const rfm95_packet_t *packet = RFM95_rxQueue.getBack();
+	if (packet == NULL) {
+		return 0;
+	}
+	// keep the packet for RFM95_getReceivingRSSI() and RFM95_getReceivingSNR()
+	RFM95.currentPacket = *packet;
+	(void)RFM95_rxQueue.popBack();
 	const uint8_t payloadLen = min(RFM95.currentPacket.payloadLen, maxBufSize);
 	const uint8_t sender = RFM95.currentPacket.header.sender;
 	const rfm95_sequenceNumber_t sequenceNumber = RFM95.currentPacket.header.sequenceNumber;
@@ -316,8 +380,6 @@ LOCAL uint8_t RFM95_receive(uint8_t *buf, const uint8_t maxBufSize)
 	if (buf != NULL) {
 		(void)memcpy((void *)buf, (void *)&RFM95.currentPacket.payload, payloadLen);
 	}
-	// clear data flag
-	RFM95.dataReceived = false;
 	// ACK handling
 	if (RFM95_getACKRequested(controlFlags) && !RFM95_getACKReceived(controlFlags)) {
 #if defined(MY_GATEWAY_FEATURE) && (F_CPU>16*1000000ul)
@@ -341,6 +403,8 @@ LOCAL bool RFM95_sendFrame(rfm95_packet_t *packet, const bool increaseSequenceCo
 		RFM95.txSequenceNumber++;
 	}
 	packet->header.sequenceNumber = RFM95.txSequenceNumber;
+	// only writes until TX starts, send them at once
+	RFM95_beginBatch();
 	// Position at the beginning of the TX FIFO
 	(void)RFM95_writeReg(RFM95_REG_0D_FIFO_ADDR_PTR, RFM95_TX_FIFO_ADDR);
 	// write packet
@@ -350,6 +414,7 @@ LOCAL bool RFM95_sendFrame(rfm95_packet_t *packet, const bool increaseSequenceCo
 	(void)RFM95_writeReg(RFM95_REG_22_PAYLOAD_LENGTH, finalLen);
 	// send message, if sent, irq fires and radio returns to standby
 	(void)RFM95_setRadioMode(RFM95_RADIO_MODE_TX);
+	RFM95_endBatch();
 	// wait until IRQ fires or timeout
 	const uint32_t startTX_MS = hwMillis();
 	// todo: make this payload length + bit rate dependend
@@ -417,6 +482,7 @@ LOCAL void RFM95_enableTCXO(void)
 // Sets registers from a canned modem configuration structure
 LOCAL void RFM95_setModemRegisters(const rfm95_modemConfig_t *config)
 {
+	RFM95.modemConfig = *config;
 	(void)RFM95_writeReg(RFM95_REG_1D_MODEM_CONFIG1, config->reg_1d);
 	(void)RFM95_writeReg(RFM95_REG_1E_MODEM_CONFIG2, config->reg_1e);
 	(void)RFM95_writeReg(RFM95_REG_26_MODEM_CONFIG3, config->reg_26);
@@ -453,8 +519,6 @@ LOCAL bool RFM95_setRadioMode(const rfm95_radioMode_t newRadioMode)
 		regMode = RFM95_MODE_CAD;
 		(void)RFM95_writeReg(RFM95_REG_40_DIO_MAPPING1, 0x80); // Interrupt on CadDone, DIO0
 	} else if (newRadioMode == RFM95_RADIO_MODE_RX) {
-		RFM95.dataReceived = false;
-		RFM95.ackReceived = false;
 		regMode = RFM95_MODE_RXCONTINUOUS;
 		(void)RFM95_writeReg(RFM95_REG_40_DIO_MAPPING1, 0x00); // Interrupt on RxDone, DIO0
 		(void)RFM95_writeReg(RFM95_REG_0D_FIFO_ADDR_PTR,
@@ -555,8 +619,11 @@ LOCAL bool RFM95_sendWithRetry(const uint8_t recipient, const void *buffer,
 		if (noACK) {
 			return true;
 		}
+		// Data packets arriving meanwhile are queued and do not end the wait
+		RFM95.ackReceived = false;
 		const uint32_t enterMS = hwMillis();
-		while (hwMillis() - enterMS < RFM95_RETRY_TIMEOUT_MS && !RFM95.dataReceived) {
+		const uint32_t timeoutMS = RFM95_getACKTimeout(recipient, retry);
+		while (hwMillis() - enterMS < timeoutMS) {
 			RFM95_handler();
 			if (RFM95.ackReceived) {
 				const uint8_t sender = RFM95.currentPacket.header.sender;
@@ -565,8 +632,6 @@ LOCAL bool RFM95_sendWithRetry(const uint8_t recipient, const void *buffer,
 				const rfm95_RSSI_t RSSI = RFM95.currentPacket.ACK.RSSI;
 				//const rfm95_SNR_t SNR = RFM95.currentPacket.ACK.SNR;
 				RFM95.ackReceived = false;
-				// packet read, back to RX
-				RFM95_setRadioMode(RFM95_RADIO_MODE_RX);
 				if (sender == recipient &&
 				        (ACKsequenceNumber == RFM95.txSequenceNumber)) {
 					RFM95_DEBUG(PSTR("RFM95:SWR:ACK FROM=%" PRIu8 ",SEQ=%" PRIu16 ",RSSI=%" PRIi16 "\n"),sender,
@@ -577,14 +642,19 @@ LOCAL bool RFM95_sendWithRetry(const uint8_t recipient, const void *buffer,
 					if (RFM95.ATCenabled && RFM95_getACKRSSIReport(flag)) {
 						(void)RFM95_executeATC(RSSI, RFM95.ATCtargetRSSI);
 					}
+					// Karn: the ACK of a retry could belong to any of the attempts
+					if (!retry) {
+						RFM95_updateRTT(recipient, hwMillis() - enterMS);
+					}
 					return true;
 				} // seq check
 			}
 			doYield();
 		}
 		RFM95_DEBUG(PSTR("!RFM95:SWR:NACK\n"));
+		// Random backoff of up to one packet air time, so colliding senders drift apart
 		const uint32_t enterCSMAMS = hwMillis();
-		const uint16_t randDelayCSMA = enterMS % 100;
+		const uint32_t randDelayCSMA = random(RFM95_getTimeOnAir(bufferSize + RFM95_HEADER_LEN) + 1);
 		while (hwMillis() - enterCSMAMS < randDelayCSMA) {
 			doYield();
 		}
@@ -596,6 +666,73 @@ LOCAL bool RFM95_sendWithRetry(const uint8_t recipient, const void *buffer,
 	return false;
 }
 
+// Time on air, see SX1276 datasheet 4.1.1.7
+LOCAL uint32_t RFM95_getTimeOnAir(const uint8_t length)
+{
+	static const uint32_t bandwidthHz[] PROGMEM = {
+		7800ul, 10400ul, 15600ul, 20800ul, 31250ul, 41700ul, 62500ul, 125000ul, 250000ul, 500000ul
+	};
+	const uint8_t bandwidth = min((uint8_t)(RFM95.modemConfig.reg_1d >> 4), (uint8_t)9u);
+	const uint8_t codingRate = (RFM95.modemConfig.reg_1d >> 1) & 0x07;
+	const uint8_t implicitHeader = RFM95.modemConfig.reg_1d & RFM95_IMPLICIT_HEADER_MODE_ON ? 1 : 0;
+	const uint8_t spreadingFactor = RFM95.modemConfig.reg_1e >> 4;
+	const uint8_t CRC = RFM95.modemConfig.reg_1e & RFM95_RX_PAYLOAD_CRC_ON ? 1 : 0;
+	const uint8_t lowDataRate = RFM95.modemConfig.reg_26 & RFM95_LOW_DATA_RATE_OPTIMIZE ? 1 : 0;
+	const uint32_t symbolUS = ((1ul << spreadingFactor) * 1000000ul) / pgm_read_dword(
+	                              &bandwidthHz[bandwidth]);
+	const int16_t payloadBits = 8 * length - 4 * spreadingFactor + 28 + 16 * CRC - 20 * implicitHeader;
+	const uint8_t bitsPerSymbol = 4 * (spreadingFactor - 2 * lowDataRate);
+	uint16_t symbols = RFM95_PREAMBLE_LENGTH + 8;
+	if (payloadBits > 0) {
+		symbols += ((payloadBits + bitsPerSymbol - 1) / bitsPerSymbol) * (codingRate + 4);
+	}
+	// preamble takes another 4.25 symbols
+	return ((symbols * 4ul + 17) * symbolUS / 4 + 999) / 1000;
+}
+
+LOCAL uint32_t RFM95_getACKTimeout(const uint8_t recipient, const uint8_t retry)
+{
+#if defined(RFM95_RETRY_TIMEOUT_MS)
+	(void)recipient;
+	(void)retry;
+	return RFM95_RETRY_TIMEOUT_MS;
+#else
+	// The ACK cannot be faster than its own air time plus the turnaround of the recipient
+	const uint32_t minimumMS = RFM95_getTimeOnAir(RFM95_HEADER_LEN + sizeof(rfm95_ack_t)) +
+	                           RFM95_ACK_TURNAROUND_MS;
+	uint32_t timeoutMS = 2 * minimumMS;
+	for (uint8_t i = 0; i < RFM95_RTT_PEERS; i++) {
+		if (RFM95.RTT[i].address == recipient) {
+			// RTO = SRTT + 4 * RTTVAR (RFC 6298)
+			timeoutMS = max((RFM95.RTT[i].SRTT >> 3) + RFM95.RTT[i].RTTVAR, minimumMS);
+			break;
+		}
+	}
+	// Exponential backoff, the link might be congested
+	return timeoutMS << min(retry, (uint8_t)3u);
+#endif
+}
+
+LOCAL void RFM95_updateRTT(const uint8_t address, const uint32_t RTT)
+{
+	for (uint8_t i = 0; i < RFM95_RTT_PEERS; i++) {
+		rfm95_RTT_t *entry = &RFM95.RTT[i];
+		if (entry->address == address) {
+			// SRTT += (RTT - SRTT) / 8, RTTVAR += (|RTT - SRTT| - RTTVAR) / 4
+			const int32_t delta = (int32_t)RTT - (int32_t)(entry->SRTT >> 3);
+			entry->SRTT += delta;
+			entry->RTTVAR += (delta < 0 ? -delta : delta) - (int32_t)(entry->RTTVAR >> 2);
+			return;
+		}
+	}
+	// First measurement: SRTT = RTT, RTTVAR = RTT / 2
+	rfm95_RTT_t *entry = &RFM95.RTT[RFM95.RTTnext];
+	RFM95.RTTnext = (RFM95.RTTnext + 1) % RFM95_RTT_PEERS;
+	entry->address = address;
+	entry->SRTT = RTT << 3;
+	entry->RTTVAR = RTT << 1;
+}
+
 // Wait until no channel activity detected or timeout
 LOCAL bool RFM95_waitCAD(void)
 {
@@ -616,6 +753,13 @@ LOCAL void RFM95_ATCmode(const bool OnOff, const int16_t targetRSSI)
 	RFM95.ATCtargetRSSI = RFM95_RSSItoInternal(targetRSSI);
 }
 
+LOCAL uint8_t RFM95_getRxQueueStats(uint32_t *dropped, uint8_t *highWater)
+{
+	*dropped = RFM95.rxDropped;
+	*highWater = RFM95.rxHighWater;
+	return RFM95_RX_QUEUE_SIZE;
+}
+
 LOCAL bool RFM95_sanityCheck(void)
 {
 	bool result = true;
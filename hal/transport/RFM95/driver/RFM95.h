@@ -24,6 +24,8 @@
  * Changelog:
  * - ACK with sequenceNumber
  * - ATC control
+ * - ACK timeouts from air time and round trip time estimates
+ * - RX queue, frames received while waiting for an ACK are kept
  *
  * Definitions for HopeRF LoRa radios:
  * http://www.hoperf.com/upload/rf/RFM95_96_97_98W.pdf
@@ -46,6 +48,7 @@
 * | | RFM95 | INIT | PIN,CS=%%d,IQP=%%d,IQN=%%d[,RST=%%d]   | Pin configuration: chip select (CS), IRQ pin (IQP), IRQ number (IQN), Reset (RST)
 * |!| RFM95 | INIT | SANCHK FAIL                            | Sanity check failed, check wiring or replace module
 * |!| RFM95 | IRH  | CRC FAIL                               | Incoming packet has CRC error, skip
+* |!| RFM95 | IRH  | RXQ FULL                               | RX queue full, incoming packet dropped (not ACKed)
 * | | RFM95 | RCV  | SEND ACK                               | ACK request received, sending ACK back
 * | | RFM95 | PTC  | LEVEL=%%d                              | Set TX power level
 * | | RFM95 | SAC  | SEND ACK,TO=%%d,RSSI=%%d,SNR=%%d       | Send ACK to node (TO), RSSI of received message (RSSI), SNR of message (SNR)
@@ -80,6 +83,7 @@
 #define _RFM95_h
 
 #include "RFM95registers.h"
+#include "drivers/CircularBuffer/SPSCCircularBuffer.h"
 
 #if !defined(RFM95_SPI)
 #define RFM95_SPI hwSPI //!< default SPI
@@ -121,13 +125,18 @@
 #define RFM95_BW31_25CR48SF512 RFM95_BW_31_25KHZ | RFM95_CODING_RATE_4_8, RFM95_SPREADING_FACTOR_512CPS | RFM95_RX_PAYLOAD_CRC_ON, RFM95_AGC_AUTO_ON //!< 0x48,0x94,0x04
 #define RFM95_BW125CR48SF4096	RFM95_BW_125KHZ | RFM95_CODING_RATE_4_8, RFM95_SPREADING_FACTOR_4096CPS | RFM95_RX_PAYLOAD_CRC_ON, RFM95_AGC_AUTO_ON | RFM95_LOW_DATA_RATE_OPTIMIZE	//!< 0x78,0xc4,0x0C
 
-#if !defined(RFM95_RETRY_TIMEOUT_MS)
-// air-time approximation for timeout, 1 hop ~15 bytes payload - adjust if needed
-// BW125/SF128: 50ms
-// BW500/SF128: 15ms
-// BW31.25/SF512: 900ms
-// BW125/SF4096: 1500ms
-#define RFM95_RETRY_TIMEOUT_MS			(500ul)			//!< Timeout for ACK, adjustments needed if modem configuration changed (air time different)
+// ACK timeouts are derived from the air time of the active modem configuration and a smoothed
+// round trip time per peer. Define RFM95_RETRY_TIMEOUT_MS to use a fixed timeout instead.
+#define RFM95_RTT_PEERS                        (4u)			//!< Number of peers with a round trip time estimate
+#define RFM95_ACK_TURNAROUND_MS                (20u)			//!< Allowance for the recipient to process a packet and start the ACK
+
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+#define RFM95_RX_QUEUE_SIZE                    (MY_RX_MESSAGE_BUFFER_SIZE)	//!< Received packets waiting for RFM95_receive()
+#else
+#define RFM95_RX_QUEUE_SIZE                    (1u)			//!< Received packets waiting for RFM95_receive()
+#endif
+#if RFM95_RX_QUEUE_SIZE > 127
+#error MY_RX_MESSAGE_BUFFER_SIZE must not exceed 127
 #endif
 
 #if !defined(MY_RFM95_TX_TIMEOUT_MS)
@@ -264,22 +273,35 @@ typedef struct {
 } __attribute__((packed)) rfm95_packet_t;
 
 
+/**
+* @brief Round trip time estimate of a peer (Jacobson/Karels)
+*/
+typedef struct {
+	uint8_t address;                          //!< Peer address
+	uint32_t SRTT;                            //!< Smoothed round trip time, 1/8 ms
+	uint32_t RTTVAR;                          //!< Round trip time variation, 1/4 ms
+} rfm95_RTT_t;
+
 /**
 * @brief RFM95 internal variables
 */
 typedef struct {
 	uint8_t address;                          //!< Node address
-	rfm95_packet_t currentPacket;             //!< Buffer for current packet
+	rfm95_packet_t currentPacket;             //!< Last ACK or packet returned by RFM95_receive()
 	rfm95_sequenceNumber_t txSequenceNumber;  //!< RFM95_txSequenceNumber
 	rfm95_powerLevel_t powerLevel;            //!< TX power level dBm
 	rfm95_RSSI_t ATCtargetRSSI;               //!< ATC: target RSSI
+	rfm95_modemConfig_t modemConfig;          //!< Active modem configuration
+	rfm95_RTT_t RTT[RFM95_RTT_PEERS];         //!< Round trip time estimates
+	uint8_t RTTnext;                          //!< Next RTT entry to replace
+	uint32_t rxDropped;                       //!< Packets dropped, RX queue full
+	uint8_t rxHighWater;                      //!< Max. packets in RX queue
 	// 8 bit
 	rfm95_radioMode_t radioMode : 3;          //!< current transceiver state
 	bool channelActive : 1;                   //!< RFM95_cad
 	bool ATCenabled : 1;                      //!< ATC enabled
 	bool ackReceived : 1;                     //!< ACK received
-	bool dataReceived : 1;                    //!< Data received
-	bool reserved : 1;                        //!< unused
+	uint8_t reserved : 2;                     //!< unused
 } rfm95_internal_t;
 
 #define LOCAL static		//!< static
@@ -319,6 +341,13 @@ LOCAL bool RFM95_available(void);
 */
 LOCAL uint8_t RFM95_receive(uint8_t *buf, const uint8_t maxBufSize);
 /**
+* @brief Get RX queue statistics
+* @param dropped Packets dropped because the queue was full
+* @param highWater Max. packets queued
+* @return Queue size
+*/
+LOCAL uint8_t RFM95_getRxQueueStats(uint32_t *dropped, uint8_t *highWater);
+/**
 * @brief RFM95_send
 * @param recipient
 * @param data
@@ -408,6 +437,25 @@ LOCAL void RFM95_sendACK(const uint8_t recipient, const rfm95_sequenceNumber_t s
 LOCAL bool RFM95_sendWithRetry(const uint8_t recipient, const void *buffer,
                                const uint8_t bufferSize, const bool noACK);
 /**
+* @brief Calculate the time on air of a packet with the active modem configuration
+* @param length Packet length including header
+* @return Time on air in ms
+*/
+LOCAL uint32_t RFM95_getTimeOnAir(const uint8_t length);
+/**
+* @brief Get the time to wait for an ACK
+* @param recipient
+* @param retry Number of previous attempts, the timeout doubles with each
+* @return Timeout in ms
+*/
+LOCAL uint32_t RFM95_getACKTimeout(const uint8_t recipient, const uint8_t retry);
+/**
+* @brief Add a round trip time measurement to the estimate of a peer
+* @param address Peer address
+* @param RTT Round trip time in ms
+*/
+LOCAL void RFM95_updateRTT(const uint8_t address, const uint32_t RTT);
+/**
 * @brief Wait until no channel activity detected
 * @return True if no channel activity detected, False if timeout occured
 */
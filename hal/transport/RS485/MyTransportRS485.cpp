@@ -55,6 +55,7 @@
 #ifdef __linux__
 #include "SerialPort.h"
 #endif
+#include "drivers/CircularBuffer/SPSCCircularBuffer.h"
 
 #if defined(MY_RS485_DE_PIN)
 #if !defined(MY_RS485_DE_INVERSE)
@@ -69,8 +70,39 @@
 #define deassertDE()
 #endif
 
-// We only use SYS_PACK in this application
+// We only use SYS_PACK in this application, the low bits are flags
 #define	ICSC_SYS_PACK	0x58
+#define	ICSC_CRC16	0x01	// CRC16 instead of the 8 bit checksum
+#define	ICSC_SEQ	0x02	// first data byte is a sequence number, ACK requested
+#define	ICSC_ACK	0x04	// ACK, the only data byte is the acknowledged sequence number
+#define	ICSC_FLAGS	(ICSC_CRC16 | ICSC_SEQ | ICSC_ACK)
+
+#if defined(MY_RS485_CRC16)
+#define RS485_SYS_PACK (ICSC_SYS_PACK | ICSC_CRC16)
+#else
+#define RS485_SYS_PACK (ICSC_SYS_PACK)
+#endif
+
+#if defined(MY_RS485_ACK)
+#define RS485_RETRIES (3u)	// Retries if no ACK is received
+// ACK frame: SOH..., to, from, command, length, STX, seq, ETX, up to 2 checksum bytes, EOT; 10 bits per byte
+#define RS485_ACK_AIRTIME_MS ((MY_RS485_SOH_COUNT + 10) * 10000ul / MY_RS485_BAUD_RATE + 1)
+#define RS485_DUPLICATE_WINDOW_MS (1000ul)	// Same sequence number within this time is a retry
+#if defined(__linux__)
+#define RS485_SEQ_TABLE_SIZE (256u)	// Last sequence number per sender
+#else
+#define RS485_SEQ_TABLE_SIZE (8u)
+#endif
+#endif
+
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+#define RS485_RX_QUEUE_SIZE (MY_RX_MESSAGE_BUFFER_SIZE)
+#else
+#define RS485_RX_QUEUE_SIZE (1u)
+#endif
+#if RS485_RX_QUEUE_SIZE > 127
+#error MY_RX_MESSAGE_BUFFER_SIZE must not exceed 127
+#endif
 
 // Receiving header information
 char _header[6];
@@ -84,6 +116,8 @@ unsigned char _recStation;
 unsigned char _recSender;
 unsigned char _recCS;
 unsigned char _recCalcCS;
+uint16_t _recCRC;
+uint16_t _recCalcCRC;
 
 
 #if defined(__linux__)
@@ -96,9 +130,30 @@ AltSoftSerial _dev;
 
 unsigned char _nodeId;
 char _data[MY_RS485_MAX_MESSAGE_LENGTH];
-uint8_t _packet_len;
-unsigned char _packet_from;
-bool _packet_received;
+
+// Completed frames waiting for transportReceive()
+typedef struct {
+	uint8_t len;
+	char data[MY_RS485_MAX_MESSAGE_LENGTH];
+} rs485Frame_t;
+static rs485Frame_t _rxQueueStorage[RS485_RX_QUEUE_SIZE];
+static SPSCCircularBuffer<rs485Frame_t> _rxQueue(_rxQueueStorage, RS485_RX_QUEUE_SIZE);
+static uint32_t _rxDropped;
+static uint8_t _rxHighWater;
+
+#if defined(MY_RS485_ACK)
+// Link layer ACKs
+uint8_t _txSeq;
+bool _ackReceived;
+uint8_t _ackFrom;
+uint8_t _ackSeq;
+typedef struct {
+	uint8_t sender;
+	uint8_t seq;
+	uint32_t timestamp;
+} rs485Seq_t;
+static rs485Seq_t _rxSeq[RS485_SEQ_TABLE_SIZE];
+#endif
 
 // Packet wrapping characters, defined in standard ASCII table
 #define SOH 1
@@ -106,7 +161,18 @@ bool _packet_received;
 #define ETX 3
 #define EOT 4
 
+// SOH..., to, from, command, length, STX, [seq], data, ETX, checksum (1 or 2 bytes), EOT
+#define RS485_FRAME_OVERHEAD (MY_RS485_SOH_COUNT + 9)
 
+// CRC-16/MODBUS, reflected polynomial 0xA001
+static uint16_t _serialCrc16(uint16_t crc, const uint8_t data)
+{
+	crc ^= data;
+	for (uint8_t bit = 0; bit < 8; bit++) {
+		crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+	}
+	return crc;
+}
 
 //Reset the state machine and release the data pointer
 void _serialReset()
@@ -117,6 +183,163 @@ void _serialReset()
 	_recCommand = 0;
 	_recCS = 0;
 	_recCalcCS = 0;
+	_recCRC = 0;
+	_recCalcCRC = 0xFFFF;
+}
+
+// Write a complete frame with a single call, no collision detection
+bool _serialSendFrame(const uint8_t to, const uint8_t command, const bool sequenced,
+                      const uint8_t seq, const char *datap, const uint8_t len)
+{
+	// Build the whole frame first, it is written with a single call (one syscall on Linux)
+	uint8_t frame[RS485_FRAME_OVERHEAD + MY_RS485_MAX_MESSAGE_LENGTH];
+	uint8_t pos = 0;
+	// Start of header by writing multiple SOH
+	for(byte w=0; w<MY_RS485_SOH_COUNT; w++) {
+		frame[pos++] = SOH;
+	}
+	const uint8_t header = pos;
+	frame[pos++] = to;  // Destination address
+	frame[pos++] = _nodeId; // Source address
+	frame[pos++] = command;  // Command code
+	frame[pos++] = len + sequenced;      // Length of text
+	frame[pos++] = STX;      // Start of text
+	if (sequenced) {
+		frame[pos++] = seq;
+	}
+	if (len) {
+		(void)memcpy(&frame[pos], datap, len);      // Text bytes
+		pos += len;
+	}
+	// Checksum over addresses, command, length and text
+	uint16_t crc = 0xFFFF;
+	unsigned char cs = 0;
+	for (uint8_t i = header; i < pos; i++) {
+		if (i == header + 4) {
+			continue;	// STX
+		}
+		if (command & ICSC_CRC16) {
+			crc = _serialCrc16(crc, frame[i]);
+		} else {
+			cs += frame[i];
+		}
+	}
+	frame[pos++] = ETX;      // End of text
+	if (command & ICSC_CRC16) {
+		frame[pos++] = crc >> 8;
+		frame[pos++] = crc & 0xFF;
+	} else {
+		frame[pos++] = cs;
+	}
+	frame[pos++] = EOT;
+
+	assertDE();
+	const uint8_t *framep = frame;
+	while (pos) {
+		const size_t written = _dev.write(framep, pos);
+		if (!written || written > pos) {
+			// Write error
+			deassertDE();
+			return false;
+		}
+		framep += written;
+		pos -= written;
+	}
+
+#if defined(MY_RS485_DE_PIN)
+#ifdef __PIC32MX__
+	// MPIDE has nothing yet for this.  It uses the hardware buffer, which
+	// could be up to 8 levels deep.  For now, let's just delay for 8
+	// characters worth.
+	delayMicroseconds((F_CPU/9600)+1);
+#else
+#if defined(ARDUINO) && ARDUINO >= 100
+#if ARDUINO >= 104
+	// Arduino 1.0.4 and upwards does it right
+	_dev.flush();
+#else
+	// Between 1.0.0 and 1.0.3 it almost does it - need to compensate
+	// for the hardware buffer. Delay for 2 bytes worth of transmission.
+	_dev.flush();
+	delayMicroseconds((20000000UL/9600)+1);
+#endif
+#elif defined(__linux__)
+	_dev.flush();
+#endif
+#endif
+	deassertDE();
+#endif
+	return true;
+}
+
+#if defined(MY_RS485_ACK)
+// A retry of a frame that was received before, but whose ACK got lost?
+bool _serialIsDuplicate(const uint8_t sender, const uint8_t seq)
+{
+	const rs485Seq_t *entry = &_rxSeq[sender % RS485_SEQ_TABLE_SIZE];
+	return entry->sender == sender && entry->seq == seq &&
+	       hwMillis() - entry->timestamp < RS485_DUPLICATE_WINDOW_MS;
+}
+#endif
+
+// Hand a valid frame in _data to the ACK logic or the RX queue
+void _serialFrameReceived()
+{
+	if (_recCommand & ICSC_ACK) {
+#if defined(MY_RS485_ACK)
+		if (_recLen == 1) {
+			_ackFrom = _recSender;
+			_ackSeq = _data[0];
+			_ackReceived = true;
+		}
+#endif
+		return;
+	}
+	const char *datap = _data;
+	uint8_t len = _recLen;
+#if defined(MY_RS485_ACK)
+	uint8_t seq = 0;
+#endif
+	const bool sequenced = _recCommand & ICSC_SEQ;
+	if (sequenced) {
+		if (!len) {
+			return;
+		}
+#if defined(MY_RS485_ACK)
+		seq = *datap;
+		if (_serialIsDuplicate(_recSender, seq)) {
+			// Our ACK got lost, ACK again but do not deliver twice
+			(void)_serialSendFrame(_recSender, ICSC_SYS_PACK | ICSC_ACK | (_recCommand & ICSC_CRC16), true,
+			                       seq, NULL, 0);
+			return;
+		}
+#endif
+		// Skip the sequence number
+		datap++;
+		len--;
+	}
+	rs485Frame_t *frame = _rxQueue.getFront();
+	if (frame == NULL) {
+		// Queue full, not ACKed so the sender retries
+		_rxDropped++;
+		return;
+	}
+	frame->len = len;
+	(void)memcpy(frame->data, datap, len);
+	(void)_rxQueue.pushFront(frame);
+	if (_rxQueue.available() > _rxHighWater) {
+		_rxHighWater = _rxQueue.available();
+	}
+#if defined(MY_RS485_ACK)
+	if (sequenced && _recStation != BROADCAST_ADDRESS) {
+		rs485Seq_t *entry = &_rxSeq[_recSender % RS485_SEQ_TABLE_SIZE];
+		entry->sender = _recSender;
+		entry->seq = seq;
+		entry->timestamp = hwMillis();
+		(void)_serialSendFrame(_recSender, ICSC_SYS_PACK | ICSC_ACK | (_recCommand & ICSC_CRC16), true,
+		                       seq, NULL, 0);
+	}
+#endif
 }
 
 // This is the main reception state machine.  Progress through the states
@@ -145,12 +368,13 @@ bool _serialProcess()
 		// our ID or BROADCAST_ADDRESS, save the header information and progress to
 		// the next state.
 		case 0:
-			memcpy(&_header[0],&_header[1],5);
+			memmove(&_header[0],&_header[1],5);
 			_header[5] = inch;
 			if ((_header[0] == SOH) && (_header[5] == STX) &&
 			        ((_header[1] == (char)_nodeId) ||
 			         (_header[1] == (char)BROADCAST_ADDRESS && _header[2] != (char)_nodeId))) {
 				_recCalcCS = 0;
+				_recCalcCRC = 0xFFFF;
 				_recStation = _header[1];
 				_recSender = _header[2];
 				_recCommand = _header[3];
@@ -158,6 +382,7 @@ bool _serialProcess()
 
 				for (i=1; i<=4; i++) {
 					_recCalcCS += _header[i];
+					_recCalcCRC = _serialCrc16(_recCalcCRC, _header[i]);
 				}
 				_recPhase = 1;
 				_recPos = 0;
@@ -180,6 +405,7 @@ bool _serialProcess()
 		case 1:
 			_data[_recPos++] = inch;
 			_recCalcCS += inch;
+			_recCalcCRC = _serialCrc16(_recCalcCRC, inch);
 			if (_recPos == _recLen) {
 				_recPhase = 2;
 			}
@@ -197,9 +423,17 @@ bool _serialProcess()
 			break;
 
 		// Next comes the checksum.  We have already calculated it from the incoming
-		// data, so just store the incoming checksum byte for later.
+		// data, so just store the incoming checksum byte for later.  CRC16 frames
+		// carry two bytes, high byte first.  The format is taken from the flag bit
+		// of each frame, not from MY_RS485_CRC16, so a bus can mix both.
 		case 3:
 			_recCS = inch;
+			_recCRC = (uint8_t)inch << 8;
+			_recPhase = (_recCommand & ICSC_CRC16) ? 5 : 4;
+			break;
+
+		case 5:
+			_recCRC |= (uint8_t)inch;
 			_recPhase = 4;
 			break;
 
@@ -208,17 +442,15 @@ bool _serialProcess()
 		// Execute it if found.
 		case 4:
 			if (inch == EOT) {
-				if (_recCS == _recCalcCS) {
+				if ((_recCommand & ICSC_CRC16) ? _recCRC == _recCalcCRC : _recCS == _recCalcCS) {
 					// First, check for system level commands.  It is possible
 					// to register your own callback as well for system level
 					// commands which will be called after the system default
 					// hook.
 
-					switch (_recCommand) {
+					switch (_recCommand & ~ICSC_FLAGS) {
 					case ICSC_SYS_PACK:
-						_packet_from = _recSender;
-						_packet_len = _recLen;
-						_packet_received = true;
+						_serialFrameReceived();
 						break;
 					}
 				}
@@ -235,88 +467,80 @@ bool _serialProcess()
 
 bool transportSend(const uint8_t to, const void* data, const uint8_t len, const bool noACK)
 {
-	(void)noACK;	// not implemented
 	const char *datap = static_cast<char const *>(data);
 	unsigned char i;
-	unsigned char cs = 0;
-
-	// This is how many times to try and transmit before failing.
-	unsigned char timeout = 10;
 
-	// Let's start out by looking for a collision.  If there has been anything seen in
-	// the last millisecond, then wait for a random time and check again.
-
-	while (_serialProcess()) {
-		unsigned char del;
-		del = rand() % 20;
-		for (i = 0; i < del; i++) {
-			delay(1);
-			_serialProcess();
-		}
-		timeout--;
-		if (timeout == 0) {
-			// Failed to transmit!!!
-			return false;
-		}
-	}
-
-	assertDE();
-
-	// Start of header by writing multiple SOH
-	for(byte w=0; w<MY_RS485_SOH_COUNT; w++) {
-		_dev.write(SOH);
-	}
-	_dev.write(to);  // Destination address
-	cs += to;
-	_dev.write(_nodeId); // Source address
-	cs += _nodeId;
-	_dev.write(ICSC_SYS_PACK);  // Command code
-	cs += ICSC_SYS_PACK;
-	_dev.write(len);      // Length of text
-	cs += len;
-	_dev.write(STX);      // Start of text
-	for(i=0; i<len; i++) {
-		_dev.write(datap[i]);      // Text bytes
-		cs += datap[i];
-	}
-	_dev.write(ETX);      // End of text
-	_dev.write(cs);
-	_dev.write(EOT);
-
-#if defined(MY_RS485_DE_PIN)
-#ifdef __PIC32MX__
-	// MPIDE has nothing yet for this.  It uses the hardware buffer, which
-	// could be up to 8 levels deep.  For now, let's just delay for 8
-	// characters worth.
-	delayMicroseconds((F_CPU/9600)+1);
-#else
-#if defined(ARDUINO) && ARDUINO >= 100
-#if ARDUINO >= 104
-	// Arduino 1.0.4 and upwards does it right
-	_dev.flush();
+#if defined(MY_RS485_ACK)
+	const bool requestACK = !noACK && to != BROADCAST_ADDRESS;
+	const uint8_t retries = requestACK ? RS485_RETRIES + 1 : 1;
+	const uint8_t seq = ++_txSeq;
 #else
-	// Between 1.0.0 and 1.0.3 it almost does it - need to compensate
-	// for the hardware buffer. Delay for 2 bytes worth of transmission.
-	_dev.flush();
-	delayMicroseconds((20000000UL/9600)+1);
-#endif
-#elif defined(__linux__)
-	_dev.flush();
+	(void)noACK;	// needs MY_RS485_ACK on the whole bus
+	const bool requestACK = false;
+	const uint8_t retries = 1;
+	const uint8_t seq = 0;
 #endif
+	// Receivers drop frames of MY_RS485_MAX_MESSAGE_LENGTH and more
+	if (len + requestACK >= MY_RS485_MAX_MESSAGE_LENGTH) {
+		return false;
+	}
+	for (uint8_t attempt = 0; attempt < retries; attempt++) {
+		// This is how many times to try and transmit before failing.
+		unsigned char timeout = 10;
+
+		// Let's start out by looking for a collision.  If there has been anything seen in
+		// the last millisecond, then wait for a random time and check again.
+
+		while (_serialProcess()) {
+			unsigned char del;
+			del = rand() % 20;
+			for (i = 0; i < del; i++) {
+				delay(1);
+				_serialProcess();
+			}
+			timeout--;
+			if (timeout == 0) {
+				// Failed to transmit!!!
+				return false;
+			}
+		}
+
+#if defined(MY_RS485_ACK)
+		_ackReceived = false;
 #endif
-	deassertDE();
+		if (!_serialSendFrame(to, RS485_SYS_PACK | (requestACK ? ICSC_SEQ : 0), requestACK, seq,
+		                      datap, len)) {
+			return false;
+		}
+		if (!requestACK) {
+			return true;
+		}
+#if defined(MY_RS485_ACK)
+		const uint32_t enterMS = hwMillis();
+		while (hwMillis() - enterMS < RS485_ACK_AIRTIME_MS + MY_RS485_ACK_TIMEOUT_MS) {
+			(void)_serialProcess();
+			if (_ackReceived && _ackFrom == to && _ackSeq == seq) {
+				return true;
+			}
+			doYield();
+		}
 #endif
-	return true;
+	}
+	return false;
 }
 
-
-
 bool transportInit(void)
 {
 	// Reset the state machine
 	_dev.begin(MY_RS485_BAUD_RATE);
 	_serialReset();
 	_nodeId = AUTO;
+	_rxQueue.clear();
+#if defined(MY_RS485_ACK)
+	for (uint16_t i = 0; i < RS485_SEQ_TABLE_SIZE; i++) {
+		_rxSeq[i].sender = BROADCAST_ADDRESS;
+	}
+#endif
 #if defined(MY_RS485_DE_PIN)
 	hwPinMode(MY_RS485_DE_PIN, OUTPUT);
 	deassertDE();
@@ -338,7 +562,7 @@ uint8_t transportGetAddress(void)
 bool transportDataAvailable(void)
 {
 	_serialProcess();
-	return _packet_received;
+	return !_rxQueue.empty();
 }
 
 bool transportSanityCheck(void)
@@ -349,15 +573,24 @@ bool transportSanityCheck(void)
 
 uint8_t transportReceive(void* data)
 {
-	if (_packet_received) {
-		memcpy(data,_data,_packet_len);
-		_packet_received = false;
-		return _packet_len;
-	} else {
+	const rs485Frame_t *frame = _rxQueue.getBack();
+	if (frame == NULL) {
 		return (0);
 	}
+	const uint8_t len = frame->len;
+	memcpy(data, frame->data, len);
+	(void)_rxQueue.popBack();
+	return len;
 }
 
+#if defined(MY_RX_MESSAGE_BUFFER_FEATURE)
+void transportGetRxQueueStats(char *buf)
+{
+	(void)snprintf(buf, MAX_PAYLOAD_SIZE + 1, "D=%" PRIu32 ",H=%u,S=%u", _rxDropped,
+	               (unsigned)_rxHighWater, (unsigned)RS485_RX_QUEUE_SIZE);
+}
+#endif
+
 void transportPowerDown(void)
 {
 	// Nothing to shut down here
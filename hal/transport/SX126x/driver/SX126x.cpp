@@ -91,6 +91,10 @@ static bool SX126x_initialise()
 	SX126x.powerLevel = 0;
 	SX126x.targetRSSI = MY_SX126x_ATC_TARGET_DBM;
 	SX126x.ATCenabled = false;
+	for (uint8_t i = 0; i < SX126x_RTT_PEERS; i++) {
+		SX126x.RTT[i].address = SX126x_BROADCAST_ADDRESS;
+	}
+	SX126x.RTTnext = 0;
 
 	SX126x_sleep();
 	SX126x_wakeUp();
@@ -489,8 +493,9 @@ static bool SX126x_sendWithRetry(const uint8_t recipient, const void *buffer,
 		if (noACK) {
 			return true;
 		}
-		uint32_t start = hwMillis();
-		while (hwMillis() < start + SX126x_RETRY_TIMEOUT_MS) {
+		const uint32_t start = hwMillis();
+		const uint32_t timeoutMS = SX126x_getACKTimeout(recipient, retry);
+		while (hwMillis() - start < timeoutMS) {
 			SX126x_handle();
 			if (SX126x.ackReceived) {
 				SX126x.ackReceived = false;
@@ -505,23 +510,27 @@ static bool SX126x_sendWithRetry(const uint8_t recipient, const void *buffer,
 					if (SX126x.ATCenabled) {
 						SX126x_ATC();
 					}
+					// Karn: the ACK of a retry could belong to any of the attempts
+					if (!retry) {
+						SX126x_updateRTT(recipient, hwMillis() - start);
+					}
 					return true;
 				}
 			}
 			doYield();
 		}
 		SX126x_DEBUG(PSTR("!SX126x:SWR:NACK\n"));
+		// random backoff of up to one packet air time, so colliding senders drift apart
 		const uint32_t enterCSMAMS = hwMillis();
-		const uint16_t randDelayCSMA = start % 100;
+		const uint32_t randDelayCSMA = random(SX126x_getTimeOnAir(bufferSize + SX126x_HEADER_LEN) + 1);
 		while (hwMillis() - enterCSMAMS < randDelayCSMA) {
 			doYield();
 		}
 		if (SX126x.ATCenabled) {
 			SX126x_txPower(SX126x.powerLevel + 2); //increase power, maybe we are far away from gateway
 		}
-		return false;
 	}
-
+	return false;
 }
 
 static bool SX126x_send(const uint8_t recipient, uint8_t *data, const uint8_t len,
@@ -607,6 +616,71 @@ static void SX126x_rx()
 	SX126x.radioMode = SX126x_MODE_RX;
 }
 
+// time on air, see SX1261/2 datasheet 6.1.4
+static uint32_t SX126x_getTimeOnAir(const uint8_t length)
+{
+	static const uint32_t bandwidthHz[] PROGMEM = {
+		7810ul, 15630ul, 31250ul, 62500ul, 125000ul, 250000ul, 500000ul, 0ul, 10420ul, 20830ul, 41670ul
+	};
+	const uint8_t spreadingFactor = MY_SX126x_LORA_SF;
+	const uint32_t symbolUS = ((1ul << spreadingFactor) * 1000000ul) / pgm_read_dword(
+	                              &bandwidthHz[MY_SX126x_LORA_BW]);
+	// explicit header (20 bits) and CRC (16 bits) are on, low data rate optimization is off.
+	// SF5 and SF6 use a longer preamble and drop the 8 extra bits of the other spreading factors
+	const bool shortSymbols = spreadingFactor < LORA_SF7;
+	const int16_t payloadBits = 8 * length - 4 * spreadingFactor + 16 + 20 + (shortSymbols ? 0 : 8);
+	const uint8_t bitsPerSymbol = 4 * spreadingFactor;
+	uint16_t symbols = SX126x_PREAMBLE_LENGTH + 8;
+	if (payloadBits > 0) {
+		symbols += ((payloadBits + bitsPerSymbol - 1) / bitsPerSymbol) * (MY_SX126x_LORA_CR + 4);
+	}
+	// preamble takes another 4.25 (SF5/6: 6.25) symbols
+	return ((symbols * 4ul + (shortSymbols ? 25 : 17)) * symbolUS / 4 + 999) / 1000;
+}
+
+static uint32_t SX126x_getACKTimeout(const uint8_t recipient, const uint8_t retry)
+{
+#if defined(SX126x_RETRY_TIMEOUT_MS)
+	(void)recipient;
+	(void)retry;
+	return SX126x_RETRY_TIMEOUT_MS;
+#else
+	// the ACK cannot be faster than its own air time plus the turnaround of the recipient
+	const uint32_t minimumMS = SX126x_getTimeOnAir(SX126x_HEADER_LEN + sizeof(sx126x_ack_t)) +
+	                           SX126x_ACK_TURNAROUND_MS;
+	uint32_t timeoutMS = 2 * minimumMS;
+	for (uint8_t i = 0; i < SX126x_RTT_PEERS; i++) {
+		if (SX126x.RTT[i].address == recipient) {
+			// RTO = SRTT + 4 * RTTVAR (RFC 6298)
+			timeoutMS = max((SX126x.RTT[i].SRTT >> 3) + SX126x.RTT[i].RTTVAR, minimumMS);
+			break;
+		}
+	}
+	// exponential backoff, the link might be congested
+	return timeoutMS << min(retry, (uint8_t)3u);
+#endif
+}
+
+static void SX126x_updateRTT(const uint8_t address, const uint32_t RTT)
+{
+	for (uint8_t i = 0; i < SX126x_RTT_PEERS; i++) {
+		sx126x_RTT_t *entry = &SX126x.RTT[i];
+		if (entry->address == address) {
+			// SRTT += (RTT - SRTT) / 8, RTTVAR += (|RTT - SRTT| - RTTVAR) / 4
+			const int32_t delta = (int32_t)RTT - (int32_t)(entry->SRTT >> 3);
+			entry->SRTT += delta;
+			entry->RTTVAR += (delta < 0 ? -delta : delta) - (int32_t)(entry->RTTVAR >> 2);
+			return;
+		}
+	}
+	// first measurement: SRTT = RTT, RTTVAR = RTT / 2
+	sx126x_RTT_t *entry = &SX126x.RTT[SX126x.RTTnext];
+	SX126x.RTTnext = (SX126x.RTTnext + 1) % SX126x_RTT_PEERS;
+	entry->address = address;
+	entry->SRTT = RTT << 3;
+	entry->RTTVAR = RTT << 1;
+}
+
 static bool SX126x_cad()
 {
 	sx126x_cadParameters_t cadParameters;
@@ -138,14 +138,10 @@
 #define SX126x_PACKET_HEADER_VERSION (1u)     //!< SX126x packet header version
 #define SX126x_MIN_PACKET_HEADER_VERSION (1u) //!< Minimal SX126x packet header version
 
-#if !defined(SX126x_RETRY_TIMEOUT_MS)
-// air-time approximation for timeout, 1 hop ~15 bytes payload - adjust if needed
-// BW125/SF128: 50ms
-// BW500/SF128: 15ms
-// BW31.25/SF512: 900ms
-// BW125/SF4096: 1500ms
-#define SX126x_RETRY_TIMEOUT_MS (500ul) //!< Timeout for ACK, adjustments needed if modem configuration changed (air time different)
-#endif
+// ACK timeouts are derived from the air time of the modem configuration and a smoothed
+// round trip time per peer. Define SX126x_RETRY_TIMEOUT_MS to use a fixed timeout instead.
+#define SX126x_RTT_PEERS (4u)          //!< Number of peers with a round trip time estimate
+#define SX126x_ACK_TURNAROUND_MS (20u) //!< Allowance for the recipient to process a packet and start the ACK
 
 #if !defined(MY_SX126x_TX_TIMEOUT_MS)
 #define MY_SX126x_TX_TIMEOUT_MS                 (5*1000ul)		//!< TX timeout
@@ -524,6 +520,15 @@ typedef struct {
 	sx126x_SNR_t SNR;	//!< SNR of current packet
 } __attribute__((packed)) sx126x_packet_t;
 
+/**
+ * @brief Round trip time estimate of a peer (Jacobson/Karels)
+ */
+typedef struct {
+	uint8_t address;						  //!< Peer address
+	uint32_t SRTT;							  //!< Smoothed round trip time, 1/8 ms
+	uint32_t RTTVAR;						  //!< Round trip time variation, 1/4 ms
+} sx126x_RTT_t;
+
 /**
  * @brief SX126x internal variables
  */
@@ -535,6 +540,8 @@ typedef struct {
 	sx126x_radioModes_t radioMode;			  //!< Current radio mode
 	sx126x_powerLevel_t targetRSSI;           //!< ATC target power level
 	bool ATCenabled;                          //!< ATC enabled
+	sx126x_RTT_t RTT[SX126x_RTT_PEERS];       //!< Round trip time estimates
+	uint8_t RTTnext;                          //!< Next RTT entry to replace
 	bool channelActive : 1;					  //!< SX126x_cadDetected
 	bool channelFree : 1;                     //!< SX126x_cadDone
 	volatile bool ackReceived : 1;			  //!< ACK received
@@ -753,6 +760,28 @@ static void SX126x_tx();
  */
 static void SX126x_rx();
 
+/**
+ * @brief Calculates the time on air of a packet with the configured modem settings
+ * @param length packet length including header
+ * @return time on air in ms
+ */
+static uint32_t SX126x_getTimeOnAir(const uint8_t length);
+
+/**
+ * @brief Gets the time to wait for an ACK
+ * @param recipient recipient of the packet
+ * @param retry number of previous attempts, the timeout doubles with each
+ * @return timeout in ms
+ */
+static uint32_t SX126x_getACKTimeout(const uint8_t recipient, const uint8_t retry);
+
+/**
+ * @brief Adds a round trip time measurement to the estimate of a peer
+ * @param address peer address
+ * @param RTT round trip time in ms
+ */
+static void SX126x_updateRTT(const uint8_t address, const uint32_t RTT);
+
 /**
  * @brief Scans channel for activity
  * @return true, if channel is free, false if there is activity on channel
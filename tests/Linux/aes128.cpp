@@ -0,0 +1,461 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+// Known answer tests of the generic AES128, run once per block kernel: the T-table one, and
+// the AES instruction one the runtime dispatch picks when the CPU has it.
+// - FIPS-197 example vectors and key expansion, SP 800-38A CBC-AES128 vectors;
+// - random keys and blocks through both kernels;
+// - ciphertext stealing of the transport HAL: every frame length 16..32 against CBC-CS2 built
+//   from plain CBC, decrypted in a buffer of exactly the frame length;
+// - messages of every payload length through transportHALSend() and transportHALReceive(),
+//   nothing written past the received message.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MY_TRANSPORT_ENCRYPTION
+#define MY_ENCRYPTION_CIPHERTEXT_STEALING
+#define MY_ENCRYPTION_SIMPLE_PASSWD "0123456789abcdef"
+
+#include "MyConfig.h"
+#include "core/MySensorsCore.h"
+#include "core/MyIndication.h"
+#include "core/MyHelperFunctions.cpp"
+#include "core/MyMessage.cpp"
+#include "hal/architecture/Linux/drivers/core/noniso.cpp"
+#include "hal/crypto/generic/MyCryptoGeneric.cpp"
+#include "hal/transport/MyTransportHAL.h"
+#include "unit_test.h"
+
+static uint8_t simFrame[64];
+static uint8_t simFrameLength;
+static uint32_t simIndications[INDICATION_ERR_START + 32];
+
+void setIndication(const indication_t ind)
+{
+	simIndications[ind]++;
+}
+
+// random() of the Linux Arduino.h
+long randMax(long howbig)
+{
+	return (long)(unitTestRandom() % (uint32_t)howbig);
+}
+
+// Radio driver: a frame sent is the next one received
+static bool transportInit(void)
+{
+	return true;
+}
+
+static bool transportSend(const uint8_t to, const void *data, const uint8_t len, const bool noACK)
+{
+	(void)to;
+	(void)noACK;
+	(void)memcpy((void *)simFrame, data, len);
+	simFrameLength = len;
+	return true;
+}
+
+static uint8_t transportReceive(void *data)
+{
+	(void)memcpy(data, (const void *)simFrame, simFrameLength < MAX_MESSAGE_SIZE ? simFrameLength :
+	             MAX_MESSAGE_SIZE);
+	return simFrameLength;
+}
+
+static void transportSetAddress(const uint8_t address)
+{
+	(void)address;
+}
+
+static uint8_t transportGetAddress(void)
+{
+	return 0;
+}
+
+static bool transportDataAvailable(void)
+{
+	return simFrameLength != 0;
+}
+
+static bool transportSanityCheck(void)
+{
+	return true;
+}
+
+static void transportPowerDown(void) {}
+static void transportPowerUp(void) {}
+static void transportSleep(void) {}
+static void transportStandBy(void) {}
+
+static int16_t transportGetSendingRSSI(void)
+{
+	return INVALID_RSSI;
+}
+
+static int16_t transportGetReceivingRSSI(void)
+{
+	return INVALID_RSSI;
+}
+
+static int16_t transportGetSendingSNR(void)
+{
+	return INVALID_SNR;
+}
+
+static int16_t transportGetReceivingSNR(void)
+{
+	return INVALID_SNR;
+}
+
+static int16_t transportGetTxPowerPercent(void)
+{
+	return INVALID_PERCENT;
+}
+
+static bool transportSetTxPowerPercent(const uint8_t powerPercent)
+{
+	(void)powerPercent;
+	return false;
+}
+
+static int16_t transportGetTxPowerLevel(void)
+{
+	return INVALID_LEVEL;
+}
+
+#include "hal/transport/MyTransportHAL.cpp"
+
+static bool sameHex(const uint8_t *data, const char *hex, const size_t length)
+{
+	for (size_t i = 0; i < length; i++) {
+		unsigned int value;
+		if (sscanf(&hex[2 * i], "%2x", &value) != 1 || data[i] != value) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void fromHex(uint8_t *dest, const char *hex, const size_t length)
+{
+	for (size_t i = 0; i < length; i++) {
+		unsigned int value = 0;
+		(void)sscanf(&hex[2 * i], "%2x", &value);
+		dest[i] = (uint8_t)value;
+	}
+}
+
+static void randomBytes(uint8_t *dest, const size_t length)
+{
+	for (size_t i = 0; i < length; i++) {
+		dest[i] = (uint8_t)unitTestRandom();
+	}
+}
+
+// Switches a context to the table kernel or the instruction kernel, false if the CPU lacks it
+static bool useKernel(AES128Context_t *ctx, const bool hw)
+{
+#if defined(AES128_HW_DISPATCH)
+	if (hw && !AES128HwAvailable()) {
+		return false;
+	}
+	if (ctx->hw != hw) {
+		// The instruction kernel takes the round keys as bytes, the table kernel as words
+		for (uint8_t i = 0; i < 4 * (AES128_ROUNDS + 1); i++) {
+			if (hw) {
+				AES128store32((uint8_t *)&ctx->encKeys[i], ctx->encKeys[i]);
+				AES128store32((uint8_t *)&ctx->decKeys[i], ctx->decKeys[i]);
+			} else {
+				ctx->encKeys[i] = AES128load32((const uint8_t *)&ctx->encKeys[i]);
+				ctx->decKeys[i] = AES128load32((const uint8_t *)&ctx->decKeys[i]);
+			}
+		}
+		ctx->hw = hw;
+	}
+	return true;
+#else
+	(void)ctx;
+	return !hw;
+#endif
+}
+
+static bool currentHw;
+
+static void initKernel(AES128Context_t *ctx, const uint8_t *key)
+{
+	AES128Init(ctx, key);
+	TEST_ASSERT(useKernel(ctx, currentHw));
+}
+
+static const struct {
+	const char *key;
+	const char *plain;
+	const char *cipher;
+} fipsVectors[] = {
+	// FIPS-197 appendix B
+	{ "2b7e151628aed2a6abf7158809cf4f3c", "3243f6a8885a308d313198a2e0370734", "3925841d02dc09fbdc118597196a0b32" },
+	// FIPS-197 appendix C.1
+	{ "000102030405060708090a0b0c0d0e0f", "00112233445566778899aabbccddeeff", "69c4e0d86a7b0430d8cdb78070b4c55a" },
+	// SP 800-38A F.1.1 ECB-AES128 block 1
+	{ "2b7e151628aed2a6abf7158809cf4f3c", "6bc1bee22e409f96e93d7e117393172a", "3ad77bb40d7a3660a89ecaf32466ef97" },
+};
+
+static void testFips(void)
+{
+	for (size_t v = 0; v < sizeof(fipsVectors) / sizeof(fipsVectors[0]); v++) {
+		AES128Context_t ctx;
+		uint8_t key[16], plain[16], block[16];
+		fromHex(key, fipsVectors[v].key, sizeof(key));
+		fromHex(plain, fipsVectors[v].plain, sizeof(plain));
+		initKernel(&ctx, key);
+
+		AES128EncryptBlock(&ctx, block, plain);
+		TEST_ASSERT(sameHex(block, fipsVectors[v].cipher, sizeof(block)));
+		AES128DecryptBlock(&ctx, block, block);
+		TEST_ASSERT(!memcmp(block, plain, sizeof(block)));
+
+		// In place
+		(void)memcpy((void *)block, (const void *)plain, sizeof(block));
+		AES128EncryptBlock(&ctx, block, block);
+		TEST_ASSERT(sameHex(block, fipsVectors[v].cipher, sizeof(block)));
+	}
+}
+
+static void testKeyExpansion(void)
+{
+	// FIPS-197 appendix A.1, first and last round key
+	uint8_t key[16];
+	fromHex(key, "2b7e151628aed2a6abf7158809cf4f3c", sizeof(key));
+	AES128Context_t ctx;
+	AES128Init(&ctx, key);
+	TEST_ASSERT(useKernel(&ctx, false));
+	const uint32_t first[4] = { 0x2b7e1516, 0x28aed2a6, 0xabf71588, 0x09cf4f3c };
+	const uint32_t last[4] = { 0xd014f9a8, 0xc9ee2589, 0xe13f0cc8, 0xb6630ca6 };
+	for (uint8_t i = 0; i < 4; i++) {
+		TEST_ASSERT(ctx.encKeys[i] == first[i]);
+		TEST_ASSERT(ctx.encKeys[4 * AES128_ROUNDS + i] == last[i]);
+		// The equivalent inverse cipher starts with the last round key
+		TEST_ASSERT(ctx.decKeys[i] == last[i]);
+		TEST_ASSERT(ctx.decKeys[4 * AES128_ROUNDS + i] == first[i]);
+	}
+}
+
+// SP 800-38A F.2.1/F.2.2 CBC-AES128
+static const char *cbcKey = "2b7e151628aed2a6abf7158809cf4f3c";
+static const char *cbcIV = "000102030405060708090a0b0c0d0e0f";
+static const char *cbcPlain =
+    "6bc1bee22e409f96e93d7e117393172aae2d8a571e03ac9c9eb76fac45af8e51"
+    "30c81c46a35ce411e5fbc1191a0a52eff69f2445df4f9b17ad2b417be66c3710";
+static const char *cbcCipher =
+    "7649abac8119b246cee98e9b12e9197d5086cb9b507219ee95db113a917678b2"
+    "73bed6b8e3c1743b7116e69e222295163ff1caa1681fac09120eca307586e1a7";
+
+static void testCbc(void)
+{
+	AES128Context_t ctx;
+	uint8_t key[16], iv[16], buffer[64];
+	fromHex(key, cbcKey, sizeof(key));
+	initKernel(&ctx, key);
+
+	fromHex(iv, cbcIV, sizeof(iv));
+	fromHex(buffer, cbcPlain, sizeof(buffer));
+	AES128EncryptCBC(&ctx, iv, buffer, 4);
+	TEST_ASSERT(sameHex(buffer, cbcCipher, sizeof(buffer)));
+	TEST_ASSERT(!memcmp(iv, &buffer[48], sizeof(iv)));
+
+	fromHex(iv, cbcIV, sizeof(iv));
+	AES128DecryptCBC(&ctx, iv, buffer, 4);
+	TEST_ASSERT(sameHex(buffer, cbcPlain, sizeof(buffer)));
+	TEST_ASSERT(sameHex(iv, &cbcCipher[96], sizeof(iv)));
+
+	// Chained through the IV across calls
+	fromHex(iv, cbcIV, sizeof(iv));
+	fromHex(buffer, cbcPlain, sizeof(buffer));
+	AES128EncryptCBC(&ctx, iv, buffer, 1);
+	AES128EncryptCBC(&ctx, iv, &buffer[16], 3);
+	TEST_ASSERT(sameHex(buffer, cbcCipher, sizeof(buffer)));
+	fromHex(iv, cbcIV, sizeof(iv));
+	AES128DecryptCBC(&ctx, iv, buffer, 3);
+	AES128DecryptCBC(&ctx, iv, &buffer[48], 1);
+	TEST_ASSERT(sameHex(buffer, cbcPlain, sizeof(buffer)));
+
+	// MyCryptoHAL interface
+	AES128CBCInit(key);
+	TEST_ASSERT(useKernel(&_aes, currentHw));
+	fromHex(iv, cbcIV, sizeof(iv));
+	fromHex(buffer, cbcPlain, sizeof(buffer));
+	AES128CBCEncrypt(iv, buffer, sizeof(buffer));
+	TEST_ASSERT(sameHex(buffer, cbcCipher, sizeof(buffer)));
+	fromHex(iv, cbcIV, sizeof(iv));
+	AES128CBCDecrypt(iv, buffer, sizeof(buffer));
+	TEST_ASSERT(sameHex(buffer, cbcPlain, sizeof(buffer)));
+}
+
+// Frames of every length through the transport HAL ciphertext stealing, checked against CBC-CS2
+// built from CBC of the zero padded frame: all but the last two blocks, the last block, then the
+// penultimate block truncated to the length of the last one
+static void testCiphertextStealing(void)
+{
+	uint8_t key[16];
+	randomBytes(key, sizeof(key));
+	AES128CBCInit(key);
+	TEST_ASSERT(useKernel(&_aes, currentHw));
+
+	for (uint16_t round = 0; round < 64; round++) {
+		for (uint8_t length = TRANSPORT_HAL_AES_BLOCK_SIZE; length <= MAX_MESSAGE_SIZE; length++) {
+			uint8_t plain[MAX_MESSAGE_SIZE], frame[MAX_MESSAGE_SIZE], cbc[MAX_MESSAGE_SIZE];
+			const uint8_t blocks = (length + TRANSPORT_HAL_AES_BLOCK_SIZE - 1) / TRANSPORT_HAL_AES_BLOCK_SIZE;
+			const uint8_t last = length - (blocks - 1) * TRANSPORT_HAL_AES_BLOCK_SIZE;
+			randomBytes(plain, length);
+
+			(void)memcpy((void *)frame, (const void *)plain, length);
+			transportHALEncryptCTS(frame, length);
+
+			uint8_t iv[16] = { 0 };
+			(void)memset((void *)cbc, 0, sizeof(cbc));
+			(void)memcpy((void *)cbc, (const void *)plain, length);
+			AES128CBCEncrypt(iv, cbc, blocks * TRANSPORT_HAL_AES_BLOCK_SIZE);
+			if (last == TRANSPORT_HAL_AES_BLOCK_SIZE) {
+				TEST_ASSERT(!memcmp(frame, cbc, length));
+			} else {
+				const uint8_t penultimate = (blocks - 2) * TRANSPORT_HAL_AES_BLOCK_SIZE;
+				TEST_ASSERT(!memcmp(frame, cbc, penultimate));
+				TEST_ASSERT(!memcmp(&frame[penultimate], &cbc[penultimate + TRANSPORT_HAL_AES_BLOCK_SIZE],
+				                    TRANSPORT_HAL_AES_BLOCK_SIZE));
+				TEST_ASSERT(!memcmp(&frame[penultimate + TRANSPORT_HAL_AES_BLOCK_SIZE], &cbc[penultimate],
+				                    last));
+			}
+
+			// Decrypted in place in a buffer of exactly the frame length, overruns hit the sanitizer
+			uint8_t *exact = (uint8_t *)malloc(length);
+			(void)memcpy((void *)exact, (const void *)frame, length);
+			transportHALDecryptCTS(exact, length);
+			TEST_ASSERT(!memcmp(exact, plain, length));
+			free(exact);
+		}
+	}
+}
+
+// The received message sits in front of a guard that must survive decryption
+typedef struct {
+	MyMessage msg;
+	uint8_t guard[16];
+} guarded_message_t;
+
+static void testSendReceive(void)
+{
+	uint8_t key[16];
+	randomBytes(key, sizeof(key));
+	AES128CBCInit(key);
+	TEST_ASSERT(useKernel(&_aes, currentHw));
+
+	for (uint16_t round = 0; round < 64; round++) {
+		for (uint8_t length = 0; length <= MAX_PAYLOAD_SIZE; length++) {
+			MyMessage sent;
+			uint8_t payload[MAX_PAYLOAD_SIZE];
+			randomBytes(payload, sizeof(payload));
+			sent.clear();
+			sent.setSender(1);
+			sent.setDestination(0);
+			sent.setLast(1);
+			sent.setSensor(length);
+			sent.setCommand(C_SET);
+			sent.setType(V_CUSTOM);
+			sent.set(payload, length);
+			const uint8_t messageLength = HEADER_SIZE + length;
+			TEST_ASSERT(transportHALSend(0, &sent, messageLength, false));
+			TEST_ASSERT(simFrameLength == (messageLength > TRANSPORT_HAL_AES_BLOCK_SIZE ? messageLength :
+			                               TRANSPORT_HAL_AES_BLOCK_SIZE));
+
+			guarded_message_t received;
+			(void)memset((void *)&received, 0x5A, sizeof(received));
+			uint8_t receivedLength = 0;
+			TEST_ASSERT(transportHALReceive(&received.msg, &receivedLength));
+			TEST_ASSERT(receivedLength == length);
+			TEST_ASSERT(!memcmp(&received.msg.last, &sent.last, messageLength));
+			for (uint8_t i = 0; i < sizeof(received.guard); i++) {
+				TEST_ASSERT(received.guard[i] == 0x5A);
+			}
+		}
+	}
+
+	// Frames shorter than a block or longer than any message are rejected before decryption
+	const uint32_t lengthErrors = simIndications[INDICATION_ERR_LENGTH];
+	guarded_message_t received;
+	uint8_t receivedLength;
+	simFrameLength = TRANSPORT_HAL_AES_BLOCK_SIZE - 1;
+	TEST_ASSERT(!transportHALReceive(&received.msg, &receivedLength));
+	simFrameLength = MAX_MESSAGE_SIZE + 1;
+	(void)memset((void *)&received, 0x5A, sizeof(received));
+	TEST_ASSERT(!transportHALReceive(&received.msg, &receivedLength));
+	TEST_ASSERT(simIndications[INDICATION_ERR_LENGTH] == lengthErrors + 2);
+	for (uint8_t i = 0; i < sizeof(received.guard); i++) {
+		TEST_ASSERT(received.guard[i] == 0x5A);
+	}
+}
+
+static void testKernelsAgree(void)
+{
+	AES128Context_t table, hw;
+	uint8_t key[16], plain[16], a[16], b[16];
+	for (uint16_t round = 0; round < 2000; round++) {
+		randomBytes(key, sizeof(key));
+		randomBytes(plain, sizeof(plain));
+		AES128Init(&table, key);
+		AES128Init(&hw, key);
+		TEST_ASSERT(useKernel(&table, false));
+		TEST_ASSERT(useKernel(&hw, true));
+		AES128EncryptBlock(&table, a, plain);
+		AES128EncryptBlock(&hw, b, plain);
+		TEST_ASSERT(!memcmp(a, b, sizeof(a)));
+		AES128DecryptBlock(&table, a, plain);
+		AES128DecryptBlock(&hw, b, plain);
+		TEST_ASSERT(!memcmp(a, b, sizeof(a)));
+	}
+}
+
+static void testKernel(const char *name, const bool hw)
+{
+	printf("  %s kernel\n", name);
+	currentHw = hw;
+	unitTestSeed(1);
+	TEST_RUN(testFips);
+	TEST_RUN(testKeyExpansion);
+	TEST_RUN(testCbc);
+	TEST_RUN(testCiphertextStealing);
+	TEST_RUN(testSendReceive);
+}
+
+int main(void)
+{
+	printf("AES128\n");
+	testKernel("T-table", false);
+#if defined(AES128_HW_DISPATCH)
+	if (AES128HwAvailable()) {
+		testKernel("AES instruction", true);
+		TEST_RUN(testKernelsAgree);
+	} else {
+		printf("  no AES instructions on this CPU, instruction kernel not tested\n");
+	}
+#endif
+	return unitTestResult();
+}
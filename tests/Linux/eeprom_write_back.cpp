@@ -0,0 +1,283 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+// Host test of the EEPROMWriteBack commit policy against a simulated flash EEPROM and a fake
+// clock, serviced the way the ESP8266/ESP32 HALs do it: hwWriteConfigBlock() writes, the main
+// loop calls process() every few ms, hwReboot() and sleep call flush().
+// - deferral: nothing reaches flash before the idle delay;
+// - coalescing: a burst of writes costs one commit, unchanged values none;
+// - maximum delay: steady writes are still committed in time;
+// - flush on commit: flush() commits pending writes at once and is a no-op when clean;
+// - write-through with delay 0, retry of failed commits, millis() wraparound.
+
+#include <stdint.h>
+#include <string.h>
+
+#include "drivers/EEPROMWriteBack/EEPROMWriteBack.h"
+#include "unit_test.h"
+
+#define EEPROM_SIZE (1024u)
+#define COMMIT_DELAY_MS (1000u)	// MY_EEPROM_COMMIT_DELAY_MS default
+#define COMMIT_MAX_DELAY_MS (10000u)	// MY_EEPROM_COMMIT_MAX_DELAY_MS default
+#define LOOP_MS (10u)	// Main loop period calling process()
+
+// ESP EEPROM library: RAM copy, commit() erases the sector and writes the copy back
+class SimulatedEEPROM
+{
+public:
+	SimulatedEEPROM(void) : commits(0), failCommits(0)
+	{
+		(void)memset(ram, 0xFF, sizeof(ram));
+		(void)memset(flash, 0xFF, sizeof(flash));
+	}
+	uint8_t read(int addr)
+	{
+		return ram[addr];
+	}
+	void write(int addr, uint8_t value)
+	{
+		ram[addr] = value;
+	}
+	bool commit(void)
+	{
+		if (failCommits) {
+			failCommits--;
+			return false;
+		}
+		commits++;
+		(void)memcpy(flash, ram, sizeof(flash));
+		return true;
+	}
+	bool committed(void) const
+	{
+		return !memcmp(ram, flash, sizeof(flash));
+	}
+	uint32_t commits;
+	uint32_t failCommits;	// Number of commits to fail
+	uint8_t ram[EEPROM_SIZE];
+	uint8_t flash[EEPROM_SIZE];
+};
+
+// hwWriteConfigBlock()
+static void writeBlock(EEPROMWriteBack<SimulatedEEPROM> &writeBack, const int addr,
+                       const void *buf, size_t length, const uint32_t now)
+{
+	const uint8_t *src = static_cast<const uint8_t *>(buf);
+	int pos = addr;
+	while (length-- > 0) {
+		writeBack.write(pos++, *src++, now);
+	}
+}
+
+// Run the main loop from start until end, return the number of commits process() did
+static uint32_t runLoop(EEPROMWriteBack<SimulatedEEPROM> &writeBack, const uint32_t start,
+                        const uint32_t end)
+{
+	uint32_t commits = 0;
+	for (uint32_t now = start; now != end; now += LOOP_MS) {
+		commits += writeBack.process(now);
+	}
+	return commits;
+}
+
+static void testDeferral(void)
+{
+	SimulatedEEPROM eeprom;
+	EEPROMWriteBack<SimulatedEEPROM> writeBack(eeprom, COMMIT_DELAY_MS, COMMIT_MAX_DELAY_MS);
+	TEST_ASSERT(!writeBack.dirty() && !writeBack.due(0));
+
+	const uint8_t nodeId = 42;
+	writeBlock(writeBack, 2, &nodeId, 1, 0);
+	TEST_ASSERT(writeBack.dirty() && eeprom.read(2) == nodeId);
+	TEST_ASSERT(eeprom.flash[2] == 0xFF && !eeprom.commits);
+
+	// Nothing reaches flash before the idle delay
+	TEST_ASSERT(!runLoop(writeBack, 0, COMMIT_DELAY_MS));
+	TEST_ASSERT(writeBack.dirty() && !eeprom.commits && eeprom.flash[2] == 0xFF);
+	TEST_ASSERT(writeBack.due(COMMIT_DELAY_MS));
+	TEST_ASSERT(writeBack.process(COMMIT_DELAY_MS));
+	TEST_ASSERT(!writeBack.dirty() && eeprom.commits == 1 && eeprom.flash[2] == nodeId);
+	TEST_ASSERT(!runLoop(writeBack, COMMIT_DELAY_MS, 5 * COMMIT_DELAY_MS));
+	TEST_ASSERT(eeprom.commits == 1);
+}
+
+static void testCoalescing(void)
+{
+	SimulatedEEPROM eeprom;
+	EEPROMWriteBack<SimulatedEEPROM> writeBack(eeprom, COMMIT_DELAY_MS, COMMIT_MAX_DELAY_MS);
+
+	// 50 routing table updates 200 ms apart, each one a commit before the write-back
+	uint32_t now = 0;
+	unitTestSeed(1);
+	for (uint8_t i = 0; i < 50; i++) {
+		const uint8_t route = (uint8_t)unitTestRandom();
+		writeBlock(writeBack, 100 + i, &route, 1, now);
+		TEST_ASSERT(!runLoop(writeBack, now, now + 200));
+		now += 200;
+	}
+	TEST_ASSERT(!eeprom.commits && writeBack.dirty());
+	TEST_ASSERT(runLoop(writeBack, now, now + COMMIT_DELAY_MS + LOOP_MS) == 1);
+	TEST_ASSERT(eeprom.commits == 1 && eeprom.committed());
+
+	// Rewriting the stored values does not mark anything dirty
+	uint8_t block[50];
+	(void)memcpy(block, &eeprom.ram[100], sizeof(block));
+	writeBlock(writeBack, 100, block, sizeof(block), now);
+	TEST_ASSERT(!writeBack.dirty());
+	TEST_ASSERT(!runLoop(writeBack, now, now + 3 * COMMIT_DELAY_MS));
+	TEST_ASSERT(eeprom.commits == 1);
+
+	// Changing a byte back and forth before the commit still costs one
+	now += 3 * COMMIT_DELAY_MS;
+	for (uint8_t i = 0; i < 10; i++) {
+		const uint8_t value = (uint8_t)(block[0] + (i & 1 ? 0 : 1));
+		writeBlock(writeBack, 100, &value, 1, now + i);
+	}
+	TEST_ASSERT(runLoop(writeBack, now, now + 2 * COMMIT_DELAY_MS) == 1);
+	TEST_ASSERT(eeprom.commits == 2 && eeprom.committed() && eeprom.flash[100] == block[0]);
+}
+
+static void testMaxDelay(void)
+{
+	SimulatedEEPROM eeprom;
+	EEPROMWriteBack<SimulatedEEPROM> writeBack(eeprom, COMMIT_DELAY_MS, COMMIT_MAX_DELAY_MS);
+
+	// A write every 500 ms never leaves the write-back idle for the commit delay
+	uint32_t pendingSince = 0;
+	uint32_t commits = 0;
+	for (uint32_t now = 0; now < 60000u; now += LOOP_MS) {
+		if (!(now % 500)) {
+			const uint8_t value = (uint8_t)(now / 500);
+			if (!writeBack.dirty()) {
+				pendingSince = now;
+			}
+			writeBlock(writeBack, 7, &value, 1, now);
+		}
+		if (writeBack.process(now)) {
+			commits++;
+			TEST_ASSERT(now - pendingSince <= COMMIT_MAX_DELAY_MS);
+			TEST_ASSERT(eeprom.committed());
+		}
+		TEST_ASSERT(!writeBack.dirty() || now - pendingSince <= COMMIT_MAX_DELAY_MS);
+	}
+	TEST_ASSERT(commits == eeprom.commits);
+	TEST_ASSERT(commits >= 60000u / (COMMIT_MAX_DELAY_MS + 500u) &&
+	            commits <= 60000u / COMMIT_MAX_DELAY_MS);
+}
+
+static void testFlushOnCommit(void)
+{
+	SimulatedEEPROM eeprom;
+	EEPROMWriteBack<SimulatedEEPROM> writeBack(eeprom, COMMIT_DELAY_MS, COMMIT_MAX_DELAY_MS);
+
+	// Nothing pending, nothing to commit
+	TEST_ASSERT(writeBack.flush());
+	TEST_ASSERT(!eeprom.commits);
+
+	// hwReboot() or sleep right after a write
+	const uint8_t parent[2] = { 0, 1 };
+	writeBlock(writeBack, 3, parent, sizeof(parent), 0);
+	TEST_ASSERT(!writeBack.process(LOOP_MS));
+	TEST_ASSERT(writeBack.flush());
+	TEST_ASSERT(!writeBack.dirty() && eeprom.commits == 1 && eeprom.committed());
+	TEST_ASSERT(writeBack.flush());
+	TEST_ASSERT(eeprom.commits == 1);
+
+	// The loop has nothing left to do afterwards
+	TEST_ASSERT(!runLoop(writeBack, LOOP_MS, 3 * COMMIT_MAX_DELAY_MS));
+	TEST_ASSERT(eeprom.commits == 1);
+
+	// A failed flush keeps the writes pending for the loop
+	const uint32_t now = 3 * COMMIT_MAX_DELAY_MS;
+	const uint8_t id = 9;
+	writeBlock(writeBack, 2, &id, 1, now);
+	eeprom.failCommits = 1;
+	TEST_ASSERT(!writeBack.flush());
+	TEST_ASSERT(writeBack.dirty() && eeprom.flash[2] != id);
+	TEST_ASSERT(runLoop(writeBack, now, now + COMMIT_DELAY_MS + LOOP_MS) == 1);
+	TEST_ASSERT(!writeBack.dirty() && eeprom.flash[2] == id);
+}
+
+static void testWriteThrough(void)
+{
+	SimulatedEEPROM eeprom;
+	EEPROMWriteBack<SimulatedEEPROM> writeBack(eeprom, 0, COMMIT_MAX_DELAY_MS);
+
+	// Delay 0 commits every changed byte, as before the write-back
+	const uint8_t block[4] = { 1, 2, 3, 4 };
+	writeBlock(writeBack, 10, block, sizeof(block), 0);
+	TEST_ASSERT(eeprom.commits == 4 && !writeBack.dirty() && eeprom.committed());
+	writeBlock(writeBack, 10, block, sizeof(block), 1);
+	TEST_ASSERT(eeprom.commits == 4);
+	TEST_ASSERT(!runLoop(writeBack, 0, COMMIT_DELAY_MS));
+}
+
+static void testFailedCommit(void)
+{
+	SimulatedEEPROM eeprom;
+	EEPROMWriteBack<SimulatedEEPROM> writeBack(eeprom, COMMIT_DELAY_MS, COMMIT_MAX_DELAY_MS);
+
+	const uint8_t value = 5;
+	writeBlock(writeBack, 0, &value, 1, 0);
+	eeprom.failCommits = 2;
+	TEST_ASSERT(!writeBack.process(COMMIT_DELAY_MS));
+	TEST_ASSERT(writeBack.dirty() && eeprom.flash[0] != value);
+	// Retried after the commit delay, not on every loop
+	TEST_ASSERT(!writeBack.due(2 * COMMIT_DELAY_MS - 1));
+	TEST_ASSERT(!writeBack.process(2 * COMMIT_DELAY_MS));
+	TEST_ASSERT(eeprom.failCommits == 0 && writeBack.dirty());
+	TEST_ASSERT(runLoop(writeBack, 2 * COMMIT_DELAY_MS, 4 * COMMIT_DELAY_MS) == 1);
+	TEST_ASSERT(!writeBack.dirty() && eeprom.committed() && eeprom.commits == 1);
+}
+
+static void testWrap(void)
+{
+	SimulatedEEPROM eeprom;
+	EEPROMWriteBack<SimulatedEEPROM> writeBack(eeprom, COMMIT_DELAY_MS, COMMIT_MAX_DELAY_MS);
+
+	// millis() wraps 500 ms after the write
+	const uint32_t start = UINT32_MAX - 499u;
+	const uint8_t value = 1;
+	writeBlock(writeBack, 0, &value, 1, start);
+	TEST_ASSERT(!writeBack.due(start + COMMIT_DELAY_MS - 1));
+	TEST_ASSERT(writeBack.due(start + COMMIT_DELAY_MS));
+
+	// Steady writes across the wrap are bounded by the maximum delay
+	uint32_t now = start;
+	for (uint16_t i = 0; i < 19; i++) {
+		now = start + i * 500u;
+		writeBlock(writeBack, 0, &i, 1, now);
+		TEST_ASSERT(!writeBack.process(now));
+	}
+	TEST_ASSERT(writeBack.process(start + COMMIT_MAX_DELAY_MS));
+	TEST_ASSERT(eeprom.commits == 1 && eeprom.committed());
+}
+
+int main(void)
+{
+	printf("EEPROM write-back\n");
+	TEST_RUN(testDeferral);
+	TEST_RUN(testCoalescing);
+	TEST_RUN(testMaxDelay);
+	TEST_RUN(testFlushOnCommit);
+	TEST_RUN(testWriteThrough);
+	TEST_RUN(testFailedCommit);
+	TEST_RUN(testWrap);
+	return unitTestResult();
+}
@@ -0,0 +1,436 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+// OTA firmware transfer of a node against a simulated controller over a simulated radio link.
+// The link serializes frames (8ms air time each), loses, delays (reorders) and duplicates them.
+// The node runs MyOTAFirmwareUpdate.cpp with windowed requests, the image has to end up in flash
+// byte for byte and pass the CRC accumulated while receiving.
+
+#include <assert.h>
+#include <stdint.h>
+#include <vector>
+
+#define MY_OTA_WINDOW_SIZE (16u)
+#define OTA_WINDOW_SIZE MY_OTA_WINDOW_SIZE
+
+#include "MyConfig.h"
+
+// The OTA code only needs the stubs below, not the whole core
+#define MySensorsCore_h
+#define GATEWAY_ADDRESS ((uint8_t)0)
+#define NODE_SENSOR_ID ((uint8_t)255)
+
+#include "core/MyEepromAddresses.h"
+#include "core/MyIndication.h"
+#include "core/MyHelperFunctions.cpp"
+#include "core/MyMessage.cpp"
+#include "hal/architecture/Linux/drivers/core/noniso.cpp"
+#include "unit_test.h"
+
+static uint32_t simMillis;
+static bool simRebooted;
+static uint32_t simIndications[INDICATION_ERR_START + 32];
+static uint8_t simEeprom[1024];
+
+static uint32_t hwMillis(void)
+{
+	return simMillis;
+}
+
+static void hwReadConfigBlock(void *buf, void *addr, size_t length)
+{
+	(void)memcpy(buf, &simEeprom[(size_t)addr], length);
+}
+
+static void hwWriteConfigBlock(void *buf, void *addr, size_t length)
+{
+	(void)memcpy(&simEeprom[(size_t)addr], buf, length);
+}
+
+static void hwReboot(void)
+{
+	simRebooted = true;
+}
+
+void setIndication(const indication_t ind)
+{
+	simIndications[ind]++;
+}
+
+static uint8_t getNodeId(void)
+{
+	return 42;
+}
+
+static inline MyMessage& build(MyMessage &msg, const uint8_t destination, const uint8_t sensor,
+                               const mysensors_command_t command, const uint8_t type, const bool requestEcho = false)
+{
+	msg.setSender(getNodeId());
+	msg.setDestination(destination);
+	msg.setSensor(sensor);
+	msg.setType(type);
+	msg.setCommand(command);
+	msg.setRequestEcho(requestEcho);
+	msg.setEcho(false);
+	return msg;
+}
+
+// External SPI flash of the node
+#define SIM_FLASH_SIZE (32768u)
+#define SIM_BLOCK_SIZE (32768u)
+class SPIFlash
+{
+public:
+	SPIFlash(uint8_t slaveSelectPin, uint16_t jedecID)
+	{
+		(void)slaveSelectPin;
+		(void)jedecID;
+	}
+	bool initialize(void)
+	{
+		return true;
+	}
+	uint8_t readByte(uint32_t addr)
+	{
+		return mem[addr];
+	}
+	void readBytes(uint32_t addr, void *buf, uint16_t len)
+	{
+		assert(addr + len <= SIM_FLASH_SIZE);
+		(void)memcpy(buf, &mem[addr], len);
+	}
+	void writeBytes(uint32_t addr, const void *buf, uint16_t len)
+	{
+		assert(addr + len <= SIM_FLASH_SIZE);
+		// NOR flash only clears bits
+		for (uint16_t i = 0; i < len; i++) {
+			mem[addr + i] &= ((const uint8_t *)buf)[i];
+		}
+	}
+	void blockErase32K(uint32_t addr)
+	{
+		// Erases the 32K block holding addr, clipped to the simulated flash
+		addr &= ~(SIM_BLOCK_SIZE - 1u);
+		assert(addr < SIM_FLASH_SIZE);
+		const uint32_t len = SIM_FLASH_SIZE - addr < SIM_BLOCK_SIZE ? SIM_FLASH_SIZE - addr : SIM_BLOCK_SIZE;
+		(void)memset(&mem[addr], 0xFF, len);
+	}
+	bool busy(void)
+	{
+		return false;
+	}
+	uint8_t mem[SIM_FLASH_SIZE];
+};
+
+MyMessage _msg;
+MyMessage _msgTmp;
+static bool _sendRoute(MyMessage &message);
+
+#include "core/MyOTAFirmwareUpdate.cpp"
+
+#define SIM_AIR_TIME_MS (8u)
+#define SIM_TIMEOUT_MS (3600000ul)
+
+typedef struct {
+	uint32_t loss;        // Frames lost, per mille
+	uint32_t duplicate;   // Frames delivered twice, per mille
+	uint32_t jitter;      // Max. extra delay of a frame in ms, later frames can overtake it
+	bool windowSupport;   // Controller answers ST_FIRMWARE_REQUEST_WINDOW
+	uint16_t corruptBlock; // Block sent with a flipped bit the first time, 0xFFFF for none
+} link_t;
+
+typedef struct {
+	uint32_t due;
+	bool toNode;
+	MyMessage msg;
+} frame_t;
+
+static link_t simLink;
+static std::vector<frame_t> simFrames;
+static uint32_t simChannelFree;
+static std::vector<uint8_t> simImage;
+static bool simCorruptSent;
+static uint32_t simWindowRequests;
+static uint32_t simBlockRequests;
+
+static void simTransmit(const MyMessage &msg, const bool toNode)
+{
+	// Frames share one channel, a frame is sent once the previous one is off the air
+	simChannelFree = (simChannelFree > simMillis ? simChannelFree : simMillis) + SIM_AIR_TIME_MS;
+	if (unitTestRandom() % 1000 < simLink.loss) {
+		return;
+	}
+	const uint8_t copies = unitTestRandom() % 1000 < simLink.duplicate ? 2 : 1;
+	for (uint8_t i = 0; i < copies; i++) {
+		frame_t frame;
+		frame.due = simChannelFree + (simLink.jitter ? unitTestRandom() % (simLink.jitter + 1) : 0);
+		frame.toNode = toNode;
+		frame.msg = msg;
+		simFrames.push_back(frame);
+	}
+}
+
+static bool _sendRoute(MyMessage &message)
+{
+	simTransmit(message, false);
+	return true;
+}
+
+static void simSendBlock(const uint16_t block)
+{
+	replyFirmwareBlock_t reply;
+	reply.type = 1;
+	reply.version = 2;
+	reply.block = block;
+	(void)memcpy(reply.data, &simImage[block * FIRMWARE_BLOCK_SIZE], FIRMWARE_BLOCK_SIZE);
+	if (block == simLink.corruptBlock && !simCorruptSent) {
+		reply.data[3] ^= 0x10;
+		simCorruptSent = true;
+	}
+	MyMessage msg;
+	msg.setCommand(C_STREAM);
+	msg.setType(ST_FIRMWARE_RESPONSE);
+	msg.set(&reply, sizeof(reply));
+	simTransmit(msg, true);
+}
+
+static void simController(const MyMessage &msg)
+{
+	if (msg.getCommand() != C_STREAM) {
+		return;
+	}
+	if (msg.getType() == ST_FIRMWARE_REQUEST) {
+		const requestFirmwareBlock_t *request = (const requestFirmwareBlock_t *)msg.data;
+		simBlockRequests++;
+		TEST_ASSERT(request->block < simImage.size() / FIRMWARE_BLOCK_SIZE);
+		simSendBlock(request->block);
+	} else if (msg.getType() == ST_FIRMWARE_REQUEST_WINDOW) {
+		const requestFirmwareWindow_t *request = (const requestFirmwareWindow_t *)msg.data;
+		simWindowRequests++;
+		if (!simLink.windowSupport) {
+			return;
+		}
+		TEST_ASSERT(request->block < simImage.size() / FIRMWARE_BLOCK_SIZE);
+		for (uint8_t n = 0; n < 32; n++) {
+			if (request->missing & (1ul << n)) {
+				// A bit below block 0 would be a broken window
+				TEST_ASSERT(n <= request->block);
+				if (n <= request->block) {
+					simSendBlock(request->block - n);
+				}
+			}
+		}
+	}
+}
+
+// Reference CRC16 (poly 0xA001 reflected, init 0xFFFF) the controller computes over the image
+static uint16_t simCrc16(const std::vector<uint8_t> &data)
+{
+	uint16_t crc = 0xFFFF;
+	for (size_t i = 0; i < data.size(); i++) {
+		crc ^= data[i];
+		for (uint8_t bit = 0; bit < 8; bit++) {
+			crc = crc & 1 ? (crc >> 1) ^ 0xA001 : crc >> 1;
+		}
+	}
+	return crc;
+}
+
+// Run a complete update of a random image with the given number of blocks.
+// Returns the simulated time it took, or 0 if the node did not reboot into the new image.
+static uint32_t simUpdate(const uint16_t blocks, const link_t &link, const uint32_t seed)
+{
+	unitTestSeed(seed);
+	simLink = link;
+	simFrames.clear();
+	simMillis = 1000;
+	simChannelFree = 0;
+	simRebooted = false;
+	simCorruptSent = false;
+	simWindowRequests = 0;
+	simBlockRequests = 0;
+	(void)memset(simIndications, 0, sizeof(simIndications));
+	(void)memset(simEeprom, 0, sizeof(simEeprom));
+	simImage.resize(blocks * FIRMWARE_BLOCK_SIZE);
+	for (size_t i = 0; i < simImage.size(); i++) {
+		simImage[i] = (uint8_t)unitTestRandom();
+	}
+
+	readFirmwareSettings();
+	presentBootloaderInformation();
+	nodeFirmwareConfig_t config;
+	config.type = 1;
+	config.version = 2;
+	config.blocks = blocks;
+	config.crc = simCrc16(simImage);
+	_msg.setCommand(C_STREAM);
+	_msg.setType(ST_FIRMWARE_CONFIG_RESPONSE);
+	_msg.set(&config, sizeof(config));
+	TEST_ASSERT(firmwareOTAUpdateProcess());
+	TEST_ASSERT(isFirmwareUpdateOngoing());
+
+	const uint32_t start = simMillis;
+	while (isFirmwareUpdateOngoing() && simMillis - start < SIM_TIMEOUT_MS) {
+		firmwareOTAUpdateRequest();
+		// Deliver the frames that are due, in the order they arrive
+		for (size_t i = 0; i < simFrames.size();) {
+			if (simFrames[i].due > simMillis) {
+				i++;
+				continue;
+			}
+			const frame_t frame = simFrames[i];
+			simFrames.erase(simFrames.begin() + i);
+			if (frame.toNode) {
+				_msg = frame.msg;
+				(void)firmwareOTAUpdateProcess();
+			} else {
+				simController(frame.msg);
+			}
+			i = 0;
+		}
+		simMillis++;
+	}
+	if (!simRebooted) {
+		return 0;
+	}
+	TEST_ASSERT(!memcmp(&_flash.mem[FIRMWARE_START_OFFSET], simImage.data(), simImage.size()));
+	TEST_ASSERT(!memcmp(&_flash.mem[0], "FLXIMG:", 7));
+	TEST_ASSERT(!memcmp(&simEeprom[EEPROM_FIRMWARE_TYPE_ADDRESS], &config, sizeof(config)));
+	return simMillis - start;
+}
+
+static const link_t LINK_PERFECT = { 0, 0, 0, true, 0xFFFF };
+
+static void testCrcTable(void)
+{
+	// The nibble table CRC matches the bitwise reference
+	std::vector<uint8_t> data(FIRMWARE_BLOCK_SIZE * 64);
+	for (size_t i = 0; i < data.size(); i++) {
+		data[i] = (uint8_t)unitTestRandom();
+	}
+	uint16_t crc = 0xFFFF;
+	for (size_t i = 0; i < data.size(); i += FIRMWARE_BLOCK_SIZE) {
+		crc = _firmwareCrcUpdate(crc, &data[i], FIRMWARE_BLOCK_SIZE);
+	}
+	TEST_ASSERT(crc == simCrc16(data));
+	// Running it backwards from the final CRC ends at the initial value
+	for (size_t i = data.size(); i > 0; i -= FIRMWARE_BLOCK_SIZE) {
+		crc = _firmwareCrcUndo(crc, &data[i - FIRMWARE_BLOCK_SIZE], FIRMWARE_BLOCK_SIZE);
+	}
+	TEST_ASSERT(crc == 0xFFFF);
+}
+
+static void testPerfectLink(void)
+{
+	const uint32_t elapsed = simUpdate(1000, LINK_PERFECT, 1);
+	TEST_ASSERT(elapsed);
+	// One window request per window, nothing is ever re-requested
+	TEST_ASSERT(simWindowRequests == (1000 + OTA_WINDOW_SIZE - 1) / OTA_WINDOW_SIZE);
+	TEST_ASSERT(simBlockRequests == 0);
+	TEST_ASSERT(simIndications[INDICATION_FW_UPDATE_RX] == 1000);
+	TEST_ASSERT(simIndications[INDICATION_FW_UPDATE_RX_ERR] == 0);
+	printf("    1000 blocks in %.1fs\n", elapsed / 1000.0);
+}
+
+static void testWindowWrap(void)
+{
+	// Images ending in a partial window, exactly one window, and crossing window boundaries
+	const uint16_t sizes[] = { 1, 2, OTA_WINDOW_SIZE - 1, OTA_WINDOW_SIZE, OTA_WINDOW_SIZE + 1,
+	                           2 * OTA_WINDOW_SIZE + 3, 1000
+	                         };
+	for (uint8_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+		TEST_ASSERT(simUpdate(sizes[i], LINK_PERFECT, 10 + i));
+		TEST_ASSERT(simIndications[INDICATION_FW_UPDATE_RX] == sizes[i]);
+		// Same sizes over a lossy link, so the last (partial) window gets holes as well
+		const link_t lossy = { 100, 0, 0, true, 0xFFFF };
+		TEST_ASSERT(simUpdate(sizes[i], lossy, 20 + i));
+	}
+}
+
+static void testLoss(void)
+{
+	const uint32_t loss[] = { 50, 200 };
+	for (uint8_t i = 0; i < sizeof(loss) / sizeof(loss[0]); i++) {
+		for (uint32_t seed = 1; seed <= 4; seed++) {
+			const link_t link = { loss[i], 0, 0, true, 0xFFFF };
+			const uint32_t elapsed = simUpdate(1000, link, seed);
+			TEST_ASSERT(elapsed);
+			if (seed == 1) {
+				printf("    1000 blocks, %u%% loss in %.1fs, %u window requests\n", loss[i] / 10,
+				       elapsed / 1000.0, simWindowRequests);
+			}
+		}
+	}
+}
+
+static void testReorderAndDuplicates(void)
+{
+	// Jitter of a few air times lets later blocks overtake earlier ones within a window,
+	// duplicates arrive after their block was stored, some even after the window moved on
+	for (uint32_t seed = 1; seed <= 4; seed++) {
+		const link_t link = { 20, 100, 5 * SIM_AIR_TIME_MS, true, 0xFFFF };
+		TEST_ASSERT(simUpdate(500, link, seed));
+		TEST_ASSERT(simIndications[INDICATION_FW_UPDATE_RX] == 500);
+		TEST_ASSERT(simIndications[INDICATION_FW_UPDATE_RX_ERR] > 0);
+	}
+	const link_t late = { 0, 0, 100 * SIM_AIR_TIME_MS, true, 0xFFFF };
+	TEST_ASSERT(simUpdate(200, late, 7));
+}
+
+static void testControllerWithoutWindows(void)
+{
+	// The window requests go unanswered, the node has to fall back to single blocks
+	const link_t link = { 50, 0, 0, false, 0xFFFF };
+	TEST_ASSERT(simUpdate(100, link, 3));
+	TEST_ASSERT(simWindowRequests == MY_OTA_RETRY + 1);
+	TEST_ASSERT(simBlockRequests >= 100);
+}
+
+static void testCorruptBlock(void)
+{
+	// A block damaged on the air is stored as is, the CRC has to catch it
+	const link_t link = { 0, 0, 0, true, 123 };
+	TEST_ASSERT(!simUpdate(300, link, 5));
+	TEST_ASSERT(!isFirmwareUpdateOngoing());
+	TEST_ASSERT(simIndications[INDICATION_ERR_FW_CHECKSUM] == 1);
+	TEST_ASSERT(!memcmp(&simEeprom[EEPROM_FIRMWARE_TYPE_ADDRESS], "\0\0\0\0\0\0\0\0", 8));
+}
+
+static void testDeadLink(void)
+{
+	// Nothing comes back, the node gives up after the retries instead of hanging
+	const link_t link = { 1000, 0, 0, true, 0xFFFF };
+	TEST_ASSERT(!simUpdate(50, link, 9));
+	TEST_ASSERT(!isFirmwareUpdateOngoing());
+	TEST_ASSERT(simIndications[INDICATION_ERR_FW_TIMEOUT] == 1);
+}
+
+int main(void)
+{
+	printf("OTA firmware update, window %u\n", OTA_WINDOW_SIZE);
+	TEST_RUN(testCrcTable);
+	TEST_RUN(testPerfectLink);
+	TEST_RUN(testWindowWrap);
+	TEST_RUN(testLoss);
+	TEST_RUN(testReorderAndDuplicates);
+	TEST_RUN(testControllerWithoutWindows);
+	TEST_RUN(testCorruptBlock);
+	TEST_RUN(testDeadLink);
+	return unitTestResult();
+}
@@ -0,0 +1,339 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+// Host test and fuzzer of protocolParseSerial(), the controller text protocol parser:
+// - valid lines decode like the former strtok_r/atoi parser did;
+// - every malformed header and payload is rejected with its PROTOCOL_PARSE_ERROR_* code;
+// - every truncated prefix of a valid line is parsed without reading past its end;
+// - mutated and random input never reads out of bounds (run under ASan) or fills the
+//   message beyond MAX_PAYLOAD_SIZE.
+// Input is always parsed from an exact size heap copy without terminator, so an overread
+// is caught by the sanitizer.
+
+#include <ctype.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+
+// Only needed to build the MQTT helpers next to the parser
+#define MY_MQTT_SUBSCRIBE_TOPIC_PREFIX "mygateway1-in"
+
+#include "MyConfig.h"
+#include "core/MySensorsCore.h"
+#include "core/MyHelperFunctions.cpp"
+#include "core/MyMessage.cpp"
+#include "hal/architecture/Linux/drivers/core/noniso.cpp"
+#include "core/MyProtocol.cpp"
+#include "protocol_lines.h"
+#include "unit_test.h"
+
+#define FUZZ_ROUNDS (200000u)
+
+// Parse length bytes of input from a heap block of exactly that size, check it stays unmodified
+static uint8_t parse(MyMessage &message, const char *input, const size_t length)
+{
+	char *copy = (char *)malloc(length ? length : 1);
+	(void)memcpy(copy, input, length);
+	const uint8_t result = protocolParseSerial(message, copy, length);
+	TEST_ASSERT(!memcmp(copy, input, length));
+	free(copy);
+	return result;
+}
+
+static uint8_t parse(MyMessage &message, const char *line)
+{
+	return parse(message, line, strlen(line));
+}
+
+static bool sameMessage(const MyMessage &a, const MyMessage &b)
+{
+	return a.getSender() == b.getSender() && a.getLast() == b.getLast() &&
+	       a.getDestination() == b.getDestination() && a.getSensor() == b.getSensor() &&
+	       a.getCommand() == b.getCommand() && a.getRequestEcho() == b.getRequestEcho() &&
+	       a.isEcho() == b.isEcho() && a.getType() == b.getType() &&
+	       a.getPayloadType() == b.getPayloadType() && a.getLength() == b.getLength() &&
+	       !memcmp(a.data, b.data, a.getLength());
+}
+
+static void testLegacyEquivalence(void)
+{
+	unitTestSeed(1);
+	for (uint16_t i = 0; i < 2000; i++) {
+		char line[MY_GATEWAY_MAX_RECEIVE_LENGTH];
+		const size_t length = protocolLine(line, unitTestRandom);
+		char legacyLine[MY_GATEWAY_MAX_RECEIVE_LENGTH];
+		(void)memcpy(legacyLine, line, length + 1);
+		MyMessage expected, msg;
+		TEST_ASSERT(legacyProtocolSerial2MyMessage(expected, legacyLine));
+		TEST_ASSERT(parse(msg, line, length) == PROTOCOL_PARSE_OK);
+		TEST_ASSERT(sameMessage(msg, expected));
+	}
+}
+
+static void testValidLines(void)
+{
+	MyMessage msg;
+	TEST_ASSERT(parse(msg, "12;6;1;1;2;ON") == PROTOCOL_PARSE_OK);
+	TEST_ASSERT(msg.getSender() == GATEWAY_ADDRESS && msg.getDestination() == 12 &&
+	            msg.getSensor() == 6 && msg.getCommand() == C_SET && msg.getRequestEcho() &&
+	            !msg.isEcho() && msg.getType() == V_STATUS);
+	TEST_ASSERT(msg.getPayloadType() == P_STRING && !strcmp(msg.getString(), "ON"));
+
+	TEST_ASSERT(parse(msg, "255;255;4;0;255;00aFfF") == PROTOCOL_PARSE_OK);
+	TEST_ASSERT(msg.getDestination() == 255 && msg.getSensor() == 255 &&
+	            msg.getCommand() == C_STREAM && msg.getType() == 255);
+	TEST_ASSERT(msg.getPayloadType() == P_CUSTOM && msg.getLength() == 3);
+	TEST_ASSERT(!memcmp(msg.getCustom(), "\x00\xaf\xff", 3));
+
+	// Leading zeros are still decimal numbers
+	TEST_ASSERT(parse(msg, "007;0;003;0;0000255;x") == PROTOCOL_PARSE_OK);
+	TEST_ASSERT(msg.getDestination() == 7 && msg.getCommand() == C_INTERNAL && msg.getType() == 255);
+
+	// No payload, with or without the last separator
+	TEST_ASSERT(parse(msg, "1;2;1;0;3") == PROTOCOL_PARSE_OK);
+	TEST_ASSERT(msg.getPayloadType() == P_BYTE && msg.getByte() == 0);
+	TEST_ASSERT(parse(msg, "1;2;4;0;3;") == PROTOCOL_PARSE_OK);
+	TEST_ASSERT(msg.getPayloadType() == P_BYTE && msg.getByte() == 0);
+
+	// Separators in the payload belong to it
+	TEST_ASSERT(parse(msg, "1;2;1;0;47;a;b;;c") == PROTOCOL_PARSE_OK);
+	TEST_ASSERT(!strcmp(msg.getString(), "a;b;;c"));
+
+	// Longest payloads
+	char line[MY_GATEWAY_MAX_RECEIVE_LENGTH];
+	int length = sprintf(line, "1;2;1;0;47;");
+	(void)memset(&line[length], 'z', MAX_PAYLOAD_SIZE);
+	line[length + MAX_PAYLOAD_SIZE] = '\0';
+	TEST_ASSERT(parse(msg, line) == PROTOCOL_PARSE_OK);
+	TEST_ASSERT(msg.getLength() == MAX_PAYLOAD_SIZE && strlen(msg.getString()) == MAX_PAYLOAD_SIZE);
+	length = sprintf(line, "1;2;4;0;1;");
+	(void)memset(&line[length], 'A', MAX_PAYLOAD_SIZE * 2);
+	line[length + MAX_PAYLOAD_SIZE * 2] = '\0';
+	TEST_ASSERT(parse(msg, line) == PROTOCOL_PARSE_OK);
+	TEST_ASSERT(msg.getLength() == MAX_PAYLOAD_SIZE && ((uint8_t *)msg.getCustom())[0] == 0xAA);
+
+	// The wrapper on a terminated string
+	char inputString[] = "3;4;2;0;2\n";
+	TEST_ASSERT(protocolSerial2MyMessage(msg, inputString));
+	TEST_ASSERT(msg.getDestination() == 3 && msg.getCommand() == C_REQ);
+	char badString[] = "3;4;2;0";
+	TEST_ASSERT(!protocolSerial2MyMessage(msg, badString));
+}
+
+static void testLineEndings(void)
+{
+	static const char *const lines[] = { "1;2;1;0;3;42", "1;2;1;0;3;42\n", "1;2;1;0;3;42\r\n",
+	                                     "1;2;1;0;3;42\n\r", "1;2;1;0;3;42\r\n\r\n"
+	                                   };
+	for (uint8_t i = 0; i < sizeof(lines) / sizeof(lines[0]); i++) {
+		MyMessage msg;
+		TEST_ASSERT(parse(msg, lines[i]) == PROTOCOL_PARSE_OK);
+		TEST_ASSERT(msg.getLength() == 2 && !strcmp(msg.getString(), "42"));
+	}
+	MyMessage msg;
+	TEST_ASSERT(parse(msg, "1;2;4;0;3;BEEF\r\n") == PROTOCOL_PARSE_OK);
+	TEST_ASSERT(msg.getLength() == 2 && !memcmp(msg.getCustom(), "\xbe\xef", 2));
+	TEST_ASSERT(parse(msg, "1;2;1;0;3\r\n") == PROTOCOL_PARSE_OK);
+	TEST_ASSERT(msg.getPayloadType() == P_BYTE);
+	TEST_ASSERT(parse(msg, "\r\n") == PROTOCOL_PARSE_ERROR_FIELDS);
+	// Only trailing line endings are removed
+	TEST_ASSERT(parse(msg, "1;2;1;0;3;4\r2") == PROTOCOL_PARSE_OK);
+	TEST_ASSERT(!strcmp(msg.getString(), "4\r2"));
+	TEST_ASSERT(parse(msg, "1\r;2;1;0;3;4") == PROTOCOL_PARSE_ERROR_NUMBER);
+}
+
+static void testMalformedHeader(void)
+{
+	static const struct {
+		const char *line;
+		uint8_t result;
+	} cases[] = {
+		{ "", PROTOCOL_PARSE_ERROR_FIELDS },
+		{ ";", PROTOCOL_PARSE_ERROR_FIELDS },
+		{ ";;;;;", PROTOCOL_PARSE_ERROR_FIELDS },
+		{ "1;2;1;0", PROTOCOL_PARSE_ERROR_FIELDS },
+		{ "1;2;1;0;", PROTOCOL_PARSE_ERROR_FIELDS },
+		{ ";2;1;0;3;x", PROTOCOL_PARSE_ERROR_FIELDS },
+		{ "1;;1;0;3;x", PROTOCOL_PARSE_ERROR_FIELDS },
+		{ "1;2;;0;3;x", PROTOCOL_PARSE_ERROR_FIELDS },
+		{ "1;2;1;;3;x", PROTOCOL_PARSE_ERROR_FIELDS },
+		{ "1;2;1;0;;x", PROTOCOL_PARSE_ERROR_FIELDS },
+		{ "a;2;1;0;3;x", PROTOCOL_PARSE_ERROR_NUMBER },
+		{ "1;2x;1;0;3;x", PROTOCOL_PARSE_ERROR_NUMBER },
+		{ "1;2; 1;0;3;x", PROTOCOL_PARSE_ERROR_NUMBER },
+		{ "1;2;1;0;3 ;x", PROTOCOL_PARSE_ERROR_NUMBER },
+		{ "-1;2;1;0;3;x", PROTOCOL_PARSE_ERROR_NUMBER },
+		{ "+1;2;1;0;3;x", PROTOCOL_PARSE_ERROR_NUMBER },
+		{ "0x1;2;1;0;3;x", PROTOCOL_PARSE_ERROR_NUMBER },
+		{ "1,2,1,0,3,x", PROTOCOL_PARSE_ERROR_NUMBER },
+		{ "256;2;1;0;3;x", PROTOCOL_PARSE_ERROR_RANGE },
+		{ "1;1000;1;0;3;x", PROTOCOL_PARSE_ERROR_RANGE },
+		{ "1;2;1;0;99999999999999999999;x", PROTOCOL_PARSE_ERROR_RANGE },
+		{ "1;2;5;0;3;x", PROTOCOL_PARSE_ERROR_RANGE },
+		{ "1;2;255;0;3;x", PROTOCOL_PARSE_ERROR_RANGE },
+		{ "1;2;1;2;3;x", PROTOCOL_PARSE_ERROR_RANGE },
+		{ "1;2;1;255;3;x", PROTOCOL_PARSE_ERROR_RANGE },
+	};
+	for (uint8_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+		MyMessage msg;
+		const uint8_t result = parse(msg, cases[i].line);
+		if (result != cases[i].result) {
+			fprintf(stderr, "\"%s\": %u, expected %u\n", cases[i].line, result, cases[i].result);
+		}
+		TEST_ASSERT(result == cases[i].result);
+	}
+}
+
+static void testMalformedPayload(void)
+{
+	char line[MY_GATEWAY_MAX_RECEIVE_LENGTH];
+	MyMessage msg;
+
+	int length = sprintf(line, "1;2;1;0;47;");
+	(void)memset(&line[length], 'z', MAX_PAYLOAD_SIZE + 1);
+	line[length + MAX_PAYLOAD_SIZE + 1] = '\0';
+	TEST_ASSERT(parse(msg, line) == PROTOCOL_PARSE_ERROR_PAYLOAD);
+
+	length = sprintf(line, "1;2;4;0;1;");
+	(void)memset(&line[length], '0', MAX_PAYLOAD_SIZE * 2 + 2);
+	line[length + MAX_PAYLOAD_SIZE * 2 + 2] = '\0';
+	TEST_ASSERT(parse(msg, line) == PROTOCOL_PARSE_ERROR_PAYLOAD);
+
+	TEST_ASSERT(parse(msg, "1;2;4;0;1;0") == PROTOCOL_PARSE_ERROR_PAYLOAD);
+	TEST_ASSERT(parse(msg, "1;2;4;0;1;ABC") == PROTOCOL_PARSE_ERROR_PAYLOAD);
+	TEST_ASSERT(parse(msg, "1;2;4;0;1;0G") == PROTOCOL_PARSE_ERROR_PAYLOAD);
+	TEST_ASSERT(parse(msg, "1;2;4;0;1;G0") == PROTOCOL_PARSE_ERROR_PAYLOAD);
+	TEST_ASSERT(parse(msg, "1;2;4;0;1;00 1") == PROTOCOL_PARSE_ERROR_PAYLOAD);
+	TEST_ASSERT(parse(msg, "1;2;4;0;1;0x12") == PROTOCOL_PARSE_ERROR_PAYLOAD);
+	TEST_ASSERT(parse(msg, "1;2;4;0;1;00;0") == PROTOCOL_PARSE_ERROR_PAYLOAD);
+	// Every non-hex character in either nibble
+	for (uint16_t c = 1; c < 256; c++) {
+		if (isxdigit(c)) {
+			continue;
+		}
+		length = sprintf(line, "1;2;4;0;1;A%c", (char)c);
+		TEST_ASSERT(parse(msg, line, length) == PROTOCOL_PARSE_ERROR_PAYLOAD);
+		length = sprintf(line, "1;2;4;0;1;%cA", (char)c);
+		TEST_ASSERT(parse(msg, line, length) == PROTOCOL_PARSE_ERROR_PAYLOAD);
+	}
+}
+
+static void testTruncated(void)
+{
+	unitTestSeed(2);
+	for (uint16_t i = 0; i < 500; i++) {
+		char line[MY_GATEWAY_MAX_RECEIVE_LENGTH];
+		const size_t length = protocolLine(line, unitTestRandom);
+		// Position after each header separator, the last one is where the payload starts
+		size_t fields[5];
+		for (size_t pos = 0, index = 0; index < 5; pos++) {
+			if (line[pos] == ';') {
+				fields[index++] = pos + 1;
+			}
+		}
+		const size_t typeStart = fields[3];
+		const size_t payloadStart = fields[4];
+		const bool stream = atoi(&line[fields[1]]) == C_STREAM;
+		for (size_t prefix = 0; prefix < length; prefix++) {
+			MyMessage msg;
+			const uint8_t result = parse(msg, line, prefix);
+			if (prefix <= typeStart) {
+				// A header field is missing or empty
+				TEST_ASSERT(result == PROTOCOL_PARSE_ERROR_FIELDS);
+			} else if (prefix <= payloadStart) {
+				// Cut inside the type or after its separator: a header without payload
+				TEST_ASSERT(result == PROTOCOL_PARSE_OK);
+				TEST_ASSERT(msg.getPayloadType() == P_BYTE && msg.getByte() == 0);
+			} else if (stream) {
+				TEST_ASSERT(result == ((prefix - payloadStart) & 1 ? PROTOCOL_PARSE_ERROR_PAYLOAD :
+				                       PROTOCOL_PARSE_OK));
+			} else {
+				TEST_ASSERT(result == PROTOCOL_PARSE_OK);
+				TEST_ASSERT(msg.getLength() == prefix - payloadStart &&
+				            !memcmp(msg.getString(), &line[payloadStart], prefix - payloadStart));
+			}
+		}
+	}
+}
+
+static void testFuzz(void)
+{
+	static const char alphabet[] = "0123456789;;;;\r\nABCDEFabcdef xyz-+\xff";
+	unitTestSeed(3);
+	uint32_t accepted = 0;
+	for (uint32_t round = 0; round < FUZZ_ROUNDS; round++) {
+		char line[MY_GATEWAY_MAX_RECEIVE_LENGTH];
+		size_t length;
+		if (round & 1) {
+			// Mutate a valid line: replace, insert or delete a few characters
+			length = protocolLine(line, unitTestRandom);
+			const uint8_t mutations = 1 + unitTestRandom() % 4;
+			for (uint8_t m = 0; m < mutations && length; m++) {
+				const size_t pos = unitTestRandom() % length;
+				switch (unitTestRandom() % 3) {
+				case 0:
+					line[pos] = (char)unitTestRandom();
+					break;
+				case 1:
+					if (length < sizeof(line) - 1) {
+						(void)memmove(&line[pos + 1], &line[pos], length - pos);
+						line[pos] = alphabet[unitTestRandom() % (sizeof(alphabet) - 1)];
+						length++;
+					}
+					break;
+				default:
+					(void)memmove(&line[pos], &line[pos + 1], length - pos - 1);
+					length--;
+					break;
+				}
+			}
+		} else {
+			// Random bytes, mostly from the protocol alphabet
+			length = unitTestRandom() % sizeof(line);
+			for (size_t n = 0; n < length; n++) {
+				line[n] = unitTestRandom() & 0x0F ? alphabet[unitTestRandom() % (sizeof(alphabet) - 1)] :
+				          (char)unitTestRandom();
+			}
+		}
+		MyMessage msg;
+		const uint8_t result = parse(msg, line, length);
+		TEST_ASSERT(result <= PROTOCOL_PARSE_ERROR_PAYLOAD);
+		if (result == PROTOCOL_PARSE_OK) {
+			accepted++;
+			TEST_ASSERT(msg.getLength() <= MAX_PAYLOAD_SIZE);
+			TEST_ASSERT(msg.getCommand() <= C_STREAM);
+		}
+	}
+	printf("    %u of %u fuzzed lines accepted\n", accepted, FUZZ_ROUNDS);
+	// Both outcomes have to be exercised
+	TEST_ASSERT(accepted > FUZZ_ROUNDS / 20 && accepted < FUZZ_ROUNDS / 2);
+}
+
+int main(void)
+{
+	printf("Controller text protocol parser\n");
+	TEST_RUN(testLegacyEquivalence);
+	TEST_RUN(testValidLines);
+	TEST_RUN(testLineEndings);
+	TEST_RUN(testMalformedHeader);
+	TEST_RUN(testMalformedPayload);
+	TEST_RUN(testTruncated);
+	TEST_RUN(testFuzz);
+	return unitTestResult();
+}
@@ -0,0 +1,280 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+// Known answer tests of the generic SHA256 and HMAC-SHA256, run once per block kernel:
+// the portable C one, and the SHA extension one the runtime dispatch picks when the CPU has it.
+// - FIPS 180-4 example messages, one million 'a' included;
+// - digests of every message length 0..300 and of HMACs with key lengths 0..130, checked as
+//   one digest over all of them (values from Python hashlib/hmac);
+// - RFC 4231 HMAC-SHA256 test cases through the one shot, precomputed key and legacy APIs;
+// - random split points, interleaved contexts, and the kernels against each other.
+
+#include <stdint.h>
+#include <inttypes.h>
+#include <string.h>
+
+#include "MyConfig.h"
+#include "core/MySensorsCore.h"
+#include "hal/crypto/generic/MyCryptoGeneric.cpp"
+#include "unit_test.h"
+
+typedef void (*kernel_t)(uint32_t *state, const uint8_t *data, size_t blocks);
+
+static void useKernel(const kernel_t kernel)
+{
+#if defined(SHA256_HW_DISPATCH)
+	SHA256CompressImpl = kernel;
+#else
+	(void)kernel;
+#endif
+}
+
+static bool sameHash(const uint8_t *hash, const char *hex, const uint8_t length = HASH_LENGTH)
+{
+	for (uint8_t i = 0; i < length; i++) {
+		unsigned int value;
+		if (sscanf(&hex[2 * i], "%2x", &value) != 1 || hash[i] != value) {
+			return false;
+		}
+	}
+	return true;
+}
+
+static void pattern(uint8_t *dest, const size_t length, const uint8_t seed)
+{
+	for (size_t i = 0; i < length; i++) {
+		dest[i] = (uint8_t)(i * 31 + seed);
+	}
+}
+
+static void testFips(void)
+{
+	static const struct {
+		const char *message;
+		const char *hash;
+	} vectors[] = {
+		{ "", "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855" },
+		{ "abc", "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad" },
+		{
+			"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+			"248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"
+		},
+		{
+			"abcdefghbcdefghicdefghijdefghijkefghijklfghijklmghijklmnhijklmnoijklmnopjklmnopqklmnopqrlmnopqrsmnopqrstnopqrstu",
+			"cf5b16a778af8380036ce59e7b0492370b249b11e8f07a51afac45037afee9d1"
+		},
+	};
+	uint8_t hash[HASH_LENGTH];
+	for (uint8_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		const uint8_t *message = (const uint8_t *)vectors[i].message;
+		const size_t length = strlen(vectors[i].message);
+		SHA256(hash, message, length);
+		TEST_ASSERT(sameHash(hash, vectors[i].hash));
+		// Byte by byte through the single-instance API
+		SHA256Init();
+		for (size_t n = 0; n < length; n++) {
+			SHA256Add(message[n]);
+		}
+		SHA256Result(hash);
+		TEST_ASSERT(sameHash(hash, vectors[i].hash));
+	}
+
+	uint8_t block[1000];
+	(void)memset(block, 'a', sizeof(block));
+	SHA256Context_t ctx;
+	SHA256Init(&ctx);
+	for (uint16_t i = 0; i < 1000; i++) {
+		SHA256Add(&ctx, block, sizeof(block));
+	}
+	SHA256Result(&ctx, hash);
+	TEST_ASSERT(sameHash(hash, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"));
+}
+
+static void testLengths(void)
+{
+	// Every padding case: tails of 0..63 bytes, with and without an extra length block
+	uint8_t message[300];
+	SHA256Context_t all;
+	SHA256Init(&all);
+	for (uint16_t length = 0; length <= sizeof(message); length++) {
+		uint8_t hash[HASH_LENGTH];
+		pattern(message, length, (uint8_t)length);
+		SHA256(hash, message, length);
+		SHA256Add(&all, hash, HASH_LENGTH);
+	}
+	uint8_t hash[HASH_LENGTH];
+	SHA256Result(&all, hash);
+	TEST_ASSERT(sameHash(hash, "2508c478cc7c1417db7b6e5532ddda7c5c497ad1e51c11df37059147d9b81354"));
+}
+
+static void testSplit(void)
+{
+	uint8_t message[1024];
+	unitTestSeed(1);
+	for (uint16_t i = 0; i < 500; i++) {
+		const size_t length = unitTestRandom() % sizeof(message);
+		for (size_t n = 0; n < length; n++) {
+			message[n] = (uint8_t)unitTestRandom();
+		}
+		uint8_t expected[HASH_LENGTH], hash[HASH_LENGTH];
+		SHA256(expected, message, length);
+		SHA256Context_t ctx;
+		SHA256Init(&ctx);
+		for (size_t pos = 0; pos < length;) {
+			const size_t chunk = 1 + unitTestRandom() % (length - pos < 150 ? length - pos : 150);
+			SHA256Add(&ctx, &message[pos], chunk);
+			pos += chunk;
+		}
+		SHA256Result(&ctx, hash);
+		TEST_ASSERT(!memcmp(hash, expected, HASH_LENGTH));
+	}
+}
+
+static void testInterleaved(void)
+{
+	// Two calculations on separate contexts must not disturb each other
+	SHA256Context_t a, b;
+	uint8_t hash[HASH_LENGTH];
+	SHA256Init(&a);
+	SHA256Init(&b);
+	SHA256Add(&a, (const uint8_t *)"abcdbcdecdefdefgefghfghighijhijk", 32);
+	SHA256Add(&b, (const uint8_t *)"a", 1);
+	SHA256Add(&a, (const uint8_t *)"ijkljklmklmnlmnomnopnopq", 24);
+	SHA256Add(&b, (const uint8_t *)"bc", 2);
+	SHA256Result(&a, hash);
+	TEST_ASSERT(sameHash(hash, "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"));
+	SHA256Result(&b, hash);
+	TEST_ASSERT(sameHash(hash, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+}
+
+static void testHmac(void)
+{
+	static const uint8_t key4[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d,
+	                                0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13, 0x14, 0x15, 0x16, 0x17, 0x18, 0x19
+	                              };
+	uint8_t key[131], data[50];
+	uint8_t hash[HASH_LENGTH];
+	SHA256HMACKey_t hmacKey;
+
+	// RFC 4231 test cases 1 to 7
+	const struct {
+		const uint8_t *key;
+		size_t keyLength;
+		const uint8_t *data;
+		size_t dataLength;
+		const char *hmac;
+		uint8_t hmacLength;
+	} vectors[] = {
+		{ (const uint8_t *)"\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b\x0b", 20, (const uint8_t *)"Hi There", 8, "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7", HASH_LENGTH },
+		{ (const uint8_t *)"Jefe", 4, (const uint8_t *)"what do ya want for nothing?", 28, "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843", HASH_LENGTH },
+		{ key, 20, data, 50, "773ea91e36800e46854db8ebd09181a72959098b3ef8c122d9635514ced565fe", HASH_LENGTH },
+		{ key4, sizeof(key4), data, 50, "82558a389a443c0ea4cc819899f2083a85f0faa3e578f8077a2e3ff46729665b", HASH_LENGTH },
+		{ (const uint8_t *)"\x0c\x0c\x0c\x0c\x0c\x0c\x0c\x0c\x0c\x0c\x0c\x0c\x0c\x0c\x0c\x0c\x0c\x0c\x0c\x0c", 20, (const uint8_t *)"Test With Truncation", 20, "a3b6167473100ee06e0c796c2955552b", 16 },
+		{ key, 131, (const uint8_t *)"Test Using Larger Than Block-Size Key - Hash Key First", 54, "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54", HASH_LENGTH },
+		{ key, 131, (const uint8_t *)"This is a test using a larger than block-size key and a larger than block-size data. The key needs to be hashed before being used by the HMAC algorithm.", 152, "9b09ffa71b942fcb27635fbcd5b0e944bfdc63644f0713938a7f51535c3a35e2", HASH_LENGTH },
+	};
+	(void)memset(key, 0xaa, sizeof(key));
+	for (uint8_t i = 0; i < sizeof(vectors) / sizeof(vectors[0]); i++) {
+		// Test cases 3 and 4 share the key buffers but not the data
+		(void)memset(data, i == 2 ? 0xdd : 0xcd, sizeof(data));
+		SHA256HMAC(hash, vectors[i].key, vectors[i].keyLength, vectors[i].data, vectors[i].dataLength);
+		TEST_ASSERT(sameHash(hash, vectors[i].hmac, vectors[i].hmacLength));
+		SHA256HMACKeyInit(&hmacKey, vectors[i].key, vectors[i].keyLength);
+		SHA256HMAC(hash, &hmacKey, vectors[i].data, vectors[i].dataLength);
+		TEST_ASSERT(sameHash(hash, vectors[i].hmac, vectors[i].hmacLength));
+		SHA256HMACInit(vectors[i].key, vectors[i].keyLength);
+		for (size_t n = 0; n < vectors[i].dataLength; n++) {
+			SHA256HMACAdd(vectors[i].data[n]);
+		}
+		SHA256HMACResult(hash);
+		TEST_ASSERT(sameHash(hash, vectors[i].hmac, vectors[i].hmacLength));
+	}
+
+	// Key lengths 0..130: padded, exactly one block and hashed keys
+	uint8_t message[100];
+	pattern(message, sizeof(message), 3);
+	SHA256Context_t all;
+	SHA256Init(&all);
+	for (uint8_t keyLength = 0; keyLength <= 130; keyLength++) {
+		pattern(key, keyLength, (uint8_t)(keyLength * 13 + 1));
+		SHA256HMAC(hash, key, keyLength, message, sizeof(message));
+		SHA256Add(&all, hash, HASH_LENGTH);
+	}
+	SHA256Result(&all, hash);
+	TEST_ASSERT(sameHash(hash, "62efe2d811e0dc218b06c8d0794cdd5ea02e3de8137b8063eee7aee1d45d2eae"));
+}
+
+static void testKernel(const char *name, const kernel_t kernel)
+{
+	printf("  %s kernel\n", name);
+	useKernel(kernel);
+	TEST_RUN(testFips);
+	TEST_RUN(testLengths);
+	TEST_RUN(testSplit);
+	TEST_RUN(testInterleaved);
+	TEST_RUN(testHmac);
+}
+
+#if defined(SHA256_HW_DISPATCH)
+static void testDispatch(void)
+{
+	// The first hash resolves the kernel
+	uint8_t hash[HASH_LENGTH];
+	SHA256CompressImpl = SHA256CompressResolve;
+	SHA256(hash, (const uint8_t *)"abc", 3);
+	TEST_ASSERT(sameHash(hash, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"));
+	TEST_ASSERT(SHA256CompressImpl == (SHA256HwAvailable() ? SHA256CompressHw :
+	                                   SHA256CompressGeneric));
+}
+
+static void testKernelsAgree(void)
+{
+	uint8_t block[BLOCK_LENGTH * 8];
+	unitTestSeed(2);
+	for (uint16_t i = 0; i < 2000; i++) {
+		uint32_t generic[8], hw[8];
+		const size_t blocks = 1 + unitTestRandom() % 8;
+		for (uint8_t n = 0; n < 8; n++) {
+			generic[n] = hw[n] = unitTestRandom();
+		}
+		for (size_t n = 0; n < blocks * BLOCK_LENGTH; n++) {
+			block[n] = (uint8_t)unitTestRandom();
+		}
+		SHA256CompressGeneric(generic, block, blocks);
+		SHA256CompressHw(hw, block, blocks);
+		TEST_ASSERT(!memcmp(generic, hw, sizeof(hw)));
+	}
+}
+#endif
+
+int main(void)
+{
+	printf("SHA256 and HMAC-SHA256\n");
+	testKernel("generic", SHA256CompressGeneric);
+#if defined(SHA256_HW_DISPATCH)
+	TEST_RUN(testDispatch);
+	if (SHA256HwAvailable()) {
+		testKernel("SHA extension", SHA256CompressHw);
+		TEST_RUN(testKernelsAgree);
+	} else {
+		printf("  no SHA extensions on this CPU, hardware kernel not tested\n");
+	}
+#endif
+	return unitTestResult();
+}
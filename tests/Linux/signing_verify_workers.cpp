@@ -0,0 +1,356 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+// Soft signing with MY_SIGNING_SOFT_VERIFY_WORKERS: received messages go through
+// signerVerifyMsgSubmit() and come back from signerVerifyMsgCollect(), verified by the main
+// thread (no worker running), by one worker and by all of them.
+// - a random mix of valid signed, unsigned, corrupted, replayed, unrequested and unchecked
+//   messages comes back in arrival order with the verdict signerVerifyMsg() would give;
+// - the nonce of a signed message is consumed when it is queued and never accepted twice;
+// - a full queue refuses messages, and the ring wraps around as messages are collected.
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/param.h>
+
+#define MY_SIGNING_SOFT
+#define MY_SIGNING_REQUEST_SIGNATURES
+#define MY_SIGNING_SIMPLE_PASSWD "0123456789abcdef0123456789abcdef"
+#define MY_SIGNING_SOFT_VERIFY_WORKERS (4u)
+#define MY_SIGNING_SOFT_NONCE_TABLE_SIZE (32u)
+
+#include "MyConfig.h"
+#include "core/MySensorsCore.h"
+#include "hal/architecture/MyHwHAL.h"
+#include "core/MyHelperFunctions.cpp"
+#include "core/MyMessage.cpp"
+#include "hal/architecture/Linux/drivers/core/noniso.cpp"
+#include "hal/crypto/generic/MyCryptoGeneric.cpp"
+#include "unit_test.h"
+
+#define NODE_ID (0u)	// The gateway verifies what the nodes send it
+
+static uint32_t simMillis;
+
+uint32_t hwMillis(void)
+{
+	return simMillis;
+}
+
+void hwReadConfigBlock(void *buf, void *addr, size_t length)
+{
+	(void)addr;
+	(void)memset(buf, 0xFF, length);
+}
+
+void hwWriteConfigBlock(void *buf, void *addr, size_t length)
+{
+	(void)buf;
+	(void)addr;
+	(void)length;
+}
+
+void hwRandomNumberInit(void)
+{
+}
+
+bool hwUniqueID(unique_id_t *uniqueID)
+{
+	(void)uniqueID;
+	return false;
+}
+
+#define MY_HW_HAS_GETENTROPY
+ssize_t hwGetentropy(void *__buffer, size_t __length)
+{
+	for (size_t i = 0; i < __length; i++) {
+		((uint8_t *)__buffer)[i] = (uint8_t)unitTestRandom();
+	}
+	return (ssize_t)__length;
+}
+
+void logError(const char *fmt, ...)
+{
+	(void)fmt;
+}
+
+uint8_t getNodeId(void)
+{
+	return NODE_ID;
+}
+
+bool _sendRoute(MyMessage &message)
+{
+	(void)message;
+	return true;
+}
+
+void _process(const uint32_t timeoutMS)
+{
+	(void)timeoutMS;
+}
+
+bool wait(const uint32_t waitingMS, const mysensors_command_t cmd, const uint8_t msgtype)
+{
+	(void)waitingMS;
+	(void)cmd;
+	(void)msgtype;
+	return false;
+}
+
+#include "core/MySigning.cpp"
+#include "core/MySigningAtsha204Soft.cpp"
+
+#define QUEUE_CAPACITY (SIGN_VERIFY_QUEUE_SIZE - 1u)
+#define COLLECT_TIMEOUT_S (10)
+
+enum {
+	KIND_SIGNED = 0,	// Signed with the nonce we handed out
+	KIND_UNSIGNED,	// Not signed although it has to be
+	KIND_CORRUPTED,	// Signed, payload changed afterwards
+	KIND_BAD_SIGNATURE,	// Signed, signature changed afterwards
+	KIND_REPLAYED,	// Copy of a message verified before, its nonce is gone
+	KIND_NO_NONCE,	// Signed with a nonce nobody asked us for
+	KIND_EXEMPT,	// Internal message that is never verified
+	KIND_NOT_FOR_US,	// Routed through us, verified by its destination
+	KIND_COUNT
+};
+
+static const bool kindVerified[KIND_COUNT] = { true, false, false, false, false, false, true, true };
+
+typedef struct {
+	uint32_t id;
+	uint8_t kind;
+} expected_t;
+
+static expected_t expected[SIGN_VERIFY_QUEUE_SIZE];
+static uint32_t nextId;
+static MyMessage lastSigned;
+static bool haveLastSigned;
+
+// What the sending node does: ask the gateway for a nonce, sign the message with it
+static void signAsNode(MyMessage &msg, const bool withNonce)
+{
+	MyMessage nonce;
+	nonce.clear();
+	nonce.setSender(msg.getSender());
+	nonce.setDestination(NODE_ID);
+	if (withNonce) {
+		TEST_ASSERT(signerAtsha204SoftGetNonce(nonce));
+	} else {
+		uint8_t bogus[32];
+		(void)hwGetentropy(bogus, sizeof(bogus));
+		nonce.set(bogus, MAX_PAYLOAD_SIZE);
+	}
+	signerAtsha204SoftPutNonce(nonce);
+	TEST_ASSERT(signerAtsha204SoftSignMsg(msg));
+}
+
+static void makeMessage(MyMessage &msg, const uint8_t kind, const uint8_t sender)
+{
+	msg.clear();
+	msg.setSender(sender);
+	msg.setDestination(kind == KIND_NOT_FOR_US ? NODE_ID + 100u : NODE_ID);
+	msg.setLast(sender);
+	msg.setSensor((uint8_t)(nextId % 200u));
+	if (kind == KIND_EXEMPT) {
+		msg.setCommand(C_INTERNAL);
+		msg.setType(I_HEARTBEAT_RESPONSE);
+	} else {
+		msg.setCommand(C_SET);
+		msg.setType(V_TEMP);
+	}
+	msg.set(nextId);
+	switch (kind) {
+	case KIND_SIGNED:
+		signAsNode(msg, true);
+		lastSigned = msg;
+		haveLastSigned = true;
+		break;
+	case KIND_CORRUPTED:
+		signAsNode(msg, true);
+		msg.data[0] ^= 0x01;
+		break;
+	case KIND_BAD_SIGNATURE:
+		signAsNode(msg, true);
+		msg.data[msg.getLength() + 1u] ^= 0x80;
+		break;
+	case KIND_NO_NONCE:
+		signAsNode(msg, false);
+		break;
+	case KIND_NOT_FOR_US:
+		signAsNode(msg, false);
+		break;
+	default:
+		break;
+	}
+}
+
+static bool collect(MyMessage &msg, bool *verified)
+{
+	const time_t start = time(NULL);
+	while (!signerVerifyMsgCollect(msg, verified)) {
+		if (time(NULL) - start > COLLECT_TIMEOUT_S) {
+			return false;
+		}
+		(void)sched_yield();
+	}
+	return true;
+}
+
+// Submit count random messages, then collect them all
+static void runBatch(const uint8_t count)
+{
+	for (uint8_t i = 0; i < count; i++) {
+		uint8_t kind = (uint8_t)(unitTestRandom() % KIND_COUNT);
+		if (kind == KIND_REPLAYED && !haveLastSigned) {
+			kind = KIND_UNSIGNED;
+		}
+		MyMessage msg;
+		const uint8_t sender = (uint8_t)(i + 1u);	// Every node has one outstanding nonce at most
+		if (kind == KIND_REPLAYED) {
+			msg = lastSigned;
+			haveLastSigned = false;
+		} else {
+			makeMessage(msg, kind, sender);
+		}
+		expected[i].id = msg.getULong();
+		expected[i].kind = kind;
+		nextId++;
+		TEST_ASSERT(signerVerifyMsgSubmit(msg));
+		// The nonce is gone as soon as the message is queued
+		TEST_ASSERT(signerNonceFind(msg.getSender()) == NULL);
+	}
+	for (uint8_t i = 0; i < count; i++) {
+		MyMessage msg;
+		bool verified = !kindVerified[expected[i].kind];
+		if (!collect(msg, &verified)) {
+			TEST_ASSERT(!"message not verified in time");
+			return;
+		}
+		TEST_ASSERT(msg.getULong() == expected[i].id);
+		TEST_ASSERT(verified == kindVerified[expected[i].kind]);
+		if (expected[i].kind != KIND_NOT_FOR_US) {
+			// Verification clears the flag of everything it looked at
+			TEST_ASSERT(!msg.getSigned());
+		}
+	}
+	MyMessage msg;
+	bool verified;
+	TEST_ASSERT(!signerVerifyMsgCollect(msg, &verified));
+}
+
+static void testMix(void)
+{
+	unitTestSeed(_signing_verify_workers + 1u);
+	for (uint16_t batch = 0; batch < 200; batch++) {
+		runBatch((uint8_t)(1u + unitTestRandom() % QUEUE_CAPACITY));
+	}
+}
+
+static void testNonceConsumedOnce(void)
+{
+	MyMessage msg;
+	makeMessage(msg, KIND_SIGNED, 7);
+	nextId++;
+	const MyMessage copy = msg;
+	MyMessage again = msg;
+	TEST_ASSERT(signerVerifyMsgSubmit(msg));
+	TEST_ASSERT(signerVerifyMsgSubmit(again));
+	// The node asks for a new nonce, the old message still must not verify with it
+	MyMessage nonce;
+	nonce.clear();
+	nonce.setSender(7);
+	TEST_ASSERT(signerAtsha204SoftGetNonce(nonce));
+	MyMessage late = copy;
+	TEST_ASSERT(signerVerifyMsgSubmit(late));
+	bool verified = false;
+	TEST_ASSERT(collect(msg, &verified) && verified);
+	TEST_ASSERT(collect(msg, &verified) && !verified);
+	TEST_ASSERT(collect(msg, &verified) && !verified);
+	// Rejected messages consume the nonce as well
+	TEST_ASSERT(signerNonceFind(7) == NULL);
+}
+
+static void testQueueFull(void)
+{
+	uint8_t queued = 0;
+	MyMessage msg;
+	for (;;) {
+		makeMessage(msg, queued % 2u ? KIND_SIGNED : KIND_UNSIGNED, (uint8_t)(queued + 1u));
+		nextId++;
+		if (!signerVerifyMsgSubmit(msg)) {
+			break;
+		}
+		queued++;
+	}
+	TEST_ASSERT(queued == QUEUE_CAPACITY);
+	TEST_ASSERT(signerVerifyMsgQueueFull());
+	// A refused message is left alone, its nonce is still there when it is submitted again
+	const uint8_t sender = msg.getSender();
+	TEST_ASSERT(signerNonceFind(sender) != NULL);
+	MyMessage refused = msg;
+	bool verified = false;
+	TEST_ASSERT(collect(msg, &verified) && !verified);
+	TEST_ASSERT(!signerVerifyMsgQueueFull());
+	TEST_ASSERT(signerVerifyMsgSubmit(refused));
+	TEST_ASSERT(signerNonceFind(sender) == NULL);
+	for (uint8_t i = 1; i < queued; i++) {
+		TEST_ASSERT(collect(msg, &verified) && verified == (i % 2u == 1u));
+	}
+	TEST_ASSERT(collect(msg, &verified) && verified);
+	TEST_ASSERT(msg.getSender() == sender);
+	TEST_ASSERT(!signerVerifyMsgCollect(msg, &verified));
+}
+
+static void runAll(void)
+{
+	TEST_RUN(testMix);
+	TEST_RUN(testNonceConsumedOnce);
+	TEST_RUN(testQueueFull);
+}
+
+int main(void)
+{
+	printf("Signature verification queue\n");
+	stateValid = true;
+	TEST_ASSERT(signerAtsha204SoftInit());
+
+	printf(" verified by the main thread\n");
+	runAll();
+
+	printf(" verified by one worker\n");
+	pthread_t thread;
+	TEST_ASSERT(pthread_create(&thread, NULL, signerVerifyWorker, NULL) == 0);
+	(void)pthread_detach(thread);
+	(void)pthread_mutex_lock(&_signing_verify_mutex);
+	_signing_verify_workers = 1;
+	(void)pthread_mutex_unlock(&_signing_verify_mutex);
+	runAll();
+
+	printf(" verified by %u workers\n", (unsigned int)MY_SIGNING_SOFT_VERIFY_WORKERS);
+	signerVerifyWorkersInit();
+	TEST_ASSERT(_signing_verify_workers == MY_SIGNING_SOFT_VERIFY_WORKERS);
+	runAll();
+
+	return unitTestResult();
+}
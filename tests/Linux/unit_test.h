@@ -0,0 +1,84 @@
+/*
+ * The MySensors Arduino library handles the wireless radio link and protocol
+ * between your home built sensors/actuators and HA controller of choice.
+ * The sensors forms a self healing radio network with optional repeaters. Each
+ * repeater and gateway builds a routing tables in EEPROM which keeps track of the
+ * network topology allowing messages to be routed to nodes.
+ *
+ * Created by Henrik Ekblad <henrik.ekblad@mysensors.org>
+ * Copyright (C) 2013-2022 Sensnology AB
+ * Full contributor list: https://github.com/mysensors/MySensors/graphs/contributors
+ *
+ * Documentation: http://www.mysensors.org
+ * Support Forum: http://forum.mysensors.org
+ *
+ * This program is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU General Public License
+ * version 2 as published by the Free Software Foundation.
+ */
+
+/**
+* @file unit_test.h
+*
+* Minimal assertions shared by the Linux host tests.
+*/
+
+#ifndef unit_test_h
+#define unit_test_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+static unsigned int _unit_test_checks = 0;
+static unsigned int _unit_test_failures = 0;
+
+/**
+ * Check a condition, report and count it when it does not hold. The test carries on.
+ */
+#define TEST_ASSERT(cond) do { \
+	_unit_test_checks++; \
+	if (!(cond)) { \
+		_unit_test_failures++; \
+		fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+	} \
+} while (0)
+
+/**
+ * Run a test case and print its name.
+ */
+#define TEST_RUN(test) do { \
+	printf("  %s\n", #test); \
+	test(); \
+} while (0)
+
+/**
+ * Deterministic PRNG (xorshift32), so every run of a test sees the same "random" input.
+ */
+static uint32_t _unit_test_random_state = 0x2545F491u;
+
+static inline void unitTestSeed(const uint32_t seed)
+{
+	_unit_test_random_state = seed ? seed : 0x2545F491u;
+}
+
+static inline uint32_t unitTestRandom(void)
+{
+	uint32_t x = _unit_test_random_state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return _unit_test_random_state = x;
+}
+
+/**
+ * Print the summary.
+ * @return Exit code for main().
+ */
+static inline int unitTestResult(void)
+{
+	printf("%u checks, %u failed\n", _unit_test_checks, _unit_test_failures);
+	return _unit_test_failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
+
+#endif // unit_test_h